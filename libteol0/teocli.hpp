@@ -144,6 +144,77 @@ public:
         return connected();
     }
 
+    /**
+     * Create client and start connecting to server without blocking
+     *
+     * Result is sent to event callback with EV_L_CONNECTED event by event
+     * loop calls, never before this method returns.
+     *
+     * @param server Server IP or name
+     * @param port Server port
+     * @param user_data Pointer to user data which will be send to event
+     *                  callback, may be NULL or Missed
+     * @param event_cb Pointer to event callback function, may be NULL or Missed
+     *
+     * @return connected status, 0 - connect is in progress
+     */
+    int connectAsync(const char *server, int port,
+        void *user_data, EventsCb event_cb, PROTOCOL connection_flag) {
+
+        eventCallBack = event_cb ? event_cb :
+          [](teo::Teocli &cli, teo::Events event, void *data,
+            size_t data_length, void *user_data) {
+            if(event != EV_L_TICK && event != EV_L_IDLE)
+            cli.eventCb(event, data, data_length, user_data);
+        };
+        userData = user_data;
+        con = teoLNullConnectAsync(server, port,
+                eventCallBack == NULL ? NULL : callbackBind, this, connection_flag);
+
+        return connected();
+    }
+
+    /**
+     * Create client and start resuming encrypted session without blocking
+     *
+     * @param server Server IP or name
+     * @param port Server port
+     * @param ticket Session ticket got by getSessionTicket
+     * @param user_data Pointer to user data which will be send to event
+     *                  callback, may be NULL
+     * @param event_cb Pointer to event callback function, may be NULL
+     *
+     * @return connected status, the same as of connectAsync
+     */
+    int connectResume(const char *server, int port,
+        const teoLNullSessionTicket *ticket, void *user_data,
+        EventsCb event_cb, PROTOCOL connection_flag) {
+
+        eventCallBack = event_cb ? event_cb :
+          [](teo::Teocli &cli, teo::Events event, void *data,
+            size_t data_length, void *user_data) {
+            if(event != EV_L_TICK && event != EV_L_IDLE)
+            cli.eventCb(event, data, data_length, user_data);
+        };
+        userData = user_data;
+        con = teoLNullConnectResume(server, port,
+                eventCallBack == NULL ? NULL : callbackBind, this,
+                connection_flag, ticket);
+
+        return connected();
+    }
+
+    /**
+     * Get ticket to resume encrypted session of this connection
+     *
+     * @param ticket [out] Session ticket
+     *
+     * @return true if connection has established encrypted session
+     */
+    bool getSessionTicket(teoLNullSessionTicket *ticket) {
+        return teoLNullGetSessionTicket(con, ticket);
+    }
+
     /**
      * Disconnect from server and free teoLNullConnectData
      *
@@ -229,6 +300,59 @@ public:
         return teoLNullSend(con, cmd, peer_name, data, data_length);
     }
 
+    /**
+     * Send command to L0 server from scatter/gather data parts
+     *
+     * Create L0 clients packet and send it to L0 server
+     *
+     * @param cmd Command
+     * @param peer_name Peer name to send to
+     * @param parts Array of data buffers
+     * @param n Number of buffers in parts
+     *
+     * @return Length of send data or -1 at error
+     */
+    ssize_t sendv(int cmd, const char *peer_name, const struct iovec *parts,
+            int n) {
+        return teoLNullSendv(con, cmd, peer_name, parts, n);
+    }
+
+    /**
+     * Send batch of commands to L0 server
+     *
+     * @param items Array of packets to send
+     * @param n Number of packets in items
+     *
+     * @return Length of send data or -1 at error
+     */
+    ssize_t sendBatch(const teoLNullSendItem *items, size_t n) {
+        return teoLNullSendBatch(con, items, n);
+    }
+
+    /**
+     * Reserve packet to write its data in place
+     *
+     * @param cmd Command
+     * @param peer_name Peer name to send to
+     * @param max_len Maximum length of data which will be written
+     *
+     * @return Pointer to packet data or NULL at error
+     */
+    void *reserve(int cmd, const char *peer_name, size_t max_len) {
+        return teoLNullPacketReserve(con, cmd, peer_name, max_len);
+    }
+
+    /**
+     * Send packet reserved by reserve()
+     *
+     * @param actual_len Length of data written to reserved packet
+     *
+     * @return Length of send data or -1 at error
+     */
+    ssize_t commit(size_t actual_len) {
+        return teoLNullPacketCommit(con, actual_len);
+    }
+
     /**
      * Send **UNRELIABLE** command to L0 server
      *
@@ -246,6 +370,56 @@ public:
         return teoLNullSendUnreliable(con, cmd, peer_name, data, data_length);
     }
 
+    /**
+     * Open handle of peer to send packets to
+     *
+     * @param peer_name Peer name
+     *
+     * @return Peer handle, should be closed by peerClose, or NULL at error
+     */
+    teoLNullPeerHandle *peerOpen(const char *peer_name) {
+        return teoLNullPeerOpen(con, peer_name);
+    }
+
+    /**
+     * Close peer handle
+     *
+     * @param peer Peer handle
+     */
+    void peerClose(teoLNullPeerHandle *peer) {
+        teoLNullPeerClose(peer);
+    }
+
+    /**
+     * Send command to pre-resolved peer
+     *
+     * @param peer Peer handle
+     * @param cmd Command
+     * @param data Pointer to data
+     * @param data_length Length of data
+     *
+     * @return Length of send data or -1 at error
+     */
+    ssize_t send(teoLNullPeerHandle *peer, int cmd, const void *data,
+            size_t data_length) {
+        return teoLNullPeerSend(peer, cmd, data, data_length);
+    }
+
+    /**
+     * Send **UNRELIABLE** command to pre-resolved peer
+     *
+     * @param peer Peer handle
+     * @param cmd Command
+     * @param data Pointer to data
+     * @param data_length Length of data
+     *
+     * @return Length of send data or -1 at error
+     */
+    ssize_t sendUnreliable(teoLNullPeerHandle *peer, int cmd, const void *data,
+            size_t data_length) {
+        return teoLNullPeerSendUnreliable(peer, cmd, data, data_length);
+    }
+
     /**
      * Send Echo command
      *
@@ -305,6 +479,58 @@ public:
         cli->eventLoop();
     }
 
+    /**
+     * Get descriptors to watch in application event loop
+     *
+     * @param fds Array to fill, may be NULL to get number of descriptors
+     * @param fds_length Length of fds array
+     *
+     * @return Number of connection descriptors
+     */
+    size_t pollFds(teoLNullPollFd *fds, size_t fds_length) const {
+        return teoLNullGetPollFds(con, fds, fds_length);
+    }
+
+    /**
+     * Get time to wait in application event loop before onTimer call
+     *
+     * @return Timeout in microseconds
+     */
+    uint64_t nextTimeoutUs() const {
+        return teoLNullGetNextTimeoutUs(con);
+    }
+
+    /**
+     * Process readable descriptor returned by pollFds
+     *
+     * @param fd Readable descriptor
+     *
+     * @return false if connection was closed
+     */
+    bool onReadable(teonetSocket fd) {
+        return teoLNullOnReadable(con, fd);
+    }
+
+    /**
+     * Process writable descriptor returned by pollFds, flushes queued output
+     *
+     * @param fd Writable descriptor
+     *
+     * @return false if connection was closed
+     */
+    bool onWritable(teonetSocket fd) {
+        return teoLNullOnWritable(con, fd);
+    }
+
+    /**
+     * Process connection timers when nextTimeoutUs expires
+     *
+     * @return false if connection was closed
+     */
+    bool onTimer() {
+        return teoLNullOnTimer(con);
+    }
+
     /**
      * Sleep
      *
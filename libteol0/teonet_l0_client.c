@@ -15,9 +15,17 @@
 
 #include "teonet_l0_client.h"
 #include "teonet_l0_client_crypt.h"
+#include "teonet_l0_client_kex.h"
+#include "teonet_l0_client_keypool.h"
+#include "teonet_l0_client_queue.h"
+#include "teonet_l0_client_reactor.h"
+#include "teonet_l0_client_resolve.h"
+#include "teonet_l0_client_udp.h"
+#include "teonet_l0_client_uring.h"
 
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -28,18 +36,28 @@
 #if defined(TEONET_OS_WINDOWS)
 #include <fcntl.h>
 #include <io.h>
+#include <ws2tcpip.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #endif
 
 #if defined(TEONET_OS_LINUX) || defined(TEONET_OS_MACOS) ||                    \
     defined(TEONET_OS_IOS) || defined(TEONET_OS_ANDROID)
+#include <arpa/inet.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
+#include <sched.h>
 #include <sys/select.h>
 #include <sys/time.h>
 #include <unistd.h>
 #endif
 
+#if defined(TEONET_OS_LINUX) || defined(TEONET_OS_ANDROID)
+#include <sys/eventfd.h>
+#define HAVE_EVENTFD 1
+#endif
+
 #include "teobase/logging.h"
 #include "teobase/socket.h"
 #include "teobase/time.h"
@@ -50,6 +68,16 @@
 #define DEBUG 0
 // Application constants
 #define BUFFER_SIZE 4096
+// Maximum data size of one TR-UDP data block
+#define TRUDP_FRAGMENT_SIZE 512
+// Initial and minimal size of receive ring
+#define RECV_RING_MIN_SIZE (L0_BUFFER_SIZE * 4)
+// Maximum number of packets in one EV_L_RECEIVED_BATCH event
+#define RECV_BATCH_SIZE 64
+// Maximum number of datagrams collected by TR-UDP select loop iteration
+#define UDP_SEND_BATCH_SIZE 64
+// Interval of EV_L_IDLE events without input in application event loop
+#define IDLE_INTERVAL_US 1000000
 
 #define SEND_MESSAGE_AFTER 1000000
 
@@ -59,29 +87,33 @@ extern bool teocliOpt_DBG_selectLoop;
 extern bool teocliOpt_DBG_sentPackets;
 extern bool teocliOpt_PacketDataChecksumInR2;
 extern int32_t teocliOpt_MaximumReceiveInSelect;
+extern int32_t teocliOpt_UdpReceiveBatchSize;
+extern int32_t teocliOpt_ReceiveTimeBudgetUs;
+extern bool teocliOpt_UdpSendBatch;
+extern bool teocliOpt_UdpSegmentOffload;
 extern int32_t teocliOpt_ConnectTimeoutMs;
+extern int32_t teocliOpt_SendQueueSize;
+extern int32_t teocliOpt_ReceiveChunkSize;
+extern bool teocliOpt_ReceiveBatchEvent;
+extern bool teocliOpt_IoUring;
 extern teoLNullEncryptionProtocol teocliOpt_EncryptionProtocol;
 
 // Internal functions
-static ssize_t teoLNullPacketSplit(teoLNullConnectData *con, void *data,
-                                   size_t data_len, ssize_t received);
+static ssize_t teoLNullPacketSplit(teoLNullConnectData *con, const void *data,
+                                   size_t received);
 static void trudpEventCback(void *tcd_pointer, int event, void *data,
                             size_t data_length, void *user_data);
 static teoLNullConnectData *
 _teoLNullConnectionInitiate(teoLNullConnectData *con,
                             teoLNullEncryptionProtocol enc_proto);
 static void teoLNullPacketUpdateHeaderChecksum(teoLNullCPacket *packet);
-static void teoLNullPacketUpdateChecksums(teoLNullCPacket *packet);
+static bool _teoLNullConnectProcess(teoLNullConnectData *con);
+static size_t _teoLNullRecvDispatch(teoLNullConnectData *con);
 
 #if defined(HAVE_MINGW) || defined(_WIN32)
 void TEOCLI_API WinSleep(uint32_t dwMilliseconds) { Sleep(dwMilliseconds); }
 #endif
 
-typedef struct teoPipeSendData {
-    size_t data_length;
-    char *data;
-} teoPipeSendData;
-
 static void send_l0_event(teoLNullConnectData *con, teoLNullEvents event,
                           void *data, size_t data_length) {
     if (con->event_cb != NULL) {
@@ -116,330 +148,1452 @@ void teoLNullInit() { teosockInit(); }
 /**
  * Cleanup L0 client library.
  *
- * Cleanup windows socket library.
+ * Stop key exchange workers and ECDH key pool and cleanup windows socket
+ * library.
  * Calls once per application to cleanup this client library.
  */
-void teoLNullCleanup() { teosockCleanup(); }
+void teoLNullCleanup() {
+    teoLNullKexWorkersSetCount(0);
+    teoLNullKeyPoolSetDepth(0);
+    teosockCleanup();
+}
 
 /**
- * Create L0 client packet
+ * Get total length of scatter/gather parts
  *
- * @param buffer Buffer to create packet in
- * @param buffer_length Buffer length
- * @param command Command to peer
- * @param peer Teonet peer
- * @param data Command data
- * @param data_length Command data length
+ * @param parts Array of buffers
+ * @param n Number of buffers in @a parts
  *
- * @return Length of created packet or zero if buffer to less
+ * @return Summary length of all buffers
  */
-size_t teoLNullPacketCreate(teoLNullEncryptionContext *ctx, void *buffer,
-                            size_t buffer_length, uint8_t command,
-                            const char *peer, const uint8_t *data,
-                            size_t data_length) {
-    size_t peer_name_length = strlen(peer) + 1;
-
-    // Check buffer length
-    if (buffer_length < teoLNullBufferSize(peer_name_length, data_length)) {
-        LTRACK_E("TeonetClient", "Insufficient buffer size");
-        abort();
+static size_t _iovLength(const struct iovec *parts, int n) {
+    size_t length = 0;
+    for (int i = 0; i < n; ++i) {
+        length += parts[i].iov_len;
     }
 
-    teoLNullCPacket *pkg = (teoLNullCPacket *)buffer;
-    memset(buffer, 0, sizeof(teoLNullCPacket));
-
-    pkg->cmd = command;
-    pkg->data_length = (uint16_t)data_length;
-    pkg->peer_name_length = (uint8_t)peer_name_length;
-
-    char *packet_peer_name = teoLNullPacketGetPeerName(pkg);
-    uint8_t *packet_data = teoLNullPacketGetData(pkg);
+    return length;
+}
 
-    memcpy(packet_peer_name, peer, pkg->peer_name_length);
-    memcpy(packet_data, data, pkg->data_length);
+/**
+ * Calculate byte checksum of scatter/gather parts
+ *
+ * Byte checksum is a plain sum, so checksums of the parts are just added.
+ *
+ * @param parts Array of buffers
+ * @param n Number of buffers in @a parts
+ *
+ * @return Byte checksum of all buffers
+ */
+static uint8_t _iovChecksum(const struct iovec *parts, int n) {
+    uint8_t checksum = 0;
+    for (int i = 0; i < n; ++i) {
+        if (parts[i].iov_len == 0) { continue; }
+        checksum += get_byte_checksum((const uint8_t *)parts[i].iov_base,
+                                      parts[i].iov_len);
+    }
 
-    if (teocliOpt_PacketDataChecksumInR2) {
-        uint8_t extra_checksum = get_byte_checksum(data, data_length);
+    return checksum;
+}
 
-        // Additional check is not performed when checksum field value is zero.
-        // Value 1 is used for both 0 and 1 checksum to avoid skipping check
-        // on packets with data checksum equal to zero.
-        if (extra_checksum == 0) {
-            ++extra_checksum;
+/**
+ * Copy range of scatter/gather parts to contiguous buffer
+ *
+ * @param dest Destination buffer
+ * @param parts Array of buffers
+ * @param n Number of buffers in @a parts
+ * @param offset Offset of first byte to copy
+ * @param length Number of bytes to copy
+ *
+ * @return Number of bytes copied
+ */
+static size_t _iovCopy(uint8_t *dest, const struct iovec *parts, int n,
+                       size_t offset, size_t length) {
+    size_t copied = 0;
+    for (int i = 0; i < n && copied < length; ++i) {
+        size_t part_len = parts[i].iov_len;
+        if (offset >= part_len) {
+            offset -= part_len;
+            continue;
         }
 
-        // The problem is only reproduced with command 150.
-        if (command == 150) {
-            char packet_id[5];
-
-            // Get string identifier of the command data
-            // (this is specific for command 150).
-            if (data_length > 12) {
-                memcpy(packet_id, data + 8, 4);
-                packet_id[4] = 0;
-            } else {
-                packet_id[0] = 0;
-            }
-
-            LTRACK_I("TeonetClient",
-                     "Scheduling to send META packet %u bytes with checksum "
-                     "%#04x and "
-                     "packet id %s.",
-                     (uint32_t)data_length, extra_checksum, packet_id);
-        }
+        size_t len = part_len - offset;
+        if (len > length - copied) { len = length - copied; }
 
-        pkg->reserved_2 = extra_checksum;
+        memcpy(dest + copied, (const uint8_t *)parts[i].iov_base + offset, len);
+        copied += len;
+        offset = 0;
     }
 
-    teoLNullPacketEncrypt(ctx, pkg);
-
-    teoLNullPacketUpdateChecksums(pkg);
-
-    return teoLNullBufferSize(pkg->peer_name_length, pkg->data_length);
+    return copied;
 }
 
-static ssize_t _teosockSend(teoLNullConnectData *con, const char *data,
-                            size_t length) {
-    if (con->tcp_f) {
-        return teosockSend(con->fd, data, length);
-    } else {
-        teoPipeSendData pipe_send_data;
-        memset(&pipe_send_data, 0, sizeof(pipe_send_data));
-
-        pipe_send_data.data_length = length;
-        pipe_send_data.data = (char*)ccl_malloc(length);
-
-        memcpy(pipe_send_data.data, data, length);
-
-// Write to pipe
-#if defined(_WIN32)
-        ssize_t write_result =
-            _write(con->pipefd[1], &pipe_send_data, sizeof(pipe_send_data));
-        SetEvent(con->handles[1]);
-#else
-        ssize_t write_result =
-            write(con->pipefd[1], &pipe_send_data, sizeof(pipe_send_data));
-#endif
+/**
+ * Set additional packet data checksum to reserved_2 field
+ *
+ * @param pkg Pointer to packet
+ * @param extra_checksum Byte checksum of packet data
+ * @param parts Packet data buffers
+ * @param n Number of buffers in @a parts
+ */
+static void teoLNullPacketSetDataChecksum(teoLNullCPacket *pkg,
+                                          uint8_t extra_checksum,
+                                          const struct iovec *parts, int n) {
+    // Additional check is not performed when checksum field value is zero.
+    // Value 1 is used for both 0 and 1 checksum to avoid skipping check
+    // on packets with data checksum equal to zero.
+    if (extra_checksum == 0) {
+        ++extra_checksum;
+    }
 
-        if (write_result == -1) {
-            LTRACK_E("TeonetClient",
-                     "Failed to write message to the pipe: write error.");
-            abort();
-        }
+    // The problem is only reproduced with command 150.
+    if (pkg->cmd == 150) {
+        char packet_id[5];
 
-        if ((size_t)write_result != sizeof(pipe_send_data)) {
-            LTRACK_E("TeonetClient", "Failed to write message to the pipe: "
-                                     "message written partially.");
-            abort();
+        // Get string identifier of the command data
+        // (this is specific for command 150).
+        if (pkg->data_length > 12) {
+            _iovCopy((uint8_t *)packet_id, parts, n, 8, 4);
+            packet_id[4] = 0;
+        } else {
+            packet_id[0] = 0;
         }
 
-        return length;
+        LTRACK_I("TeonetClient",
+                 "Scheduling to send META packet %u bytes with checksum "
+                 "%#04x and "
+                 "packet id %s.",
+                 (uint32_t)pkg->data_length, extra_checksum, packet_id);
     }
+
+    pkg->reserved_2 = extra_checksum;
 }
 
 /**
- * Send packet to L0 server/client
+ * Set packet payload checksum and header checksum of built packet
  *
- * @param con Pointer to teoLNullConnectData
- * @param data Package to send
- * @param data_length Package length
+ * Payload of packet protected by authenticated encryption has zero
+ * checksum, its tag is checked instead.
  *
- * @return Length of send data or -1 at error
+ * @param ctx Encryption context packet was encrypted with, may be NULL
+ * @param pkg Pointer to packet
+ * @param peer_checksum Byte checksum of peer name
+ * @param data_checksum Byte checksum of packet data as written
  */
-ssize_t teoLNullPacketSend(teoLNullConnectData *con, const char *data,
-                           size_t data_length) {
-    if (con != NULL) {
-        return _teosockSend(con, data, data_length);
+static void _teoLNullPacketSetChecksums(const teoLNullEncryptionContext *ctx,
+                                        teoLNullCPacket *pkg,
+                                        uint8_t peer_checksum,
+                                        uint8_t data_checksum) {
+    if (teoLNullPacketIsAuthenticated(ctx, pkg)) {
+        pkg->checksum = 0;
     } else {
-        return -1;
+        pkg->checksum = peer_checksum + data_checksum;
     }
+    teoLNullPacketUpdateHeaderChecksum(pkg);
 }
 
 /**
- * Send command to L0 server
+ * Fill L0 client packet header and peer name
  *
- * Create L0 clients packet and send it to L0 server
- *
- * @param con Pointer to teoLNullConnectData
- * @param cmd Command
- * @param peer_name Peer name to send to
- * @param data Pointer to data
- * @param data_length Length of data
+ * Packet data is not touched, checksums are not calculated.
  *
- * @return Length of send data or -1 at error
+ * @param pkg Buffer to create packet header in
+ * @param command Command to peer
+ * @param peer Teonet peer
+ * @param peer_name_length Length of @a peer including leading zero
+ * @param data_length Command data length
  */
-ssize_t teoLNullSend(teoLNullConnectData *con, uint8_t cmd,
-                     const char *peer_name, const void *data,
-                     size_t data_length) {
-    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
-            "Sending reliable data %u bytes.", (uint32_t)data_length);
+static void teoLNullPacketFillHeader(teoLNullCPacket *pkg, uint8_t command,
+                                     const char *peer, size_t peer_name_length,
+                                     size_t data_length) {
+    memset(pkg, 0, sizeof(teoLNullCPacket));
 
-    if (data == NULL) { data_length = 0; }
-
-    const size_t peer_length = strlen(peer_name) + 1;
-    const size_t buf_length = teoLNullBufferSize(peer_length, data_length);
-    char *buf = (char*)ccl_malloc(buf_length);
-
-    size_t pkg_length = teoLNullPacketCreate(con->client_crypt, buf, buf_length,
-                                             cmd, peer_name, data, data_length);
-    ssize_t snd = _teosockSend(con, buf, pkg_length);
-
-    free(buf);
+    pkg->cmd = command;
+    pkg->data_length = (uint16_t)data_length;
+    pkg->peer_name_length = (uint8_t)peer_name_length;
 
-    return snd;
+    memcpy(teoLNullPacketGetPeerName(pkg), peer, peer_name_length);
 }
 
-ssize_t teoLNullSendUnreliable(teoLNullConnectData *con, uint8_t cmd,
-                               const char *peer_name, const void *data,
-                               size_t data_length) {
-    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
-            "Sending unreliable data %u bytes.", (uint32_t)data_length);
+/**
+ * Check if packet payload will be encrypted by teoLNullPacketEncrypt
+ *
+ * @param ctx Encryption context
+ * @param data_length Packet data length
+ *
+ * @return true if payload should be encrypted
+ */
+static inline bool _teoLNullWillEncrypt(teoLNullEncryptionContext *ctx,
+                                        size_t data_length) {
+    // Authenticated encryption seals packets without data too
+    return ctx != NULL && ctx->state == SESCRYPT_ESTABLISHED &&
+           ctx->enc_proto != ENC_PROTO_DISABLED &&
+           (data_length > 0 ||
+            ctx->enc_proto == ENC_PROTO_ECDH_AES_128_GCM_V2);
+}
 
-    if (data == NULL) { data_length = 0; }
+/**
+ * Create L0 client packet from scatter/gather data parts
+ *
+ * @param ctx Encryption context
+ * @param buffer Buffer to create packet in
+ * @param buffer_length Buffer length
+ * @param command Command to peer
+ * @param peer Teonet peer
+ * @param parts Command data buffers
+ * @param n Number of buffers in @a parts
+ *
+ * @return Length of created packet
+ */
+size_t teoLNullPacketCreatev(teoLNullEncryptionContext *ctx, void *buffer,
+                             size_t buffer_length, uint8_t command,
+                             const char *peer, const struct iovec *parts,
+                             int n) {
+    size_t peer_name_length = strlen(peer) + 1;
+    size_t data_length = _iovLength(parts, n);
+
+    // Check buffer length, encryption may append tag to data
+    const size_t overhead = _teoLNullWillEncrypt(ctx, data_length)
+                                ? teoLNullEncryptionOverhead(ctx)
+                                : 0;
+    if (buffer_length <
+        teoLNullBufferSize(peer_name_length, data_length + overhead)) {
+        LTRACK_E("TeonetClient", "Insufficient buffer size");
+        abort();
+    }
 
-    const size_t peer_length = strlen(peer_name) + 1;
-    const size_t buf_length = teoLNullBufferSize(peer_length, data_length);
-    char *buf = (char*)ccl_malloc(buf_length);
+    teoLNullCPacket *pkg = (teoLNullCPacket *)buffer;
+    teoLNullPacketFillHeader(pkg, command, peer, peer_name_length, data_length);
 
-    // Unreliable packets couldn't be encrypted/decrypted due to it's
-    // unreliability - we can't correctly count them and seed encryption algo
-    // with identifier
-    size_t pkg_length = teoLNullPacketCreate(NULL, buf, buf_length, cmd,
-                                             peer_name,
-                                             data, data_length);
+    // Data is copied, encrypted and summed in one pass
+    uint8_t data_checksum;
+    uint8_t checksum =
+        teoLNullPacketEncryptCopyv(ctx, pkg, parts, n, &data_checksum);
 
-    ssize_t snd = 0;
-    if (con->tcp_f) {
-        snd = _teosockSend(con, buf, pkg_length);
-    } else {
-        snd = trudpUdpSendto(con->td->fd, buf, pkg_length,
-                             (__CONST_SOCKADDR_ARG)&con->tcd->remaddr,
-                             sizeof(con->tcd->remaddr));
+    if (teocliOpt_PacketDataChecksumInR2) {
+        teoLNullPacketSetDataChecksum(pkg, data_checksum, parts, n);
     }
-    free(buf);
 
-    return snd;
+    _teoLNullPacketSetChecksums(
+        ctx, pkg, get_byte_checksum((const uint8_t *)peer, peer_name_length),
+        checksum);
+
+    return teoLNullBufferSize(pkg->peer_name_length, pkg->data_length);
 }
 
 /**
- * Create package for Echo command
- * @param buf Buffer to create packet in
- * @param buf_len Buffer length
- * @param peer_name Peer name to send to
- * @param msg Echo message
- * @return
+ * Create L0 client packet
+ *
+ * @param buffer Buffer to create packet in
+ * @param buffer_length Buffer length
+ * @param command Command to peer
+ * @param peer Teonet peer
+ * @param data Command data
+ * @param data_length Command data length
+ *
+ * @return Length of created packet or zero if buffer to less
  */
-size_t teoLNullPacketCreateEcho(teoLNullEncryptionContext* ctx, void *buf, size_t buf_len,
-                                const char *peer_name, const char *msg) {
-    int64_t current_time_ms = teotimeGetCurrentTimeMs();
-
-    const unsigned int time_length = sizeof(current_time_ms);
-
-    const size_t msg_len = strlen(msg) + 1;
-    const size_t msg_buf_len = msg_len + time_length;
-    void *msg_buf = ccl_malloc(msg_buf_len);
-
-    // Fill message buffer
-    memcpy(msg_buf, msg, msg_len);
-    memcpy((char *)msg_buf + msg_len, &current_time_ms, time_length);
-    size_t package_len = teoLNullPacketCreate(ctx, buf, buf_len, CMD_L_ECHO,
-                                              peer_name, msg_buf, msg_buf_len);
-
-    free(msg_buf);
+size_t teoLNullPacketCreate(teoLNullEncryptionContext *ctx, void *buffer,
+                            size_t buffer_length, uint8_t command,
+                            const char *peer, const uint8_t *data,
+                            size_t data_length) {
+    struct iovec part;
+    part.iov_base = (void *)data;
+    part.iov_len = data_length;
 
-    return package_len;
+    return teoLNullPacketCreatev(ctx, buffer, buffer_length, command, peer,
+                                 &part, 1);
 }
 
 /**
- * Send ECHO command to L0 server
+ * Create send queue doorbell
  *
- * Create L0 clients packet and send it to L0 server
+ * On Windows doorbell is teoLNullConnectData::handles[1] event created
+ * separately.
  *
  * @param con Pointer to teoLNullConnectData
- * @param peer_name Peer name to send to
- * @param msg Message
  *
- * @return Length of send data or -1 at error
+ * @return true on success
  */
-ssize_t teoLNullSendEcho(teoLNullConnectData *con, const char *peer_name,
-                         const char *msg) {
-    // Add current time to the end of message (it should be return
-    // back by server)
-
-    char buf[L0_BUFFER_SIZE];
-    size_t pkg_length = teoLNullPacketCreateEcho(
-        con->client_crypt, buf, L0_BUFFER_SIZE, peer_name, msg);
+static bool _teoLNullDoorbellCreate(teoLNullConnectData *con) {
+#if defined(_WIN32)
+    (void)con;
+    return true;
+#elif defined(HAVE_EVENTFD)
+    int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd == -1) { return false; }
 
-    // Send message with time
-    ssize_t snd = _teosockSend(con, buf, pkg_length);
+    con->doorbell_fd[0] = efd;
+    con->doorbell_fd[1] = efd;
+    return true;
+#else
+    if (pipe(con->doorbell_fd) == -1) { return false; }
 
-    return snd;
+    for (int i = 0; i < 2; ++i) {
+        int flags = fcntl(con->doorbell_fd[i], F_GETFL, 0);
+        fcntl(con->doorbell_fd[i], F_SETFL, flags | O_NONBLOCK);
+    }
+    return true;
+#endif
 }
 
 /**
- * Process ECHO_ANSWER request.(Get time from answers data and calculate trip
- * time)
+ * Close send queue doorbell
  *
- * @param msg Echo answers command data
- * @return Trip time in ms
+ * @param con Pointer to teoLNullConnectData
  */
-int64_t teoLNullProccessEchoAnswer(const char *msg) {
-    size_t time_ptr = strlen(msg) + 1;
-
-    const int64_t *time_pointer = (const int64_t *)(msg + time_ptr);
-    int64_t time_value = *time_pointer;
+static void _teoLNullDoorbellClose(teoLNullConnectData *con) {
+#if !defined(_WIN32)
+    if (con->doorbell_fd[0] != -1) { close(con->doorbell_fd[0]); }
 
-    int64_t trip_time_ms = teotimeGetTimePassedMs(time_value);
+    if (con->doorbell_fd[1] != -1 &&
+        con->doorbell_fd[1] != con->doorbell_fd[0]) {
+        close(con->doorbell_fd[1]);
+    }
+#endif
 
-    return trip_time_ms;
+    con->doorbell_fd[0] = -1;
+    con->doorbell_fd[1] = -1;
 }
 
 /**
- * Calculate and set teoLNullCPacket header checksum.
+ * Wake up event loop thread to drain send queue
  *
- * @param packet Pointer to packet
+ * @param con Pointer to teoLNullConnectData
  */
-static void teoLNullPacketUpdateHeaderChecksum(teoLNullCPacket* packet) {
-    uint8_t* packet_buffer = (uint8_t*)packet;
-    size_t header_size_without_checksum =
-        sizeof(teoLNullCPacket) - sizeof(packet->header_checksum);
+static void _teoLNullDoorbellRaise(teoLNullConnectData *con) {
+#if defined(_WIN32)
+    SetEvent(con->handles[1]);
+#else
+#if defined(HAVE_EVENTFD)
+    uint64_t value = 1;
+#else
+    uint8_t value = 1;
+#endif
+    ssize_t write_result = write(con->doorbell_fd[1], &value, sizeof(value));
 
-    packet->header_checksum =
-        get_byte_checksum(packet_buffer, header_size_without_checksum);
+    // Full pipe or eventfd counter means doorbell is raised already
+    if (write_result == -1 && errno != EAGAIN) {
+        LTRACK_E("TeonetClient", "Failed to raise send queue doorbell: %s",
+                 strerror(errno));
+    }
+#endif
 }
 
 /**
- * Calculate and set teoLNullCPacket checksums.
+ * Reset send queue doorbell before draining send queue
  *
- * @param packet Pointer to packet
+ * @param con Pointer to teoLNullConnectData
  */
-static void teoLNullPacketUpdateChecksums(teoLNullCPacket *packet) {
-    uint8_t *packet_full_pauload = teoLNullPacketGetFullPayload(packet);
-    size_t packet_payload_size = teoLNullPacketGetFullPayloadSize(packet);
-
-    packet->checksum =
-        get_byte_checksum(packet_full_pauload, packet_payload_size);
-
-    teoLNullPacketUpdateHeaderChecksum(packet);
+static void _teoLNullDoorbellClear(teoLNullConnectData *con) {
+#if defined(_WIN32)
+    ResetEvent(con->handles[1]);
+#elif defined(HAVE_EVENTFD)
+    uint64_t value;
+    if (read(con->doorbell_fd[0], &value, sizeof(value)) == -1 &&
+        errno != EAGAIN) {
+        LTRACK_E("TeonetClient", "Failed to reset send queue doorbell: %s",
+                 strerror(errno));
+    }
+#else
+    uint8_t buffer[64];
+    while (read(con->doorbell_fd[0], buffer, sizeof(buffer)) > 0) {}
+#endif
 }
 
 /**
- * Check teoLNullCPacket checksums.
+ * Pass packet to TR-UDP thread safe send queue
  *
- * @param packet Pointer to packet
+ * @param con Pointer to teoLNullConnectData
+ * @param data Packet allocated with ccl_malloc, event loop thread takes
+ *  ownership
+ * @param length Packet length
  *
- * @return true if packet checksums are valid or false otherwise.
+ * @return Length of send data
  */
-static bool teoLNullPacketChecksumCheck(teoLNullCPacket *packet) {
-    uint8_t *packet_buffer = (uint8_t *)packet;
-    size_t header_size_without_checksum =
-        sizeof(teoLNullCPacket) - sizeof(packet->header_checksum);
+static ssize_t _teosockQueueSend(teoLNullConnectData *con, char *data,
+                                 size_t length) {
+    bool raise_doorbell = false;
+
+    // Queue is full: wait for event loop thread to drain it, the same way as
+    // blocking write to pipe did
+    while (!teoLNullSendQueuePush(con->send_queue, data, length,
+                                  &raise_doorbell)) {
+#if defined(_WIN32)
+        SwitchToThread();
+#else
+        sched_yield();
+#endif
+    }
+
+    if (raise_doorbell) { _teoLNullDoorbellRaise(con); }
+
+    return length;
+}
+
+/**
+ * Queue buffers to io_uring of connection
+ *
+ * Buffers are submitted at once, or at the end of event loop iteration if
+ * it collects sends.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param iov Array of buffers
+ * @param iovcnt Number of buffers in @a iov
+ * @param addr Datagram destination, NULL for TCP
+ *
+ * @return Length of send data or -1 at error
+ */
+static ssize_t _teoLNullUringSendv(teoLNullConnectData *con,
+                                   const struct iovec *iov, int iovcnt,
+                                   const struct sockaddr_in *addr) {
+    if (!teoLNullUringSend(con->uring, iov, iovcnt, addr)) { return -1; }
+
+    if (!con->udp_send_collect && teoLNullUringSubmit(con->uring) == -1) {
+        return -1;
+    }
+
+    return (ssize_t)_iovLength(iov, iovcnt);
+}
+
+/**
+ * Send data to TCP socket of connection
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param data Data to send
+ * @param length Length of @a data
+ *
+ * @return Length of send data or -1 at error
+ */
+static ssize_t _teoLNullTcpSend(teoLNullConnectData *con, const char *data,
+                                size_t length) {
+    if (con->uring != NULL) {
+        struct iovec iov;
+        iov.iov_base = (void *)data;
+        iov.iov_len = length;
+
+        return _teoLNullUringSendv(con, &iov, 1, NULL);
+    }
+
+    return teosockSend(con->fd, data, length);
+}
+
+static ssize_t _teosockSend(teoLNullConnectData *con, const char *data,
+                            size_t length) {
+    if (con->tcp_f) {
+        return _teoLNullTcpSend(con, data, length);
+    } else {
+        char *queue_data = (char *)ccl_malloc(length);
+        memcpy(queue_data, data, length);
+
+        return _teosockQueueSend(con, queue_data, length);
+    }
+}
+
+#if !defined(_WIN32)
+
+#if !defined(IOV_MAX)
+#define IOV_MAX 16
+#endif
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * Send scatter/gather buffers to TCP socket
+ *
+ * Sends all buffers, continues after partial writes.
+ *
+ * @param fd Socket descriptor
+ * @param iov Array of buffers, modified during send
+ * @param iovcnt Number of buffers in @a iov
+ *
+ * @return Length of send data or -1 at error
+ */
+static ssize_t _teosockSendv(teonetSocket fd, struct iovec *iov, int iovcnt) {
+    ssize_t sent = 0;
+
+    while (iovcnt > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        ssize_t rc = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (rc == -1) {
+            int send_errno = errno;
+            if (send_errno == EINTR) { continue; }
+// EWOULDBLOCK may be not defined or may have same value as EAGAIN.
+#if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
+            if (send_errno == EAGAIN || send_errno == EWOULDBLOCK) {
+#else
+            if (send_errno == EAGAIN) {
+#endif
+                teosockSelect(fd, TEOSOCK_SELECT_MODE_WRITE, 100);
+                continue;
+            }
+            return -1;
+        }
+
+        sent += rc;
+
+        // Skip fully sent buffers and move start of partially sent one
+        size_t done = (size_t)rc;
+        while (iovcnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+
+    return sent;
+}
+
+/**
+ * Send scatter/gather buffers to TCP socket of connection
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param iov Array of buffers, may be modified during send
+ * @param iovcnt Number of buffers in @a iov
+ *
+ * @return Length of send data or -1 at error
+ */
+static ssize_t _teoLNullTcpSendv(teoLNullConnectData *con, struct iovec *iov,
+                                 int iovcnt) {
+    if (con->uring != NULL) {
+        return _teoLNullUringSendv(con, iov, iovcnt, NULL);
+    }
+
+    return _teosockSendv(con->fd, iov, iovcnt);
+}
+#endif
+
+/**
+ * Get encryption context of unreliable packets
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return Connection context if it encrypts packets with explicit nonce or
+ *  NULL to send unreliable packets unencrypted
+ */
+static inline teoLNullEncryptionContext *
+_teoLNullUnreliableCtx(teoLNullConnectData *con) {
+    return teoLNullEncryptionHasExplicitNonce(con->client_crypt)
+               ? con->client_crypt
+               : NULL;
+}
+
+/**
+ * Pre-resolved peer with L0 packet header template
+ */
+struct teoLNullPeerHandle {
+    teoLNullConnectData *con; ///< Connection to send packets to
+    uint8_t peer_checksum;    ///< Byte checksum of peer name
+    uint8_t prefix_length;    ///< Header and peer name length
+    uint8_t prefix[sizeof(teoLNullCPacket) + UINT8_MAX]; ///< Packet header
+                                                          ///< and peer name
+};
+
+/**
+ * Initialize peer handle: fill packet header template and peer name
+ *
+ * @param peer Peer handle to initialize
+ * @param con Pointer to teoLNullConnectData
+ * @param peer_name Peer name
+ *
+ * @return true on success or false if peer name is too long
+ */
+static bool _teoLNullPeerInit(teoLNullPeerHandle *peer,
+                              teoLNullConnectData *con,
+                              const char *peer_name) {
+    const size_t peer_length = strlen(peer_name) + 1;
+    if (peer_length > UINT8_MAX) {
+        LTRACK_E("TeonetClient", "Peer name %u bytes too long",
+                 (uint32_t)peer_length);
+        return false;
+    }
+
+    teoLNullPacketFillHeader((teoLNullCPacket *)peer->prefix, 0, peer_name,
+                             peer_length, 0);
+
+    peer->con = con;
+    peer->peer_checksum =
+        get_byte_checksum((const uint8_t *)peer_name, peer_length);
+    peer->prefix_length = (uint8_t)(sizeof(teoLNullCPacket) + peer_length);
+
+    return true;
+}
+
+/**
+ * Create L0 packet from peer handle template and scatter/gather data parts
+ *
+ * @param ctx Encryption context
+ * @param buffer Buffer to create packet in, should fit the packet
+ * @param cmd Command
+ * @param peer Peer handle
+ * @param parts Array of data buffers
+ * @param n Number of buffers in @a parts
+ * @param data_length Summary length of @a parts
+ * @param reliable Packet is delivered in order, unreliable packet is
+ *  encrypted with explicit nonce or not encrypted
+ *
+ * @return Length of created packet
+ */
+static size_t _teoLNullPeerPacketCreatev(teoLNullEncryptionContext *ctx,
+                                       char *buffer, uint8_t cmd,
+                                       const teoLNullPeerHandle *peer,
+                                       const struct iovec *parts, int n,
+                                       size_t data_length, bool reliable) {
+    teoLNullCPacket *pkg = (teoLNullCPacket *)buffer;
+    memcpy(pkg, peer->prefix, peer->prefix_length);
+    pkg->cmd = cmd;
+    pkg->data_length = (uint16_t)data_length;
+
+    // Data is copied, encrypted and summed in one pass
+    uint8_t data_checksum;
+    uint8_t checksum =
+        reliable ? teoLNullPacketEncryptCopyv(ctx, pkg, parts, n,
+                                              &data_checksum)
+                 : teoLNullPacketEncryptUnreliableCopyv(ctx, pkg, parts, n,
+                                                        &data_checksum);
+
+    if (teocliOpt_PacketDataChecksumInR2) {
+        teoLNullPacketSetDataChecksum(pkg, data_checksum, parts, n);
+    }
+
+    // Peer name checksum is cached
+    _teoLNullPacketSetChecksums(ctx, pkg, peer->peer_checksum, checksum);
+
+    return teoLNullBufferSize(pkg->peer_name_length, pkg->data_length);
+}
+
+/**
+ * Packet sent by application while key exchange answer is applied by worker
+ */
+struct teoLNullDeferredSend {
+    teoLNullDeferredSend *next; ///< Next deferred packet
+    teoLNullPeerHandle peer;    ///< Peer to send to
+    uint8_t cmd;                ///< Command
+    bool reliable;              ///< Send TR-UDP packet via reliable channel
+    size_t data_length;         ///< Data length
+    uint8_t data[];             ///< Packet data, not encrypted
+};
+
+/**
+ * Keep packet until key exchange worker establishes encryption
+ *
+ * Packets are encrypted and sent in the same order by
+ * _teoLNullDeferredFlush.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param cmd Command
+ * @param peer Peer handle
+ * @param parts Array of data buffers
+ * @param n Number of buffers in @a parts
+ * @param data_length Summary length of @a parts
+ * @param reliable Send TR-UDP packet via reliable channel
+ *
+ * @return Length of packet
+ */
+static ssize_t _teoLNullDeferredPush(teoLNullConnectData *con, uint8_t cmd,
+                                     const teoLNullPeerHandle *peer,
+                                     const struct iovec *parts, int n,
+                                     size_t data_length, bool reliable) {
+    teoLNullDeferredSend *send = (teoLNullDeferredSend *)ccl_malloc(
+        sizeof(teoLNullDeferredSend) + data_length);
+    send->next = NULL;
+    send->peer = *peer;
+    send->cmd = cmd;
+    send->reliable = reliable;
+    send->data_length = data_length;
+    _iovCopy(send->data, parts, n, 0, data_length);
+
+    if (con->deferred_tail != NULL) {
+        con->deferred_tail->next = send;
+    } else {
+        con->deferred_head = send;
+    }
+    con->deferred_tail = send;
+
+    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
+            "Deferred %u bytes until key exchange is applied.",
+            (uint32_t)data_length);
+
+    return (ssize_t)(peer->prefix_length + data_length);
+}
+
+/**
+ * Create and send L0 packet to pre-resolved peer from scatter/gather data
+ * parts
+ *
+ * Plain TCP packets are sent directly from callers buffers without any heap
+ * allocation or data copy. Encrypted packets and TR-UDP packets are gathered
+ * into one buffer first.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param ctx Encryption context or NULL to send unencrypted packet
+ * @param cmd Command
+ * @param peer Peer handle
+ * @param parts Array of data buffers
+ * @param n Number of buffers in @a parts
+ * @param reliable Send TR-UDP packet via reliable channel
+ *
+ * @return Length of send data or -1 at error
+ */
+static ssize_t _teoLNullPeerSendv(teoLNullConnectData *con,
+                                  teoLNullEncryptionContext *ctx, uint8_t cmd,
+                                  const teoLNullPeerHandle *peer,
+                                  const struct iovec *parts, int n,
+                                  bool reliable) {
+    if (n < 0 || (n > 0 && parts == NULL)) { return -1; }
+
+    const size_t data_length = _iovLength(parts, n);
+    const size_t overhead = teoLNullEncryptionOverhead(ctx);
+
+    if (data_length + overhead > UINT16_MAX) {
+        LTRACK_E("TeonetClient", "Can't send packet: data %u bytes too long",
+                 (uint32_t)data_length);
+        return -1;
+    }
+
+    // Buffer length, packet may be shorter if it is not encrypted
+    size_t pkg_length = peer->prefix_length + data_length + overhead;
+
+    // Encryption is not established yet, packet waits for key exchange
+    if (con->kex_job != NULL && ctx != NULL) {
+        return _teoLNullDeferredPush(con, cmd, peer, parts, n, data_length,
+                                     reliable);
+    }
+
+#if !defined(_WIN32)
+    const bool encrypt =
+        _teoLNullWillEncrypt(ctx, data_length) &&
+        (reliable || teoLNullEncryptionHasExplicitNonce(ctx));
+    if (con->tcp_f && !encrypt && n < IOV_MAX - 1) {
+        // Header is built on stack, peer name is sent from the handle and
+        // data from callers buffers
+        teoLNullCPacket pkg;
+        memcpy(&pkg, peer->prefix, sizeof(pkg));
+        pkg.cmd = cmd;
+        pkg.data_length = (uint16_t)data_length;
+
+        uint8_t data_checksum = _iovChecksum(parts, n);
+        if (teocliOpt_PacketDataChecksumInR2) {
+            teoLNullPacketSetDataChecksum(&pkg, data_checksum, parts, n);
+        }
+
+        pkg.checksum = peer->peer_checksum + data_checksum;
+        teoLNullPacketUpdateHeaderChecksum(&pkg);
+
+        struct iovec iov[n + 2];
+        iov[0].iov_base = &pkg;
+        iov[0].iov_len = sizeof(pkg);
+        iov[1].iov_base = (void *)(peer->prefix + sizeof(pkg));
+        iov[1].iov_len = peer->prefix_length - sizeof(pkg);
+        int iovcnt = 2;
+        for (int i = 0; i < n; ++i) {
+            if (parts[i].iov_len == 0) { continue; }
+            iov[iovcnt++] = parts[i];
+        }
+
+        return _teoLNullTcpSendv(con, iov, iovcnt);
+    }
+#endif
+
+    // TR-UDP send queue takes ownership of the packet buffer, so it is
+    // allocated once and never copied again. Other packets are built on stack
+    // if fit.
+    char stack_buf[L0_BUFFER_SIZE];
+    const bool to_queue = !con->tcp_f && reliable;
+    char *buf = (!to_queue && pkg_length <= sizeof(stack_buf))
+                    ? stack_buf
+                    : (char *)ccl_malloc(pkg_length);
+
+    pkg_length = _teoLNullPeerPacketCreatev(ctx, buf, cmd, peer, parts, n,
+                                            data_length, reliable);
+
+    ssize_t snd;
+    if (to_queue) {
+        return _teosockQueueSend(con, buf, pkg_length);
+    } else if (con->tcp_f) {
+        snd = _teoLNullTcpSend(con, buf, pkg_length);
+    } else {
+        snd = trudpUdpSendto(con->td->fd, buf, pkg_length,
+                             (__CONST_SOCKADDR_ARG)&con->tcd->remaddr,
+                             sizeof(con->tcd->remaddr));
+    }
+
+    if (buf != stack_buf) { free(buf); }
+
+    return snd;
+}
+
+/**
+ * Create and send L0 packet from scatter/gather data parts
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param ctx Encryption context or NULL to send unencrypted packet
+ * @param cmd Command
+ * @param peer_name Peer name to send to
+ * @param parts Array of data buffers
+ * @param n Number of buffers in @a parts
+ * @param reliable Send TR-UDP packet via reliable channel
+ *
+ * @return Length of send data or -1 at error
+ */
+static ssize_t _teoLNullSendv(teoLNullConnectData *con,
+                              teoLNullEncryptionContext *ctx, uint8_t cmd,
+                              const char *peer_name, const struct iovec *parts,
+                              int n, bool reliable) {
+    if (con == NULL || peer_name == NULL) { return -1; }
+
+    teoLNullPeerHandle peer;
+    if (!_teoLNullPeerInit(&peer, con, peer_name)) { return -1; }
+
+    return _teoLNullPeerSendv(con, ctx, cmd, &peer, parts, n, reliable);
+}
+
+/**
+ * Send packet to L0 server/client
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param data Package to send
+ * @param data_length Package length
+ *
+ * @return Length of send data or -1 at error
+ */
+ssize_t teoLNullPacketSend(teoLNullConnectData *con, const char *data,
+                           size_t data_length) {
+    if (con != NULL) {
+        return _teosockSend(con, data, data_length);
+    } else {
+        return -1;
+    }
+}
+
+/**
+ * Free packet reserved by teoLNullPacketReserve and not committed
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullPacketDiscardReserved(teoLNullConnectData *con) {
+    if (con->reserved_packet == NULL) { return; }
+
+    // TR-UDP packets are allocated per reserve, TCP packets live in
+    // connection send buffer
+    if (!con->tcp_f) { free(con->reserved_packet); }
+
+    con->reserved_packet = NULL;
+    con->reserved_data_length = 0;
+}
+
+/**
+ * Reserve L0 packet to write its data in place
+ *
+ * Creates packet header in connection owned buffer and returns pointer to
+ * packet data, so caller can serialize data directly to the packet. Packet is
+ * sent by teoLNullPacketCommit. Only one packet can be reserved at a time,
+ * reserving new packet discards previous one if it was not committed.
+ * Reserve and commit should be called from one thread.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param cmd Command
+ * @param peer Peer name to send to
+ * @param max_len Maximum length of data which will be written
+ *
+ * @return Pointer to @a max_len bytes of packet data or NULL at error
+ */
+void *teoLNullPacketReserve(teoLNullConnectData *con, uint8_t cmd,
+                            const char *peer, size_t max_len) {
+    if (con == NULL || peer == NULL) { return NULL; }
+
+    const size_t peer_length = strlen(peer) + 1;
+    const size_t overhead = teoLNullEncryptionOverhead(con->client_crypt);
+    if (peer_length > UINT8_MAX || max_len + overhead > UINT16_MAX) {
+        LTRACK_E("TeonetClient",
+                 "Can't reserve packet: peer name %u or data %u bytes too long",
+                 (uint32_t)peer_length, (uint32_t)max_len);
+        return NULL;
+    }
+
+    _teoLNullPacketDiscardReserved(con);
+
+    // Authentication tag is appended to data on commit
+    const size_t buf_length =
+        teoLNullBufferSize(peer_length, max_len + overhead);
+    teoLNullCPacket *pkg;
+    if (con->tcp_f) {
+        if (con->send_buffer_size < buf_length) {
+            if (con->send_buffer != NULL) {
+                con->send_buffer = ccl_realloc(con->send_buffer, buf_length);
+            } else {
+                con->send_buffer = ccl_malloc(buf_length);
+            }
+            con->send_buffer_size = buf_length;
+        }
+        pkg = (teoLNullCPacket *)con->send_buffer;
+    } else {
+        // Send queue takes ownership of the packet on commit
+        pkg = (teoLNullCPacket *)ccl_malloc(buf_length);
+    }
+
+    teoLNullPacketFillHeader(pkg, cmd, peer, peer_length, max_len);
+
+    con->reserved_packet = pkg;
+    con->reserved_data_length = max_len;
+
+    return teoLNullPacketGetData(pkg);
+}
+
+/**
+ * Finalize and send packet reserved by teoLNullPacketReserve
+ *
+ * Sets packet data length, encrypts data in place, calculates checksums and
+ * sends packet (or passes it to TR-UDP send queue).
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param actual_len Length of data written to reserved packet
+ *
+ * @return Length of send data or -1 at error
+ */
+ssize_t teoLNullPacketCommit(teoLNullConnectData *con, size_t actual_len) {
+    if (con == NULL || con->reserved_packet == NULL) {
+        LTRACK_E("TeonetClient", "Can't commit packet: nothing reserved");
+        return -1;
+    }
+
+    if (actual_len > con->reserved_data_length) {
+        LTRACK_E("TeonetClient",
+                 "Can't commit packet: data %u bytes exceeds reserved %u bytes",
+                 (uint32_t)actual_len, (uint32_t)con->reserved_data_length);
+        _teoLNullPacketDiscardReserved(con);
+        return -1;
+    }
+
+    teoLNullCPacket *pkg = con->reserved_packet;
+
+    // Encryption is not established yet, packet waits for key exchange
+    if (con->kex_job != NULL) {
+        teoLNullPeerHandle peer;
+        struct iovec part;
+        part.iov_base = teoLNullPacketGetData(pkg);
+        part.iov_len = actual_len;
+
+        ssize_t result = -1;
+        if (_teoLNullPeerInit(&peer, con, pkg->peer_name)) {
+            result = _teoLNullDeferredPush(con, pkg->cmd, &peer, &part, 1,
+                                           actual_len, true);
+        }
+        _teoLNullPacketDiscardReserved(con);
+        return result;
+    }
+
+    con->reserved_packet = NULL;
+    con->reserved_data_length = 0;
+
+    pkg->data_length = (uint16_t)actual_len;
+
+    struct iovec part;
+    part.iov_base = teoLNullPacketGetData(pkg);
+    part.iov_len = actual_len;
+
+    // Packet id is logged from plain data, so it is set before encryption
+    if (teocliOpt_PacketDataChecksumInR2) {
+        teoLNullPacketSetDataChecksum(pkg, _iovChecksum(&part, 1), &part, 1);
+    }
+
+    // Data written by application is encrypted in place and summed in one
+    // pass
+    uint8_t checksum =
+        teoLNullPacketEncryptCopyv(con->client_crypt, pkg, &part, 1, NULL);
+
+    _teoLNullPacketSetChecksums(
+        con->client_crypt, pkg,
+        get_byte_checksum((const uint8_t *)teoLNullPacketGetPeerName(pkg),
+                          pkg->peer_name_length),
+        checksum);
+
+    const size_t pkg_length =
+        teoLNullBufferSize(pkg->peer_name_length, pkg->data_length);
+
+    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
+            "Sending reserved data %u bytes.", (uint32_t)actual_len);
+
+    if (con->tcp_f) {
+        return _teoLNullTcpSend(con, (const char *)pkg, pkg_length);
+    }
+
+    return _teosockQueueSend(con, (char *)pkg, pkg_length);
+}
+
+/**
+ * Send command to L0 server
+ *
+ * Create L0 clients packet and send it to L0 server
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param cmd Command
+ * @param peer_name Peer name to send to
+ * @param data Pointer to data
+ * @param data_length Length of data
+ *
+ * @return Length of send data or -1 at error
+ */
+ssize_t teoLNullSend(teoLNullConnectData *con, uint8_t cmd,
+                     const char *peer_name, const void *data,
+                     size_t data_length) {
+    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
+            "Sending reliable data %u bytes.", (uint32_t)data_length);
+
+    if (con == NULL) { return -1; }
+    if (data == NULL) { data_length = 0; }
+
+    struct iovec part;
+    part.iov_base = (void *)data;
+    part.iov_len = data_length;
+
+    return _teoLNullSendv(con, con->client_crypt, cmd, peer_name, &part, 1,
+                          true);
+}
+
+/**
+ * Send command to L0 server from scatter/gather data parts
+ *
+ * Data parts are sent as one L0 packet. On TCP connection without encryption
+ * the packet is passed to socket without heap allocation and data copy.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param cmd Command
+ * @param peer_name Peer name to send to
+ * @param parts Array of data buffers
+ * @param n Number of buffers in @a parts
+ *
+ * @return Length of send data or -1 at error
+ */
+ssize_t teoLNullSendv(teoLNullConnectData *con, uint8_t cmd,
+                      const char *peer_name, const struct iovec *parts,
+                      int n) {
+    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
+            "Sending reliable data in %d parts.", n);
+
+    if (con == NULL) { return -1; }
+
+    return _teoLNullSendv(con, con->client_crypt, cmd, peer_name, parts, n,
+                          true);
+}
+
+#if !defined(_WIN32)
+/**
+ * Send batch of L0 packets to TCP socket without data copy
+ *
+ * Headers are collected in stack buffer and sent together with callers data
+ * buffers, one system call per up to IOV_MAX / 2 packets.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param items Array of packets to send, must be validated
+ * @param n Number of packets in @a items
+ *
+ * @return Length of send data or -1 at error
+ */
+static ssize_t _teoLNullSendBatchv(teoLNullConnectData *con,
+                                   const teoLNullSendItem *items, size_t n) {
+    uint8_t headers[L0_BUFFER_SIZE];
+    struct iovec iov[IOV_MAX];
+    size_t headers_length = 0;
+    int iovcnt = 0;
+    ssize_t sent = 0;
+
+    for (size_t i = 0; i <= n; ++i) {
+        const size_t peer_length =
+            (i < n) ? strlen(items[i].peer_name) + 1 : 0;
+        const size_t header_length = sizeof(teoLNullCPacket) + peer_length;
+
+        // Flush collected packets at the end or when scratch buffers are full
+        if (i == n || iovcnt + 2 > IOV_MAX ||
+            headers_length + header_length > sizeof(headers)) {
+            if (iovcnt > 0) {
+                ssize_t rc = _teoLNullTcpSendv(con, iov, iovcnt);
+                if (rc == -1) { return -1; }
+                sent += rc;
+            }
+
+            if (i == n) { break; }
+            headers_length = 0;
+            iovcnt = 0;
+        }
+
+        const size_t data_length = items[i].data ? items[i].data_length : 0;
+
+        teoLNullCPacket *pkg = (teoLNullCPacket *)(headers + headers_length);
+        teoLNullPacketFillHeader(pkg, items[i].cmd, items[i].peer_name,
+                                 peer_length, data_length);
+
+        struct iovec part;
+        part.iov_base = (void *)items[i].data;
+        part.iov_len = data_length;
+
+        uint8_t data_checksum = _iovChecksum(&part, 1);
+        if (teocliOpt_PacketDataChecksumInR2) {
+            teoLNullPacketSetDataChecksum(pkg, data_checksum, &part, 1);
+        }
+
+        pkg->checksum = get_byte_checksum((const uint8_t *)items[i].peer_name,
+                                          peer_length) +
+                        data_checksum;
+        teoLNullPacketUpdateHeaderChecksum(pkg);
+
+        iov[iovcnt].iov_base = pkg;
+        iov[iovcnt].iov_len = header_length;
+        ++iovcnt;
+        if (data_length > 0) { iov[iovcnt++] = part; }
+
+        headers_length += header_length;
+    }
+
+    return sent;
+}
+#endif
+
+/**
+ * Send batch of commands to L0 server
+ *
+ * All packets are created one after another, so encryption nonces follow
+ * order of @a items. On TCP connection packets are sent with one system call
+ * (plain TCP packets are sent without data copy). On TR-UDP connection packets
+ * are placed contiguously into one send queue entry which is split into as few
+ * TR-UDP data blocks as fragment size allows.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param items Array of packets to send
+ * @param n Number of packets in @a items
+ *
+ * @return Length of send data or -1 at error. Nothing is sent if any packet
+ *  is invalid.
+ */
+ssize_t teoLNullSendBatch(teoLNullConnectData *con,
+                          const teoLNullSendItem *items, size_t n) {
+    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
+            "Sending batch of %u packets.", (uint32_t)n);
+
+    if (con == NULL || (n > 0 && items == NULL)) { return -1; }
+
+    teoLNullEncryptionContext *ctx = con->client_crypt;
+    const size_t overhead = teoLNullEncryptionOverhead(ctx);
+
+    // Buffer length, packets may be shorter if they are not encrypted
+    size_t total_length = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (items[i].peer_name == NULL) { return -1; }
+
+        const size_t peer_length = strlen(items[i].peer_name) + 1;
+        const size_t data_length =
+            (items[i].data ? items[i].data_length : 0) + overhead;
+
+        if (peer_length > UINT8_MAX || data_length > UINT16_MAX) {
+            LTRACK_E("TeonetClient",
+                     "Can't send batch: packet %u peer name %u or data %u "
+                     "bytes too long",
+                     (uint32_t)i, (uint32_t)peer_length,
+                     (uint32_t)data_length);
+            return -1;
+        }
+
+        total_length += teoLNullBufferSize(peer_length, data_length);
+    }
+
+    if (total_length == 0) { return 0; }
+
+    // Encryption is not established yet, packets wait for key exchange
+    if (con->kex_job != NULL) {
+        ssize_t sent = 0;
+        for (size_t i = 0; i < n; ++i) {
+            struct iovec part;
+            part.iov_base = (void *)items[i].data;
+            part.iov_len = items[i].data ? items[i].data_length : 0;
+
+            ssize_t snd = _teoLNullSendv(con, ctx, items[i].cmd,
+                                         items[i].peer_name, &part, 1, true);
+            if (snd < 0) { return -1; }
+            sent += snd;
+        }
+        return sent;
+    }
+
+#if !defined(_WIN32)
+    if (con->tcp_f && !_teoLNullWillEncrypt(ctx, total_length)) {
+        return _teoLNullSendBatchv(con, items, n);
+    }
+#endif
+
+    char stack_buf[L0_BUFFER_SIZE];
+    char *buf = (con->tcp_f && total_length <= sizeof(stack_buf))
+                    ? stack_buf
+                    : (char *)ccl_malloc(total_length);
+
+    size_t offset = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t data_length = items[i].data ? items[i].data_length : 0;
+        offset += teoLNullPacketCreate(
+            ctx, buf + offset, total_length - offset, items[i].cmd,
+            items[i].peer_name, (const uint8_t *)items[i].data, data_length);
+    }
+
+    if (!con->tcp_f) {
+        return _teosockQueueSend(con, buf, offset);
+    }
+
+    ssize_t snd = _teoLNullTcpSend(con, buf, offset);
+    if (buf != stack_buf) { free(buf); }
+
+    return snd;
+}
+
+ssize_t teoLNullSendUnreliable(teoLNullConnectData *con, uint8_t cmd,
+                               const char *peer_name, const void *data,
+                               size_t data_length) {
+    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
+            "Sending unreliable data %u bytes.", (uint32_t)data_length);
+
+    if (con == NULL) { return -1; }
+    if (data == NULL) { data_length = 0; }
+
+    struct iovec part;
+    part.iov_base = (void *)data;
+    part.iov_len = data_length;
+
+    // Unreliable packets may be lost, so they can't be counted by implicit
+    // nonce. They are encrypted only by protocol carrying nonce in packet.
+    return _teoLNullSendv(con, _teoLNullUnreliableCtx(con), cmd, peer_name,
+                          &part, 1, false);
+}
+
+/**
+ * Open handle of peer to send packets to
+ *
+ * Peer name length, packet header template with peer name and peer name
+ * checksum are calculated once, so sending by handle only processes packet
+ * data. Handle is valid while connection is and should be closed by
+ * teoLNullPeerClose.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param peer_name Peer name
+ *
+ * @return Pointer to peer handle or NULL at error
+ */
+teoLNullPeerHandle *teoLNullPeerOpen(teoLNullConnectData *con,
+                                     const char *peer_name) {
+    if (con == NULL || peer_name == NULL) { return NULL; }
+
+    teoLNullPeerHandle *peer =
+        (teoLNullPeerHandle *)ccl_malloc(sizeof(teoLNullPeerHandle));
+
+    if (!_teoLNullPeerInit(peer, con, peer_name)) {
+        free(peer);
+        return NULL;
+    }
+
+    return peer;
+}
+
+/**
+ * Close peer handle
+ *
+ * @param peer Peer handle, may be NULL
+ */
+void teoLNullPeerClose(teoLNullPeerHandle *peer) { free(peer); }
+
+/**
+ * Send command to pre-resolved peer
+ *
+ * @param peer Peer handle
+ * @param cmd Command
+ * @param data Pointer to data
+ * @param data_length Length of data
+ *
+ * @return Length of send data or -1 at error
+ */
+ssize_t teoLNullPeerSend(teoLNullPeerHandle *peer, uint8_t cmd,
+                         const void *data, size_t data_length) {
+    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
+            "Sending reliable data %u bytes.", (uint32_t)data_length);
+
+    if (peer == NULL) { return -1; }
+    if (data == NULL) { data_length = 0; }
+
+    struct iovec part;
+    part.iov_base = (void *)data;
+    part.iov_len = data_length;
+
+    return _teoLNullPeerSendv(peer->con, peer->con->client_crypt, cmd, peer,
+                              &part, 1, true);
+}
+
+/**
+ * Send command to pre-resolved peer from scatter/gather data parts
+ *
+ * @param peer Peer handle
+ * @param cmd Command
+ * @param parts Array of data buffers
+ * @param n Number of buffers in @a parts
+ *
+ * @return Length of send data or -1 at error
+ */
+ssize_t teoLNullPeerSendv(teoLNullPeerHandle *peer, uint8_t cmd,
+                          const struct iovec *parts, int n) {
+    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
+            "Sending reliable data in %d parts.", n);
+
+    if (peer == NULL) { return -1; }
+
+    return _teoLNullPeerSendv(peer->con, peer->con->client_crypt, cmd, peer,
+                              parts, n, true);
+}
+
+/**
+ * Send **UNRELIABLE** command to pre-resolved peer
+ *
+ * @param peer Peer handle
+ * @param cmd Command
+ * @param data Pointer to data
+ * @param data_length Length of data
+ *
+ * @return Length of send data or -1 at error
+ */
+ssize_t teoLNullPeerSendUnreliable(teoLNullPeerHandle *peer, uint8_t cmd,
+                                   const void *data, size_t data_length) {
+    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
+            "Sending unreliable data %u bytes.", (uint32_t)data_length);
+
+    if (peer == NULL) { return -1; }
+    if (data == NULL) { data_length = 0; }
+
+    struct iovec part;
+    part.iov_base = (void *)data;
+    part.iov_len = data_length;
+
+    // Unreliable packets are encrypted only with explicit nonce, see
+    // teoLNullSendUnreliable
+    return _teoLNullPeerSendv(peer->con, _teoLNullUnreliableCtx(peer->con), cmd,
+                              peer, &part, 1, false);
+}
+
+/**
+ * Create package for Echo command
+ * @param buf Buffer to create packet in
+ * @param buf_len Buffer length
+ * @param peer_name Peer name to send to
+ * @param msg Echo message
+ * @return
+ */
+size_t teoLNullPacketCreateEcho(teoLNullEncryptionContext* ctx, void *buf, size_t buf_len,
+                                const char *peer_name, const char *msg) {
+    int64_t current_time_ms = teotimeGetCurrentTimeMs();
+
+    const unsigned int time_length = sizeof(current_time_ms);
+
+    const size_t msg_len = strlen(msg) + 1;
+    const size_t msg_buf_len = msg_len + time_length;
+    void *msg_buf = ccl_malloc(msg_buf_len);
+
+    // Fill message buffer
+    memcpy(msg_buf, msg, msg_len);
+    memcpy((char *)msg_buf + msg_len, &current_time_ms, time_length);
+    size_t package_len = teoLNullPacketCreate(ctx, buf, buf_len, CMD_L_ECHO,
+                                              peer_name, msg_buf, msg_buf_len);
+
+    free(msg_buf);
+
+    return package_len;
+}
+
+/**
+ * Send ECHO command to L0 server
+ *
+ * Create L0 clients packet and send it to L0 server
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param peer_name Peer name to send to
+ * @param msg Message
+ *
+ * @return Length of send data or -1 at error
+ */
+ssize_t teoLNullSendEcho(teoLNullConnectData *con, const char *peer_name,
+                         const char *msg) {
+    // Add current time to the end of message (it should be return
+    // back by server)
+
+    char buf[L0_BUFFER_SIZE];
+    size_t pkg_length = teoLNullPacketCreateEcho(
+        con->client_crypt, buf, L0_BUFFER_SIZE, peer_name, msg);
+
+    // Send message with time
+    ssize_t snd = _teosockSend(con, buf, pkg_length);
+
+    return snd;
+}
+
+/**
+ * Process ECHO_ANSWER request.(Get time from answers data and calculate trip
+ * time)
+ *
+ * @param msg Echo answers command data
+ * @return Trip time in ms
+ */
+int64_t teoLNullProccessEchoAnswer(const char *msg) {
+    size_t time_ptr = strlen(msg) + 1;
+
+    const int64_t *time_pointer = (const int64_t *)(msg + time_ptr);
+    int64_t time_value = *time_pointer;
+
+    int64_t trip_time_ms = teotimeGetTimePassedMs(time_value);
+
+    return trip_time_ms;
+}
+
+/**
+ * Calculate and set teoLNullCPacket header checksum.
+ *
+ * @param packet Pointer to packet
+ */
+static void teoLNullPacketUpdateHeaderChecksum(teoLNullCPacket* packet) {
+    uint8_t* packet_buffer = (uint8_t*)packet;
+    size_t header_size_without_checksum =
+        sizeof(teoLNullCPacket) - sizeof(packet->header_checksum);
+
+    packet->header_checksum =
+        get_byte_checksum(packet_buffer, header_size_without_checksum);
+}
+
+/**
+ * Check teoLNullCPacket checksums.
+ *
+ * Payload checksum of authenticated packet is not checked, its tag is checked
+ * on decrypt.
+ *
+ * @param ctx Pointer to encryption context, may be NULL
+ * @param packet Pointer to packet
+ *
+ * @return true if packet checksums are valid or false otherwise.
+ */
+static bool
+teoLNullPacketChecksumCheck(const teoLNullEncryptionContext *ctx,
+                            teoLNullCPacket *packet) {
+    uint8_t *packet_buffer = (uint8_t *)packet;
+    size_t header_size_without_checksum =
+        sizeof(teoLNullCPacket) - sizeof(packet->header_checksum);
 
     uint8_t header_checksum =
         get_byte_checksum(packet_buffer, header_size_without_checksum);
 
     if (packet->header_checksum != header_checksum) { return false; }
 
+    if (teoLNullPacketIsAuthenticated(ctx, packet)) { return true; }
+
     uint8_t *packet_full_pauload = teoLNullPacketGetFullPayload(packet);
     size_t packet_payload_size = teoLNullPacketGetFullPayloadSize(packet);
 
@@ -451,6 +1605,122 @@ static bool teoLNullPacketChecksumCheck(teoLNullCPacket *packet) {
     return true;
 }
 
+/**
+ * Send packets deferred while key exchange answer was applied by worker
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullDeferredFlush(teoLNullConnectData *con) {
+    while (con->deferred_head != NULL) {
+        teoLNullDeferredSend *send = con->deferred_head;
+        con->deferred_head = send->next;
+
+        struct iovec part;
+        part.iov_base = send->data;
+        part.iov_len = send->data_length;
+        _teoLNullPeerSendv(con, con->client_crypt, send->cmd, &send->peer,
+                           &part, 1, send->reliable);
+        free(send);
+    }
+    con->deferred_tail = NULL;
+}
+
+/**
+ * Free packets deferred while key exchange answer was applied by worker
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullDeferredFree(teoLNullConnectData *con) {
+    while (con->deferred_head != NULL) {
+        teoLNullDeferredSend *send = con->deferred_head;
+        con->deferred_head = send->next;
+        free(send);
+    }
+    con->deferred_tail = NULL;
+}
+
+/**
+ * Release key exchange job of connection and stop watching its descriptor
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullKexJobRelease(teoLNullConnectData *con) {
+    if (con->kex_job == NULL) { return; }
+
+    if (con->reactor != NULL) { teoLNullReactorUnwatchKex(con->reactor, con); }
+    teoLNullKexJobRelease(con->kex_job);
+    con->kex_job = NULL;
+}
+
+/**
+ * Pass key exchange answer of asynchronous connect to worker pool
+ *
+ * Encryption context stays SESCRYPT_PENDING, packets sent meanwhile are
+ * deferred and packets received meanwhile are kept in receive ring until
+ * _teoLNullKexJobFinish takes worker result.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param kex Key exchange payload
+ * @param kex_length Key exchange payload length
+ *
+ * @return true if answer is passed to worker, false if it should be applied
+ *  in place
+ */
+static bool _teoLNullKexJobStart(teoLNullConnectData *con,
+                                 KeyExchangePayload_Common *kex,
+                                 size_t kex_length) {
+    // Blocking connect and repeated answers are applied in place
+    if (con->connect_state != CON_STATE_HANDSHAKE || con->kex_job != NULL ||
+        con->client_crypt == NULL ||
+        con->client_crypt->enc_proto == ENC_PROTO_DISABLED) {
+        return false;
+    }
+
+    // Invalid answer fails in place
+    if (!teoLNullKEXValidate(con->client_crypt, kex, kex_length)) {
+        return false;
+    }
+
+    con->kex_job = teoLNullKexJobStart(con->client_crypt, kex, kex_length);
+    if (con->kex_job == NULL) { return false; }
+
+    if (con->reactor != NULL) { teoLNullReactorWatchKex(con->reactor, con); }
+
+    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+            "KEX answer passed to worker");
+    return true;
+}
+
+/**
+ * Take result of key exchange worker
+ *
+ * Sends EV_L_CONNECTED event, deferred packets and delivers packets kept in
+ * receive ring when encryption is established or sends EV_L_CONNECTED event
+ * with error status when it failed.
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullKexJobFinish(teoLNullConnectData *con) {
+    int result = teoLNullKexJobResult(con->kex_job, con->client_crypt);
+    if (result == 0) { return; }
+
+    _teoLNullKexJobRelease(con);
+
+    if (result < 0) {
+        LTRACK_E("TeonetClient", "Invalid KEX, can't apply; disconnecting");
+        _teoLNullDeferredFree(con);
+        con->status = CON_STATUS_ENCRYPTION_ERROR;
+        send_l0_event(con, EV_L_CONNECTED, &con->status, sizeof(con->status));
+        return;
+    }
+
+    LTRACK_I("TeonetClient", "Applied KEX answer");
+    con->status = CON_STATUS_CONNECTED;
+    send_l0_event(con, EV_L_CONNECTED, &con->status, sizeof(con->status));
+    _teoLNullDeferredFlush(con);
+    _teoLNullRecvDispatch(con);
+}
+
 static inline bool _applyKEXAnswer(teoLNullConnectData *con,
                                    KeyExchangePayload_Common *kex,
                                    size_t kex_length) {
@@ -494,6 +1764,10 @@ static inline bool _teoLNullProccessKEXAnswer(teoLNullConnectData *con,
     // const bool was_established = con->client_crypt->state ==
     // SESCRYPT_ESTABLISHED;
     const bool was_connected = (con->status == CON_STATUS_CONNECTED);
+    if (!was_connected && _teoLNullKexJobStart(con, kex, kex_length)) {
+        return true;
+    }
+
     if (_applyKEXAnswer(con, kex, kex_length)) {
         if (!was_connected) {
             con->status = CON_STATUS_CONNECTED;
@@ -514,83 +1788,311 @@ static inline bool _teoLNullProccessKEXAnswer(teoLNullConnectData *con,
     return false;
 }
 
+/**
+ * Copy bytes from receive ring
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param offset Offset from the first not consumed byte
+ * @param dest Destination buffer
+ * @param length Number of bytes to copy
+ */
+static void _recvRingRead(const teoLNullConnectData *con, size_t offset,
+                          void *dest, size_t length) {
+    size_t position = (con->recv_ring_head + offset) % con->recv_ring_size;
+    size_t first = con->recv_ring_size - position;
+    if (first > length) { first = length; }
+
+    memcpy(dest, con->recv_ring + position, first);
+    memcpy((uint8_t *)dest + first, con->recv_ring, length - first);
+}
+
+/**
+ * Get contiguous free space after the last byte in receive ring
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param available [out] Number of bytes which can be written to the pointer
+ *
+ * @return Pointer to write received data to
+ */
+static uint8_t *_recvRingTail(const teoLNullConnectData *con,
+                              size_t *available) {
+    size_t tail = con->recv_ring_head + con->recv_ring_length;
+    if (tail < con->recv_ring_size) {
+        *available = con->recv_ring_size - tail;
+    } else {
+        tail -= con->recv_ring_size;
+        *available = con->recv_ring_head - tail;
+    }
+
+    return con->recv_ring + tail;
+}
+
+/**
+ * Account bytes written to receive ring
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param length Number of bytes written
+ */
+static void _recvRingCommit(teoLNullConnectData *con, size_t length) {
+    con->recv_ring_length += length;
+    if (con->recv_ring_peak < con->recv_ring_length) {
+        con->recv_ring_peak = con->recv_ring_length;
+    }
+}
+
+/**
+ * Make sure receive ring has free space
+ *
+ * Ring grows to the nearest power of two multiple of its size, not consumed
+ * data is moved to the beginning of new ring.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param length Number of bytes to be written
+ */
+static void _recvRingReserve(teoLNullConnectData *con, size_t length) {
+    const size_t needed = con->recv_ring_length + length;
+    if (con->recv_ring != NULL && needed <= con->recv_ring_size) { return; }
+
+    size_t size = con->recv_ring != NULL ? con->recv_ring_size
+                                         : RECV_RING_MIN_SIZE;
+    while (size < needed) {
+        size <<= 1;
+    }
+
+    uint8_t *ring = (uint8_t *)ccl_malloc(size);
+    if (con->recv_ring != NULL) {
+        _recvRingRead(con, 0, ring, con->recv_ring_length);
+        free(con->recv_ring);
+    }
+
+    con->recv_ring = ring;
+    con->recv_ring_size = size;
+    con->recv_ring_head = 0;
+    con->read_buffer = ring;
+
+    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+            "L0 Client: Increase read buffer to new size: %" PRId32
+            " bytes ...\n",
+            (int)size);
+}
+
+/**
+ * Consume packets delivered since previous receive of new data
+ *
+ * When ring becomes empty it restarts from the beginning, and it is halved
+ * if not more than a quarter of it was used since it was empty last time.
+ * Ring is not shrunk below size needed to receive one chunk.
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _recvRingRelease(teoLNullConnectData *con) {
+    if (con->last_packet_offset == 0) { return; }
+
+    con->recv_ring_head =
+        (con->recv_ring_head + con->last_packet_offset) % con->recv_ring_size;
+    con->recv_ring_length -= con->last_packet_offset;
+    con->last_packet_offset = 0;
+
+    if (con->recv_ring_length > 0) {
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "L0 Client: Use %" PRId32
+                " bytes from previously received data...\n",
+                (int)con->recv_ring_length);
+        return;
+    }
+
+    con->recv_ring_head = 0;
+
+    if (con->recv_ring_size > RECV_RING_MIN_SIZE &&
+        con->recv_ring_size / 2 >= (size_t)teocliOpt_ReceiveChunkSize &&
+        con->recv_ring_peak * 4 <= con->recv_ring_size) {
+        con->recv_ring_size >>= 1;
+        free(con->recv_ring);
+        con->recv_ring = (uint8_t *)ccl_malloc(con->recv_ring_size);
+    }
+
+    con->recv_ring_peak = 0;
+    con->read_buffer = con->recv_ring;
+}
+
+/**
+ * Add received data to receive ring
+ *
+ * Packets delivered before are consumed.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param data Received data
+ * @param length Length of @a data
+ */
+static void _recvRingAppend(teoLNullConnectData *con, const void *data,
+                            size_t length) {
+    _recvRingRelease(con);
+    _recvRingReserve(con, length);
+
+    size_t available;
+    uint8_t *tail = _recvRingTail(con, &available);
+    if (available > length) { available = length; }
+
+    memcpy(tail, data, available);
+    memcpy(con->recv_ring, (const uint8_t *)data + available,
+           length - available);
+    _recvRingCommit(con, length);
+}
+
+/**
+ * Add data received by io_uring to receive ring
+ *
+ * @param data Received data
+ * @param data_length Length of @a data
+ * @param addr Not used for TCP
+ * @param user_data Pointer to teoLNullConnectData
+ */
+static void _teoLNullUringTcpReceive(void *data, size_t data_length,
+                                     struct sockaddr_in *addr,
+                                     void *user_data) {
+    (void)addr;
+    _recvRingAppend((teoLNullConnectData *)user_data, data, data_length);
+}
+
+/**
+ * Add data already received by io_uring of TCP connection to receive ring
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return Number of received bytes, 0 if disconnected or -1 if there is no
+ *  data
+ */
+static ssize_t _teoLNullUringRecv(teoLNullConnectData *con) {
+    const size_t length = con->recv_ring_length;
+
+    teoLNullUringProcess(con->uring, 0, _teoLNullUringTcpReceive, NULL, con);
+
+    if (con->recv_ring_length > length) {
+        return (ssize_t)(con->recv_ring_length - length);
+    }
+
+    return teoLNullUringClosed(con->uring) ? 0 : -1;
+}
+
+/**
+ * Receive chunk of data from TCP socket directly to receive ring
+ *
+ * Packets delivered before are consumed.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param requested [out] Number of bytes requested from socket
+ *
+ * @return Number of received bytes, 0 if disconnected or -1 at error
+ */
+static ssize_t _teoLNullRecvChunk(teoLNullConnectData *con,
+                                  size_t *requested) {
+    const size_t chunk = (size_t)teocliOpt_ReceiveChunkSize;
+
+    _recvRingRelease(con);
+
+    if (con->uring != NULL) {
+        *requested = chunk;
+        return _teoLNullUringRecv(con);
+    }
+
+    _recvRingReserve(con, chunk);
+
+    size_t available;
+    uint8_t *tail = _recvRingTail(con, &available);
+    if (available > chunk) { available = chunk; }
+    *requested = available;
+
+    ssize_t rc = teosockRecv(con->fd, (char *)tail, available);
+    if (rc > 0) { _recvRingCommit(con, rc); }
+
+    return rc;
+}
+
 /**
  * Split or Combine input buffer
  *
- * @param kld Pointer to input buffer
- * @param data Received data buffer
- * @param data_len Received data buffer length
+ * Received data is added to receive ring and next complete packet is
+ * delivered from it. Delivered packets are left in the ring until new data
+ * is received, so packets delivered one after another stay valid together.
+ * Packet wrapped around ring end is copied to scratch buffer to be
+ * contiguous. Packets received after key exchange answer are not delivered
+ * while worker applies it, they wait in the ring for established encryption.
+ *
+ * @param kld Pointer to teoLNullConnectData
+ * @param data Received data buffer, may be NULL when @a received is zero
  * @param received Received data length
  *
  * @return Size of packet or Packet state code
- * @retval >0 Packet received
+ * @retval >0 Packet received, teoLNullConnectData::read_buffer points to it
  * @retval -1 Packet not receiving yet (got part of packet)
  * @retval -2 Wrong packet received (dropped)
  */
-static ssize_t teoLNullPacketSplit(teoLNullConnectData *kld, void *data,
-                                   size_t data_len, ssize_t received) {
+static ssize_t teoLNullPacketSplit(teoLNullConnectData *kld, const void *data,
+                                   size_t received) {
     ssize_t retval = -1;
 
     CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
             "L0 Client: Got %" PRId32 " bytes of packet...\n", (int)received);
 
-    // Check end of previous buffer
-    if (kld->last_packet_offset > 0) {
-        kld->read_buffer_offset =
-            kld->read_buffer_offset - kld->last_packet_offset;
-
-        if (kld->read_buffer_offset > 0) {
-            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                    "L0 Client: Use %" PRId32
-                    " bytes from previously received data...\n",
-                    (int)(kld->read_buffer_offset));
-
-            memmove(kld->read_buffer,
-                    (char *)kld->read_buffer + kld->last_packet_offset,
-                    kld->read_buffer_offset);
-        }
+    // Add received data to the receive ring
+    if (received > 0) { _recvRingAppend(kld, data, received); }
 
-        kld->last_packet_offset = 0;
-    }
+    // Decrypt of packets would fail and lose their nonces, they are
+    // delivered by _teoLNullKexJobFinish
+    if (kld->kex_job != NULL) { return retval; }
 
-    // Increase buffer size
-    if ((size_t)received > kld->read_buffer_size - kld->read_buffer_offset) {
-        kld->read_buffer_size += data_len;
-        if (kld->read_buffer != NULL) {
-            kld->read_buffer = ccl_realloc(kld->read_buffer, kld->read_buffer_size);
-        } else {
-            kld->read_buffer = ccl_malloc(kld->read_buffer_size);
-        }
+    const size_t offset = kld->last_packet_offset;
+    const size_t length = kld->recv_ring_length - offset;
 
+    if (length <= sizeof(teoLNullCPacket)) {
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                "L0 Client: Increase read buffer to new size: %" PRId32
+                "L0 Client: Wait next part of packet, now it has %" PRId32
                 " bytes ...\n",
-                (int)kld->read_buffer_size);
+                (int)length);
+        return retval;
     }
 
-    // Add received data to the read buffer
-    if (received > 0) {
-        memmove((char *)kld->read_buffer + kld->read_buffer_offset, data,
-                received);
-        kld->read_buffer_offset += received;
-    }
+    // Header may be wrapped too
+    teoLNullCPacket header;
+    _recvRingRead(kld, offset, &header, sizeof(header));
+    size_t len =
+        teoLNullBufferSize(header.peer_name_length, header.data_length);
 
-    teoLNullCPacket *packet = (teoLNullCPacket *)kld->read_buffer;
-    ssize_t len;
+    // Process receive ring
+    if (length >= len) {
+        const size_t position =
+            (kld->recv_ring_head + offset) % kld->recv_ring_size;
 
-    // \todo Check packet
+        teoLNullCPacket *packet;
+        if (position + len <= kld->recv_ring_size) {
+            packet = (teoLNullCPacket *)(kld->recv_ring + position);
+        } else {
+            // Only one packet in the ring can wrap, so one scratch buffer
+            // is enough for all delivered packets
+            if (kld->recv_scratch == NULL) {
+                kld->recv_scratch = (uint8_t *)ccl_malloc(
+                    teoLNullBufferSize(UINT8_MAX, UINT16_MAX));
+            }
+            _recvRingRead(kld, offset, kld->recv_scratch, len);
+            packet = (teoLNullCPacket *)kld->recv_scratch;
+        }
 
-    // Process read buffer
-    if (kld->read_buffer_offset > sizeof(teoLNullCPacket) &&
-        kld->read_buffer_offset >=
-            (size_t)(len = teoLNullBufferSize(packet->peer_name_length,
-                                              packet->data_length))) {
-        if (teoLNullPacketChecksumCheck(packet)) {
-            // Packet has received - return packet size
-            retval = len;
+        if (teoLNullPacketChecksumCheck(kld->client_crypt, packet)) {
             kld->last_packet_offset += len;
 
-            teoLNullPacketDecrypt(kld->client_crypt, packet);
+            // Forged or damaged authenticated packet is dropped alone, stream
+            // is still in sync as its header is valid
+            if (!teoLNullPacketDecrypt(kld->client_crypt, packet)) {
+                CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                        "L0 Client: Not authenticated packet %" PRId32
+                        " bytes length; dropped ...\n",
+                        (int)len);
+                return -2;
+            }
+
+            // Packet has received - return packet size
+            retval = len;
+            kld->read_buffer = packet;
 
             CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
                     "L0 Server: Identify packet %" PRId32 " bytes length ...\n",
@@ -598,8 +2100,10 @@ static ssize_t teoLNullPacketSplit(teoLNullConnectData *kld, void *data,
 
         } else { // Wrong checksum, wrong packet - drop this packet and return
                  // -2
-            kld->read_buffer_offset = 0;
+            kld->recv_ring_head = 0;
+            kld->recv_ring_length = 0;
             kld->last_packet_offset = 0;
+            kld->read_buffer = kld->recv_ring;
             retval = -2;
 
             CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
@@ -611,21 +2115,100 @@ static ssize_t teoLNullPacketSplit(teoLNullConnectData *kld, void *data,
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
                 "L0 Client: Wait next part of packet, now it has %" PRId32
                 " bytes ...\n",
-                (int)kld->read_buffer_offset);
+                (int)length);
     }
 
     return retval;
 }
 
+/**
+ * Process L0 system packet which is not passed to application
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param cp Received packet
+ *
+ * @return Packet state code
+ * @retval 0 Application packet
+ * @retval -1 Echo command answered
+ * @retval -2 Key exchange packet processed
+ */
+static ssize_t _teoLNullRecvSystem(teoLNullConnectData *con,
+                                   teoLNullCPacket *cp) {
+    if (cp->cmd == CMD_L_INIT) {
+        KeyExchangePayload_Common *kex =
+            (KeyExchangePayload_Common *)teoLNullPacketGetPayload(cp);
+        size_t kex_length = cp->data_length;
+        if (_teoLNullProccessKEXAnswer(con, kex, kex_length)) {
+            return -2; // Skip current packet
+        }
+        return -2; // Skip current packet
+        // return 0; // Disconnect
+    }
+
+    if (cp->cmd == CMD_L_ECHO && con->fd) {
+        // Send echo answer to echo command
+        char *data = cp->peer_name + cp->peer_name_length;
+        teoLNullSend(con, CMD_L_ECHO_ANSWER, cp->peer_name, data,
+                        cp->data_length);
+        return -1; // break current iteration
+    }
+
+    return 0;
+}
+
+/**
+ * Deliver all complete packets from receive ring to event callback
+ *
+ * Every packet is sent in EV_L_RECEIVED event, or packets are collected to
+ * EV_L_RECEIVED_BATCH events if teocliOpt_ReceiveBatchEvent is set.
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return Number of delivered packets
+ */
+static size_t _teoLNullRecvDispatch(teoLNullConnectData *con) {
+    teoLNullPacketView views[RECV_BATCH_SIZE];
+    size_t count = 0;
+    size_t delivered = 0;
+    ssize_t rc;
+
+    // Dropped packet clears the ring, so loop ends on next split
+    while ((rc = teoLNullPacketSplit(con, NULL, 0)) != -1) {
+        if (rc <= 0) { continue; }
+
+        teoLNullCPacket *cp = (teoLNullCPacket *)con->read_buffer;
+        if (_teoLNullRecvSystem(con, cp) != 0) { continue; }
+
+        ++delivered;
+        if (!teocliOpt_ReceiveBatchEvent) {
+            send_l0_event(con, EV_L_RECEIVED, cp, rc);
+            continue;
+        }
+
+        views[count].packet = cp;
+        views[count].packet_length = rc;
+        if (++count == RECV_BATCH_SIZE) {
+            send_l0_event(con, EV_L_RECEIVED_BATCH, views, count);
+            count = 0;
+        }
+    }
+
+    if (count > 0) { send_l0_event(con, EV_L_RECEIVED_BATCH, views, count); }
+
+    return delivered;
+}
+
 /**
  * Check that buffer is valid teoLNullCPacket.
  *
+ * @param ctx Pointer to encryption context, may be NULL
  * @param data Received data buffer
  * @param data_len Received data buffer length
  *
  * @return true if packet is valid or false otherwise.
  */
-static inline bool teoLNullPacketCheck(uint8_t *data, size_t data_len) {
+static inline bool teoLNullPacketCheck(const teoLNullEncryptionContext *ctx,
+                                       uint8_t *data, size_t data_len) {
     if (data_len < sizeof(teoLNullCPacket)) { return false; }
 
     teoLNullCPacket *packet = (teoLNullCPacket *)data;
@@ -634,7 +2217,7 @@ static inline bool teoLNullPacketCheck(uint8_t *data, size_t data_len) {
 
     if (data_len != len) { return false; }
 
-    return teoLNullPacketChecksumCheck(packet);
+    return teoLNullPacketChecksumCheck(ctx, packet);
 }
 
 /**
@@ -647,7 +2230,7 @@ static inline bool teoLNullPacketCheck(uint8_t *data, size_t data_len) {
  * NULL otherwise
  */
 teoLNullCPacket *teoLNullPacketGetFromBuffer(uint8_t *data, size_t data_len) {
-    if (teoLNullPacketCheck(data, data_len)) {
+    if (teoLNullPacketCheck(NULL, data, data_len)) {
         return (teoLNullCPacket *)data;
     }
     return NULL;
@@ -665,12 +2248,12 @@ teoLNullCPacket *teoLNullPacketGetFromBuffer(uint8_t *data, size_t data_len) {
  * @retval -2 Wrong packet received (dropped)
  */
 ssize_t teoLNullRecv(teoLNullConnectData *con) {
-    char buf[L0_BUFFER_SIZE];
-
-    ssize_t rc = teosockRecv(con->fd, buf, L0_BUFFER_SIZE);
-    if (rc != 0) { rc = teoLNullRecvCheck(con, buf, rc); }
+    // Receive directly to the ring, teoLNullPacketSplit gets no extra data
+    size_t requested;
+    ssize_t rc = _teoLNullRecvChunk(con, &requested);
+    if (rc == 0) { return rc; }
 
-    return rc;
+    return teoLNullRecvCheck(con, NULL, 0);
 }
 
 /**
@@ -685,32 +2268,17 @@ ssize_t teoLNullRecv(teoLNullConnectData *con) {
  * @retval >0 Packet received
  * @retval -1 Packet not receiving yet (got part of packet)
  * @retval -2 Wrong packet received (dropped)
- */
-ssize_t teoLNullRecvCheck(teoLNullConnectData *con, char *buf, ssize_t rc) {
-    rc = teoLNullPacketSplit(con, buf, L0_BUFFER_SIZE, rc != -1 ? rc : 0);
-    if (rc <= 0) {
-        return rc; // No packet to check
-    }
-
-    teoLNullCPacket *cp = (teoLNullCPacket *)con->read_buffer;
-    if (cp->cmd == CMD_L_INIT) {
-        KeyExchangePayload_Common *kex =
-            (KeyExchangePayload_Common *)teoLNullPacketGetPayload(cp);
-        size_t kex_length = cp->data_length;
-        if (_teoLNullProccessKEXAnswer(con, kex, kex_length)) {
-            return -2; // Skip current packet
-        }
-        return -2; // Skip current packet
-        // return 0; // Disconnect
+ */
+ssize_t teoLNullRecvCheck(teoLNullConnectData *con, char *buf, ssize_t rc) {
+    rc = teoLNullPacketSplit(con, buf, rc > 0 ? rc : 0);
+    if (rc <= 0) {
+        return rc; // No packet to check
     }
 
-    if (cp->cmd == CMD_L_ECHO && con->fd) {
-        // Send echo answer to echo command
-        char *data = cp->peer_name + cp->peer_name_length;
-        teoLNullSend(con, CMD_L_ECHO_ANSWER, cp->peer_name, data,
-                        cp->data_length);
-        return -1; // break current iteration
-    }
+    ssize_t system_rc =
+        _teoLNullRecvSystem(con, (teoLNullCPacket *)con->read_buffer);
+    if (system_rc != 0) { return system_rc; }
+
     return rc;  // Pass as-is
 }
 
@@ -765,7 +2333,9 @@ size_t teoLNullPacketCreateLogin(teoLNullEncryptionContext *ctx, void *buffer,
 ssize_t teoLNullLogin(teoLNullConnectData *con, const char *host_name) {
     // \TODO: create crypto key here
 
-    const size_t buf_len = teoLNullBufferSize(1, strlen(host_name) + 1);
+    const size_t buf_len =
+        teoLNullBufferSize(1, strlen(host_name) + 1 +
+                                  teoLNullEncryptionOverhead(con->client_crypt));
 
 #if defined(_WIN32)
     char *buf = ccl_malloc(buf_len);
@@ -787,27 +2357,6 @@ ssize_t teoLNullLogin(teoLNullConnectData *con, const char *host_name) {
     return snd;
 }
 
-/**
- * Calculate checksum
- *
- * Calculate byte checksum in data buffer
- *
- * @param data Pointer to data buffer
- * @param data_length Length of the data buffer to calculate checksum
- *
- * @return Byte checksum of the input buffer
- */
-uint8_t get_byte_checksum(const uint8_t *data, size_t data_length) {
-    const uint8_t *position;
-    uint8_t checksum = 0;
-    for (size_t i = 0; i < data_length; ++i) {
-        position = data + i;
-        checksum += *position;
-    }
-
-    return checksum;
-}
-
 /**
  * Get L0 packet payload pointer
  *
@@ -827,6 +2376,188 @@ uint8_t *teoLNullPacketGetPayload(teoLNullCPacket *packet) {
 #define SELECT_RESULT_ERROR -1
 #endif
 
+/**
+ * Pass received datagram to TR-UDP channel
+ *
+ * @param data Datagram
+ * @param data_length Datagram length
+ * @param addr Datagram source address
+ * @param user_data Pointer to teoLNullConnectData
+ */
+static void _teoLNullUdpProcessDatagram(void *data, size_t data_length,
+                                        struct sockaddr_in *addr,
+                                        void *user_data) {
+    teoLNullConnectData *con = (teoLNullConnectData *)user_data;
+
+    CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
+            "Received %u bytes from socket.", (uint32_t)data_length);
+
+    size_t processed_length;
+    trudpChannelData *tcd =
+        trudpGetChannelCreate(con->td, (__SOCKADDR_ARG)addr, 0);
+    trudpChannelProcessReceivedPacket(tcd, data, data_length,
+                                      &processed_length);
+}
+
+/**
+ * Receive datagrams from TR-UDP socket
+ *
+ * Datagrams are received in batches of up to teocliOpt_UdpReceiveBatchSize
+ * by one system call where supported. Up to teocliOpt_MaximumReceiveInSelect
+ * batches are received, or, when teocliOpt_ReceiveTimeBudgetUs is set, until
+ * socket is drained or time budget is used up.
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullUdpReceiveAll(teoLNullConnectData *con) {
+    if (con->udp_receiver == NULL) {
+        con->udp_receiver = teoLNullUdpReceiverCreate(
+            (size_t)teocliOpt_UdpReceiveBatchSize, BUFFER_SIZE);
+        if (con->udp_receiver == NULL) {
+            LTRACK_E("TeonetClient", "Failed to allocate UDP receiver");
+            return;
+        }
+    }
+
+    const uint32_t budget = (uint32_t)teocliOpt_ReceiveTimeBudgetUs;
+    const uint64_t started = budget ? teoGetTimestampFull() : 0;
+    int32_t batches_left = teocliOpt_MaximumReceiveInSelect;
+
+    for (;;) {
+        // Every call is limited by receiver batch size only
+        int received = teoLNullUdpReceive(con->udp_receiver, con->td->fd,
+                                          INT_MAX, _teoLNullUdpProcessDatagram,
+                                          con);
+
+        if (received == -1) {
+#if defined(_WIN32)
+            int recv_errno = WSAGetLastError();
+#else
+            int recv_errno = errno;
+#endif
+            // TODO: Use thread safe error formatting function.
+            // TODO: On Windows use correct error formatting function.
+            LTRACK_E("TeonetClient",
+                     "trudpUdpRecvfrom failed with error %" PRId32 ": %s",
+                     recv_errno, strerror(recv_errno));
+        }
+
+        if (received <= 0) {
+#if defined(_WIN32)
+            CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
+                    "Resetting socket receive state.");
+
+            WSANETWORKEVENTS network_events;
+            memset(&network_events, 0, sizeof(network_events));
+
+            WSAEnumNetworkEvents(con->fd, con->handles[0], &network_events);
+#endif
+            // No more messages to receive. Leaving receive loop.
+            break;
+        }
+
+        if (budget) {
+            if (teoGetTimestampFull() - started >= budget) { break; }
+        } else {
+            if (--batches_left <= 0) { break; }
+        }
+    }
+}
+
+/**
+ * Send packet taken from send queue to TR-UDP channel
+ *
+ * @param data Packet, freed after sending
+ * @param data_length Packet length
+ * @param user_data Pointer to teoLNullConnectData
+ */
+static void _teoLNullSendQueueProcess(char *data, size_t data_length,
+                                      void *user_data) {
+    teoLNullConnectData *con = (teoLNullConnectData *)user_data;
+
+    size_t ptr = 0;
+    size_t length = data_length;
+    for (;;) {
+        size_t len =
+            length > TRUDP_FRAGMENT_SIZE ? TRUDP_FRAGMENT_SIZE : length;
+        trudpChannelSendData(con->tcd, data + ptr, len);
+        length -= len;
+        if (!length) break;
+        ptr += len;
+    }
+
+    free(data);
+}
+
+/**
+ * Send packets passed to TR-UDP send queue by other threads
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullSendQueueDrainAll(teoLNullConnectData *con) {
+    CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient", "Draining send queue.");
+
+    _teoLNullDoorbellClear(con);
+
+    size_t queued_count =
+        teoLNullSendQueueDrain(con->send_queue, _teoLNullSendQueueProcess, con);
+
+    CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
+            "Sent %u packets from send queue.", (uint32_t)queued_count);
+}
+
+/**
+ * Start collecting datagrams sent by TR-UDP select loop iteration
+ *
+ * Connection with io_uring collects TCP and UDP sends in its ring.
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullUdpSendBegin(teoLNullConnectData *con) {
+    if (con->uring != NULL) {
+        con->udp_send_collect = true;
+        return;
+    }
+
+    if (!teocliOpt_UdpSendBatch) { return; }
+
+    if (con->udp_sender == NULL) {
+        con->udp_sender = teoLNullUdpSenderCreate(
+            UDP_SEND_BATCH_SIZE, UDP_SEND_BATCH_SIZE * BUFFER_SIZE / 4);
+        if (con->udp_sender == NULL) {
+            LTRACK_E("TeonetClient", "Failed to allocate UDP sender");
+            return;
+        }
+    }
+
+    con->udp_send_collect = true;
+}
+
+/**
+ * Send datagrams collected by TR-UDP select loop iteration
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullUdpSendEnd(teoLNullConnectData *con) {
+    if (!con->udp_send_collect) { return; }
+
+    con->udp_send_collect = false;
+
+    if (con->uring != NULL) {
+        int sends = teoLNullUringSubmit(con->uring);
+
+        CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
+                "Submitted %d sends to io_uring.", sends);
+        return;
+    }
+
+    int calls = teoLNullUdpSenderFlush(con->udp_sender, con->td->fd,
+                                       teocliOpt_UdpSegmentOffload);
+
+    CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
+            "Sent batched datagrams by %d system calls.", calls);
+}
+
 /**
  * The TR-UDP cat network loop with select function
  *
@@ -846,7 +2577,7 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
     fd_set rfds;
     FD_ZERO(&rfds);
     FD_SET(td->fd, &rfds);
-    FD_SET(con->pipefd[0], &rfds);
+    FD_SET(con->doorbell_fd[0], &rfds);
 #endif
 
     uint64_t ts = teoGetTimestampFull();
@@ -859,7 +2590,7 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
     DWORD select_result =
         WaitForMultipleObjects(2, con->handles, FALSE, t / 1000);
 #else
-    int nfds = td->fd > con->pipefd[0] ? td->fd : con->pipefd[0];
+    int nfds = td->fd > con->doorbell_fd[0] ? td->fd : con->doorbell_fd[0];
 
     struct timeval tv;
     usecToTv(&tv, t);
@@ -867,6 +2598,9 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
     int select_result = select(nfds + 1, &rfds, NULL, NULL, &tv);
 #endif
 
+    // Datagrams sent by ACKs, queued packets and resends go out together
+    _teoLNullUdpSendBegin(con);
+
     // Error
     if (select_result == SELECT_RESULT_ERROR) {
 #if defined(_WIN32)
@@ -911,141 +2645,312 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
         if (FD_ISSET(td->fd, &rfds)) {
 #endif
 
-            char buffer[BUFFER_SIZE];
-            struct sockaddr_in remaddr; // remote address
-            socklen_t addr_len = sizeof(remaddr);
-
-            for (int receive_counter = 0;
-                 receive_counter < teocliOpt_MaximumReceiveInSelect;
-                 ++receive_counter) {
-                ssize_t recvlen =
-                    trudpUdpRecvfrom(td->fd, buffer, BUFFER_SIZE,
-                                     (__SOCKADDR_ARG)&remaddr, &addr_len);
-                // Process received packet
-                if (recvlen > 0) {
-                    CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                            "Received %u bytes from socket.",
-                            (uint32_t)recvlen);
-
-                    size_t data_length;
-                    trudpChannelData *tcd =
-                        trudpGetChannelCreate(td, (__SOCKADDR_ARG)&remaddr, 0);
-                    trudpChannelProcessReceivedPacket(tcd, buffer, recvlen,
-                                                      &data_length);
-                } else {
-                    if (recvlen == -1) {
-#if defined(_WIN32)
-                        int recv_errno = WSAGetLastError();
-                        if (recv_errno != WSAEWOULDBLOCK) {
-#else
-                        int recv_errno = errno;
-// EWOULDBLOCK may be not defined or may have same value as EAGAIN.
-#if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
-                        if (recv_errno != EAGAIN && recv_errno != EWOULDBLOCK) {
-#else
-                        if (recv_errno != EAGAIN) {
-#endif
-#endif
-                            // TODO: Use thread safe error formatting function.
-                            // TODO: On Windows use correct error formatting function.
-                            LTRACK_E(
-                                "TeonetClient",
-                                "trudpUdpRecvfrom failed with error %" PRId32
-                                ": %s",
-                                recv_errno, strerror(recv_errno));
-                        }
-                    }
-#if defined(_WIN32)
-                    CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                            "Resetting socket receive state.");
-
-                    WSANETWORKEVENTS network_events;
-                    memset(&network_events, 0, sizeof(network_events));
-
-                    WSAEnumNetworkEvents(con->fd, con->handles[0],
-                                         &network_events);
-#endif
-                    // No more messages to receive. Leaving receive loop.
-                    break;
-                }
-            }
+            _teoLNullUdpReceiveAll(con);
         }
-// Process Pipe (thread safe write)
+// Process send queue (thread safe write)
 #if defined(_WIN32)
         if (select_result == WAIT_OBJECT_0 + 1) {
 #else
-        if (FD_ISSET(con->pipefd[0], &rfds)) {
+        if (FD_ISSET(con->doorbell_fd[0], &rfds)) {
 #endif
-            CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                    "Checking sent data on pipe.");
+            _teoLNullSendQueueDrainAll(con);
+        }
 
-            teoPipeSendData pipe_send_data;
-            memset(&pipe_send_data, 0, sizeof(pipe_send_data));
+        retval = TEOSOCK_SELECT_READY;
+    }
 
-#if defined(_WIN32)
-            struct _stat status;
-            memset(&status, 0, sizeof(status));
+    if (select_result != SELECT_RESULT_ERROR && timeout_sq != UINT32_MAX) {
+        CLTRACK(DEBUG || teocliOpt_DBG_selectLoop, "TeonetClient",
+                "Processing send queue.");
+        int process_queue_result = trudpProcessSendQueue(td, 0);
+        CLTRACK(DEBUG || teocliOpt_DBG_selectLoop, "TeonetClient",
+                "Send queue processing finished with result %d.",
+                process_queue_result);
+    } else {
+        CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
+                "Skipping processing send queue.");
+    }
 
-            int fstat_result = _fstat(con->pipefd[0], &status);
+    _teoLNullUdpSendEnd(con);
 
-            int read_result = -1;
-            if (fstat_result == 0 && status.st_size > 0) {
-                read_result = _read(con->pipefd[0], &pipe_send_data,
-                                    sizeof(pipe_send_data));
-            }
-#else
-            ssize_t read_result =
-                read(con->pipefd[0], &pipe_send_data, sizeof(pipe_send_data));
-#endif
+    return retval;
+}
 
-            if (read_result != -1 && read_result != 0) {
-                if ((size_t)read_result != sizeof(pipe_send_data)) {
-                    LTRACK_E("TeonetClient", "Failed to read message from the "
-                                             "pipe: message read partially.");
-                    abort();
-                }
-
-                CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                        "Received message from pipe.");
-
-                ssize_t ptr = 0;
-                size_t length = pipe_send_data.data_length;
-                for (;;) {
-                    size_t len = length > 512 ? 512 : length;
-                    trudpChannelSendData(con->tcd, pipe_send_data.data + ptr,
-                                         len);
-                    length -= len;
-                    if (!length) break;
-                    ptr += len;
-                }
-                free(pipe_send_data.data);
+/**
+ * Drain send queue when its doorbell watched by io_uring is raised
+ *
+ * @param user_data Pointer to teoLNullConnectData
+ */
+static void _teoLNullUringDoorbell(void *user_data) {
+    _teoLNullSendQueueDrainAll((teoLNullConnectData *)user_data);
+}
 
+/**
+ * The io_uring network loop
+ *
+ * Waits for ring completions, delivers received packets, drains send queue
+ * and resends TR-UDP packets. Packets sent during the iteration are
+ * submitted together with the next wait.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param timeout Timeout of wait in microseconds, 0 to not wait
+ *
+ * @return Select result
+ */
+static teosockSelectResult _teoLNullUringSelectLoop(teoLNullConnectData *con,
+                                                    int64_t timeout) {
+    if (teoLNullUringClosed(con->uring)) { return TEOSOCK_SELECT_READY; }
+
+    if (!con->tcp_f) {
+        uint32_t timeout_sq =
+            trudpGetSendQueueTimeout(con->td, teoGetTimestampFull());
+        if (timeout_sq < timeout) { timeout = timeout_sq; }
+    }
+
+    _teoLNullUdpSendBegin(con);
+
+    int rc;
+    if (con->tcp_f) {
+        rc = teoLNullUringProcess(con->uring, timeout,
+                                  _teoLNullUringTcpReceive, NULL, con);
+        if (rc > 0) { _teoLNullRecvDispatch(con); }
+    } else {
+        rc = teoLNullUringProcess(con->uring, timeout,
+                                  _teoLNullUdpProcessDatagram,
+                                  _teoLNullUringDoorbell, con);
+        trudpProcessSendQueue(con->td, 0);
+    }
+
+    _teoLNullUdpSendEnd(con);
+
+    if (rc == -1) { return TEOSOCK_SELECT_ERROR; }
+
+    return rc > 0 ? TEOSOCK_SELECT_READY : TEOSOCK_SELECT_TIMEOUT;
+}
+
+/**
+ * Check if TCP connection with io_uring was closed by server
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return false if connection was closed
+ */
+static bool _teoLNullUringCheckClosed(teoLNullConnectData *con) {
+    if (!con->tcp_f || !teoLNullUringClosed(con->uring)) { return true; }
+
+    LTRACK_I("TeonetClient", "send_l0_event EV_L_DISCONNECTED in "
+                             "teoLNullReadEventLoop with closed io_uring");
+
+    send_l0_event(con, EV_L_DISCONNECTED, NULL, 0);
+    con->status = CON_STATUS_NOT_CONNECTED;
+    return false;
+}
+
+/**
+ * Check if socket has data to read without waiting
+ *
+ * @param fd Socket
+ *
+ * @return true if socket is readable
+ */
+static bool _teoLNullSocketReadable(teonetSocket fd) {
 #if defined(_WIN32)
-                SetEvent(con->handles[1]);
-#endif
-            } else {
-#if defined(_WIN32)
-                ResetEvent(con->handles[1]);
+    return teosockSelect(fd, TEOSOCK_SELECT_MODE_READ, 0) ==
+           TEOSOCK_SELECT_READY;
+#else
+    // poll has no FD_SETSIZE limit of select
+    struct pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
 #endif
-            }
+}
+
+/**
+ * Read TCP socket and deliver received packets
+ *
+ * Reads large chunks and delivers all packets of every chunk, next chunk is
+ * read only if socket filled previous one and has more data, so the call
+ * does not block on readable socket.
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return false if connection was closed by server
+ */
+static bool _teoLNullTcpReadable(teoLNullConnectData *con) {
+    for (;;) {
+        size_t requested;
+        ssize_t rc = _teoLNullRecvChunk(con, &requested);
+        if (rc == 0) {
+            LTRACK_I("TeonetClient", "send_l0_event EV_L_DISCONNECTED in "
+                                     "teoLNullReadEventLoop with 0 data");
+
+            send_l0_event(con, EV_L_DISCONNECTED, NULL, 0);
+            con->status = CON_STATUS_NOT_CONNECTED;
+            return false;
         }
 
-        retval = TEOSOCK_SELECT_READY;
+        _teoLNullRecvDispatch(con);
+
+        if (rc < 0 || (size_t)rc < requested) { break; }
+        if (!_teoLNullSocketReadable(con->fd)) { break; }
+    }
+
+    return true;
+}
+
+/**
+ * Check if TR-UDP channel was reset by server or by teoLNullShutdown
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return false if connection is closed
+ */
+static bool _teoLNullTrudpCheckReset(teoLNullConnectData *con) {
+    if (con->udp_reset_f) {
+        LTRACK_I("TeonetClient", "send_l0_event EV_L_DISCONNECTED in "
+                                 "teoLNullReadEventLoop with udp reset");
+
+        send_l0_event(con, EV_L_DISCONNECTED, NULL, 0);
+        con->status = CON_STATUS_NOT_CONNECTED;
+        con->udp_reset_f = 0;
+
+        // teoLNullDisconnect(con);  // This crashes app because we still
+        // need con after this function. We probably have to set
+        // con->tcd->conneced_f to false instead
+        con->tcd->connected_f = 0;
+
+        return false;
+    }
+
+    return con->status >= 0;
+}
+
+/**
+ * Check if asynchronous connect waits for resolver or TCP connect
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return true if connection has no socket yet
+ */
+static inline bool _teoLNullConnectPending(const teoLNullConnectData *con) {
+    return con->connect_state == CON_STATE_RESOLVING ||
+           con->connect_state == CON_STATE_CONNECTING;
+}
+
+/**
+ * Process readable descriptor of connection with socket
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param fd Readable descriptor
+ *
+ * @return false if connection was closed
+ */
+static bool _teoLNullProcessReadable(teoLNullConnectData *con,
+                                     teonetSocket fd) {
+    if (con->uring != NULL) {
+        _teoLNullUringSelectLoop(con, 0);
+
+        if (!_teoLNullUringCheckClosed(con)) { return false; }
+        return con->tcp_f ? true : _teoLNullTrudpCheckReset(con);
+    }
+
+    if (con->tcp_f) { return _teoLNullTcpReadable(con); }
+
+    _teoLNullUdpSendBegin(con);
+
+    if (fd == con->fd) {
+        _teoLNullUdpReceiveAll(con);
+    } else if (fd == con->doorbell_fd[0]) {
+        _teoLNullSendQueueDrainAll(con);
+    }
+
+    trudpProcessSendQueue(con->td, 0);
+    _teoLNullUdpSendEnd(con);
+
+    return _teoLNullTrudpCheckReset(con);
+}
+
+bool teoLNullProcessReadable(teoLNullConnectData *con, teonetSocket fd) {
+    if (_teoLNullConnectPending(con)) { return _teoLNullConnectProcess(con); }
+
+    if (con->kex_job != NULL && fd == teoLNullKexJobFd(con->kex_job)) {
+        return _teoLNullConnectProcess(con);
+    }
+
+    if (con->connect_state == CON_STATE_HANDSHAKE) {
+        return _teoLNullProcessReadable(con, fd) &&
+               _teoLNullConnectProcess(con);
+    }
+
+    return _teoLNullProcessReadable(con, fd);
+}
+
+uint32_t teoLNullProcessTimers(teoLNullConnectData *con) {
+    if (con->tcp_f || con->td == NULL) { return UINT32_MAX; }
+
+    _teoLNullUdpSendBegin(con);
+    trudpProcessSendQueue(con->td, 0);
+    _teoLNullUdpSendEnd(con);
+
+    return trudpGetSendQueueTimeout(con->td, teoGetTimestampFull());
+}
+
+uint32_t teoLNullTimersTimeout(teoLNullConnectData *con) {
+    if (con->tcp_f || con->td == NULL) { return UINT32_MAX; }
+
+    return trudpGetSendQueueTimeout(con->td, teoGetTimestampFull());
+}
+
+bool teoLNullProcessIdle(teoLNullConnectData *con) {
+    // Connect deadline is checked at least once per idle interval
+    if (con->connect_state != CON_STATE_DONE &&
+        !_teoLNullConnectProcess(con)) {
+        return false;
+    }
+
+    send_l0_event(con, EV_L_IDLE, NULL, 0);
+    if (con->tcp_f || con->td == NULL) { return true; }
+
+    trudpProcessKeepConnection(con->td);
+
+    return _teoLNullTrudpCheckReset(con);
+}
+
+/**
+ * Wait for resolver, TCP connect or key exchange worker of asynchronous
+ * connect during timeout
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param timeout Timeout of wait in ms
+ *
+ * @return false if connection failed
+ */
+static bool _teoLNullConnectWait(teoLNullConnectData *con, int timeout) {
+    const uint64_t now = teoGetTimestampFull();
+    const uint64_t remaining_ms = con->connect_deadline > now
+                                      ? (con->connect_deadline - now + 999) /
+                                            1000
+                                      : 0;
+    if (timeout < 0 || remaining_ms < (uint64_t)timeout) {
+        timeout = (int)remaining_ms;
     }
 
-    if (select_result != SELECT_RESULT_ERROR && timeout_sq != UINT32_MAX) {
-        CLTRACK(DEBUG || teocliOpt_DBG_selectLoop, "TeonetClient",
-                "Processing send queue.");
-        int process_queue_result = trudpProcessSendQueue(td, 0);
-        CLTRACK(DEBUG || teocliOpt_DBG_selectLoop, "TeonetClient",
-                "Send queue processing finished with result %d.",
-                process_queue_result);
+    if (con->connect_state == CON_STATE_RESOLVING) {
+        // Resolver without descriptor has result already
+        teonetSocket fd = teoLNullResolverFd(con->resolver);
+        if (fd != -1) {
+            teosockSelect(fd, TEOSOCK_SELECT_MODE_READ, timeout);
+        }
+    } else if (con->kex_job != NULL) {
+        teosockSelect(teoLNullKexJobFd(con->kex_job),
+                      TEOSOCK_SELECT_MODE_READ, timeout);
     } else {
-        CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                "Skipping processing send queue.");
+        teosockSelect(con->fd, TEOSOCK_SELECT_MODE_WRITE, timeout);
     }
 
-    return retval;
+    bool can_continue = _teoLNullConnectProcess(con);
+    send_l0_event(con, EV_L_TICK, NULL, 0);
+
+    return can_continue;
 }
 
 /**
@@ -1060,7 +2965,15 @@ bool teoLNullReadEventLoop(teoLNullConnectData *con, int timeout) {
     bool can_continue = true;
     int rv;
 
-    if (con->tcp_f) {
+    // TCP connection waits for key exchange worker, packets received with
+    // its answer are delivered when worker is done
+    if (_teoLNullConnectPending(con) || (con->tcp_f && con->kex_job != NULL)) {
+        return _teoLNullConnectWait(con, timeout);
+    }
+
+    if (con->uring != NULL) {
+        rv = _teoLNullUringSelectLoop(con, (int64_t)timeout * 1000);
+    } else if (con->tcp_f) {
         rv = teosockSelect(con->fd, TEOSOCK_SELECT_MODE_READ, timeout);
     } else {
         rv = trudpNetworkSelectLoop(con, timeout * 1000);
@@ -1078,49 +2991,245 @@ bool teoLNullReadEventLoop(teoLNullConnectData *con, int timeout) {
         if (!con->tcp_f) { trudpProcessKeepConnection(con->td); }
     } else { // There is a data in sd. We should send TCP-data to event-loop,
              // UDP-data has been send in trudp-eventloop
-        if (con->tcp_f) {
-            ssize_t rc;
-            while ((rc = teoLNullRecv(con)) != -1) {
-                if (rc > 0) {
-                    send_l0_event(con, EV_L_RECEIVED, con->read_buffer, rc);
-                } else if (rc == 0) {
-                    LTRACK_I("TeonetClient",
-                             "send_l0_event EV_L_DISCONNECTED in "
-                             "teoLNullReadEventLoop with 0 data");
-
-                    send_l0_event(con, EV_L_DISCONNECTED, NULL, 0);
-                    con->status = CON_STATUS_NOT_CONNECTED;
-                    can_continue = false;
-                    break;
-                }
-            }
+        if (con->tcp_f && con->uring == NULL) {
+            can_continue = _teoLNullTcpReadable(con);
         }
     }
 
-    if (!con->tcp_f) {
-        if (con->udp_reset_f) {
-            LTRACK_I("TeonetClient", "send_l0_event EV_L_DISCONNECTED in "
-                                     "teoLNullReadEventLoop with udp reset");
+    if (con->uring != NULL && !_teoLNullUringCheckClosed(con)) {
+        can_continue = false;
+    }
 
-            send_l0_event(con, EV_L_DISCONNECTED, NULL, 0);
-            con->status = CON_STATUS_NOT_CONNECTED;
-            can_continue = false;
-            con->udp_reset_f = 0;
+    if (!con->tcp_f && !_teoLNullTrudpCheckReset(con)) {
+        can_continue = false;
+    }
 
-            // teoLNullDisconnect(con);  // This crashes app because we still
-            // need con after this function. We probably have to set
-            // con->tcd->conneced_f to false instead
-            con->tcd->connected_f = 0;
+    if (con->connect_state == CON_STATE_HANDSHAKE &&
+        !_teoLNullConnectProcess(con)) {
+        can_continue = false;
+    }
+    send_l0_event(con, EV_L_TICK, NULL, 0);
 
-        } else {
-            if (con->status < 0) {
-                can_continue = false;
+    return can_continue;
+}
+
+/**
+ * Get descriptors of connection to watch in application event loop
+ *
+ * The connection socket and, for TR-UDP connections, the send queue doorbell
+ * should be watched, ready descriptors are passed to teoLNullOnReadable or
+ * teoLNullOnWritable. On Windows send queue is drained by teoLNullOnTimer.
+ * Connection with io_uring has only ring descriptor. During asynchronous
+ * connect descriptors change: resolver descriptor is returned first, then
+ * socket waiting for TCP connect with TEOLNULL_POLL_WRITE flag, and key
+ * exchange worker descriptor is added while worker applies server answer, so
+ * they should be taken again after every teoLNullOn* call.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param fds Array to fill, may be NULL to get number of descriptors
+ * @param fds_length Length of @a fds array
+ *
+ * @return Number of connection descriptors, may be more than @a fds_length
+ */
+size_t teoLNullGetPollFds(teoLNullConnectData *con, teoLNullPollFd *fds,
+                          size_t fds_length) {
+    size_t count = 0;
+
+    if (con->connect_state == CON_STATE_RESOLVING) {
+        teonetSocket fd = teoLNullResolverFd(con->resolver);
+        if (fd == -1) { return 0; }
+
+        if (count < fds_length) {
+            fds[count].fd = fd;
+            fds[count].events = TEOLNULL_POLL_READ;
+        }
+        return ++count;
+    }
+
+    if (con->connect_state == CON_STATE_CONNECTING) {
+        if (count < fds_length) {
+            fds[count].fd = con->fd;
+            fds[count].events = TEOLNULL_POLL_WRITE;
+        }
+        return ++count;
+    }
+
+    if (con->fd < 0) { return 0; }
+
+    // Ring completes socket input and doorbell watch
+    if (con->uring != NULL) {
+        if (count < fds_length) {
+            fds[count].fd = teoLNullUringFd(con->uring);
+            fds[count].events = TEOLNULL_POLL_READ;
+        }
+        ++count;
+    } else {
+        if (count < fds_length) {
+            fds[count].fd = con->fd;
+            fds[count].events = TEOLNULL_POLL_READ;
+        }
+        ++count;
+
+#if !defined(_WIN32)
+        if (!con->tcp_f) {
+            if (count < fds_length) {
+                fds[count].fd = con->doorbell_fd[0];
+                fds[count].events = TEOLNULL_POLL_READ;
             }
+            ++count;
         }
+#endif
     }
-    send_l0_event(con, EV_L_TICK, NULL, 0);
 
-    return can_continue;
+    // Key exchange worker descriptor is the last one
+    if (con->kex_job != NULL) {
+        if (count < fds_length) {
+            fds[count].fd = teoLNullKexJobFd(con->kex_job);
+            fds[count].events = TEOLNULL_POLL_READ;
+        }
+        ++count;
+    }
+
+    return count;
+}
+
+/**
+ * Get time of next EV_L_IDLE event, start idle interval on first call
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param now Current time
+ *
+ * @return Time of next EV_L_IDLE event
+ */
+static uint64_t _teoLNullIdleAt(teoLNullConnectData *con, uint64_t now) {
+    if (con->idle_at == 0) { con->idle_at = now + IDLE_INTERVAL_US; }
+
+    return con->idle_at;
+}
+
+/**
+ * Get time to wait in application event loop before teoLNullOnTimer call
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return Timeout in microseconds: time to next TR-UDP resend, EV_L_IDLE
+ *  event or connect deadline, 0 if teoLNullOnTimer should be called at once
+ */
+uint64_t teoLNullGetNextTimeoutUs(teoLNullConnectData *con) {
+    const uint64_t now = teoGetTimestampFull();
+    const uint64_t idle_at = _teoLNullIdleAt(con, now);
+
+    uint64_t timeout = idle_at > now ? idle_at - now : 0;
+
+    const uint32_t resend_timeout = teoLNullTimersTimeout(con);
+    if (resend_timeout < timeout) { timeout = resend_timeout; }
+
+    if (con->connect_state != CON_STATE_DONE) {
+        // Resolver without descriptor has result already
+        if (con->connect_state == CON_STATE_RESOLVING &&
+            teoLNullResolverFd(con->resolver) == -1) {
+            return 0;
+        }
+
+        const uint64_t connect_timeout =
+            con->connect_deadline > now ? con->connect_deadline - now : 0;
+        if (connect_timeout < timeout) { timeout = connect_timeout; }
+    }
+
+    return timeout;
+}
+
+/**
+ * Process readable connection descriptor without blocking
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param fd Readable descriptor returned by teoLNullGetPollFds
+ *
+ * @return false if connection was closed
+ */
+bool teoLNullOnReadable(teoLNullConnectData *con, teonetSocket fd) {
+    // Input postpones EV_L_IDLE, send queue doorbell is not input
+    if (fd == con->fd ||
+        (con->uring != NULL && fd == teoLNullUringFd(con->uring))) {
+        con->idle_at = teoGetTimestampFull() + IDLE_INTERVAL_US;
+    }
+
+    return teoLNullProcessReadable(con, fd);
+}
+
+/**
+ * Process writable connection descriptor without blocking
+ *
+ * Completes TCP connect of teoLNullConnectAsync. Connected connection
+ * flushes output which is not sent yet: TR-UDP packets queued by other
+ * threads and due in TR-UDP send queue, and sends queued to io_uring. Packets
+ * are sent at once by send functions, so descriptors are returned with
+ * TEOLNULL_POLL_WRITE flag only while connection waits for TCP connect, but
+ * loop watching write readiness of connection socket may call it any time.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param fd Writable descriptor returned by teoLNullGetPollFds
+ *
+ * @return false if connection was closed
+ */
+bool teoLNullOnWritable(teoLNullConnectData *con, teonetSocket fd) {
+    (void)fd;
+
+    if (_teoLNullConnectPending(con)) { return _teoLNullConnectProcess(con); }
+    if (con->status < 0 || con->fd < 0) { return con->status >= 0; }
+
+    if (con->uring != NULL) {
+        if (teoLNullUringSubmit(con->uring) == -1) {
+            LTRACK_E("TeonetClient", "io_uring submit failed");
+        }
+
+        if (!_teoLNullUringCheckClosed(con)) { return false; }
+        return con->tcp_f ? true : _teoLNullTrudpCheckReset(con);
+    }
+
+    if (con->tcp_f) { return true; }
+
+    _teoLNullUdpSendBegin(con);
+    _teoLNullSendQueueDrainAll(con);
+    trudpProcessSendQueue(con->td, 0);
+    _teoLNullUdpSendEnd(con);
+
+    return _teoLNullTrudpCheckReset(con);
+}
+
+/**
+ * Process connection timers when teoLNullGetNextTimeoutUs expires
+ *
+ * Resends TR-UDP packets which are due and sends EV_L_IDLE event and TR-UDP
+ * keepalive if connection had no input during idle interval. Fails
+ * asynchronous connect after its deadline. Early calls do nothing.
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return false if connection was closed
+ */
+bool teoLNullOnTimer(teoLNullConnectData *con) {
+    if (_teoLNullConnectPending(con)) { return _teoLNullConnectProcess(con); }
+
+#if defined(_WIN32)
+    if (!con->tcp_f) { _teoLNullSendQueueDrainAll(con); }
+#endif
+
+    teoLNullProcessTimers(con);
+
+    if (con->connect_state == CON_STATE_HANDSHAKE &&
+        !_teoLNullConnectProcess(con)) {
+        return false;
+    }
+
+    const uint64_t now = teoGetTimestampFull();
+    if (now < _teoLNullIdleAt(con, now)) {
+        return con->tcp_f ? true : _teoLNullTrudpCheckReset(con);
+    }
+
+    con->idle_at = now + IDLE_INTERVAL_US;
+
+    return teoLNullProcessIdle(con);
 }
 
 static inline bool
@@ -1135,8 +3244,15 @@ _setupEncryptionContext(teoLNullConnectData *con,
     if (crypt_size == 0) { return false; }
 
     con->client_crypt = (teoLNullEncryptionContext *)ccl_malloc(crypt_size);
-    size_t result = teoLNullEncryptionContextCreate(
-        enc_proto, (uint8_t *)con->client_crypt, crypt_size);
+    size_t result;
+    if (enc_proto == ENC_PROTO_ECDH_AES_128_RESUME_V1) {
+        if (con->resume_ticket == NULL) { return false; }
+        result = teoLNullEncryptionContextCreateResume(
+            con->resume_ticket, (uint8_t *)con->client_crypt, crypt_size);
+    } else {
+        result = teoLNullEncryptionContextCreate(
+            enc_proto, (uint8_t *)con->client_crypt, crypt_size);
+    }
     if (result == 0) { return false; }
 
     return true;
@@ -1163,18 +3279,59 @@ static inline uint8_t *_createKEXPayload(teoLNullConnectData *con,
 }
 
 /**
- * Performs connection handshake if required
+ * Start io_uring backend of connected socket if teocliOpt_IoUring is set
+ *
+ * Connection uses select if io_uring is not available.
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullUringStart(teoLNullConnectData *con) {
+    if (!teocliOpt_IoUring) { return; }
+
+    const size_t buffer_size = con->tcp_f
+                                   ? (size_t)teocliOpt_ReceiveChunkSize
+                                   : BUFFER_SIZE + 64;
+
+    con->uring = teoLNullUringCreate(con->fd, !con->tcp_f, buffer_size);
+    if (con->uring != NULL && !con->tcp_f &&
+        !teoLNullUringWatch(con->uring, con->doorbell_fd[0])) {
+        teoLNullUringDestroy(con->uring);
+        con->uring = NULL;
+    }
+
+    if (con->uring == NULL) {
+        LTRACK_I("TeonetClient", "io_uring is not used, fd = %d",
+                 (int)con->fd);
+    }
+}
+
+/**
+ * Close socket of connection and its io_uring
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullSocketClose(teoLNullConnectData *con) {
+    teoLNullUringDestroy(con->uring);
+    con->uring = NULL;
+
+    teosockClose(con->fd);
+    con->fd = -1;
+}
+
+/**
+ * Starts connection handshake if required
  * TCP connection without encryption considered established instantly
- * For TRUDP connection without encryption - sends dummy empty packet and awaits
- * for ACK or DATA in response.
- * If connecion uses encryption - sends key exchange packet to server and awaits
- * for remote keys in answer, both - for TCP and UDP
+ * For TRUDP connection without encryption - sends dummy empty packet, ACK or
+ * DATA in response connects it.
+ * If connecion uses encryption - sends key exchange packet to server, remote
+ * keys in answer connect it, both - for TCP and UDP
  *
- * @return resulting connection
+ * Sends EV_L_CONNECTED event if connection is established or failed.
+ *
+ * @return false if connection failed
  */
-static inline teoLNullConnectData *
-_teoLNullConnectionInitiate(teoLNullConnectData *con,
-                            teoLNullEncryptionProtocol enc_proto) {
+static bool _teoLNullHandshakeStart(teoLNullConnectData *con,
+                                    teoLNullEncryptionProtocol enc_proto) {
     if (enc_proto == ENC_PROTO_DISABLED) {
         if (con->tcp_f) {
             // Plain old TCP connection ready to use
@@ -1182,7 +3339,7 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
             con->status = CON_STATUS_CONNECTED;
             send_l0_event(con, EV_L_CONNECTED, &con->status,
                           sizeof(con->status));
-            return con;
+            return true;
 
         } else {
             CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
@@ -1201,11 +3358,10 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
                      (int)enc_proto);
 
             con->status = CON_STATUS_ENCRYPTION_ERROR;
-            teosockClose(con->fd);
-            con->fd = -1;
+            _teoLNullSocketClose(con);
             send_l0_event(con, EV_L_CONNECTED, &con->status,
                           sizeof(con->status));
-            return con;
+            return false;
         }
 
         // Prepare and send key exchange packet to establish encryption
@@ -1220,11 +3376,10 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
                      proto_name, (int)enc_proto);
 
             con->status = CON_STATUS_ENCRYPTION_ERROR;
-            teosockClose(con->fd);
-            con->fd = -1;
+            _teoLNullSocketClose(con);
             send_l0_event(con, EV_L_CONNECTED, &con->status,
                           sizeof(con->status));
-            return con;
+            return false;
         }
 
         // Wrap it via teoLNullCPacket
@@ -1246,49 +3401,242 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
                      (int)send_result);
 
             con->status = CON_STATUS_ENCRYPTION_ERROR;
-            teosockClose(con->fd);
-            con->fd = -1;
+            _teoLNullSocketClose(con);
+            send_l0_event(con, EV_L_CONNECTED, &con->status,
+                          sizeof(con->status));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Performs connection handshake if required and waits for its end
+ *
+ * @return resulting connection
+ */
+static inline teoLNullConnectData *
+_teoLNullConnectionInitiate(teoLNullConnectData *con,
+                            teoLNullEncryptionProtocol enc_proto) {
+    if (!_teoLNullHandshakeStart(con, enc_proto) ||
+        con->status == CON_STATUS_CONNECTED) {
+        return con;
+    }
+
+    const int64_t connect_deadline_ms =
+        teotimeGetCurrentTimeMs() + teocliOpt_ConnectTimeoutMs;
+    while (con->status == CON_STATUS_NOT_CONNECTED) {
+        const int64_t remaining_ms =
+            connect_deadline_ms - teotimeGetCurrentTimeMs();
+        if (remaining_ms <= 0) {
+            CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
+                      "connection timed out");
+            con->status = CON_STATUS_CONNECTION_ERROR;
+            _teoLNullSocketClose(con);
             send_l0_event(con, EV_L_CONNECTED, &con->status,
                           sizeof(con->status));
             return con;
         }
+
+        // Wait for answer until connect deadline, TR-UDP loop wakes up
+        // earlier for resends. Event loop timeout is converted to
+        // microseconds.
+        const int64_t wait_ms =
+            remaining_ms < INT_MAX / 1000 ? remaining_ms : INT_MAX / 1000;
+        bool can_continue = teoLNullReadEventLoop(con, (int)wait_ms);
+        if (!can_continue) {
+            CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
+                      "connection event loop stopped");
+            break;
+        }
+    }
+
+    if (con->status != CON_STATUS_CONNECTED) {
+        CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
+                  "Connection canceled by status %s (%d)",
+                  STRING_teoLNullConnectionStatus(con->status),
+                  (int)con->status);
+        _teoLNullSocketClose(con);
+        return con;
+    }
+
+    // Success !!!
+    return con;
+}
+
+/**
+ * Allocate connection data and initialize it for not connected connection
+ *
+ * @param event_cb Pointer to event callback function
+ * @param user_data Pointer to user data which will be send to event callback
+ * @param connection_flag TCP or TRUDP
+ *
+ * @return Pointer to teoLNullConnectData
+ */
+static teoLNullConnectData *
+_teoLNullConnectDataCreate(teoLNullEventsCb event_cb, void *user_data,
+                           PROTOCOL connection_flag) {
+    teoLNullConnectData *con =
+        (teoLNullConnectData *)ccl_malloc(sizeof(teoLNullConnectData));
+    if (con == NULL) {
+        LTRACK_E("TeonetClient", "Failed to allocate teoLNullConnectData");
+        abort();
+    }
+
+    con->last_packet_offset = 0;
+    con->read_buffer = NULL;
+    con->recv_ring = NULL;
+    con->recv_ring_size = 0;
+    con->recv_ring_head = 0;
+    con->recv_ring_length = 0;
+    con->recv_ring_peak = 0;
+    con->recv_scratch = NULL;
+    con->udp_receiver = NULL;
+    con->udp_sender = NULL;
+    con->udp_send_collect = false;
+    con->uring = NULL;
+    con->reactor = NULL;
+    con->reactor_entry = NULL;
+    con->shard = NULL;
+    con->idle_at = 0;
+    con->client_crypt = NULL;
+    con->resume_ticket = NULL;
+    con->kex_job = NULL;
+    con->deferred_head = NULL;
+    con->deferred_tail = NULL;
+    con->reserved_packet = NULL;
+    con->reserved_data_length = 0;
+    con->send_buffer = NULL;
+    con->send_buffer_size = 0;
+    con->event_cb = event_cb;
+    con->user_data = user_data;
+    con->udp_reset_f = 0;
+    con->td = NULL;
+    con->tcp_f = connection_flag;
+    con->tcd = NULL;
+    con->send_queue = NULL;
+    con->doorbell_fd[0] = -1;
+    con->doorbell_fd[1] = -1;
+    con->status = CON_STATUS_NOT_CONNECTED;
+    con->connect_state = CON_STATE_DONE;
+    con->connect_deadline = 0;
+    con->resolver = NULL;
+    con->connect_port = 0;
+    con->connect_enc_proto = ENC_PROTO_DISABLED;
+
+#if defined(_WIN32)
+    con->handles[0] = NULL;
+    con->handles[1] = NULL;
+#endif
+
+    return con;
+}
+
+/**
+ * Bind UDP socket and create TR-UDP channel to server
+ *
+ * Sends EV_L_CONNECTED event with error status if failed.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param server Server IP or name
+ * @param port Server port
+ *
+ * @return true on success
+ */
+static bool _teoLNullUdpOpen(teoLNullConnectData *con, const char *server,
+                             int16_t port) {
+    int port_local = 0;
+    con->fd = trudpUdpBindRaw(&port_local, 1);
+    if (con->fd < 0) {
+        LTRACK_E("TeonetClient", "Failed to bind UDP socket.");
+        con->status = CON_STATUS_SOCKET_ERROR;
+        con->fd = -1;
+        send_l0_event(con, EV_L_CONNECTED, &con->status,
+                      sizeof(con->status));
+        return false;
+    }
+
+    con->td = trudpInit(con->fd, port, trudpEventCback, con);
+    con->tcd = trudpChannelNew(con->td, (char *)server, port, 0);
+    LTRACK_I("TeonetClient", "TR-UDP port = %d created, fd = %d",
+             port_local, (int)con->fd);
+
+    // Send queue and its doorbell create
+    con->send_queue = teoLNullSendQueueCreate(teocliOpt_SendQueueSize);
+    if (con->send_queue == NULL || !_teoLNullDoorbellCreate(con)) {
+        con->status = CON_STATUS_PIPE_ERROR;
+        LTRACK_E("TeonetClient",
+                 "Failed to create queue for sending commands.");
+
+        teosockClose(con->fd);
+        con->fd = -1;
+        send_l0_event(con, EV_L_CONNECTED, &con->status,
+                      sizeof(con->status));
+        return false;
+    }
+
+#if defined(_WIN32)
+    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient", "Creating events.");
+    con->handles[0] = WSACreateEvent();
+    con->handles[1] = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    int event_select_result = 0;
+    if (con->handles[0] != NULL && con->handles[1] != NULL) {
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "Binding socket to event.");
+        event_select_result =
+            WSAEventSelect(con->fd, con->handles[0], FD_READ | FD_CLOSE);
+        if (event_select_result != 0) {
+            int error_code = WSAGetLastError();
+            LTRACK_E("TeonetClient", "Failed to bind event, error code %d.",
+                     error_code);
+
+            if (error_code == WSAENETDOWN) {
+                LTRACK_E("TeonetClient", "Error: WSAENETDOWN.");
+            } else if (error_code == WSAEINVAL) {
+                LTRACK_E("TeonetClient", "Error: WSAEINVAL.");
+            } else if (error_code == WSAEINPROGRESS) {
+                LTRACK_E("TeonetClient", "Error: WSAEINPROGRESS.");
+            } else if (error_code == WSAENOTSOCK) {
+                LTRACK_E("TeonetClient", "Error: WSAENOTSOCK.");
+            } else {
+                LTRACK_E("TeonetClient", "Error: unknown.");
+            }
+        }
     }
 
-    int64_t connect_start_time_ms = teotimeGetCurrentTimeMs();
-    while (con->status == CON_STATUS_NOT_CONNECTED) {
-        bool can_continue = teoLNullReadEventLoop(con, 100);
-        if (!can_continue) {
-            CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
-                      "connection event loop stopped");
-            break;
+    if (con->handles[0] == NULL || con->handles[1] == NULL ||
+        event_select_result != 0) {
+        LTRACK_E("TeonetClient",
+                 "Failed to create events for sending commands.");
+
+        if (con->handles[0] != NULL) {
+            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                    "Closing write handle.");
+            WSACloseEvent(con->handles[0]);
+            con->handles[0] = NULL;
         }
-        const int64_t connection_time_ms =
-            teotimeGetTimePassedMs(connect_start_time_ms);
-        if (connection_time_ms > teocliOpt_ConnectTimeoutMs) {
 
-            CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
-                      "connection timed out");
-            con->status = CON_STATUS_CONNECTION_ERROR;
-            teosockClose(con->fd);
-            con->fd = -1;
-            send_l0_event(con, EV_L_CONNECTED, &con->status,
-                          sizeof(con->status));
-            return con;
+        if (con->handles[1] != NULL) {
+            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                    "Closing read handle.");
+            CloseHandle(con->handles[1]);
+            con->handles[1] = NULL;
         }
-    }
 
-    if (con->status != CON_STATUS_CONNECTED) {
-        CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
-                  "Connection canceled by status %s (%d)",
-                  STRING_teoLNullConnectionStatus(con->status),
-                  (int)con->status);
+        con->status = CON_STATUS_PIPE_ERROR;
         teosockClose(con->fd);
         con->fd = -1;
-        return con;
+        send_l0_event(con, EV_L_CONNECTED, &con->status,
+                      sizeof(con->status));
+        return false;
     }
+#endif
 
-    // Success !!!
-    return con;
+    _teoLNullUringStart(con);
+
+    return true;
 }
 
 /**
@@ -1311,31 +3659,7 @@ teoLNullConnectData *teoLNullConnectE(const char *server, int16_t port,
                                       void *user_data,
                                       PROTOCOL connection_flag) {
     teoLNullConnectData *con =
-        (teoLNullConnectData *)ccl_malloc(sizeof(teoLNullConnectData));
-    if (con == NULL) {
-        LTRACK_E("TeonetClient", "Failed to allocate teoLNullConnectData");
-        abort();
-    }
-
-    con->last_packet_offset = 0;
-    con->read_buffer = NULL;
-    con->read_buffer_offset = 0;
-    con->read_buffer_size = 0;
-    con->client_crypt = NULL;
-    con->event_cb = event_cb;
-    con->user_data = user_data;
-    con->udp_reset_f = 0;
-    con->td = NULL;
-    con->tcp_f = connection_flag;
-    con->tcd = NULL;
-    con->pipefd[0] = -1;
-    con->pipefd[1] = -1;
-    con->status = CON_STATUS_NOT_CONNECTED;
-
-#if defined(_WIN32)
-    con->handles[0] = NULL;
-    con->handles[1] = NULL;
-#endif
+        _teoLNullConnectDataCreate(event_cb, user_data, connection_flag);
 
     // Connect to TCP
     if (con->tcp_f) {
@@ -1384,129 +3708,350 @@ teoLNullConnectData *teoLNullConnectE(const char *server, int16_t port,
         // Set TCP_NODELAY option
         teosockSetTcpNodelay(con->fd);
 
+        _teoLNullUringStart(con);
+
     } else {
         // Connect to UDP
-        int port_local = 0;
-        con->fd = trudpUdpBindRaw(&port_local, 1);
-        if (con->fd < 0) {
-            LTRACK_E("TeonetClient", "Failed to bind UDP socket.");
-            con->status = CON_STATUS_SOCKET_ERROR;
-            con->fd = -1;
-            send_l0_event(con, EV_L_CONNECTED, &con->status,
-                          sizeof(con->status));
-            return con;
+        if (!_teoLNullUdpOpen(con, server, port)) { return con; }
+    }
+
+    return _teoLNullConnectionInitiate(con, teocliOpt_EncryptionProtocol);
+}
+
+/**
+ * Create TCP client and connect to server without event callback
+ *
+ * @param server Server IP or name
+ * @param port Server port
+ *
+ * @return Pointer to teoLNullConnectData. Null if no memory error
+ * @retval teoLNullConnectData::status== 1 - Success connection
+ * @retval teoLNullConnectData::status==-1 - Create socket error
+ * @retval teoLNullConnectData::status==-2 - HOST NOT FOUND error
+ * @retval teoLNullConnectData::status==-3 - Client-connect() error
+ */
+teoLNullConnectData *teoLNullConnect(const char *server, int16_t port,
+                                     PROTOCOL connection_flag) {
+    return teoLNullConnectE(server, port, NULL, NULL, connection_flag);
+}
+
+/**
+ * Finish asynchronous connect with error
+ *
+ * Closes socket and sends EV_L_CONNECTED event with error status.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param status Error status
+ *
+ * @return false
+ */
+static bool _teoLNullConnectFail(teoLNullConnectData *con,
+                                 teoLNullConnectionStatus status) {
+    teoLNullResolverRelease(con->resolver);
+    con->resolver = NULL;
+    _teoLNullKexJobRelease(con);
+    _teoLNullDeferredFree(con);
+
+    if (con->fd >= 0) { _teoLNullSocketClose(con); }
+
+    con->connect_state = CON_STATE_DONE;
+    con->status = status;
+    send_l0_event(con, EV_L_CONNECTED, &con->status, sizeof(con->status));
+
+    return false;
+}
+
+/**
+ * Start handshake of asynchronous connect on connected socket
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return false if connection failed
+ */
+static bool _teoLNullConnectHandshake(teoLNullConnectData *con) {
+    con->connect_state = CON_STATE_HANDSHAKE;
+
+    if (!_teoLNullHandshakeStart(
+            con, (teoLNullEncryptionProtocol)con->connect_enc_proto)) {
+        con->connect_state = CON_STATE_DONE;
+        return false;
+    }
+
+    if (con->status == CON_STATUS_CONNECTED) {
+        con->connect_state = CON_STATE_DONE;
+    }
+
+    return true;
+}
+
+/**
+ * Start TCP connect or TR-UDP channel to resolved server address
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param addr Server address
+ *
+ * @return false if connection failed
+ */
+static bool _teoLNullConnectStart(teoLNullConnectData *con,
+                                  const struct sockaddr_in *addr) {
+    if (!con->tcp_f) {
+        char host[INET_ADDRSTRLEN];
+        if (inet_ntop(AF_INET, (void *)&addr->sin_addr, host,
+                      sizeof(host)) == NULL) {
+            return _teoLNullConnectFail(con, CON_STATUS_HOST_ERROR);
+        }
+
+        // Failed open sends EV_L_CONNECTED itself
+        con->connect_state = CON_STATE_DONE;
+        if (!_teoLNullUdpOpen(con, host, (int16_t)con->connect_port)) {
+            return false;
         }
 
-        con->td = trudpInit(con->fd, port, trudpEventCback, con);
-        con->tcd = trudpChannelNew(con->td, (char *)server, port, 0);
-        LTRACK_I("TeonetClient", "TR-UDP port = %d created, fd = %d",
-                 port_local, (int)con->fd);
+        return _teoLNullConnectHandshake(con);
+    }
+
+    con->fd = teosockCreateTcp();
+    if (con->fd == TEOSOCK_INVALID_SOCKET) {
+        LTRACK_E("TeonetClient", "Can't create socket");
+        con->fd = -1;
+        return _teoLNullConnectFail(con, CON_STATUS_SOCKET_ERROR);
+    }
+
+    teosockSetBlockingMode(con->fd, TEOSOCK_NON_BLOCKING_MODE);
 
-// Pipe create
+    // Connected socket is writable at once, so both results are checked by
+    // CON_STATE_CONNECTING step
+    int result =
+        connect(con->fd, (const struct sockaddr *)addr, sizeof(*addr));
 #if defined(_WIN32)
-        int pipe_result = _pipe(con->pipefd, 1024 * 10, _O_BINARY);
+    const bool in_progress = WSAGetLastError() == WSAEWOULDBLOCK;
 #else
-        int pipe_result = pipe(con->pipefd);
+    const bool in_progress = errno == EINPROGRESS;
 #endif
-        if (pipe_result == -1) {
-            con->status = CON_STATUS_PIPE_ERROR;
-            con->pipefd[0] = -1;
-            con->pipefd[1] = -1;
-            LTRACK_E("TeonetClient",
-                     "Failed to create pipe for sending commands.");
+    if (result != 0 && !in_progress) {
+        int error = errno;
+        LTRACK_E("TeonetClient", "Client-connect() error: %" PRId32 ", %s",
+                 error, strerror(error));
+        return _teoLNullConnectFail(con, CON_STATUS_CONNECTION_ERROR);
+    }
 
-            teosockClose(con->fd);
-            con->fd = -1;
-            send_l0_event(con, EV_L_CONNECTED, &con->status,
-                          sizeof(con->status));
-            return con;
-        }
+    con->connect_state = CON_STATE_CONNECTING;
+    return true;
+}
 
-#if defined(_WIN32)
-        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient", "Creating events.");
-        con->handles[0] = WSACreateEvent();
-        con->handles[1] = CreateEventA(NULL, TRUE, FALSE, NULL);
+/**
+ * Advance asynchronous connect without blocking
+ *
+ * Takes resolved address, checks finished TCP connect and handshake result
+ * and fails connect after its deadline.
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return false if connection failed
+ */
+static bool _teoLNullConnectProcess(teoLNullConnectData *con) {
+    if (con->connect_state == CON_STATE_RESOLVING) {
+        // Resolver which failed to start fails connect at the first step
+        if (con->resolver == NULL) {
+            return _teoLNullConnectFail(con, CON_STATUS_SOCKET_ERROR);
+        }
 
-        int event_select_result = 0;
-        if (con->handles[0] != NULL && con->handles[1] != NULL) {
-            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                    "Binding socket to event.");
-            event_select_result =
-                WSAEventSelect(con->fd, con->handles[0], FD_READ | FD_CLOSE);
-            if (event_select_result != 0) {
-                int error_code = WSAGetLastError();
-                LTRACK_E("TeonetClient", "Failed to bind event, error code %d.",
-                         error_code);
-
-                if (error_code == WSAENETDOWN) {
-                    LTRACK_E("TeonetClient", "Error: WSAENETDOWN.");
-                } else if (error_code == WSAEINVAL) {
-                    LTRACK_E("TeonetClient", "Error: WSAEINVAL.");
-                } else if (error_code == WSAEINPROGRESS) {
-                    LTRACK_E("TeonetClient", "Error: WSAEINPROGRESS.");
-                } else if (error_code == WSAENOTSOCK) {
-                    LTRACK_E("TeonetClient", "Error: WSAENOTSOCK.");
-                } else {
-                    LTRACK_E("TeonetClient", "Error: unknown.");
-                }
-            }
+        struct sockaddr_in addr;
+        int result = teoLNullResolverResult(con->resolver, &addr);
+        if (result < 0) {
+            LTRACK_E("TeonetClient", "HOST NOT FOUND");
+            return _teoLNullConnectFail(con, CON_STATUS_HOST_ERROR);
         }
 
-        if (con->handles[0] == NULL || con->handles[1] == NULL ||
-            event_select_result != 0) {
-            LTRACK_E("TeonetClient",
-                     "Failed to create events for sending commands.");
+        if (result > 0) {
+            teoLNullResolverRelease(con->resolver);
+            con->resolver = NULL;
 
-            if (con->handles[0] != NULL) {
-                CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                        "Closing write handle.");
-                WSACloseEvent(con->handles[0]);
-                con->handles[0] = NULL;
-            }
+            if (!_teoLNullConnectStart(con, &addr)) { return false; }
+        }
+    }
 
-            if (con->handles[1] != NULL) {
-                CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                        "Closing read handle.");
-                CloseHandle(con->handles[1]);
-                con->handles[1] = NULL;
+    if (con->connect_state == CON_STATE_CONNECTING) {
+        if (teosockSelect(con->fd, TEOSOCK_SELECT_MODE_WRITE, 0) ==
+            TEOSOCK_SELECT_READY) {
+            int error = 0;
+            socklen_t error_length = sizeof(error);
+            if (getsockopt(con->fd, SOL_SOCKET, SO_ERROR, (char *)&error,
+                           &error_length) != 0 ||
+                error != 0) {
+                LTRACK_E("TeonetClient",
+                         "Client-connect() error: %" PRId32 ", %s", error,
+                         strerror(error));
+                return _teoLNullConnectFail(con, CON_STATUS_CONNECTION_ERROR);
             }
 
-            _close(con->pipefd[0]);
-            _close(con->pipefd[1]);
+            // Receive and send functions expect blocking socket
+            teosockSetBlockingMode(con->fd, TEOSOCK_BLOCKING_MODE);
+            teosockSetTcpNodelay(con->fd);
+            _teoLNullUringStart(con);
 
-            con->pipefd[0] = -1;
-            con->pipefd[1] = -1;
+            if (!_teoLNullConnectHandshake(con)) { return false; }
+        }
+    }
 
-            con->status = CON_STATUS_PIPE_ERROR;
-            teosockClose(con->fd);
-            con->fd = -1;
-            send_l0_event(con, EV_L_CONNECTED, &con->status,
-                          sizeof(con->status));
-            return con;
+    // Worker result connects or fails handshake like KEX answer in place
+    if (con->connect_state == CON_STATE_HANDSHAKE && con->kex_job != NULL) {
+        _teoLNullKexJobFinish(con);
+    }
+
+    if (con->connect_state == CON_STATE_HANDSHAKE) {
+        // KEX answer or TR-UDP channel connects it
+        if (con->status == CON_STATUS_CONNECTED) {
+            con->connect_state = CON_STATE_DONE;
+            return true;
         }
-#endif
 
-        con->status = CON_STATUS_NOT_CONNECTED;
+        // Failed KEX answer sent EV_L_CONNECTED already
+        if (con->status < 0) {
+            CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
+                      "Connection canceled by status %s (%d)",
+                      STRING_teoLNullConnectionStatus(con->status),
+                      (int)con->status);
+            _teoLNullSocketClose(con);
+            con->connect_state = CON_STATE_DONE;
+            return false;
+        }
     }
 
-    return _teoLNullConnectionInitiate(con, teocliOpt_EncryptionProtocol);
+    if (con->connect_state != CON_STATE_DONE &&
+        teoGetTimestampFull() >= con->connect_deadline) {
+        CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
+                  "connection timed out");
+        return _teoLNullConnectFail(con, CON_STATUS_CONNECTION_ERROR);
+    }
+
+    return con->connect_state != CON_STATE_DONE ||
+           con->status == CON_STATUS_CONNECTED;
 }
 
 /**
- * Create TCP client and connect to server without event callback
+ * Start asynchronous connect of created connection
+ *
+ * Only resolver is started here. Next steps are made by event loop calls, so
+ * EV_L_CONNECTED is never sent before caller gets connection.
+ *
+ * @param con Pointer to teoLNullConnectData with connect_enc_proto set
+ * @param server Server IP or name
+ * @param port Server port
+ */
+static void _teoLNullConnectAsyncStart(teoLNullConnectData *con,
+                                       const char *server, int16_t port) {
+    con->connect_port = (uint16_t)port;
+    con->connect_deadline =
+        teoGetTimestampFull() + (uint64_t)teocliOpt_ConnectTimeoutMs * 1000;
+
+    // Failed start is reported by the first step
+    con->resolver = teoLNullResolverStart(server, (uint16_t)port);
+    if (con->resolver == NULL) {
+        LTRACK_E("TeonetClient", "Can't start resolver of %s", server);
+    }
+
+    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+            "Connecting to %s at port %" PRIu16 " ...", server, port);
+
+    con->connect_state = CON_STATE_RESOLVING;
+}
+
+/**
+ * Create client and start connecting to server without blocking
+ *
+ * Server name is resolved, TCP connection is connected and TR-UDP or key
+ * exchange handshake is made by teoLNullReadEventLoop or by application
+ * event loop through teoLNullGetPollFds, teoLNullGetNextTimeoutUs and
+ * teoLNullOn* functions. Function only starts resolver, so events are never
+ * sent before it returns: the first step is made by the first of these
+ * calls, teoLNullGetNextTimeoutUs returns 0 until then. EV_L_CONNECTED event
+ * reports result, connect fails with CON_STATUS_CONNECTION_ERROR after
+ * teoLNUllSetOption_ConnectTimeoutMs. Packets should be sent after
+ * successful EV_L_CONNECTED event. Connection can be added to reactor when
+ * teoLNullGetPollFds returns its socket.
  *
  * @param server Server IP or name
  * @param port Server port
+ * @param event_cb Pointer to event callback function
+ * @param user_data Pointer to user data which will be send to event callback
+ * @param connection_flag TCP or TRUDP
  *
- * @return Pointer to teoLNullConnectData. Null if no memory error
+ * @return Pointer to teoLNullConnectData with status 0, connect is in
+ *  progress. Status values of EV_L_CONNECTED event:
  * @retval teoLNullConnectData::status== 1 - Success connection
  * @retval teoLNullConnectData::status==-1 - Create socket error
  * @retval teoLNullConnectData::status==-2 - HOST NOT FOUND error
  * @retval teoLNullConnectData::status==-3 - Client-connect() error
+ * @retval teoLNullConnectData::status==-4 - Pipe creation error
  */
-teoLNullConnectData *teoLNullConnect(const char *server, int16_t port,
-                                     PROTOCOL connection_flag) {
-    return teoLNullConnectE(server, port, NULL, NULL, connection_flag);
+teoLNullConnectData *teoLNullConnectAsync(const char *server, int16_t port,
+                                          teoLNullEventsCb event_cb,
+                                          void *user_data,
+                                          PROTOCOL connection_flag) {
+    teoLNullConnectData *con =
+        _teoLNullConnectDataCreate(event_cb, user_data, connection_flag);
+
+    con->connect_enc_proto = teocliOpt_EncryptionProtocol;
+    _teoLNullConnectAsyncStart(con, server, port);
+
+    return con;
+}
+
+/**
+ * Create client and start resuming encrypted session without blocking
+ *
+ * Works like teoLNullConnectAsync but key exchange sends @a ticket instead of
+ * ECDH public key, so connection is established without ECDH and PBKDF2
+ * computations. Ticket is taken by teoLNullGetSessionTicket from previous
+ * connection to the same server, resumed session keeps encryption protocol
+ * of that connection. Connect fails with
+ * CON_STATUS_ENCRYPTION_ERROR if server does not accept ticket, application
+ * should connect by teoLNullConnectAsync then.
+ *
+ * @param server Server IP or name
+ * @param port Server port
+ * @param event_cb Pointer to event callback function
+ * @param user_data Pointer to user data which will be send to event callback
+ * @param connection_flag TCP or TRUDP
+ * @param ticket Session ticket, copied to connection
+ *
+ * @return Pointer to teoLNullConnectData, status values are the same as of
+ *  teoLNullConnectAsync
+ */
+teoLNullConnectData *
+teoLNullConnectResume(const char *server, int16_t port,
+                      teoLNullEventsCb event_cb, void *user_data,
+                      PROTOCOL connection_flag,
+                      const teoLNullSessionTicket *ticket) {
+    teoLNullConnectData *con =
+        _teoLNullConnectDataCreate(event_cb, user_data, connection_flag);
+
+    con->resume_ticket =
+        (teoLNullSessionTicket *)ccl_malloc(sizeof(teoLNullSessionTicket));
+    *con->resume_ticket = *ticket;
+    con->connect_enc_proto = ENC_PROTO_ECDH_AES_128_RESUME_V1;
+    _teoLNullConnectAsyncStart(con, server, port);
+
+    return con;
+}
+
+/**
+ * Get ticket to resume encrypted session of connection
+ *
+ * Ticket is derived from session key and is the same for all calls on one
+ * connection. Resumed connection gives new ticket.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param ticket [out] Session ticket
+ *
+ * @return true if connection has established encrypted session
+ */
+bool teoLNullGetSessionTicket(teoLNullConnectData *con,
+                              teoLNullSessionTicket *ticket) {
+    if (con == NULL) { return false; }
+
+    return teoLNullEncryptionContextExportTicket(con->client_crypt, ticket);
 }
 
 /**
@@ -1516,33 +4061,41 @@ teoLNullConnectData *teoLNullConnect(const char *server, int16_t port,
  */
 void teoLNullDisconnect(teoLNullConnectData *con) {
     if (con != NULL) {
+        if (con->reactor != NULL) { teoLNullReactorRemove(con->reactor, con); }
+
+        teoLNullResolverRelease(con->resolver);
+        _teoLNullKexJobRelease(con);
+        _teoLNullDeferredFree(con);
+
+        teoLNullUringDestroy(con->uring);
         if (con->fd > 0) { teosockClose(con->fd); }
 
-        if (con->read_buffer != NULL) { free(con->read_buffer); }
+        if (con->recv_ring != NULL) { free(con->recv_ring); }
+        if (con->recv_scratch != NULL) { free(con->recv_scratch); }
 
-        if (con->client_crypt != NULL) { free(con->client_crypt); }
+        _teoLNullPacketDiscardReserved(con);
+        if (con->send_buffer != NULL) { free(con->send_buffer); }
 
-        if (!con->tcp_f) {
-            trudpChannelDestroyAll(con->td);
-            trudpDestroy(con->td);
+        if (con->client_crypt != NULL) {
+            teoLNullEncryptionContextDestroy(con->client_crypt);
+            free(con->client_crypt);
         }
-
-        if (con->pipefd[0] != -1) {
-#if defined(_WIN32)
-            _close(con->pipefd[0]);
-#else
-            close(con->pipefd[0]);
-#endif
+        if (con->resume_ticket != NULL) {
+            zero_bytes((uint8_t *)con->resume_ticket,
+                       sizeof(teoLNullSessionTicket));
+            free(con->resume_ticket);
         }
 
-        if (con->pipefd[1] != -1) {
-#if defined(_WIN32)
-            _close(con->pipefd[1]);
-#else
-            close(con->pipefd[1]);
-#endif
+        if (!con->tcp_f && con->td != NULL) {
+            trudpChannelDestroyAll(con->td);
+            trudpDestroy(con->td);
         }
 
+        _teoLNullDoorbellClose(con);
+        teoLNullSendQueueDestroy(con->send_queue);
+        teoLNullUdpReceiverDestroy(con->udp_receiver);
+        teoLNullUdpSenderDestroy(con->udp_sender);
+
 #if defined(_WIN32)
         if (con->handles[0] != NULL) {
             WSACloseEvent(con->handles[0]);
@@ -1751,34 +4304,18 @@ static void trudpEventCback(void *tcd_pointer, int event, void *data,
         uint32_t id = trudpPacketGetId(packet);
         size_t block_len = trudpPacketGetDataLength(packet);
         void* block = trudpPacketGetData(packet);
-        ssize_t ready_bytes_count = teoLNullRecvCheck(con, block, block_len);
-        if (ready_bytes_count <= 0) {
-            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                    "Got block id=%u chan=%s of %u bytes", id, tcd->channel_key,
-                    (uint32_t)block_len);
-            break;
-        }
-        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                "Got block id=%u chan=%s of %u bytes, assembled L0 packet of "
-                "%d bytes",
-                id, tcd->channel_key, (uint32_t)block_len,
-                (int32_t)ready_bytes_count);
 
-        teoLNullCPacket *cp = (teoLNullCPacket *)con->read_buffer;
+        // Block may complete several L0 packets, all of them are sent to
+        // L0 event loop (echo commands are answered)
+        _recvRingAppend(con, block, block_len);
+        size_t delivered = _teoLNullRecvDispatch(con);
+
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                "trip(mid)=[%.3f(%.3f) ms] peer=%s, cmd=%d, payload=%u",
-                (double)tcd->triptime / 1000.0,
-                (double)tcd->triptimeMiddle / 1000.0, cp->peer_name,
-                (int32_t)cp->cmd, (uint32_t)cp->data_length);
-
-        // Process commands
-        if (cp->cmd == CMD_L_ECHO) {
-            cp->cmd = CMD_L_ECHO_ANSWER;
-            teoLNullPacketUpdateHeaderChecksum(cp);
-            trudpChannelSendData(tcd, cp, ready_bytes_count);
-        } else { // Send other commands to L0 event loop
-            send_l0_event(con, EV_L_RECEIVED, cp, ready_bytes_count);
-        }
+                "Got block id=%u chan=%s of %u bytes, assembled %u L0 packets, "
+                "trip(mid)=[%.3f(%.3f) ms]",
+                id, tcd->channel_key, (uint32_t)block_len,
+                (uint32_t)delivered, (double)tcd->triptime / 1000.0,
+                (double)tcd->triptimeMiddle / 1000.0);
     } break;
 
     // Got DATA event
@@ -1788,18 +4325,31 @@ static void trudpEventCback(void *tcd_pointer, int event, void *data,
     case GOT_DATA_NO_TRUDP: {
         teoLNullConnectData *con = (teoLNullConnectData*)user_data;
 
-        if (!teoLNullPacketCheck(data, data_length)) {
+        if (!teoLNullPacketCheck(con->client_crypt, data, data_length)) {
             CLTRACK(DEBUG, "TeonetClient",
                     "got invalid non TR-UDP data packet with %u bytes of data",
                     (uint32_t)data_length);
             break;
         }
 
+        // Unreliable packet carries its nonce, so it is decrypted regardless
+        // of lost and reordered ones
+        teoLNullCPacket *cp = (teoLNullCPacket *)data;
+        if (!teoLNullPacketDecrypt(con->client_crypt, cp)) {
+            CLTRACK(DEBUG, "TeonetClient",
+                    "got not authenticated non TR-UDP data packet with %u "
+                    "bytes of data",
+                    (uint32_t)data_length);
+            break;
+        }
+
         CLTRACK(DEBUG, "TeonetClient",
                 "got valid non TR-UDP data packet with %u bytes of data",
                 (uint32_t)data_length);
-        send_l0_event(con, EV_L_RECEIVED, data, data_length);
-    }
+        send_l0_event(con, EV_L_RECEIVED, data,
+                      teoLNullBufferSize(cp->peer_name_length,
+                                         cp->data_length));
+    } break;
 
     // Process received data
     // @param tcd Pointer to trudpData
@@ -1816,10 +4366,22 @@ static void trudpEventCback(void *tcd_pointer, int event, void *data,
     // @param data_length Length of send
     // @param user_data NULL
     case PROCESS_SEND: {
-        // Send to UDP
-        trudpUdpSendto(TD(tcd)->fd, data, data_length,
-                       (__CONST_SOCKADDR_ARG)&tcd->remaddr,
-                       sizeof(tcd->remaddr));
+        teoLNullConnectData *con = (teoLNullConnectData *)user_data;
+
+        // Send to UDP, or collect to send at the end of select loop iteration
+        if (con != NULL && con->uring != NULL) {
+            struct iovec iov;
+            iov.iov_base = data;
+            iov.iov_len = data_length;
+            _teoLNullUringSendv(con, &iov, 1, &tcd->remaddr);
+        } else if (con == NULL || !con->udp_send_collect ||
+            !teoLNullUdpSenderAdd(con->udp_sender, TD(tcd)->fd, data,
+                                  data_length, &tcd->remaddr,
+                                  teocliOpt_UdpSegmentOffload)) {
+            trudpUdpSendto(TD(tcd)->fd, data, data_length,
+                           (__CONST_SOCKADDR_ARG)&tcd->remaddr,
+                           sizeof(tcd->remaddr));
+        }
 
         if (DEBUG) {
             trudpPacket* packet = (trudpPacket*)data;
@@ -1865,6 +4427,7 @@ const char *STRING_teoLNullEvents(teoLNullEvents v) {
     case EV_L_RECEIVED: return "EV_L_RECEIVED";
     case EV_L_TICK: return "EV_L_TICK";
     case EV_L_IDLE: return "EV_L_IDLE";
+    case EV_L_RECEIVED_BATCH: return "EV_L_RECEIVED_BATCH";
     default: break;
     }
 
@@ -30,6 +30,18 @@ extern int usleep(__useconds_t __useconds);
 #endif
 #endif
 
+#if defined(_WIN32)
+/**
+ * Scatter/gather buffer descriptor, same layout as POSIX struct iovec
+ */
+struct iovec {
+    void *iov_base; ///< Pointer to buffer
+    size_t iov_len; ///< Buffer length
+};
+#else
+#include <sys/uio.h>
+#endif
+
 #include "teobase/socket.h"
 #include "trudp.h"
 #include "trudp_utils.h"
@@ -67,8 +79,12 @@ typedef enum teoLNullEvents {
     EV_L_DISCONNECTED, ///< After disconnected from L0 server
     EV_L_RECEIVED,     ///< Data received
     EV_L_TICK,         ///< Send after every teoLNullReadEventLoop calls
-    EV_L_IDLE ///< Send after teoLNullReadEventLoop calls if data was not
-              ///< received during timeout
+    EV_L_IDLE, ///< Send after teoLNullReadEventLoop calls if data was not
+               ///< received during timeout
+    EV_L_RECEIVED_BATCH ///< Several packets received, data is array of
+                        ///< teoLNullPacketView and data_len is number of
+                        ///< packets. Send instead of EV_L_RECEIVED if
+                        ///< enabled by teoLNUllSetOption_ReceiveBatchEvent
 } teoLNullEvents;
 
 typedef void (*teoLNullEventsCb)(void *kc, teoLNullEvents event, void *data,
@@ -89,8 +105,55 @@ typedef enum teoLNullConnectionStatus {
 
 typedef enum PROTOCOL { TRUDP = 0, TCP = 1 } PROTOCOL;
 
+/**
+ * L0 client asynchronous connect state
+ */
+typedef enum teoLNullConnectState {
+    CON_STATE_DONE = 0,   ///< Connect finished or connection is connected
+                          ///< by blocking teoLNullConnectE
+    CON_STATE_RESOLVING,  ///< Waiting for server address
+    CON_STATE_CONNECTING, ///< Waiting for TCP connect
+    CON_STATE_HANDSHAKE,  ///< Waiting for TR-UDP probe or KEX answer
+} teoLNullConnectState;
+
 // forward declaration, complete type in libteol0/teonet_l0_client_crypt.h
 typedef struct teoLNullEncryptionContext teoLNullEncryptionContext;
+typedef struct teoLNullSessionTicket teoLNullSessionTicket;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_queue.c
+typedef struct teoLNullSendQueue teoLNullSendQueue;
+
+// forward declaration, complete type in libteol0/teonet_l0_client.c
+typedef struct teoLNullPeerHandle teoLNullPeerHandle;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_race.c
+typedef struct teoLNullRace teoLNullRace;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_udp.c
+typedef struct teoLNullUdpReceiver teoLNullUdpReceiver;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_udp.c
+typedef struct teoLNullUdpSender teoLNullUdpSender;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_uring.c
+typedef struct teoLNullUring teoLNullUring;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_resolve.c
+typedef struct teoLNullResolver teoLNullResolver;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_kex.c
+typedef struct teoLNullKexJob teoLNullKexJob;
+
+// forward declaration, complete type in libteol0/teonet_l0_client.c
+typedef struct teoLNullDeferredSend teoLNullDeferredSend;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_reactor.c
+typedef struct teoLNullReactor teoLNullReactor;
+typedef struct teoLNullReactorEntry teoLNullReactorEntry;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_shards.c
+typedef struct teoLNullReactorPool teoLNullReactorPool;
+typedef struct teoLNullShard teoLNullShard;
 
 /**
  * L0 client connect data
@@ -100,10 +163,17 @@ typedef struct teoLNullConnectData {
 
     teoLNullConnectionStatus status; ///< Connection status
 
-    void *read_buffer;         ///< Pointer to saved buffer
-    size_t read_buffer_offset; ///< Offset in read buffer
-    size_t read_buffer_size;   ///< Read buffer size
-    size_t last_packet_offset; ///< Last received packet offset (length)
+    void *read_buffer;         ///< Last received packet, valid until next
+                               ///< receive call
+    size_t last_packet_offset; ///< Last received packet length, consumed on
+                               ///< next receive call
+
+    uint8_t *recv_ring;      ///< Receive ring buffer
+    size_t recv_ring_size;   ///< Receive ring size
+    size_t recv_ring_head;   ///< Offset of first not consumed byte in ring
+    size_t recv_ring_length; ///< Number of not consumed bytes in ring
+    size_t recv_ring_peak;   ///< Maximum ring usage since it was empty
+    uint8_t *recv_scratch;   ///< Buffer for packets wrapped around ring end
 
     teoLNullEventsCb event_cb; ///< Event callback function
     void *user_data;           ///< User data
@@ -113,9 +183,37 @@ typedef struct teoLNullConnectData {
     trudpData *td;         ///< TRUDP connection data
     trudpChannelData *tcd; ///< TRUDP channel data
 
-    int pipefd[2]; ///< Pipe to use it in thread safe write function
+    teoLNullSendQueue *send_queue; ///< Thread safe TR-UDP send queue
+    int doorbell_fd[2]; ///< Send queue doorbell read and write ends: eventfd
+                        ///< (both ends are the same descriptor) or pipe
+    teoLNullUdpReceiver *udp_receiver; ///< TR-UDP datagram receive buffers
+    teoLNullUdpSender *udp_sender;     ///< TR-UDP outgoing datagrams batch
+    bool udp_send_collect; ///< Collect outgoing datagrams to udp_sender or
+                           ///< sends to uring until select loop iteration end
+    teoLNullUring *uring;  ///< io_uring backend, NULL if select is used
+
+    teoLNullReactor *reactor;            ///< Reactor processing connection
+    teoLNullReactorEntry *reactor_entry; ///< Connection entry in reactor
+    teoLNullShard *shard; ///< Reactor thread owning connection
+    uint64_t idle_at; ///< Time of next EV_L_IDLE in application event loop
+
+    teoLNullConnectState connect_state; ///< Asynchronous connect state
+    uint64_t connect_deadline;  ///< Time when asynchronous connect fails
+    teoLNullResolver *resolver; ///< Server address resolver
+    uint16_t connect_port;      ///< Server port
+    int connect_enc_proto;      ///< Encryption protocol of connect
 
     teoLNullEncryptionContext *client_crypt;
+    teoLNullSessionTicket *resume_ticket; ///< Ticket of resumed session
+    teoLNullKexJob *kex_job; ///< Key exchange answer applied by worker
+    teoLNullDeferredSend *deferred_head; ///< Sends waiting for kex_job
+    teoLNullDeferredSend *deferred_tail; ///< Last send waiting for kex_job
+
+    struct teoLNullCPacket *reserved_packet; ///< Packet reserved by
+                                             ///< teoLNullPacketReserve
+    size_t reserved_data_length; ///< Maximum data length of reserved packet
+    void *send_buffer;           ///< Buffer to build TCP packets in place
+    size_t send_buffer_size;     ///< Send buffer size
 
 #if defined(_WIN32)
     HANDLE handles[2];
@@ -251,6 +349,47 @@ typedef struct l0_info_data {
 
 #pragma pack(pop)
 
+/**
+ * Received packet in EV_L_RECEIVED_BATCH event
+ *
+ * Packet is valid until event callback returns.
+ */
+typedef struct teoLNullPacketView {
+    teoLNullCPacket *packet; ///< Received packet
+    size_t packet_length;    ///< Packet length
+} teoLNullPacketView;
+
+/**
+ * One packet of teoLNullSendBatch
+ */
+typedef struct teoLNullSendItem {
+    uint8_t cmd;           ///< Command
+    const char *peer_name; ///< Peer name to send to
+    const void *data;      ///< Pointer to data, may be NULL
+    size_t data_length;    ///< Length of data
+} teoLNullSendItem;
+
+/**
+ * L0 server endpoint of teoLNullConnectAny
+ */
+typedef struct teoLNullEndpoint {
+    const char *server; ///< Server IP or name
+    int16_t port;       ///< Server port
+    PROTOCOL protocol;  ///< TCP or TRUDP
+} teoLNullEndpoint;
+
+// teoLNullPollFd::events flags
+#define TEOLNULL_POLL_READ 0x1  ///< Wait for descriptor to become readable
+#define TEOLNULL_POLL_WRITE 0x2 ///< Wait for descriptor to become writable
+
+/**
+ * Connection descriptor watched by application event loop
+ */
+typedef struct teoLNullPollFd {
+    teonetSocket fd; ///< Descriptor
+    int events;      ///< TEOLNULL_POLL_READ and TEOLNULL_POLL_WRITE flags
+} teoLNullPollFd;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -280,6 +419,21 @@ teoLNullConnect(const char *server, int16_t port, PROTOCOL connection_flag);
 TEOCLI_API teoLNullConnectData *
 teoLNullConnectE(const char *server, int16_t port, teoLNullEventsCb event_cb,
                  void *user_data, PROTOCOL connection_flag);
+TEOCLI_API teoLNullConnectData *
+teoLNullConnectAsync(const char *server, int16_t port,
+                     teoLNullEventsCb event_cb, void *user_data,
+                     PROTOCOL connection_flag);
+TEOCLI_API teoLNullConnectData *
+teoLNullConnectResume(const char *server, int16_t port,
+                      teoLNullEventsCb event_cb, void *user_data,
+                      PROTOCOL connection_flag,
+                      const teoLNullSessionTicket *ticket);
+TEOCLI_API bool teoLNullGetSessionTicket(teoLNullConnectData *con,
+                                         teoLNullSessionTicket *ticket);
+TEOCLI_API teoLNullRace *
+teoLNullConnectAny(const teoLNullEndpoint *endpoints, size_t endpoints_count,
+                   teoLNullEventsCb event_cb, void *user_data);
+TEOCLI_API void teoLNullRaceDestroy(teoLNullRace *race);
 TEOCLI_API void teoLNullDisconnect(teoLNullConnectData *con);
 TEOCLI_API void teoLNullShutdown(teoLNullConnectData *con);
 
@@ -291,6 +445,21 @@ TEOCLI_API ssize_t teoLNullSend(teoLNullConnectData *con, uint8_t cmd,
 TEOCLI_API ssize_t teoLNullSendUnreliable(teoLNullConnectData *con, uint8_t cmd,
                                           const char *peer_name, const void *data,
                                           size_t data_length);
+TEOCLI_API ssize_t teoLNullSendv(teoLNullConnectData *con, uint8_t cmd,
+                                 const char *peer_name,
+                                 const struct iovec *parts, int n);
+TEOCLI_API ssize_t teoLNullSendBatch(teoLNullConnectData *con,
+                                     const teoLNullSendItem *items, size_t n);
+TEOCLI_API teoLNullPeerHandle *teoLNullPeerOpen(teoLNullConnectData *con,
+                                                const char *peer_name);
+TEOCLI_API void teoLNullPeerClose(teoLNullPeerHandle *peer);
+TEOCLI_API ssize_t teoLNullPeerSend(teoLNullPeerHandle *peer, uint8_t cmd,
+                                    const void *data, size_t data_length);
+TEOCLI_API ssize_t teoLNullPeerSendv(teoLNullPeerHandle *peer, uint8_t cmd,
+                                     const struct iovec *parts, int n);
+TEOCLI_API ssize_t teoLNullPeerSendUnreliable(teoLNullPeerHandle *peer,
+                                              uint8_t cmd, const void *data,
+                                              size_t data_length);
 TEOCLI_API ssize_t teoLNullSendEcho(teoLNullConnectData *con,
                                     const char *peer_name, const char *msg);
 TEOCLI_API int64_t teoLNullProccessEchoAnswer(const char *msg);
@@ -301,6 +470,21 @@ TEOCLI_API ssize_t teoLNullRecvTimeout(teoLNullConnectData *con,
                                        uint32_t timeout);
 TEOCLI_API bool teoLNullReadEventLoop(teoLNullConnectData *con, int timeout);
 
+// Application event loop integration
+TEOCLI_API size_t teoLNullGetPollFds(teoLNullConnectData *con,
+                                     teoLNullPollFd *fds, size_t fds_length);
+TEOCLI_API uint64_t teoLNullGetNextTimeoutUs(teoLNullConnectData *con);
+TEOCLI_API bool teoLNullOnReadable(teoLNullConnectData *con, teonetSocket fd);
+TEOCLI_API bool teoLNullOnWritable(teoLNullConnectData *con, teonetSocket fd);
+TEOCLI_API bool teoLNullOnTimer(teoLNullConnectData *con);
+TEOCLI_API size_t teoLNullRaceGetPollFds(teoLNullRace *race,
+                                         teoLNullPollFd *fds,
+                                         size_t fds_length);
+TEOCLI_API uint64_t teoLNullRaceGetNextTimeoutUs(teoLNullRace *race);
+TEOCLI_API bool teoLNullRaceOnReadable(teoLNullRace *race, teonetSocket fd);
+TEOCLI_API bool teoLNullRaceOnWritable(teoLNullRace *race, teonetSocket fd);
+TEOCLI_API bool teoLNullRaceOnTimer(teoLNullRace *race);
+
 // Low level functions
 TEOCLI_API size_t teoLNullPacketCreateLogin(teoLNullEncryptionContext *ctx, void *buffer, size_t buffer_length,
                                             const char *host_name);
@@ -310,14 +494,37 @@ TEOCLI_API size_t teoLNullPacketCreateEcho(teoLNullEncryptionContext *ctx, void
 TEOCLI_API size_t teoLNullPacketCreate(teoLNullEncryptionContext *ctx, void *buffer, size_t buffer_length,
                                        uint8_t command, const char *peer,
                                        const uint8_t *data, size_t data_length);
+TEOCLI_API size_t teoLNullPacketCreatev(teoLNullEncryptionContext *ctx,
+                                        void *buffer, size_t buffer_length,
+                                        uint8_t command, const char *peer,
+                                        const struct iovec *parts, int n);
 TEOCLI_API ssize_t teoLNullPacketSend(teoLNullConnectData *con, const char *data,
                                       size_t data_length);
+TEOCLI_API void *teoLNullPacketReserve(teoLNullConnectData *con, uint8_t cmd,
+                                       const char *peer, size_t max_len);
+TEOCLI_API ssize_t teoLNullPacketCommit(teoLNullConnectData *con,
+                                        size_t actual_len);
 
 TEOCLI_API uint8_t *teoLNullPacketGetPayload(teoLNullCPacket *packet);
 TEOCLI_API teoLNullCPacket *teoLNullPacketGetFromBuffer(uint8_t *data, size_t data_len);
 
 // Teonet utils functions
 TEOCLI_API uint8_t get_byte_checksum(const uint8_t* data, size_t data_length);
+TEOCLI_INTERNAL uint8_t teoLNullCopyByteChecksum(uint8_t *dest,
+                                                 const uint8_t *src,
+                                                 size_t length);
+
+/**
+ * Byte checksum implementation, all of them give identical results
+ */
+typedef enum teoLNullChecksumBackend {
+    CHECKSUM_BACKEND_AUTO,   ///< Fastest one supported by CPU
+    CHECKSUM_BACKEND_SCALAR, ///< One byte at a time
+    CHECKSUM_BACKEND_SSE2,   ///< 64 bytes per iteration, x86 only
+    CHECKSUM_BACKEND_AVX2,   ///< 128 bytes per iteration, x86 only
+} teoLNullChecksumBackend;
+
+TEOCLI_API int teoLNullChecksumSetBackend(teoLNullChecksumBackend backend);
 
 #if defined(TEONET_COMPILER_GCC)
 #define DEPRECATED_FUNCTION __attribute__((deprecated))
@@ -0,0 +1,413 @@
+/**
+ * \file   teonet_l0_client_checksum.c
+ *
+ * L0 packet byte checksum.
+ *
+ * Byte checksum is a sum of all bytes modulo 256, so bytes may be summed in
+ * any order and grouping. Vector implementations add 16 or 32 bytes at a time
+ * with wrapping byte adds and fold accumulated lanes with one SAD instruction
+ * at the end. Implementation is selected on first call by CPU features or by
+ * teoLNullChecksumSetBackend.
+ *
+ * Copying variants write data to packet and sum it in the same pass, so
+ * packet data is not read again to calculate checksum.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teonet_l0_client.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||            \
+    defined(_M_IX86)
+#define CHECKSUM_X86 1
+#if defined(_MSC_VER)
+#define CHECKSUM_TARGET(name)
+#else
+#define CHECKSUM_TARGET(name) __attribute__((target(name)))
+#endif
+#include <immintrin.h>
+#endif
+
+typedef uint8_t (*checksumFunc)(const uint8_t *data, size_t data_length);
+typedef uint8_t (*copyChecksumFunc)(uint8_t *dest, const uint8_t *src,
+                                    size_t length);
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Implementation pointers are read and written by many threads, relaxed
+// atomic access is enough as every stored implementation is valid
+#if defined(_MSC_VER) && defined(_WIN64)
+#define implLoad(type, impl)                                                   \
+    ((type)(intptr_t)__iso_volatile_load64((const volatile __int64 *)&(impl)))
+#define implStore(impl, value)                                                 \
+    __iso_volatile_store64((volatile __int64 *)&(impl),                        \
+                           (__int64)(intptr_t)(value))
+#elif defined(_MSC_VER)
+#define implLoad(type, impl)                                                   \
+    ((type)(intptr_t)__iso_volatile_load32((const volatile __int32 *)&(impl)))
+#define implStore(impl, value)                                                 \
+    __iso_volatile_store32((volatile __int32 *)&(impl),                        \
+                           (__int32)(intptr_t)(value))
+#else
+#define implLoad(type, impl) __atomic_load_n(&(impl), __ATOMIC_RELAXED)
+#define implStore(impl, value)                                                 \
+    __atomic_store_n(&(impl), (value), __ATOMIC_RELAXED)
+#endif
+
+static uint8_t _checksumResolve(const uint8_t *data, size_t data_length);
+static uint8_t _copyChecksumResolve(uint8_t *dest, const uint8_t *src,
+                                    size_t length);
+
+/// Selected implementations, resolved on first call
+static checksumFunc _checksumImpl = _checksumResolve;
+static copyChecksumFunc _copyChecksumImpl = _copyChecksumResolve;
+
+/**
+ * Calculate byte checksum one byte at a time
+ */
+static uint8_t _checksumScalar(const uint8_t *data, size_t data_length) {
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < data_length; ++i) {
+        checksum += data[i];
+    }
+
+    return checksum;
+}
+
+/**
+ * Copy data and calculate its byte checksum one byte at a time
+ */
+static uint8_t _copyChecksumScalar(uint8_t *dest, const uint8_t *src,
+                                   size_t length) {
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < length; ++i) {
+        dest[i] = src[i];
+        checksum += src[i];
+    }
+
+    return checksum;
+}
+
+#if defined(CHECKSUM_X86)
+/**
+ * Calculate byte checksum 64 bytes per iteration with SSE2
+ */
+CHECKSUM_TARGET("sse2")
+static uint8_t _checksumSse2(const uint8_t *data, size_t data_length) {
+    __m128i acc_0 = _mm_setzero_si128();
+    __m128i acc_1 = _mm_setzero_si128();
+    __m128i acc_2 = _mm_setzero_si128();
+    __m128i acc_3 = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 64 <= data_length; i += 64) {
+        const __m128i *p = (const __m128i *)(data + i);
+        acc_0 = _mm_add_epi8(acc_0, _mm_loadu_si128(p));
+        acc_1 = _mm_add_epi8(acc_1, _mm_loadu_si128(p + 1));
+        acc_2 = _mm_add_epi8(acc_2, _mm_loadu_si128(p + 2));
+        acc_3 = _mm_add_epi8(acc_3, _mm_loadu_si128(p + 3));
+    }
+    for (; i + 16 <= data_length; i += 16) {
+        acc_0 =
+            _mm_add_epi8(acc_0, _mm_loadu_si128((const __m128i *)(data + i)));
+    }
+
+    __m128i acc = _mm_add_epi8(_mm_add_epi8(acc_0, acc_1),
+                               _mm_add_epi8(acc_2, acc_3));
+
+    // Sum 16 byte lanes into two 64 bit lanes
+    __m128i sum = _mm_sad_epu8(acc, _mm_setzero_si128());
+    uint8_t checksum = (uint8_t)(_mm_cvtsi128_si32(sum) +
+                                 _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+
+    return checksum + _checksumScalar(data + i, data_length - i);
+}
+
+/**
+ * Copy data and calculate byte checksum 64 bytes per iteration with SSE2
+ */
+CHECKSUM_TARGET("sse2")
+static uint8_t _copyChecksumSse2(uint8_t *dest, const uint8_t *src,
+                                 size_t length) {
+    __m128i acc_0 = _mm_setzero_si128();
+    __m128i acc_1 = _mm_setzero_si128();
+    __m128i acc_2 = _mm_setzero_si128();
+    __m128i acc_3 = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 64 <= length; i += 64) {
+        const __m128i *s = (const __m128i *)(src + i);
+        __m128i *d = (__m128i *)(dest + i);
+        __m128i v_0 = _mm_loadu_si128(s);
+        __m128i v_1 = _mm_loadu_si128(s + 1);
+        __m128i v_2 = _mm_loadu_si128(s + 2);
+        __m128i v_3 = _mm_loadu_si128(s + 3);
+        _mm_storeu_si128(d, v_0);
+        _mm_storeu_si128(d + 1, v_1);
+        _mm_storeu_si128(d + 2, v_2);
+        _mm_storeu_si128(d + 3, v_3);
+        acc_0 = _mm_add_epi8(acc_0, v_0);
+        acc_1 = _mm_add_epi8(acc_1, v_1);
+        acc_2 = _mm_add_epi8(acc_2, v_2);
+        acc_3 = _mm_add_epi8(acc_3, v_3);
+    }
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dest + i), v);
+        acc_0 = _mm_add_epi8(acc_0, v);
+    }
+
+    __m128i acc = _mm_add_epi8(_mm_add_epi8(acc_0, acc_1),
+                               _mm_add_epi8(acc_2, acc_3));
+
+    __m128i sum = _mm_sad_epu8(acc, _mm_setzero_si128());
+    uint8_t checksum = (uint8_t)(_mm_cvtsi128_si32(sum) +
+                                 _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+
+    return checksum + _copyChecksumScalar(dest + i, src + i, length - i);
+}
+
+/**
+ * Calculate byte checksum 128 bytes per iteration with AVX2
+ */
+CHECKSUM_TARGET("avx2")
+static uint8_t _checksumAvx2(const uint8_t *data, size_t data_length) {
+    __m256i acc_0 = _mm256_setzero_si256();
+    __m256i acc_1 = _mm256_setzero_si256();
+    __m256i acc_2 = _mm256_setzero_si256();
+    __m256i acc_3 = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 128 <= data_length; i += 128) {
+        const __m256i *p = (const __m256i *)(data + i);
+        acc_0 = _mm256_add_epi8(acc_0, _mm256_loadu_si256(p));
+        acc_1 = _mm256_add_epi8(acc_1, _mm256_loadu_si256(p + 1));
+        acc_2 = _mm256_add_epi8(acc_2, _mm256_loadu_si256(p + 2));
+        acc_3 = _mm256_add_epi8(acc_3, _mm256_loadu_si256(p + 3));
+    }
+    for (; i + 32 <= data_length; i += 32) {
+        acc_0 = _mm256_add_epi8(
+            acc_0, _mm256_loadu_si256((const __m256i *)(data + i)));
+    }
+
+    __m256i acc = _mm256_add_epi8(_mm256_add_epi8(acc_0, acc_1),
+                                  _mm256_add_epi8(acc_2, acc_3));
+
+    // Sum 32 byte lanes into four 64 bit lanes, then fold them
+    __m256i sum256 = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sum256),
+                                _mm256_extracti128_si256(sum256, 1));
+    uint8_t checksum = (uint8_t)(_mm_cvtsi128_si32(sum) +
+                                 _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+
+    return checksum + _checksumScalar(data + i, data_length - i);
+}
+
+/**
+ * Copy data and calculate byte checksum 128 bytes per iteration with AVX2
+ */
+CHECKSUM_TARGET("avx2")
+static uint8_t _copyChecksumAvx2(uint8_t *dest, const uint8_t *src,
+                                 size_t length) {
+    __m256i acc_0 = _mm256_setzero_si256();
+    __m256i acc_1 = _mm256_setzero_si256();
+    __m256i acc_2 = _mm256_setzero_si256();
+    __m256i acc_3 = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 128 <= length; i += 128) {
+        const __m256i *s = (const __m256i *)(src + i);
+        __m256i *d = (__m256i *)(dest + i);
+        __m256i v_0 = _mm256_loadu_si256(s);
+        __m256i v_1 = _mm256_loadu_si256(s + 1);
+        __m256i v_2 = _mm256_loadu_si256(s + 2);
+        __m256i v_3 = _mm256_loadu_si256(s + 3);
+        _mm256_storeu_si256(d, v_0);
+        _mm256_storeu_si256(d + 1, v_1);
+        _mm256_storeu_si256(d + 2, v_2);
+        _mm256_storeu_si256(d + 3, v_3);
+        acc_0 = _mm256_add_epi8(acc_0, v_0);
+        acc_1 = _mm256_add_epi8(acc_1, v_1);
+        acc_2 = _mm256_add_epi8(acc_2, v_2);
+        acc_3 = _mm256_add_epi8(acc_3, v_3);
+    }
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dest + i), v);
+        acc_0 = _mm256_add_epi8(acc_0, v);
+    }
+
+    __m256i acc = _mm256_add_epi8(_mm256_add_epi8(acc_0, acc_1),
+                                  _mm256_add_epi8(acc_2, acc_3));
+
+    __m256i sum256 = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sum256),
+                                _mm256_extracti128_si256(sum256, 1));
+    uint8_t checksum = (uint8_t)(_mm_cvtsi128_si32(sum) +
+                                 _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+
+    return checksum + _copyChecksumScalar(dest + i, src + i, length - i);
+}
+
+/**
+ * Check if CPU and OS support AVX2
+ */
+static int _cpuHasAvx2(void) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) { return 0; }
+
+    // OSXSAVE and AVX, then OS saves YMM registers
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) {
+        return 0;
+    }
+    if ((_xgetbv(0) & 0x6) != 0x6) { return 0; }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+/**
+ * Check if CPU supports SSE2
+ */
+static int _cpuHasSse2(void) {
+#if defined(_M_X64) || defined(__x86_64__)
+    return 1;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+#endif
+
+/**
+ * Select checksum implementations
+ *
+ * Every thread selects the same implementations by CPU features, so
+ * concurrent first calls are harmless.
+ *
+ * @param backend Implementation to select, CHECKSUM_BACKEND_AUTO selects the
+ *  fastest one supported by CPU
+ *
+ * @return Nonzero if selected or zero if CPU does not support @a backend
+ */
+static int _checksumSelect(teoLNullChecksumBackend backend) {
+    checksumFunc impl = _checksumScalar;
+    copyChecksumFunc copy_impl = _copyChecksumScalar;
+
+    switch (backend) {
+    case CHECKSUM_BACKEND_AUTO:
+#if defined(CHECKSUM_X86)
+        if (_cpuHasAvx2()) {
+            impl = _checksumAvx2;
+            copy_impl = _copyChecksumAvx2;
+        } else if (_cpuHasSse2()) {
+            impl = _checksumSse2;
+            copy_impl = _copyChecksumSse2;
+        }
+#endif
+        break;
+
+    case CHECKSUM_BACKEND_SCALAR: break;
+
+#if defined(CHECKSUM_X86)
+    case CHECKSUM_BACKEND_SSE2:
+        if (!_cpuHasSse2()) { return 0; }
+        impl = _checksumSse2;
+        copy_impl = _copyChecksumSse2;
+        break;
+
+    case CHECKSUM_BACKEND_AVX2:
+        if (!_cpuHasAvx2()) { return 0; }
+        impl = _checksumAvx2;
+        copy_impl = _copyChecksumAvx2;
+        break;
+#endif
+
+    default: return 0;
+    }
+
+    implStore(_checksumImpl, impl);
+    implStore(_copyChecksumImpl, copy_impl);
+
+    return 1;
+}
+
+/**
+ * Select implementations and calculate checksum
+ */
+static uint8_t _checksumResolve(const uint8_t *data, size_t data_length) {
+    _checksumSelect(CHECKSUM_BACKEND_AUTO);
+
+    return implLoad(checksumFunc, _checksumImpl)(data, data_length);
+}
+
+/**
+ * Select implementations, copy data and calculate checksum
+ */
+static uint8_t _copyChecksumResolve(uint8_t *dest, const uint8_t *src,
+                                    size_t length) {
+    _checksumSelect(CHECKSUM_BACKEND_AUTO);
+
+    return implLoad(copyChecksumFunc, _copyChecksumImpl)(dest, src, length);
+}
+
+/**
+ * Select byte checksum implementation
+ *
+ * All implementations give identical results, explicit selection is used by
+ * benchmark and tests.
+ *
+ * @param backend Implementation to select
+ *
+ * @return Nonzero if selected or zero if CPU does not support @a backend
+ */
+int teoLNullChecksumSetBackend(teoLNullChecksumBackend backend) {
+    return _checksumSelect(backend);
+}
+
+/**
+ * Calculate checksum
+ *
+ * Calculate byte checksum in data buffer
+ *
+ * @param data Pointer to data buffer
+ * @param data_length Length of the data buffer to calculate checksum
+ *
+ * @return Byte checksum of the input buffer
+ */
+uint8_t get_byte_checksum(const uint8_t *data, size_t data_length) {
+    // Header checksum and short peer names are not worth vector setup
+    if (data_length < 16) { return _checksumScalar(data, data_length); }
+
+    return implLoad(checksumFunc, _checksumImpl)(data, data_length);
+}
+
+/**
+ * Copy data and calculate its byte checksum in one pass
+ *
+ * @param dest Destination buffer
+ * @param src Source buffer, may be equal to @a dest
+ * @param length Number of bytes to copy
+ *
+ * @return Byte checksum of copied data
+ */
+uint8_t teoLNullCopyByteChecksum(uint8_t *dest, const uint8_t *src,
+                                 size_t length) {
+    if (length < 16) { return _copyChecksumScalar(dest, src, length); }
+
+    return implLoad(copyChecksumFunc, _copyChecksumImpl)(dest, src, length);
+}
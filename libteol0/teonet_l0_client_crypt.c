@@ -1,12 +1,16 @@
 #include "teonet_l0_client_crypt.h"
 #include "teonet_l0_client.h"
+#include "teonet_l0_client_keypool.h"
 #include "teobase/logging.h"
 #include <assert.h>
+#include <inttypes.h>
+#include <string.h>
 
 extern int teocliOpt_DBG_packetFlow;
 
 typedef struct KeyExchangePayload_ECDH_AES_128_V1 {
-    //! common.protocolId, must be ENC_PROTO_ECDH_AES_128_V1
+    //! common.protocolId, must be ENC_PROTO_ECDH_AES_128_V1 or
+    //! ENC_PROTO_ECDH_AES_128_GCM_V2
     KeyExchangePayload_Common common;
 
     // Protocol-dependent encryption parameters
@@ -14,15 +18,71 @@ typedef struct KeyExchangePayload_ECDH_AES_128_V1 {
     AES128_1_BLOCK salt; ///< common salt
 } KeyExchangePayload_ECDH_AES_128_V1;
 
+typedef struct KeyExchangePayload_ECDH_AES_128_RESUME_V1 {
+    //! common.protocolId, must be ENC_PROTO_ECDH_AES_128_RESUME_V1
+    KeyExchangePayload_Common common;
+
+    // Protocol-dependent encryption parameters
+    uint8_t ticket_id[TEOLNULL_TICKET_ID_SIZE]; ///< resumed session ticket
+    AES128_1_BLOCK salt; ///< client salt in request, server salt in answer
+} KeyExchangePayload_ECDH_AES_128_RESUME_V1;
+
+// Labels of keys derived from session key for session ticket
+static const AES128_1_BLOCK TICKET_ID_LABEL = {{
+    't', 'e', 'o', 'c', 'l', 'i', '-', 't',
+    'i', 'c', 'k', 'e', 't', '-', 'i', 'd',
+}};
+static const AES128_1_BLOCK TICKET_KEY_LABEL = {{
+    't', 'e', 'o', 'c', 'l', 'i', '-', 'r',
+    'e', 's', 'u', 'm', 'e', 'k', 'e', 'y',
+}};
+
+// Direction of ENC_PROTO_ECDH_AES_128_GCM_V2 packet in its nonce, both sides
+// count packets with the same session key. Explicit nonce packets are counted
+// separately and have AEAD_NONCE_EXPLICIT bit set.
+enum {
+    AEAD_NONCE_TO_SERVER = 1,
+    AEAD_NONCE_TO_CLIENT = 2,
+    AEAD_NONCE_EXPLICIT = 0x80,
+};
+
+/**
+ * Get nonce direction of packets sent by side of context
+ *
+ * @param ctx Encryption context
+ *
+ * @return AEAD_NONCE_TO_SERVER or AEAD_NONCE_TO_CLIENT
+ */
+static inline uint8_t _aeadSendDirection(const teoLNullEncryptionContext *ctx) {
+    return ctx->server_side ? AEAD_NONCE_TO_CLIENT : AEAD_NONCE_TO_SERVER;
+}
+
+/**
+ * Get nonce direction of packets received by side of context
+ *
+ * @param ctx Encryption context
+ *
+ * @return AEAD_NONCE_TO_SERVER or AEAD_NONCE_TO_CLIENT
+ */
+static inline uint8_t
+_aeadReceiveDirection(const teoLNullEncryptionContext *ctx) {
+    return ctx->server_side ? AEAD_NONCE_TO_SERVER : AEAD_NONCE_TO_CLIENT;
+}
+
 size_t teoLNullKEXBufferSize(teoLNullEncryptionProtocol enc_proto) {
     static_assert(3 == sizeof(KeyExchangePayload_Common),
                   "KeyExchangePayload_Common memory layout must be 1+2 bytes");
 
     switch (enc_proto) {
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: {
         return sizeof(KeyExchangePayload_ECDH_AES_128_V1);
     }
 
+    case ENC_PROTO_ECDH_AES_128_RESUME_V1: {
+        return sizeof(KeyExchangePayload_ECDH_AES_128_RESUME_V1);
+    }
+
     default: {
         return 0;
     }
@@ -32,7 +92,8 @@ size_t teoLNullKEXBufferSize(teoLNullEncryptionProtocol enc_proto) {
 size_t teoLNullKEXCreate(teoLNullEncryptionContext *ctx, uint8_t *buffer,
                          size_t buffer_length) {
     switch (ctx->enc_proto) {
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: {
         const size_t payload_len = teoLNullKEXBufferSize(ctx->enc_proto);
         if (payload_len != buffer_length) {
             LTRACK_E("TeonetClient", "Buffer size mismatch in KEXCreate");
@@ -49,6 +110,23 @@ size_t teoLNullKEXCreate(teoLNullEncryptionContext *ctx, uint8_t *buffer,
         return payload_len;
     }
 
+    case ENC_PROTO_ECDH_AES_128_RESUME_V1: {
+        const size_t payload_len = teoLNullKEXBufferSize(ctx->enc_proto);
+        if (payload_len != buffer_length) {
+            LTRACK_E("TeonetClient", "Buffer size mismatch in KEXCreate");
+            abort();
+        }
+
+        KeyExchangePayload_ECDH_AES_128_RESUME_V1 *kex =
+            (KeyExchangePayload_ECDH_AES_128_RESUME_V1 *)buffer;
+
+        kex->common.nul_byte = 0;
+        kex->common.protocolId = ctx->enc_proto;
+        memcpy(kex->ticket_id, ctx->resume.id, sizeof(kex->ticket_id));
+        kex->salt = ctx->keys.sessionsalt;
+        return payload_len;
+    }
+
     default: {
         return 0;
     }
@@ -83,7 +161,17 @@ bool teoLNullKEXValidate(teoLNullEncryptionContext *ctx,
             return false;
         }
 
-        if (ctx && ctx->enc_proto != buffer->protocolId) {
+        // Resumed session has no ECDH key pair to apply answer to
+        if (ctx && ctx->resumed) {
+            LTRACK_E("TeonetClient",
+                     "KEX_PACKET broken ECDH_AES_128_V1 answer to resumed "
+                     "session");
+            return false;
+        }
+
+        // Server without ENC_PROTO_ECDH_AES_128_GCM_V2 answers with V1
+        if (ctx && ctx->enc_proto != buffer->protocolId &&
+            ctx->enc_proto != ENC_PROTO_ECDH_AES_128_GCM_V2) {
             LTRACK_E("TeonetClient",
                      "KEX_PACKET broken ECDH_AES_128_V1 proto mismatch "
                      "ctx %s(%d)",
@@ -94,6 +182,60 @@ bool teoLNullKEXValidate(teoLNullEncryptionContext *ctx,
         return true;
     }
 
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: {
+        const size_t kex_len = teoLNullKEXBufferSize(buffer->protocolId);
+        if (kex_len != buffer_length) {
+            LTRACK_E("TeonetClient",
+                     "KEX_PACKET broken ECDH_AES_128_GCM_V2 size %u mismatch "
+                     "buffer %u bytes",
+                     (uint32_t)kex_len, (uint32_t)buffer_length);
+            return false;
+        }
+
+        if (ctx && (ctx->resumed || ctx->enc_proto != buffer->protocolId)) {
+            LTRACK_E("TeonetClient",
+                     "KEX_PACKET broken ECDH_AES_128_GCM_V2 proto mismatch "
+                     "ctx %s(%d)",
+                     STRING_teoLNullEncryptionProtocol(ctx->enc_proto),
+                     (int)ctx->enc_proto);
+            return false;
+        }
+        return true;
+    }
+
+    case ENC_PROTO_ECDH_AES_128_RESUME_V1: {
+        const size_t kex_len = teoLNullKEXBufferSize(buffer->protocolId);
+        if (kex_len != buffer_length) {
+            LTRACK_E("TeonetClient",
+                     "KEX_PACKET broken ECDH_AES_128_RESUME_V1 size %u "
+                     "mismatch buffer %u bytes",
+                     (uint32_t)kex_len, (uint32_t)buffer_length);
+            return false;
+        }
+
+        // Established resumed session has protocol of its ticket
+        if (ctx && !ctx->resumed) {
+            LTRACK_E("TeonetClient",
+                     "KEX_PACKET broken ECDH_AES_128_RESUME_V1 proto "
+                     "mismatch ctx %s(%d)",
+                     STRING_teoLNullEncryptionProtocol(ctx->enc_proto),
+                     (int)ctx->enc_proto);
+            return false;
+        }
+
+        // Server which does not know ticket can't answer with it
+        KeyExchangePayload_ECDH_AES_128_RESUME_V1 *kex =
+            (KeyExchangePayload_ECDH_AES_128_RESUME_V1 *)buffer;
+        if (ctx && memcmp(kex->ticket_id, ctx->resume.id,
+                          sizeof(kex->ticket_id)) != 0) {
+            LTRACK_E("TeonetClient",
+                     "KEX_PACKET broken ECDH_AES_128_RESUME_V1 ticket "
+                     "mismatch");
+            return false;
+        }
+        return true;
+    }
+
     default: {
         LTRACK_E("TeonetClient", "KEX_PACKET broken: Unknown proto %s(%d)",
                  STRING_teoLNullEncryptionProtocol(buffer->protocolId),
@@ -103,9 +245,31 @@ bool teoLNullKEXValidate(teoLNullEncryptionContext *ctx,
     }
 }
 
+/**
+ * Init peer keys like initPeerKeys but take ECDH key pair from key pool
+ *
+ * Key pair is generated in place when pool is empty or disabled.
+ *
+ * @param keys Peer keys
+ */
+static void _initPeerKeysPooled(PeerKeyset *keys) {
+    if (!teoLNullKeyPoolTake(&keys->pvtkeylocal, &keys->pubkeylocal)) {
+        initPeerKeys(keys);
+        return;
+    }
+
+    zero_bytes(keys->pubkeyremote.data, sizeof(keys->pubkeyremote.data));
+    zero_bytes(keys->sharedkey.data, sizeof(keys->sharedkey.data));
+
+    zero_bytes(keys->sessionkey.data, sizeof(keys->sessionkey.data));
+    randomize_bytes(keys->sessionsalt.data, sizeof(keys->sessionsalt.data));
+}
+
 size_t teoLNullEncryptionContextSize(teoLNullEncryptionProtocol enc_proto) {
     switch (enc_proto) {
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_RESUME_V1: {
         return sizeof(teoLNullEncryptionContext);
     }
 
@@ -118,7 +282,8 @@ size_t teoLNullEncryptionContextSize(teoLNullEncryptionProtocol enc_proto) {
 size_t teoLNullEncryptionContextCreate(teoLNullEncryptionProtocol enc_proto,
                                        uint8_t *buffer, size_t buffer_length) {
     switch (enc_proto) {
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: {
         if (buffer_length != sizeof(teoLNullEncryptionContext)) {
             LTRACK_E("TeonetClient",
                      "Buffer size mismatch in EncryptioContextCreate");
@@ -129,18 +294,196 @@ size_t teoLNullEncryptionContextCreate(teoLNullEncryptionProtocol enc_proto,
         ctx->enc_proto = enc_proto;
         ctx->receiveNonce = 1;
         ctx->sendNonce = 1;
+        ctx->sendSequence = 1;
+        ctx->receiveSequence = 0;
+        ctx->receiveWindow = 0;
+        ctx->resumed = false;
+        ctx->server_side = false;
         ctx->state = SESCRYPT_PENDING;
-        initPeerKeys(&ctx->keys);
+        _initPeerKeysPooled(&ctx->keys);
 
         return sizeof(teoLNullEncryptionContext);
     }
 
+    case ENC_PROTO_ECDH_AES_128_RESUME_V1: {
+        LTRACK_E("TeonetClient", "ENC_PROTO_ECDH_AES_128_RESUME_V1 context "
+                                 "requires session ticket");
+        return 0;
+    }
+
     default: {
         return 0;
     }
     }
 }
 
+/**
+ * Check that ticket resumes session of supported protocol
+ *
+ * @param ticket Session ticket
+ *
+ * @return true if ticket protocol is supported
+ */
+static bool _ticketProtocolValid(const teoLNullSessionTicket *ticket) {
+    switch (ticket->protocol) {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: {
+        return true;
+    }
+
+    default: {
+        LTRACK_E("TeonetClient",
+                 "Session ticket of unsupported protocol %s(%d)",
+                 STRING_teoLNullEncryptionProtocol(ticket->protocol),
+                 (int)ticket->protocol);
+        return false;
+    }
+    }
+}
+
+/**
+ * Init context of ENC_PROTO_ECDH_AES_128_RESUME_V1 session with fresh salt
+ *
+ * @param ctx Context to init
+ * @param ticket Session ticket
+ * @param server_side Context of server side of session
+ */
+static void _resumeContextInit(teoLNullEncryptionContext *ctx,
+                               const teoLNullSessionTicket *ticket,
+                               bool server_side) {
+    memset(ctx, 0, sizeof(teoLNullEncryptionContext));
+    ctx->enc_proto = ENC_PROTO_ECDH_AES_128_RESUME_V1;
+    ctx->receiveNonce = 1;
+    ctx->sendNonce = 1;
+    ctx->sendSequence = 1;
+    ctx->state = SESCRYPT_PENDING;
+    ctx->resume = *ticket;
+    ctx->resumed = true;
+    ctx->server_side = server_side;
+
+    // Only fresh salt is needed, no ECDH key pair
+    randomize_bytes(ctx->keys.sessionsalt.data,
+                    sizeof(ctx->keys.sessionsalt.data));
+}
+
+/**
+ * Establish resumed session: derive session key from ticket and salts of
+ * both sides and switch context to protocol of ticket
+ *
+ * @param ctx Context of resumed session
+ * @param client_salt Salt of client resume KEX
+ * @param server_salt Salt of server answer
+ */
+static void _resumeEstablish(teoLNullEncryptionContext *ctx,
+                             const AES128_1_BLOCK *client_salt,
+                             const AES128_1_BLOCK *server_salt) {
+    // Session key depends on both client and server salt
+    AES128_1_KEY client_key;
+    PBKDF2_AES128_1(&ctx->resume.key, client_salt, 1, client_key.data,
+                    sizeof(client_key.data));
+    PBKDF2_AES128_1(&client_key, server_salt, 1, ctx->keys.sessionkey.data,
+                    sizeof(ctx->keys.sessionkey.data));
+    zero_bytes(client_key.data, sizeof(client_key.data));
+
+    // Resumed session continues with protocol of original session
+    ctx->enc_proto = ctx->resume.protocol;
+    if (ctx->enc_proto == ENC_PROTO_ECDH_AES_128_GCM_V2) {
+        AES128_GCM_EngineCreate(&ctx->aead, &ctx->keys.sessionkey);
+    } else {
+        AES128_1_EngineCreate(&ctx->engine, &ctx->keys.sessionkey);
+    }
+    ctx->state = SESCRYPT_ESTABLISHED;
+}
+
+size_t teoLNullEncryptionContextCreateResume(const teoLNullSessionTicket *ticket,
+                                             uint8_t *buffer,
+                                             size_t buffer_length) {
+    if (buffer_length != sizeof(teoLNullEncryptionContext)) {
+        LTRACK_E("TeonetClient",
+                 "Buffer size mismatch in EncryptioContextCreateResume");
+        abort();
+    }
+
+    if (!_ticketProtocolValid(ticket)) { return 0; }
+
+    _resumeContextInit((teoLNullEncryptionContext *)buffer, ticket, false);
+
+    return sizeof(teoLNullEncryptionContext);
+}
+
+const uint8_t *
+teoLNullKEXResumeTicketId(const KeyExchangePayload_Common *buffer,
+                          size_t buffer_length) {
+    if (buffer->protocolId != ENC_PROTO_ECDH_AES_128_RESUME_V1 ||
+        buffer_length != sizeof(KeyExchangePayload_ECDH_AES_128_RESUME_V1)) {
+        return NULL;
+    }
+
+    return ((const KeyExchangePayload_ECDH_AES_128_RESUME_V1 *)buffer)
+        ->ticket_id;
+}
+
+size_t teoLNullEncryptionContextAcceptResume(
+    const teoLNullSessionTicket *ticket, const KeyExchangePayload_Common *kex,
+    size_t kex_length, uint8_t *answer, size_t answer_length, uint8_t *buffer,
+    size_t buffer_length) {
+    if (buffer_length != sizeof(teoLNullEncryptionContext)) {
+        LTRACK_E("TeonetClient",
+                 "Buffer size mismatch in EncryptioContextAcceptResume");
+        abort();
+    }
+
+    const uint8_t *ticket_id = teoLNullKEXResumeTicketId(kex, kex_length);
+    if (ticket_id == NULL ||
+        memcmp(ticket_id, ticket->id, sizeof(ticket->id)) != 0) {
+        LTRACK_E("TeonetClient",
+                 "KEX_PACKET broken ECDH_AES_128_RESUME_V1 ticket mismatch");
+        return 0;
+    }
+
+    if (!_ticketProtocolValid(ticket)) { return 0; }
+
+    teoLNullEncryptionContext *ctx = (teoLNullEncryptionContext *)buffer;
+    _resumeContextInit(ctx, ticket, true);
+
+    // Answer carries ticket id and server salt
+    if (teoLNullKEXCreate(ctx, answer, answer_length) == 0) {
+        teoLNullEncryptionContextDestroy(ctx);
+        return 0;
+    }
+
+    const KeyExchangePayload_ECDH_AES_128_RESUME_V1 *request =
+        (const KeyExchangePayload_ECDH_AES_128_RESUME_V1 *)kex;
+    _resumeEstablish(ctx, &request->salt, &ctx->keys.sessionsalt);
+    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+            "KEX_PACKET ECDH_AES_128_RESUME_V1 accepted, session %s",
+            STRING_teoLNullEncryptionProtocol(ctx->enc_proto));
+
+    return sizeof(teoLNullEncryptionContext);
+}
+
+bool teoLNullEncryptionContextExportTicket(const teoLNullEncryptionContext *ctx,
+                                           teoLNullSessionTicket *ticket) {
+    if (ctx == NULL || ctx->state != SESCRYPT_ESTABLISHED) { return false; }
+
+    // Established resumed session has protocol of its ticket
+    switch (ctx->enc_proto) {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: {
+        PBKDF2_AES128_1(&ctx->keys.sessionkey, &TICKET_ID_LABEL, 1,
+                        ticket->id, sizeof(ticket->id));
+        PBKDF2_AES128_1(&ctx->keys.sessionkey, &TICKET_KEY_LABEL, 1,
+                        ticket->key.data, sizeof(ticket->key.data));
+        ticket->protocol = ctx->enc_proto;
+        return true;
+    }
+
+    default: {
+        return false;
+    }
+    }
+}
+
 bool teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
                                        KeyExchangePayload_Common *buffer,
                                        size_t buffer_length) {
@@ -150,20 +493,47 @@ bool teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
     }
 
     switch (buffer->protocolId) {
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: {
         KeyExchangePayload_ECDH_AES_128_V1 *kex =
             (KeyExchangePayload_ECDH_AES_128_V1 *)buffer;
 
         const char *err =
             initApplyRemoteKey(&ctx->keys, &kex->pubkey, &kex->salt);
         if (err != NULL) {
-            LTRACK_E("TeonetClient",
-                     "KEX_PACKET ECDH_AES_128_V1 failed apply: %s", err);
+            LTRACK_E("TeonetClient", "KEX_PACKET %s failed apply: %s",
+                     STRING_teoLNullEncryptionProtocol(buffer->protocolId),
+                     err);
             return false;
         }
+
+        if (buffer->protocolId == ENC_PROTO_ECDH_AES_128_GCM_V2) {
+            AES128_GCM_EngineCreate(&ctx->aead, &ctx->keys.sessionkey);
+        } else {
+            if (ctx->enc_proto != ENC_PROTO_ECDH_AES_128_V1) {
+                LTRACK_I("TeonetClient", "KEX_PACKET server answered %s, "
+                                         "session downgraded from %s",
+                         STRING_teoLNullEncryptionProtocol(buffer->protocolId),
+                         STRING_teoLNullEncryptionProtocol(ctx->enc_proto));
+                ctx->enc_proto = ENC_PROTO_ECDH_AES_128_V1;
+            }
+            AES128_1_EngineCreate(&ctx->engine, &ctx->keys.sessionkey);
+        }
         ctx->state = SESCRYPT_ESTABLISHED;
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient", "KEX_PACKET %s",
+                STRING_teoLNullEncryptionProtocol(buffer->protocolId));
+
+        return true;
+    }
+
+    case ENC_PROTO_ECDH_AES_128_RESUME_V1: {
+        KeyExchangePayload_ECDH_AES_128_RESUME_V1 *kex =
+            (KeyExchangePayload_ECDH_AES_128_RESUME_V1 *)buffer;
+
+        _resumeEstablish(ctx, &ctx->keys.sessionsalt, &kex->salt);
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                "KEX_PACKET ECDH_AES_128_V1");
+                "KEX_PACKET ECDH_AES_128_RESUME_V1, session %s",
+                STRING_teoLNullEncryptionProtocol(ctx->enc_proto));
 
         return true;
     }
@@ -175,6 +545,15 @@ bool teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
     }
 }
 
+void teoLNullEncryptionContextDestroy(teoLNullEncryptionContext *ctx) {
+    if (ctx == NULL) { return; }
+
+    AES128_1_EngineDestroy(&ctx->engine);
+    AES128_GCM_EngineDestroy(&ctx->aead);
+    zero_bytes((uint8_t *)&ctx->keys, sizeof(ctx->keys));
+    zero_bytes((uint8_t *)&ctx->resume, sizeof(ctx->resume));
+}
+
 const uint32_t PACKET_ENCRYPTED_FLAG = 0x80;
 
 bool teoLNullPacketIsEncrypted(teoLNullCPacket *packet) {
@@ -190,6 +569,186 @@ inline void _packetSetIsEncrypted(teoLNullCPacket *packet, bool is_encrypted) {
     }
 }
 
+const uint32_t PACKET_EXPLICIT_NONCE_FLAG = 0x40;
+
+size_t teoLNullEncryptionOverhead(const teoLNullEncryptionContext *ctx) {
+    if (ctx != NULL && ctx->enc_proto == ENC_PROTO_ECDH_AES_128_GCM_V2) {
+        return TEOLNULL_AEAD_TAG_SIZE + TEOLNULL_EXPLICIT_NONCE_SIZE;
+    }
+
+    return 0;
+}
+
+bool teoLNullEncryptionHasExplicitNonce(const teoLNullEncryptionContext *ctx) {
+    return ctx != NULL && ctx->enc_proto == ENC_PROTO_ECDH_AES_128_GCM_V2;
+}
+
+bool teoLNullPacketIsAuthenticated(const teoLNullEncryptionContext *ctx,
+                                   const teoLNullCPacket *packet) {
+    return ctx != NULL && ctx->state == SESCRYPT_ESTABLISHED &&
+           ctx->enc_proto == ENC_PROTO_ECDH_AES_128_GCM_V2 &&
+           (packet->reserved_1 & PACKET_ENCRYPTED_FLAG) != 0;
+}
+
+/**
+ * Write 64-bit big-endian number
+ *
+ * @param value Number
+ * @param out Buffer of 8 bytes
+ */
+static void _storeBE64(uint64_t value, uint8_t *out) {
+    for (int i = 7; i >= 0; --i) {
+        out[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+/**
+ * Read 64-bit big-endian number
+ *
+ * @param in Buffer of 8 bytes
+ *
+ * @return Number
+ */
+static uint64_t _loadBE64(const uint8_t *in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) { value = (value << 8) | in[i]; }
+
+    return value;
+}
+
+/**
+ * Make ENC_PROTO_ECDH_AES_128_GCM_V2 nonce: direction, zeros and big-endian
+ * packet counter
+ *
+ * @param direction AEAD_NONCE_TO_SERVER or AEAD_NONCE_TO_CLIENT, with
+ *  AEAD_NONCE_EXPLICIT for explicit nonce packet
+ * @param counter Packet counter or sequence number of explicit nonce packet
+ * @param iv Nonce of AES128_GCM_IV_SIZE bytes
+ */
+static void _aeadNonce(uint8_t direction, uint64_t counter, uint8_t *iv) {
+    memset(iv, 0, AES128_GCM_IV_SIZE);
+    iv[0] = direction;
+    _storeBE64(counter, iv + AES128_GCM_IV_SIZE - 8);
+}
+
+/**
+ * Check that explicit nonce packet is not replayed or too old
+ *
+ * @param ctx Established encryption context
+ * @param sequence Sequence number of packet
+ *
+ * @return true if packet may be accepted
+ */
+static bool _replayCheck(const teoLNullEncryptionContext *ctx,
+                         uint64_t sequence) {
+    if (sequence == 0) { return false; }
+    if (sequence > ctx->receiveSequence) { return true; }
+
+    const uint64_t age = ctx->receiveSequence - sequence;
+    if (age >= TEOLNULL_REPLAY_WINDOW_SIZE) { return false; }
+
+    return (ctx->receiveWindow & ((uint64_t)1 << age)) == 0;
+}
+
+/**
+ * Remember authenticated explicit nonce packet in replay window
+ *
+ * @param ctx Established encryption context
+ * @param sequence Sequence number of packet accepted by _replayCheck
+ */
+static void _replayUpdate(teoLNullEncryptionContext *ctx, uint64_t sequence) {
+    if (sequence > ctx->receiveSequence) {
+        const uint64_t shift = sequence - ctx->receiveSequence;
+        ctx->receiveWindow = shift < TEOLNULL_REPLAY_WINDOW_SIZE
+                                 ? ctx->receiveWindow << shift
+                                 : 0;
+        ctx->receiveWindow |= 1;
+        ctx->receiveSequence = sequence;
+    } else {
+        ctx->receiveWindow |= (uint64_t)1 << (ctx->receiveSequence - sequence);
+    }
+}
+
+/**
+ * Make additional authenticated data of packet: command, peer name length
+ * and peer name
+ *
+ * @param packet L0 packet
+ * @param aad Buffer of 2 + UINT8_MAX bytes
+ *
+ * @return Length of additional data
+ */
+static size_t _aeadHeader(const teoLNullCPacket *packet, uint8_t *aad) {
+    aad[0] = packet->cmd;
+    aad[1] = packet->peer_name_length;
+    memcpy(aad + 2, packet->peer_name, packet->peer_name_length);
+
+    return 2 + (size_t)packet->peer_name_length;
+}
+
+/**
+ * Encrypt data parts to packet data by ENC_PROTO_ECDH_AES_128_GCM_V2 and
+ * append tag
+ *
+ * @param ctx Established encryption context
+ * @param packet L0 packet with data_length set, has
+ *  teoLNullEncryptionOverhead bytes after data
+ * @param parts Data buffers, may point to packet data
+ * @param n Number of buffers in @a parts
+ * @param explicit_nonce Append sequence number before tag instead of using
+ *  packet counter
+ *
+ * @return Byte checksum of plain data
+ */
+static uint8_t _aeadSeal(teoLNullEncryptionContext *ctx,
+                         teoLNullCPacket *packet, const struct iovec *parts,
+                         int n, bool explicit_nonce) {
+    const size_t length = packet->data_length;
+    const size_t nonce_length =
+        explicit_nonce ? TEOLNULL_EXPLICIT_NONCE_SIZE : 0;
+    if (length + nonce_length + TEOLNULL_AEAD_TAG_SIZE > UINT16_MAX) {
+        LTRACK_E("TeonetClient", "Packet data %u bytes too long for tag",
+                 (uint32_t)length);
+        abort();
+    }
+
+    uint8_t *data = teoLNullPacketGetPayload(packet);
+    uint8_t iv[AES128_GCM_IV_SIZE];
+    if (explicit_nonce) {
+        const uint64_t sequence = ctx->sendSequence++;
+        _aeadNonce(_aeadSendDirection(ctx) | AEAD_NONCE_EXPLICIT, sequence, iv);
+        _storeBE64(sequence, data + length);
+        packet->reserved_1 |= PACKET_EXPLICIT_NONCE_FLAG;
+    } else {
+        _aeadNonce(_aeadSendDirection(ctx), ctx->sendNonce++, iv);
+    }
+
+    uint32_t src_sum = 0;
+    size_t offset = 0;
+    for (int i = 0; i < n; ++i) {
+        if (parts[i].iov_len == 0) { continue; }
+        AES128_GCM_XCryptCopy(&ctx->aead, iv, offset,
+                              (const uint8_t *)parts[i].iov_base,
+                              data + offset, parts[i].iov_len, &src_sum, NULL);
+        offset += parts[i].iov_len;
+    }
+
+    // Sequence number is authenticated as a part of nonce
+    uint8_t aad[2 + UINT8_MAX];
+    size_t aad_length = _aeadHeader(packet, aad);
+    AES128_GCM_Tag(&ctx->aead, iv, aad, aad_length, data, length,
+                   data + length + nonce_length);
+
+    packet->data_length =
+        (uint16_t)(length + nonce_length + TEOLNULL_AEAD_TAG_SIZE);
+    _packetSetIsEncrypted(packet, true);
+    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+            "Encrypted - ENC_PROTO_ECDH_AES_128_GCM_V2");
+
+    return (uint8_t)src_sum;
+}
+
 void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *packet) {
     if (ctx == NULL) {
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
@@ -210,11 +769,12 @@ void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
                 "Skip - ENC_PROTO_DISABLED\n");
     } break;
 
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_RESUME_V1: {
         if (packet->data_length) {
-            XCrypt_AES128_1(&ctx->keys.sessionkey, ctx->sendNonce,
-                            teoLNullPacketGetPayload(packet),
-                            packet->data_length);
+            AES128_1_EngineXCrypt(&ctx->engine, (uint32_t)ctx->sendNonce,
+                                  teoLNullPacketGetPayload(packet),
+                                  packet->data_length);
 
             _packetSetIsEncrypted(packet, true);
             ctx->sendNonce++;
@@ -226,6 +786,14 @@ void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
         }
     } break;
 
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: {
+        // Packet without data is sealed too, so its header is authenticated
+        struct iovec part;
+        part.iov_base = teoLNullPacketGetPayload(packet);
+        part.iov_len = packet->data_length;
+        _aeadSeal(ctx, packet, &part, 1, false);
+    } break;
+
     default: {
         // Invalid/unknown encryption
         LTRACK("TeonetClient", "Unexpected teoLNullEncryptionProtocol (%d)",
@@ -235,10 +803,178 @@ void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
     }
 }
 
+/**
+ * Copy data parts to packet data unencrypted
+ *
+ * @param packet L0 packet
+ * @param parts Data buffers, may point to packet data
+ * @param n Number of buffers in @a parts
+ *
+ * @return Byte checksum of data
+ */
+static uint8_t _packetCopyPlain(teoLNullCPacket *packet,
+                                const struct iovec *parts, int n) {
+    uint8_t *data = teoLNullPacketGetPayload(packet);
+
+    uint8_t checksum = 0;
+    size_t offset = 0;
+    for (int i = 0; i < n; ++i) {
+        if (parts[i].iov_len == 0) { continue; }
+        checksum += teoLNullCopyByteChecksum(data + offset,
+                                             (const uint8_t *)parts[i].iov_base,
+                                             parts[i].iov_len);
+        offset += parts[i].iov_len;
+    }
+
+    return checksum;
+}
+
+uint8_t teoLNullPacketEncryptCopyv(teoLNullEncryptionContext *ctx,
+                                   teoLNullCPacket *packet,
+                                   const struct iovec *parts, int n,
+                                   uint8_t *plain_checksum) {
+    uint8_t *data = teoLNullPacketGetPayload(packet);
+
+    bool encrypt = false;
+    if (ctx != NULL && ctx->state == SESCRYPT_ESTABLISHED) {
+        switch (ctx->enc_proto) {
+        case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+        case ENC_PROTO_ECDH_AES_128_RESUME_V1: {
+            encrypt = packet->data_length != 0;
+        } break;
+
+        case ENC_PROTO_ECDH_AES_128_GCM_V2: {
+            // Tag protects packet, byte checksum of payload is not used
+            uint8_t checksum = _aeadSeal(ctx, packet, parts, n, false);
+            if (plain_checksum != NULL) { *plain_checksum = checksum; }
+            return 0;
+        }
+
+        default: {
+        } break;
+        }
+    }
+
+    if (!encrypt) {
+        uint8_t checksum = _packetCopyPlain(packet, parts, n);
+        if (plain_checksum != NULL) { *plain_checksum = checksum; }
+
+        // Nothing to encrypt, keeps logging of skipped encryption
+        teoLNullPacketEncrypt(ctx, packet);
+        return checksum;
+    }
+
+    uint32_t src_sum = 0;
+    uint32_t dst_sum = 0;
+    size_t offset = 0;
+    for (int i = 0; i < n; ++i) {
+        if (parts[i].iov_len == 0) { continue; }
+        AES128_1_EngineXCryptCopy(&ctx->engine, (uint32_t)ctx->sendNonce,
+                                  offset, (const uint8_t *)parts[i].iov_base,
+                                  data + offset, parts[i].iov_len, &src_sum,
+                                  &dst_sum);
+        offset += parts[i].iov_len;
+    }
+
+    _packetSetIsEncrypted(packet, true);
+    ctx->sendNonce++;
+    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+            "Encrypted - ENC_PROTO_ECDH_AES_128_V1");
+
+    if (plain_checksum != NULL) { *plain_checksum = (uint8_t)src_sum; }
+    return (uint8_t)dst_sum;
+}
+
+uint8_t teoLNullPacketEncryptUnreliableCopyv(teoLNullEncryptionContext *ctx,
+                                             teoLNullCPacket *packet,
+                                             const struct iovec *parts, int n,
+                                             uint8_t *plain_checksum) {
+    if (teoLNullEncryptionHasExplicitNonce(ctx) &&
+        ctx->state == SESCRYPT_ESTABLISHED) {
+        // Tag protects packet, byte checksum of payload is not used
+        uint8_t checksum = _aeadSeal(ctx, packet, parts, n, true);
+        if (plain_checksum != NULL) { *plain_checksum = checksum; }
+        return 0;
+    }
+
+    // Implicit packet counter can't be used by packets which may be lost
+    uint8_t checksum = _packetCopyPlain(packet, parts, n);
+    if (plain_checksum != NULL) { *plain_checksum = checksum; }
+    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+            "Skip - NO_EXPLICIT_NONCE\n");
+
+    return checksum;
+}
+
+/**
+ * Decrypt ENC_PROTO_ECDH_AES_128_GCM_V2 packet with explicit nonce
+ *
+ * Does not depend on other received packets except of replay window.
+ *
+ * @param ctx Established encryption context
+ * @param packet L0 packet with PACKET_EXPLICIT_NONCE_FLAG
+ *
+ * @return true if packet is authenticated and decrypted
+ */
+static bool _aeadOpenExplicit(teoLNullEncryptionContext *ctx,
+                              teoLNullCPacket *packet) {
+    const size_t overhead =
+        TEOLNULL_EXPLICIT_NONCE_SIZE + TEOLNULL_AEAD_TAG_SIZE;
+    if (packet->data_length < overhead) {
+        LTRACK_E("TeonetClient", "Broken - NO_EXPLICIT_NONCE %u bytes",
+                 (uint32_t)packet->data_length);
+        return false;
+    }
+
+    uint8_t *data = teoLNullPacketGetPayload(packet);
+    const size_t length = packet->data_length - overhead;
+    const uint64_t sequence = _loadBE64(data + length);
+
+    // Replayed packet is rejected before spending time on its tag
+    if (!_replayCheck(ctx, sequence)) {
+        CLTRACK_E(teocliOpt_DBG_packetFlow, "TeonetClient",
+                  "Broken - REPLAYED sequence %" PRIu64, sequence);
+        return false;
+    }
+
+    uint8_t iv[AES128_GCM_IV_SIZE];
+    _aeadNonce(_aeadReceiveDirection(ctx) | AEAD_NONCE_EXPLICIT, sequence, iv);
+    uint8_t aad[2 + UINT8_MAX];
+    size_t aad_length = _aeadHeader(packet, aad);
+
+    if (!AES128_GCM_Check(&ctx->aead, iv, aad, aad_length, data, length,
+                          data + length + TEOLNULL_EXPLICIT_NONCE_SIZE)) {
+        LTRACK_E("TeonetClient", "Broken - AEAD_TAG_MISMATCH cmd %u",
+                 (uint32_t)packet->cmd);
+        return false;
+    }
+
+    // Only authenticated sequence numbers move the window
+    _replayUpdate(ctx, sequence);
+
+    AES128_GCM_XCryptCopy(&ctx->aead, iv, 0, data, data, length, NULL, NULL);
+    packet->data_length = (uint16_t)length;
+    packet->reserved_1 &= ~PACKET_EXPLICIT_NONCE_FLAG;
+    _packetSetIsEncrypted(packet, false);
+    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+            "Decrypted - ENC_PROTO_ECDH_AES_128_GCM_V2 explicit nonce");
+
+    return true;
+}
+
 bool teoLNullPacketDecrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *packet) {
     // HINT: check is_encrypted flag first
     const bool encrypted = teoLNullPacketIsEncrypted(packet);
     if (!encrypted) {
+        // Encrypted flag is not covered by tag, so authenticated session
+        // accepts sealed packets only
+        if (ctx != NULL && ctx->state == SESCRYPT_ESTABLISHED &&
+            ctx->enc_proto == ENC_PROTO_ECDH_AES_128_GCM_V2) {
+            LTRACK_E("TeonetClient", "Broken - NOT_AUTHENTICATED cmd %u",
+                     (uint32_t)packet->cmd);
+            return false;
+        }
+
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient", "Skip - NOT_ENCRYPTED\n");
         // unencrypted packets always return success
         return true;
@@ -260,12 +996,13 @@ bool teoLNullPacketDecrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
 
     // encrypted packet
     switch (ctx->enc_proto) {
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_RESUME_V1: {
         // decrypt packet payload
         if (packet->data_length) {
-            XCrypt_AES128_1(&ctx->keys.sessionkey, ctx->receiveNonce,
-                            teoLNullPacketGetPayload(packet),
-                            packet->data_length);
+            AES128_1_EngineXCrypt(&ctx->engine, (uint32_t)ctx->receiveNonce,
+                                  teoLNullPacketGetPayload(packet),
+                                  packet->data_length);
             CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
                     "Decrypted - ENC_PROTO_ECDH_AES_128_V1");
             // Not encrypted anymore, clear is_encrypted flag
@@ -278,6 +1015,43 @@ bool teoLNullPacketDecrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
         }
     } break;
 
+    case ENC_PROTO_ECDH_AES_128_GCM_V2: {
+        if (packet->reserved_1 & PACKET_EXPLICIT_NONCE_FLAG) {
+            return _aeadOpenExplicit(ctx, packet);
+        }
+
+        // Nonce is used by every received packet, even rejected one
+        const uint64_t nonce = ctx->receiveNonce++;
+
+        if (packet->data_length < TEOLNULL_AEAD_TAG_SIZE) {
+            LTRACK_E("TeonetClient", "Broken - NO_AEAD_TAG %u bytes",
+                     (uint32_t)packet->data_length);
+            return false;
+        }
+
+        uint8_t *data = teoLNullPacketGetPayload(packet);
+        const size_t length = packet->data_length - TEOLNULL_AEAD_TAG_SIZE;
+        uint8_t iv[AES128_GCM_IV_SIZE];
+        _aeadNonce(_aeadReceiveDirection(ctx), nonce, iv);
+        uint8_t aad[2 + UINT8_MAX];
+        size_t aad_length = _aeadHeader(packet, aad);
+
+        // Corrupted or tampered data is never decrypted
+        if (!AES128_GCM_Check(&ctx->aead, iv, aad, aad_length, data, length,
+                              data + length)) {
+            LTRACK_E("TeonetClient", "Broken - AEAD_TAG_MISMATCH cmd %u",
+                     (uint32_t)packet->cmd);
+            return false;
+        }
+
+        AES128_GCM_XCryptCopy(&ctx->aead, iv, 0, data, data, length, NULL,
+                              NULL);
+        packet->data_length = (uint16_t)length;
+        _packetSetIsEncrypted(packet, false);
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "Decrypted - ENC_PROTO_ECDH_AES_128_GCM_V2");
+    } break;
+
     case ENC_PROTO_DISABLED: {
         // TODO : separate log control
         // encryption disabled
@@ -301,6 +1075,10 @@ const char *STRING_teoLNullEncryptionProtocol(teoLNullEncryptionProtocol v) {
     switch (v) {
     case ENC_PROTO_DISABLED: return "ENC_PROTO_DISABLED";
     case ENC_PROTO_ECDH_AES_128_V1: return "ENC_PROTO_ECDH_AES_128_V1";
+    case ENC_PROTO_ECDH_AES_128_RESUME_V1:
+        return "ENC_PROTO_ECDH_AES_128_RESUME_V1";
+    case ENC_PROTO_ECDH_AES_128_GCM_V2:
+        return "ENC_PROTO_ECDH_AES_128_GCM_V2";
     default: break;
     }
 
@@ -22,8 +22,29 @@ typedef enum teoLNullEncryptionProtocol {
     ENC_PROTO_DISABLED = 0,
     //! First implementation protocol
     ENC_PROTO_ECDH_AES_128_V1 = 1,
+    //! Resumption of ENC_PROTO_ECDH_AES_128_V1 or
+    //! ENC_PROTO_ECDH_AES_128_GCM_V2 session by session ticket, skips ECDH
+    //! and PBKDF2. Resumed session continues with protocol of ticket.
+    ENC_PROTO_ECDH_AES_128_RESUME_V1 = 2,
+    //! ENC_PROTO_ECDH_AES_128_V1 key exchange with AES-128-GCM authenticated
+    //! encryption, packet data is followed by TEOLNULL_AEAD_TAG_SIZE bytes tag
+    //! and byte checksum of packet payload is not used. Unreliable packets
+    //! carry TEOLNULL_EXPLICIT_NONCE_SIZE bytes sequence number before tag.
+    //! Server which answers KEX with ENC_PROTO_ECDH_AES_128_V1 downgrades
+    //! session to it.
+    ENC_PROTO_ECDH_AES_128_GCM_V2 = 3,
 } teoLNullEncryptionProtocol;
 
+//! Authentication tag size of ENC_PROTO_ECDH_AES_128_GCM_V2 packets
+#define TEOLNULL_AEAD_TAG_SIZE AES128_GCM_TAG_SIZE
+
+//! Size of big-endian sequence number carried by explicit nonce packets
+#define TEOLNULL_EXPLICIT_NONCE_SIZE 8
+
+//! Number of latest sequence numbers remembered to reject replayed explicit
+//! nonce packets, older packets are rejected too
+#define TEOLNULL_REPLAY_WINDOW_SIZE 64
+
 typedef enum teoLNullEncryptedSessionState {
     //! Keys sent from our side, waiting for other side reply
     SESCRYPT_PENDING,
@@ -31,19 +52,55 @@ typedef enum teoLNullEncryptedSessionState {
     SESCRYPT_ESTABLISHED,
 } teoLNullEncryptedSessionState;
 
+#define TEOLNULL_TICKET_ID_SIZE 16
+
+/**
+ * Session ticket exported from established session to resume it on
+ * reconnect
+ */
+typedef struct teoLNullSessionTicket {
+    //! Ticket id, server finds resumption key by it
+    uint8_t id[TEOLNULL_TICKET_ID_SIZE];
+    //! Resumption key, new session key is derived from it
+    AES128_1_KEY key;
+    //! Protocol of session, ENC_PROTO_ECDH_AES_128_V1 or
+    //! ENC_PROTO_ECDH_AES_128_GCM_V2
+    teoLNullEncryptionProtocol protocol;
+} teoLNullSessionTicket;
+
 typedef struct teoLNullEncryptionContext {
     //! Stages of session handshake
     teoLNullEncryptedSessionState state;
     //! Encryption protocol variant, for future extensions
     teoLNullEncryptionProtocol enc_proto;
-    //! counters for CTR-mode encryption
-    uint32_t receiveNonce, sendNonce;
+    //! counters for CTR-mode encryption, ENC_PROTO_ECDH_AES_128_V1 uses low
+    //! 32 bits, ENC_PROTO_ECDH_AES_128_GCM_V2 never wraps them to reuse nonce
+    uint64_t receiveNonce, sendNonce;
+    //! Sequence number of next explicit nonce packet to send
+    uint64_t sendSequence;
+    //! Highest sequence number of received explicit nonce packet
+    uint64_t receiveSequence;
+    //! Received explicit nonce packets, bit N is receiveSequence - N
+    uint64_t receiveWindow;
     //! Encryption keys holder
     PeerKeyset keys;
+    //! Ticket of ENC_PROTO_ECDH_AES_128_RESUME_V1 session
+    teoLNullSessionTicket resume;
+    //! Session is resumed by ticket, enc_proto is switched to protocol of
+    //! ticket when session is established
+    bool resumed;
+    //! Context of server side of session, nonces of sent and received
+    //! ENC_PROTO_ECDH_AES_128_GCM_V2 packets are swapped
+    bool server_side;
+    //! Session key with expanded round keys, valid in established session
+    AES128_1_Engine engine;
+    //! Session key of ENC_PROTO_ECDH_AES_128_GCM_V2 established session
+    AES128_GCM_Engine aead;
 } teoLNullEncryptionContext;
 
 // forward declaration, complete type in libteol0/teonet_l0_client.h
 typedef struct teoLNullCPacket teoLNullCPacket;
+struct iovec;
 
 #pragma pack(push)
 #pragma pack(1)
@@ -125,6 +182,76 @@ TEOCLI_API size_t
 teoLNullEncryptionContextCreate(teoLNullEncryptionProtocol enc_proto,
                                 uint8_t *buffer, size_t buffer_length);
 
+/**
+ * Create teoLNullEncryptionContext resuming session of @a ticket
+ *
+ * Context uses ENC_PROTO_ECDH_AES_128_RESUME_V1, its KEX carries ticket id
+ * and fresh salt instead of ECDH public key.
+ *
+ * @param ticket Ticket exported by teoLNullEncryptionContextExportTicket
+ * @param buffer Buffer to create context in
+ * @param buffer_length Buffer length
+ *
+ * @return Length of created teoLNullEncryptionContext or zero if failed
+ */
+TEOCLI_API size_t
+teoLNullEncryptionContextCreateResume(const teoLNullSessionTicket *ticket,
+                                      uint8_t *buffer, size_t buffer_length);
+
+/**
+ * Get ticket id of ENC_PROTO_ECDH_AES_128_RESUME_V1 KEX payload
+ *
+ * Used by server side to find ticket of resumed session.
+ *
+ * @param buffer payload, must be already checked via teoLNullKEXGetFromPayload
+ * @param buffer_length length of @a buffer in bytes
+ *
+ * @return Pointer to TEOLNULL_TICKET_ID_SIZE bytes id or NULL if payload is
+ *  not resume KEX
+ */
+TEOCLI_API const uint8_t *
+teoLNullKEXResumeTicketId(const KeyExchangePayload_Common *buffer,
+                          size_t buffer_length);
+
+/**
+ * Create server side teoLNullEncryptionContext answering resume KEX
+ *
+ * Server side counterpart of teoLNullEncryptionContextCreateResume: session
+ * key is derived from ticket and salts of both sides, answer KEX with server
+ * salt is created in @a answer. Context is established with protocol of
+ * ticket.
+ *
+ * @param ticket Ticket exported by server from its side of session
+ * @param kex Resume KEX payload of client, validated against ticket
+ * @param kex_length Length of @a kex in bytes
+ * @param answer Buffer to create answer KEX payload in
+ * @param answer_length Buffer length, see teoLNullKEXBufferSize
+ * @param buffer Buffer to create context in
+ * @param buffer_length Buffer length
+ *
+ * @return Length of created teoLNullEncryptionContext or zero if failed
+ */
+TEOCLI_API size_t teoLNullEncryptionContextAcceptResume(
+    const teoLNullSessionTicket *ticket, const KeyExchangePayload_Common *kex,
+    size_t kex_length, uint8_t *answer, size_t answer_length, uint8_t *buffer,
+    size_t buffer_length);
+
+/**
+ * Export ticket of established session to resume it on reconnect
+ *
+ * Ticket id and resumption key are derived from session key, so server
+ * derives the same ticket from its side of session. Ticket keeps protocol
+ * of session, so resumed session is not downgraded.
+ *
+ * @param ctx Established context
+ * @param ticket Exported ticket
+ *
+ * @return true on success, false if session is not established
+ */
+TEOCLI_API bool
+teoLNullEncryptionContextExportTicket(const teoLNullEncryptionContext *ctx,
+                                      teoLNullSessionTicket *ticket);
+
 /**
  * Apply valid KEX payload to given context
  *
@@ -139,9 +266,47 @@ teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
                                   KeyExchangePayload_Common *buffer,
                                   size_t buffer_length);
 
+/**
+ * Wipe keys of context before it is freed
+ *
+ * @param ctx Encryption context, may be NULL
+ */
+TEOCLI_API void
+teoLNullEncryptionContextDestroy(teoLNullEncryptionContext *ctx);
+
+/**
+ * Get number of bytes encryption may add to packet data
+ *
+ * Buffers of packets encrypted by @a ctx should have this space after data.
+ *
+ * @param ctx Encryption context, may be NULL
+ *
+ * @return TEOLNULL_AEAD_TAG_SIZE + TEOLNULL_EXPLICIT_NONCE_SIZE for
+ *  ENC_PROTO_ECDH_AES_128_GCM_V2 context, zero otherwise
+ */
+TEOCLI_API size_t
+teoLNullEncryptionOverhead(const teoLNullEncryptionContext *ctx);
+
+/**
+ * Check if integrity of encrypted packet is verified by its decryption, so
+ * byte checksum of packet payload is not used
+ *
+ * @param ctx Encryption context, may be NULL
+ * @param packet L0 packet
+ *
+ * @return true if packet is encrypted by authenticated encryption of @a ctx
+ */
+TEOCLI_API bool
+teoLNullPacketIsAuthenticated(const teoLNullEncryptionContext *ctx,
+                              const teoLNullCPacket *packet);
+
 /**
  * Encrypt packet before sending. Encrypts inplace.
  *
+ * Authenticated encryption appends tag to packet data and increases its
+ * data_length, see teoLNullEncryptionOverhead. It seals packets without
+ * data too, so their command and peer name are authenticated.
+ *
  * @param ctx Encryption context, determines the way data be encrypted
  *  if ctx is NULL or session weren't established yet - no encryption performed
  * @param packet L0 packet to be encrypted
@@ -149,6 +314,58 @@ teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
 TEOCLI_API void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx,
                                       teoLNullCPacket *packet);
 
+/**
+ * Copy data to packet, encrypting it in the same pass when
+ * teoLNullPacketEncrypt would encrypt the packet
+ *
+ * Source data is read once and packet data is written once, byte checksums
+ * of plain and written data are calculated in the same pass.
+ *
+ * @param ctx Encryption context, may be NULL
+ * @param packet L0 packet with data_length set, its data is written
+ * @param parts Data buffers of data_length bytes, may point to packet data
+ *  to encrypt it in place
+ * @param n Number of buffers in @a parts
+ * @param plain_checksum Byte checksum of plain data, may be NULL
+ *
+ * @return Byte checksum of packet data as written, zero for authenticated
+ *  packet
+ */
+TEOCLI_API uint8_t teoLNullPacketEncryptCopyv(teoLNullEncryptionContext *ctx,
+                                              teoLNullCPacket *packet,
+                                              const struct iovec *parts,
+                                              int n, uint8_t *plain_checksum);
+
+/**
+ * Check if context encrypts packets with explicit nonce, which may be lost,
+ * reordered or decrypted in any order
+ *
+ * @param ctx Encryption context, may be NULL
+ *
+ * @return true for ENC_PROTO_ECDH_AES_128_GCM_V2 context
+ */
+TEOCLI_API bool
+teoLNullEncryptionHasExplicitNonce(const teoLNullEncryptionContext *ctx);
+
+/**
+ * Copy data to packet like teoLNullPacketEncryptCopyv, encrypting it with
+ * sequence number carried in the packet instead of implicit packet counter
+ *
+ * Data of context without explicit nonce support is copied unencrypted.
+ *
+ * @param ctx Encryption context, may be NULL
+ * @param packet L0 packet with data_length set, its data is written
+ * @param parts Data buffers of data_length bytes, may point to packet data
+ * @param n Number of buffers in @a parts
+ * @param plain_checksum Byte checksum of plain data, may be NULL
+ *
+ * @return Byte checksum of packet data as written, zero for authenticated
+ *  packet
+ */
+TEOCLI_API uint8_t teoLNullPacketEncryptUnreliableCopyv(
+    teoLNullEncryptionContext *ctx, teoLNullCPacket *packet,
+    const struct iovec *parts, int n, uint8_t *plain_checksum);
+
 /**
  * Decrypt received packet inplace.
  *
@@ -156,7 +373,14 @@ TEOCLI_API void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx,
  *  if ctx is NULL or session weren't established yet - no encryption performed
  * @param packet L0 packet to be decrypted
  *
- * @return true if success, false if error
+ * Explicit nonce packet is checked against replay window and does not use
+ * packet counter, so it may be received out of order. Established
+ * ENC_PROTO_ECDH_AES_128_GCM_V2 session rejects packets which are not
+ * encrypted.
+ *
+ * @return true if success, false if error or authenticated packet was
+ *  corrupted, tampered, replayed or not encrypted, its data is not decrypted
+ *  then
  */
 TEOCLI_API bool teoLNullPacketDecrypt(teoLNullEncryptionContext *ctx,
                                       teoLNullCPacket *packet);
@@ -0,0 +1,281 @@
+/**
+ * \file   teonet_l0_client_kex.c
+ *
+ * Key exchange worker pool.
+ *
+ * Applying key exchange answer computes ECDH shared secret and PBKDF2 session
+ * key, which blocks event loop with all its connections. Worker threads apply
+ * answers to copy of encryption context instead. Job is shared by worker and
+ * connection and freed by the last of them, so connection can be destroyed
+ * while job is still queued. Finished worker writes to a pipe watched by
+ * connection event loop.
+ */
+
+#include "teonet_l0_client_kex.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teobase/platform.h"
+
+#if !defined(TEONET_OS_WINDOWS)
+#include <pthread.h>
+#include <unistd.h>
+#define HAVE_KEX_WORKERS 1
+#endif
+
+#include "teobase/logging.h"
+
+#include "teoccl/memory.h"
+
+#if defined(HAVE_KEX_WORKERS)
+
+/**
+ * Key exchange job shared by connection and worker
+ */
+struct teoLNullKexJob {
+    teoLNullKexJob *next;          ///< Next job in pool queue
+    pthread_mutex_t mutex;         ///< Protects result and refs
+    int refs;                      ///< Number of owners: connection and pool
+    int result;                    ///< 1 - applied, 0 - queued, -1 - failed
+    int pipe_fd[2];                ///< Finish notification pipe
+    teoLNullEncryptionContext ctx; ///< Copy of connection context
+    size_t kex_length;             ///< Key exchange payload length
+    uint8_t kex[];                 ///< Key exchange payload
+};
+
+/**
+ * Worker threads and queue of jobs
+ */
+typedef struct teoLNullKexPool {
+    pthread_mutex_t mutex;  ///< Protects all fields
+    pthread_cond_t cond;    ///< Signaled when job is queued or pool stops
+    pthread_t *threads;     ///< Worker threads
+    size_t count;           ///< Number of worker threads
+    bool stop;              ///< Workers should exit
+    teoLNullKexJob *head;   ///< First queued job
+    teoLNullKexJob *tail;   ///< Last queued job
+} teoLNullKexPool;
+
+static teoLNullKexPool kex_pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+/**
+ * Drop one reference of job and free it if it was the last one
+ *
+ * @param job Job
+ */
+static void _kexJobUnref(teoLNullKexJob *job) {
+    pthread_mutex_lock(&job->mutex);
+    int refs = --job->refs;
+    pthread_mutex_unlock(&job->mutex);
+
+    if (refs > 0) { return; }
+
+    close(job->pipe_fd[0]);
+    close(job->pipe_fd[1]);
+    pthread_mutex_destroy(&job->mutex);
+    zero_bytes((uint8_t *)&job->ctx, sizeof(job->ctx));
+    free(job);
+}
+
+/**
+ * Set job result, notify connection and drop pool reference
+ *
+ * @param job Job
+ * @param result 1 - applied, -1 - failed
+ */
+static void _kexJobFinish(teoLNullKexJob *job, int result) {
+    pthread_mutex_lock(&job->mutex);
+    job->result = result;
+    pthread_mutex_unlock(&job->mutex);
+
+    const char notify = 1;
+    if (write(job->pipe_fd[1], &notify, 1) != 1) {
+        LTRACK_E("TeonetClient", "Failed to notify key exchange pipe");
+    }
+
+    _kexJobUnref(job);
+}
+
+/**
+ * Worker thread
+ *
+ * @param arg Not used
+ *
+ * @return NULL
+ */
+static void *_kexWorkerThread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&kex_pool.mutex);
+    for (;;) {
+        while (!kex_pool.stop && kex_pool.head == NULL) {
+            pthread_cond_wait(&kex_pool.cond, &kex_pool.mutex);
+        }
+        if (kex_pool.stop) { break; }
+
+        teoLNullKexJob *job = kex_pool.head;
+        kex_pool.head = job->next;
+        if (kex_pool.head == NULL) { kex_pool.tail = NULL; }
+        pthread_mutex_unlock(&kex_pool.mutex);
+
+        // Context copy is owned by the job until it is finished
+        bool applied = teoLNullEncryptionContextApplyKEX(
+            &job->ctx, (KeyExchangePayload_Common *)job->kex,
+            job->kex_length);
+        _kexJobFinish(job, applied ? 1 : -1);
+
+        pthread_mutex_lock(&kex_pool.mutex);
+    }
+    pthread_mutex_unlock(&kex_pool.mutex);
+
+    return NULL;
+}
+
+void teoLNullKexWorkersSetCount(size_t count) {
+    // Stop current workers, queued jobs wait for new ones
+    pthread_mutex_lock(&kex_pool.mutex);
+    pthread_t *threads = kex_pool.threads;
+    size_t old_count = kex_pool.count;
+    kex_pool.threads = NULL;
+    kex_pool.count = 0;
+    kex_pool.stop = true;
+    pthread_cond_broadcast(&kex_pool.cond);
+    pthread_mutex_unlock(&kex_pool.mutex);
+
+    for (size_t i = 0; i < old_count; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    if (threads != NULL) { free(threads); }
+
+    pthread_mutex_lock(&kex_pool.mutex);
+    kex_pool.stop = false;
+
+    if (count > 0) {
+        kex_pool.threads =
+            (pthread_t *)ccl_malloc(count * sizeof(pthread_t));
+        for (size_t i = 0; i < count; ++i) {
+            if (pthread_create(&kex_pool.threads[kex_pool.count], NULL,
+                               _kexWorkerThread, NULL) != 0) {
+                LTRACK_E("TeonetClient",
+                         "Failed to start key exchange worker thread");
+                break;
+            }
+            ++kex_pool.count;
+        }
+    }
+
+    // Jobs left without workers fail
+    teoLNullKexJob *failed = NULL;
+    if (kex_pool.count == 0) {
+        failed = kex_pool.head;
+        kex_pool.head = NULL;
+        kex_pool.tail = NULL;
+    }
+    pthread_mutex_unlock(&kex_pool.mutex);
+
+    while (failed != NULL) {
+        teoLNullKexJob *next = failed->next;
+        _kexJobFinish(failed, -1);
+        failed = next;
+    }
+}
+
+teoLNullKexJob *teoLNullKexJobStart(const teoLNullEncryptionContext *ctx,
+                                    const KeyExchangePayload_Common *kex,
+                                    size_t kex_length) {
+    pthread_mutex_lock(&kex_pool.mutex);
+    const bool enabled = kex_pool.count > 0;
+    pthread_mutex_unlock(&kex_pool.mutex);
+    if (!enabled) { return NULL; }
+
+    teoLNullKexJob *job = ccl_malloc(sizeof(teoLNullKexJob) + kex_length);
+    memset(job, 0, sizeof(teoLNullKexJob));
+    job->refs = 2;
+    job->ctx = *ctx;
+    job->kex_length = kex_length;
+    memcpy(job->kex, kex, kex_length);
+
+    if (pipe(job->pipe_fd) == -1) {
+        LTRACK_E("TeonetClient", "Failed to create key exchange pipe");
+        zero_bytes((uint8_t *)&job->ctx, sizeof(job->ctx));
+        free(job);
+        return NULL;
+    }
+    pthread_mutex_init(&job->mutex, NULL);
+
+    pthread_mutex_lock(&kex_pool.mutex);
+    if (kex_pool.count == 0) {
+        pthread_mutex_unlock(&kex_pool.mutex);
+        job->refs = 1;
+        _kexJobUnref(job);
+        return NULL;
+    }
+
+    if (kex_pool.tail != NULL) {
+        kex_pool.tail->next = job;
+    } else {
+        kex_pool.head = job;
+    }
+    kex_pool.tail = job;
+    pthread_cond_signal(&kex_pool.cond);
+    pthread_mutex_unlock(&kex_pool.mutex);
+
+    return job;
+}
+
+teonetSocket teoLNullKexJobFd(const teoLNullKexJob *job) {
+    return job->pipe_fd[0];
+}
+
+int teoLNullKexJobResult(teoLNullKexJob *job, teoLNullEncryptionContext *ctx) {
+    pthread_mutex_lock(&job->mutex);
+    int result = job->result;
+    if (result == 1) { *ctx = job->ctx; }
+    pthread_mutex_unlock(&job->mutex);
+
+    return result;
+}
+
+void teoLNullKexJobRelease(teoLNullKexJob *job) {
+    if (job == NULL) { return; }
+
+    _kexJobUnref(job);
+}
+
+#else
+
+void teoLNullKexWorkersSetCount(size_t count) {
+    if (count != 0) {
+        LTRACK_I("TeonetClient",
+                 "Key exchange workers are not supported on this platform");
+    }
+}
+
+teoLNullKexJob *teoLNullKexJobStart(const teoLNullEncryptionContext *ctx,
+                                    const KeyExchangePayload_Common *kex,
+                                    size_t kex_length) {
+    (void)ctx;
+    (void)kex;
+    (void)kex_length;
+    return NULL;
+}
+
+teonetSocket teoLNullKexJobFd(const teoLNullKexJob *job) {
+    (void)job;
+    return -1;
+}
+
+int teoLNullKexJobResult(teoLNullKexJob *job, teoLNullEncryptionContext *ctx) {
+    (void)job;
+    (void)ctx;
+    return -1;
+}
+
+void teoLNullKexJobRelease(teoLNullKexJob *job) { (void)job; }
+
+#endif
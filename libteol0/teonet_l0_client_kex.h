@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_KEX_H
+#define TEONET_L0_CLIENT_KEX_H
+
+#include <stddef.h>
+
+#include "teobase/socket.h"
+
+#include "teocli_api.h"
+#include "teonet_l0_client_crypt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Key exchange worker pool
+/////////////////
+
+// forward declaration, complete type in libteol0/teonet_l0_client_kex.c
+typedef struct teoLNullKexJob teoLNullKexJob;
+
+/**
+ * Set number of threads applying key exchange answers
+ *
+ * Zero stops the threads, queued jobs fail. Platforms without threads have
+ * no workers.
+ *
+ * @param count Number of worker threads
+ */
+TEOCLI_INTERNAL void teoLNullKexWorkersSetCount(size_t count);
+
+/**
+ * Start applying validated key exchange answer to copy of encryption context
+ * in worker thread
+ *
+ * @param ctx Encryption context, copied to job
+ * @param kex Key exchange payload, copied to job
+ * @param kex_length Key exchange payload length
+ *
+ * @return Pointer to job or NULL if there are no workers, answer should be
+ *  applied by caller then
+ */
+TEOCLI_INTERNAL teoLNullKexJob *
+teoLNullKexJobStart(const teoLNullEncryptionContext *ctx,
+                    const KeyExchangePayload_Common *kex, size_t kex_length);
+
+/**
+ * Get descriptor which becomes readable when job is finished
+ *
+ * @param job Job
+ *
+ * @return Descriptor
+ */
+TEOCLI_INTERNAL teonetSocket teoLNullKexJobFd(const teoLNullKexJob *job);
+
+/**
+ * Get job result without waiting
+ *
+ * @param job Job
+ * @param ctx Encryption context to copy established context to
+ *
+ * @return 1 if answer is applied and @a ctx is updated, 0 if job is not
+ *  finished or -1 if answer can't be applied
+ */
+TEOCLI_INTERNAL int teoLNullKexJobResult(teoLNullKexJob *job,
+                                         teoLNullEncryptionContext *ctx);
+
+/**
+ * Release job, not finished worker frees it when done
+ *
+ * @param job Job, may be NULL
+ */
+TEOCLI_INTERNAL void teoLNullKexJobRelease(teoLNullKexJob *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_KEX_H */
@@ -0,0 +1,213 @@
+/**
+ * \file   teonet_l0_client_keypool.c
+ *
+ * Pool of pregenerated ECDH key pairs.
+ *
+ * ECDH key generation is the slowest part of encryption context creation, so
+ * background thread keeps the pool filled and connect path only copies keys.
+ * Context creation generates keys itself when the pool is empty.
+ */
+
+#include "teonet_l0_client_keypool.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teobase/platform.h"
+
+#if !defined(TEONET_OS_WINDOWS)
+#include <pthread.h>
+#define HAVE_KEYPOOL_THREAD 1
+#endif
+
+#include "teobase/logging.h"
+
+#include "teoccl/memory.h"
+
+#if defined(HAVE_KEYPOOL_THREAD)
+
+/**
+ * Pregenerated key pair
+ */
+typedef struct teoLNullKeyPair {
+    ECDHPvtkey pvtkey; ///< Private key
+    ECDHPubkey pubkey; ///< Public key
+} teoLNullKeyPair;
+
+/**
+ * Key pool shared by generating thread and connecting threads
+ */
+typedef struct teoLNullKeyPool {
+    pthread_mutex_t config_mutex; ///< Serializes resizing and stopping
+    pthread_mutex_t mutex; ///< Protects other fields
+    pthread_cond_t cond;   ///< Signaled when pool is not full or stopped
+    pthread_t thread;      ///< Generating thread
+    bool running;          ///< Generating thread is started
+    bool stop;             ///< Generating thread should exit
+    size_t depth;          ///< Number of key pairs to keep
+    size_t count;          ///< Number of key pairs in pool
+    teoLNullKeyPair *pairs; ///< Key pairs, @a depth elements
+} teoLNullKeyPool;
+
+static teoLNullKeyPool key_pool = {
+    .config_mutex = PTHREAD_MUTEX_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+/**
+ * Generate new ECDH key pair
+ *
+ * @param pair [out] Key pair
+ */
+static void _keyPoolGenerate(teoLNullKeyPair *pair) {
+    for (;;) {
+        randomize_bytes(pair->pvtkey.data, sizeof(pair->pvtkey.data));
+        if (ecdh_generate_keys(pair->pubkey.data, pair->pvtkey.data)) {
+            break;
+        }
+    }
+}
+
+/**
+ * Key pool generating thread
+ *
+ * @param arg Not used
+ *
+ * @return NULL
+ */
+static void *_keyPoolThread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&key_pool.mutex);
+    while (!key_pool.stop) {
+        if (key_pool.count >= key_pool.depth) {
+            pthread_cond_wait(&key_pool.cond, &key_pool.mutex);
+            continue;
+        }
+
+        // Generate without lock, pool can be resized meanwhile
+        pthread_mutex_unlock(&key_pool.mutex);
+        teoLNullKeyPair pair;
+        _keyPoolGenerate(&pair);
+        pthread_mutex_lock(&key_pool.mutex);
+
+        if (key_pool.count < key_pool.depth) {
+            key_pool.pairs[key_pool.count++] = pair;
+        }
+        zero_bytes((uint8_t *)&pair, sizeof(pair));
+    }
+    pthread_mutex_unlock(&key_pool.mutex);
+
+    return NULL;
+}
+
+/**
+ * Stop generating thread and wipe pooled keys
+ *
+ * Called with teoLNullKeyPool::config_mutex locked, so pool is not resized
+ * while thread is joined.
+ */
+static void _keyPoolStop(void) {
+    pthread_mutex_lock(&key_pool.mutex);
+    bool running = key_pool.running;
+    key_pool.stop = true;
+    pthread_cond_broadcast(&key_pool.cond);
+    pthread_mutex_unlock(&key_pool.mutex);
+
+    if (running) { pthread_join(key_pool.thread, NULL); }
+
+    pthread_mutex_lock(&key_pool.mutex);
+    if (key_pool.pairs != NULL) {
+        zero_bytes((uint8_t *)key_pool.pairs,
+                   key_pool.depth * sizeof(teoLNullKeyPair));
+        free(key_pool.pairs);
+    }
+    key_pool.pairs = NULL;
+    key_pool.depth = 0;
+    key_pool.count = 0;
+    key_pool.running = false;
+    key_pool.stop = false;
+    pthread_mutex_unlock(&key_pool.mutex);
+}
+
+void teoLNullKeyPoolSetDepth(size_t depth) {
+    pthread_mutex_lock(&key_pool.config_mutex);
+
+    if (depth == 0) {
+        _keyPoolStop();
+        pthread_mutex_unlock(&key_pool.config_mutex);
+        return;
+    }
+
+    teoLNullKeyPair *pairs =
+        (teoLNullKeyPair *)ccl_malloc(depth * sizeof(teoLNullKeyPair));
+    if (pairs == NULL) {
+        LTRACK_E("TeonetClient", "Failed to allocate key pool of %u pairs",
+                 (uint32_t)depth);
+        pthread_mutex_unlock(&key_pool.config_mutex);
+        return;
+    }
+
+    pthread_mutex_lock(&key_pool.mutex);
+
+    // Keep already generated pairs which fit new depth
+    size_t count = key_pool.count < depth ? key_pool.count : depth;
+    if (key_pool.pairs != NULL) {
+        memcpy(pairs, key_pool.pairs, count * sizeof(teoLNullKeyPair));
+        zero_bytes((uint8_t *)key_pool.pairs,
+                   key_pool.depth * sizeof(teoLNullKeyPair));
+        free(key_pool.pairs);
+    }
+    key_pool.pairs = pairs;
+    key_pool.depth = depth;
+    key_pool.count = count;
+
+    if (!key_pool.running) {
+        int rc = pthread_create(&key_pool.thread, NULL, _keyPoolThread, NULL);
+        if (rc == 0) {
+            key_pool.running = true;
+        } else {
+            LTRACK_E("TeonetClient", "Failed to start key pool thread");
+        }
+    }
+
+    pthread_cond_signal(&key_pool.cond);
+    pthread_mutex_unlock(&key_pool.mutex);
+    pthread_mutex_unlock(&key_pool.config_mutex);
+}
+
+bool teoLNullKeyPoolTake(ECDHPvtkey *pvtkey, ECDHPubkey *pubkey) {
+    pthread_mutex_lock(&key_pool.mutex);
+    if (key_pool.count == 0) {
+        pthread_mutex_unlock(&key_pool.mutex);
+        return false;
+    }
+
+    teoLNullKeyPair *pair = &key_pool.pairs[--key_pool.count];
+    *pvtkey = pair->pvtkey;
+    *pubkey = pair->pubkey;
+    zero_bytes((uint8_t *)pair, sizeof(*pair));
+
+    pthread_cond_signal(&key_pool.cond);
+    pthread_mutex_unlock(&key_pool.mutex);
+
+    return true;
+}
+
+#else
+
+void teoLNullKeyPoolSetDepth(size_t depth) {
+    if (depth != 0) {
+        LTRACK_I("TeonetClient", "Key pool is not supported on this platform");
+    }
+}
+
+bool teoLNullKeyPoolTake(ECDHPvtkey *pvtkey, ECDHPubkey *pubkey) {
+    (void)pvtkey;
+    (void)pubkey;
+    return false;
+}
+
+#endif
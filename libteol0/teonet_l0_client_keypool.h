@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_KEYPOOL_H
+#define TEONET_L0_CLIENT_KEYPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "libtinycrypt/tinycrypt.h"
+
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Pool of pregenerated ECDH key pairs
+/////////////////
+
+/**
+ * Set number of key pairs kept by pool
+ *
+ * Positive @a depth starts background thread generating key pairs until pool
+ * holds @a depth of them. Zero stops the thread and wipes pooled keys.
+ * Concurrent calls are applied one after another, pool keeps its depth if
+ * new one can't be allocated. Platforms without threads have no pool.
+ *
+ * @param depth Number of pooled key pairs
+ */
+TEOCLI_INTERNAL void teoLNullKeyPoolSetDepth(size_t depth);
+
+/**
+ * Take pregenerated key pair from pool without waiting
+ *
+ * @param pvtkey [out] Private key
+ * @param pubkey [out] Public key
+ *
+ * @return true if pool had key pair, false if it is empty or disabled
+ */
+TEOCLI_INTERNAL bool teoLNullKeyPoolTake(ECDHPvtkey *pvtkey,
+                                         ECDHPubkey *pubkey);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_KEYPOOL_H */
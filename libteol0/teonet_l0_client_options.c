@@ -5,6 +5,8 @@
 
 #include "teobase/logging.h"
 #include "teonet_l0_client_crypt.h"
+#include "teonet_l0_client_kex.h"
+#include "teonet_l0_client_keypool.h"
 
 extern bool teocliOpt_DBG_packetFlow;
 bool teocliOpt_DBG_packetFlow = false;
@@ -48,14 +50,108 @@ void teoLNUllSetOption_MaximumReceiveInSelect(int32_t maximum_messages) {
            teocliOpt_MaximumReceiveInSelect);
 }
 
+enum {
+    DEFAULT_UDP_RECEIVE_BATCH_SIZE = 32,
+    MAXIMUM_UDP_RECEIVE_BATCH_SIZE = 1024,
+};
+
+extern int32_t teocliOpt_UdpReceiveBatchSize;
+int32_t teocliOpt_UdpReceiveBatchSize = DEFAULT_UDP_RECEIVE_BATCH_SIZE;
+
+void teoLNUllSetOption_UdpReceiveBatchSize(int32_t batch_size) {
+    if (batch_size < 1) {
+        teocliOpt_UdpReceiveBatchSize = DEFAULT_UDP_RECEIVE_BATCH_SIZE;
+    } else if (batch_size > MAXIMUM_UDP_RECEIVE_BATCH_SIZE) {
+        teocliOpt_UdpReceiveBatchSize = MAXIMUM_UDP_RECEIVE_BATCH_SIZE;
+    } else {
+        teocliOpt_UdpReceiveBatchSize = batch_size;
+    }
+
+    LTRACK("TeonetClient", "Set UdpReceiveBatchSize = %d",
+           teocliOpt_UdpReceiveBatchSize);
+}
+
+extern int32_t teocliOpt_ReceiveTimeBudgetUs;
+int32_t teocliOpt_ReceiveTimeBudgetUs = 0;
+
+void teoLNUllSetOption_ReceiveTimeBudgetUs(int32_t budget_us) {
+    teocliOpt_ReceiveTimeBudgetUs = (budget_us > 0) ? budget_us : 0;
+
+    LTRACK("TeonetClient", "Set ReceiveTimeBudgetUs = %d us",
+           teocliOpt_ReceiveTimeBudgetUs);
+}
+
+extern bool teocliOpt_UdpSendBatch;
+bool teocliOpt_UdpSendBatch = false;
+
+void teoLNUllSetOption_UdpSendBatch(bool enable) {
+    teocliOpt_UdpSendBatch = enable;
+}
+
+extern bool teocliOpt_UdpSegmentOffload;
+bool teocliOpt_UdpSegmentOffload = false;
+
+void teoLNUllSetOption_UdpSegmentOffload(bool enable) {
+    teocliOpt_UdpSegmentOffload = enable;
+}
+
+enum {
+    DEFAULT_SEND_QUEUE_SIZE = 4096,
+};
+
+extern int32_t teocliOpt_SendQueueSize;
+int32_t teocliOpt_SendQueueSize = DEFAULT_SEND_QUEUE_SIZE;
+
+void teoLNUllSetOption_SendQueueSize(int32_t queue_size) {
+    teocliOpt_SendQueueSize =
+        (queue_size > 0) ? queue_size : DEFAULT_SEND_QUEUE_SIZE;
+
+    LTRACK("TeonetClient", "Set SendQueueSize = %d",
+           teocliOpt_SendQueueSize);
+}
+
+enum {
+    DEFAULT_RECEIVE_CHUNK_SIZE = 64 * 1024,
+    MINIMUM_RECEIVE_CHUNK_SIZE = 4096,
+};
+
+extern int32_t teocliOpt_ReceiveChunkSize;
+int32_t teocliOpt_ReceiveChunkSize = DEFAULT_RECEIVE_CHUNK_SIZE;
+
+void teoLNUllSetOption_ReceiveChunkSize(int32_t chunk_size) {
+    if (chunk_size <= 0) {
+        teocliOpt_ReceiveChunkSize = DEFAULT_RECEIVE_CHUNK_SIZE;
+    } else if (chunk_size < MINIMUM_RECEIVE_CHUNK_SIZE) {
+        teocliOpt_ReceiveChunkSize = MINIMUM_RECEIVE_CHUNK_SIZE;
+    } else {
+        teocliOpt_ReceiveChunkSize = chunk_size;
+    }
+
+    LTRACK("TeonetClient", "Set ReceiveChunkSize = %d",
+           teocliOpt_ReceiveChunkSize);
+}
+
+extern bool teocliOpt_ReceiveBatchEvent;
+bool teocliOpt_ReceiveBatchEvent = false;
+
+void teoLNUllSetOption_ReceiveBatchEvent(bool enable) {
+    teocliOpt_ReceiveBatchEvent = enable;
+}
+
+extern bool teocliOpt_IoUring;
+bool teocliOpt_IoUring = false;
+
+void teoLNUllSetOption_IoUring(bool enable) { teocliOpt_IoUring = enable; }
+
 extern teoLNullEncryptionProtocol teocliOpt_EncryptionProtocol;
 teoLNullEncryptionProtocol teocliOpt_EncryptionProtocol =
     ENC_PROTO_ECDH_AES_128_V1;
 
 void teoLNUllSetOption_EncryptionProtocol(int protocol) {
     switch (protocol) {
-    case ENC_PROTO_DISABLED: // fallthrough
-    case ENC_PROTO_ECDH_AES_128_V1:
+    case ENC_PROTO_DISABLED:        // fallthrough
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_AES_128_GCM_V2:
         teocliOpt_EncryptionProtocol = (teoLNullEncryptionProtocol)protocol;
         break;
 
@@ -80,3 +176,52 @@ void teoLNUllSetOption_ConnectTimeoutMs(int32_t timeout_ms) {
     LTRACK("TeonetClient", "Set ConnectTimeoutMs = %d ms",
            teocliOpt_ConnectTimeoutMs);
 }
+
+enum {
+    DEFAULT_CONNECT_STAGGER_MS = 250,
+};
+
+extern int32_t teocliOpt_ConnectStaggerMs;
+int32_t teocliOpt_ConnectStaggerMs = DEFAULT_CONNECT_STAGGER_MS;
+
+void teoLNUllSetOption_ConnectStaggerMs(int32_t stagger_ms) {
+    teocliOpt_ConnectStaggerMs =
+        (stagger_ms > 0) ? stagger_ms : DEFAULT_CONNECT_STAGGER_MS;
+
+    LTRACK("TeonetClient", "Set ConnectStaggerMs = %d ms",
+           teocliOpt_ConnectStaggerMs);
+}
+
+enum {
+    MAX_KEY_POOL_DEPTH = 1024,
+};
+
+extern int32_t teocliOpt_KeyPoolDepth;
+int32_t teocliOpt_KeyPoolDepth = 0;
+
+void teoLNUllSetOption_KeyPoolDepth(int32_t depth) {
+    if (depth < 0) { depth = 0; }
+    if (depth > MAX_KEY_POOL_DEPTH) { depth = MAX_KEY_POOL_DEPTH; }
+
+    teocliOpt_KeyPoolDepth = depth;
+    teoLNullKeyPoolSetDepth((size_t)depth);
+
+    LTRACK("TeonetClient", "Set KeyPoolDepth = %d", teocliOpt_KeyPoolDepth);
+}
+
+enum {
+    MAX_KEX_WORKERS = 64,
+};
+
+extern int32_t teocliOpt_KexWorkers;
+int32_t teocliOpt_KexWorkers = 0;
+
+void teoLNUllSetOption_KexWorkers(int32_t workers) {
+    if (workers < 0) { workers = 0; }
+    if (workers > MAX_KEX_WORKERS) { workers = MAX_KEX_WORKERS; }
+
+    teocliOpt_KexWorkers = workers;
+    teoLNullKexWorkersSetCount((size_t)workers);
+
+    LTRACK("TeonetClient", "Set KexWorkers = %d", teocliOpt_KexWorkers);
+}
@@ -54,20 +54,142 @@ TEOCLI_API void teoLNUllSetOption_PacketDataChecksumInR2(bool enable);
  */
 TEOCLI_API void teoLNUllSetOption_ConnectTimeoutMs(int32_t timeout_ms);
 
+/**
+ * Set delay between connect attempts of teoLNullConnectAny.
+ *
+ * @param stagger_ms should be positive integer, specifying time in
+ * milliseconds given to running attempt before next endpoint is tried in
+ * parallel. Default value is 250ms. If @a stagger_ms is zero or less then
+ * delay set to default 250ms instead.
+ */
+TEOCLI_API void teoLNUllSetOption_ConnectStaggerMs(int32_t stagger_ms);
+
+/**
+ * Set number of ECDH key pairs pregenerated for encrypted connections.
+ *
+ * @param depth should be non-negative integer. If positive, background thread
+ * keeps @a depth key pairs ready and connect takes keys from them instead of
+ * generating keys itself, keys are generated in place when pool is empty.
+ * Maximum is 1024. Zero (default) stops the thread and wipes pooled keys.
+ * Pool is stopped by teoLNullCleanup.
+ */
+TEOCLI_API void teoLNUllSetOption_KeyPoolDepth(int32_t depth);
+
+/**
+ * Set number of threads applying key exchange answers.
+ *
+ * @param workers should be non-negative integer. If positive, key exchange
+ * answer of teoLNullConnectAsync connection (ECDH shared secret and session
+ * key derivation) is applied by one of @a workers threads instead of event
+ * loop thread. Connection stays not connected and keeps packets sent
+ * meanwhile until worker finishes, then EV_L_CONNECTED event is sent and
+ * packets are encrypted and sent by event loop thread. Maximum is 64. Zero
+ * (default) applies answers in event loop thread. Workers are stopped by
+ * teoLNullCleanup.
+ */
+TEOCLI_API void teoLNUllSetOption_KexWorkers(int32_t workers);
+
 /**
  * Set maximum messages that can be received in one select loop.
  *
  * @param maximum_messages should be positive integer, specifying desirable
  * maximum amount of messages that can be received in one select loop
  * iteration. Default value is 1. If @a maximum_messages is zero or less
- * then amount set to default 1 instead.
+ * then amount set to default 1 instead. TR-UDP connections receive up to
+ * @a maximum_messages batches of datagrams, see
+ * teoLNUllSetOption_UdpReceiveBatchSize.
  */
 TEOCLI_API void teoLNUllSetOption_MaximumReceiveInSelect(int32_t maximum_messages);
 
+/**
+ * Set maximum datagrams received from TR-UDP socket by one system call.
+ *
+ * @param batch_size should be positive integer, specifying number of
+ * preallocated datagram buffers used by recvmmsg (datagrams are received one
+ * by one where recvmmsg is not available). Default value is 32, maximum is
+ * 1024. If @a batch_size is zero or less then size set to default 32 instead.
+ * Applied to connections created after the call.
+ */
+TEOCLI_API void teoLNUllSetOption_UdpReceiveBatchSize(int32_t batch_size);
+
+/**
+ * Enable adaptive receive in TR-UDP select loop.
+ *
+ * @param budget_us should be non-negative integer. If positive, select loop
+ * receives datagrams until socket is drained or @a budget_us microseconds
+ * are used up, MaximumReceiveInSelect is ignored. Zero disables adaptive
+ * receive, this is default.
+ */
+TEOCLI_API void teoLNUllSetOption_ReceiveTimeBudgetUs(int32_t budget_us);
+
+/**
+ * Send TR-UDP datagrams in batches.
+ *
+ * @param enable - boolean, if true - datagrams produced by one select loop
+ * iteration are collected and sent together by sendmmsg at the end of the
+ * iteration (one by one where sendmmsg is not available). Disabled by default.
+ */
+TEOCLI_API void teoLNUllSetOption_UdpSendBatch(bool enable);
+
+/**
+ * Use UDP generic segmentation offload for batched datagrams.
+ *
+ * @param enable - boolean, if true - equal sized batched datagrams to the same
+ * address are passed to kernel as one UDP_SEGMENT message. Takes effect with
+ * UdpSendBatch enabled on Linux 4.18 and newer, turned off for connection if
+ * kernel rejects it. Disabled by default.
+ */
+TEOCLI_API void teoLNUllSetOption_UdpSegmentOffload(bool enable);
+
+/**
+ * Set capacity of thread safe TR-UDP send queue.
+ *
+ * @param queue_size should be positive integer, specifying maximum amount of
+ * packets waiting to be sent by event loop thread. It is rounded up to power
+ * of two. Default value is 4096. If @a queue_size is zero or less then size
+ * set to default 4096 instead. Applied to connections created after the call.
+ */
+TEOCLI_API void teoLNUllSetOption_SendQueueSize(int32_t queue_size);
+
+/**
+ * Set size of data read from TCP socket by one receive call.
+ *
+ * @param chunk_size should be positive integer, specifying maximum amount of
+ * bytes read at once, all complete packets read are delivered together.
+ * Default value is 65536, 262144 suits bulk streams. If @a chunk_size is zero
+ * or less then size set to default 65536 instead, values less than 4096 are
+ * set to 4096.
+ */
+TEOCLI_API void teoLNUllSetOption_ReceiveChunkSize(int32_t chunk_size);
+
+/**
+ * Deliver received packets in EV_L_RECEIVED_BATCH events.
+ *
+ * @param enable - boolean, if true - all packets received by one event loop
+ * iteration are sent in EV_L_RECEIVED_BATCH events (up to 64 packets per
+ * event) instead of EV_L_RECEIVED event per packet. Disabled by default.
+ */
+TEOCLI_API void teoLNUllSetOption_ReceiveBatchEvent(bool enable);
+
+/**
+ * Use io_uring instead of select and socket system calls.
+ *
+ * Connection socket is received by multishot receive into kernel provided
+ * buffers and packets sent by one event loop iteration are submitted by one
+ * system call. teoLNullGetPollFds returns ring descriptor. TCP packets of
+ * such connection should be sent from its event loop thread. Connection
+ * falls back to select if kernel does not support io_uring features used.
+ * Linux only, disabled by default. Applied to connections created after the
+ * call.
+ */
+TEOCLI_API void teoLNUllSetOption_IoUring(bool enable);
+
 /**
  * Set encryption protocol used by connections
  * by default used ENC_PROTO_ECDH_AES_128_V1
  * to disable application should explicitly set it to ENC_PROTO_DISABLED
+ * ENC_PROTO_ECDH_AES_128_GCM_V2 authenticates packets, session falls back to
+ * ENC_PROTO_ECDH_AES_128_V1 if server does not support it
  *
  * @param protocol one of teoLNullEncryptionProtocol values
 */
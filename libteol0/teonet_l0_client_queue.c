@@ -0,0 +1,210 @@
+/**
+ * \file   teonet_l0_client_queue.c
+ *
+ * Bounded lock-free multi-producer/single-consumer queue used to pass packets
+ * from sending threads to TR-UDP event loop thread.
+ *
+ * Queue is a ring of slots with per slot sequence numbers. Producers reserve
+ * slot by CAS on enqueue position and publish it by storing sequence. Single
+ * consumer reads slots in order without atomic read-modify-write.
+ *
+ * Number of not consumed buffers is counted separately in pending counter.
+ * Producer which moves counter from zero to one raises doorbell, so consumer
+ * is woken up once per empty to non-empty transition.
+ */
+
+#include "teonet_l0_client_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "teobase/platform.h"
+
+#include "teoccl/memory.h"
+
+#if defined(TEONET_COMPILER_MSVC)
+#include <windows.h>
+
+typedef volatile LONG64 queue_atomic_t;
+
+#define atomicLoad(p) InterlockedCompareExchange64((p), 0, 0)
+#define atomicStore(p, v) InterlockedExchange64((p), (v))
+#define atomicFetchAdd(p, v) InterlockedExchangeAdd64((p), (v))
+#define cpuYield() SwitchToThread()
+
+static inline bool atomicCas(queue_atomic_t *p, int64_t *expected,
+                             int64_t desired) {
+    LONG64 previous = InterlockedCompareExchange64(p, desired, *expected);
+    if (previous == *expected) { return true; }
+
+    *expected = previous;
+    return false;
+}
+#else
+#include <sched.h>
+#include <stdatomic.h>
+
+typedef _Atomic int64_t queue_atomic_t;
+
+#define atomicLoad(p) atomic_load_explicit((p), memory_order_acquire)
+#define atomicStore(p, v) atomic_store_explicit((p), (v), memory_order_release)
+#define atomicCas(p, expected, desired)                                        \
+    atomic_compare_exchange_weak_explicit((p), (expected), (desired),         \
+                                          memory_order_relaxed,                \
+                                          memory_order_relaxed)
+#define atomicFetchAdd(p, v)                                                   \
+    atomic_fetch_add_explicit((p), (v), memory_order_acq_rel)
+#define cpuYield() sched_yield()
+#endif
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct teoLNullSendQueueSlot {
+    queue_atomic_t sequence; ///< Slot sequence, equal to position when free
+    char *data;              ///< Queued buffer
+    size_t data_length;      ///< Queued buffer length
+} teoLNullSendQueueSlot;
+
+struct teoLNullSendQueue {
+    teoLNullSendQueueSlot *slots; ///< Ring of slots
+    int64_t mask;                 ///< Number of slots minus one
+
+    char pad_0[CACHE_LINE_SIZE];
+    queue_atomic_t enqueue_position; ///< Next position to reserve by producer
+
+    char pad_1[CACHE_LINE_SIZE];
+    queue_atomic_t pending; ///< Pushed buffers not yet released by consumer
+
+    char pad_2[CACHE_LINE_SIZE];
+    int64_t dequeue_position; ///< Next position to read, consumer only
+};
+
+teoLNullSendQueue *teoLNullSendQueueCreate(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    teoLNullSendQueue *queue =
+        (teoLNullSendQueue *)ccl_malloc(sizeof(teoLNullSendQueue));
+    if (queue == NULL) { return NULL; }
+
+    queue->slots = (teoLNullSendQueueSlot *)ccl_malloc(
+        sizeof(teoLNullSendQueueSlot) * size);
+    if (queue->slots == NULL) {
+        free(queue);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        atomicStore(&queue->slots[i].sequence, (int64_t)i);
+        queue->slots[i].data = NULL;
+        queue->slots[i].data_length = 0;
+    }
+
+    queue->mask = (int64_t)size - 1;
+    atomicStore(&queue->enqueue_position, 0);
+    atomicStore(&queue->pending, 0);
+    queue->dequeue_position = 0;
+
+    return queue;
+}
+
+/**
+ * Take next published buffer from the queue
+ *
+ * @return true if buffer taken or false if next slot is not published yet
+ */
+static bool _teoLNullSendQueuePop(teoLNullSendQueue *queue, char **data,
+                                  size_t *data_length) {
+    const int64_t position = queue->dequeue_position;
+    teoLNullSendQueueSlot *slot = &queue->slots[position & queue->mask];
+
+    if (atomicLoad(&slot->sequence) != position + 1) { return false; }
+
+    *data = slot->data;
+    *data_length = slot->data_length;
+    slot->data = NULL;
+
+    // Free slot for producers which will come one lap later
+    atomicStore(&slot->sequence, position + queue->mask + 1);
+    queue->dequeue_position = position + 1;
+
+    return true;
+}
+
+void teoLNullSendQueueDestroy(teoLNullSendQueue *queue) {
+    if (queue == NULL) { return; }
+
+    char *data;
+    size_t data_length;
+    while (_teoLNullSendQueuePop(queue, &data, &data_length)) {
+        free(data);
+    }
+
+    free(queue->slots);
+    free(queue);
+}
+
+bool teoLNullSendQueuePush(teoLNullSendQueue *queue, char *data,
+                           size_t data_length, bool *raise_doorbell) {
+    int64_t position = atomicLoad(&queue->enqueue_position);
+    teoLNullSendQueueSlot *slot;
+
+    for (;;) {
+        slot = &queue->slots[position & queue->mask];
+        int64_t difference = atomicLoad(&slot->sequence) - position;
+
+        if (difference == 0) {
+            // Slot is free, try to reserve it, position is reloaded on failure
+            if (atomicCas(&queue->enqueue_position, &position, position + 1)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // Slot still holds buffer from previous lap - queue is full
+            return false;
+        } else {
+            // Other producer reserved this position
+            position = atomicLoad(&queue->enqueue_position);
+        }
+    }
+
+    slot->data = data;
+    slot->data_length = data_length;
+    atomicStore(&slot->sequence, position + 1);
+
+    // Count buffer only after it is published, so consumer which sees positive
+    // pending counter always finds published buffers
+    *raise_doorbell = (atomicFetchAdd(&queue->pending, 1) == 0);
+
+    return true;
+}
+
+size_t teoLNullSendQueueDrain(teoLNullSendQueue *queue, teoLNullSendQueueCb cb,
+                              void *user_data) {
+    size_t total = 0;
+
+    for (;;) {
+        int64_t count = 0;
+        char *data;
+        size_t data_length;
+
+        while (_teoLNullSendQueuePop(queue, &data, &data_length)) {
+            cb(data, data_length, user_data);
+            ++count;
+        }
+
+        total += (size_t)count;
+
+        // Stop when there are no counted buffers left. Producers which pushed
+        // after this point will find counter at zero and raise doorbell.
+        int64_t remaining = atomicFetchAdd(&queue->pending, -count) - count;
+        if (remaining <= 0) { break; }
+
+        // Counted buffer is placed after slot reserved by a producer which
+        // is still writing it
+        if (count == 0) { cpuYield(); }
+    }
+
+    return total;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_QUEUE_H
+#define TEONET_L0_CLIENT_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Bounded lock-free multi-producer/single-consumer send queue
+/////////////////
+
+// forward declaration, complete type in libteol0/teonet_l0_client_queue.c
+typedef struct teoLNullSendQueue teoLNullSendQueue;
+
+/**
+ * Send queue consumer callback
+ *
+ * @param data Queued buffer, callback takes ownership
+ * @param data_length Length of @a data
+ * @param user_data Pointer passed to teoLNullSendQueueDrain
+ */
+typedef void (*teoLNullSendQueueCb)(char *data, size_t data_length,
+                                    void *user_data);
+
+/**
+ * Create send queue
+ *
+ * @param capacity Maximum number of queued buffers, rounded up to power of two
+ *
+ * @return Pointer to created queue or NULL if failed
+ */
+TEOCLI_INTERNAL teoLNullSendQueue *teoLNullSendQueueCreate(size_t capacity);
+
+/**
+ * Destroy send queue and free all buffers left in it
+ *
+ * @param queue Queue to destroy, may be NULL
+ */
+TEOCLI_INTERNAL void teoLNullSendQueueDestroy(teoLNullSendQueue *queue);
+
+/**
+ * Add buffer to the queue. Can be called from any thread.
+ *
+ * @param queue Send queue
+ * @param data Buffer allocated with ccl_malloc, queue takes ownership on
+ *  success
+ * @param data_length Length of @a data
+ * @param raise_doorbell Set to true if queue was empty before this call and
+ *  consumer should be woken up
+ *
+ * @return true on success or false if queue is full
+ */
+TEOCLI_INTERNAL bool teoLNullSendQueuePush(teoLNullSendQueue *queue,
+                                           char *data, size_t data_length,
+                                           bool *raise_doorbell);
+
+/**
+ * Take all buffers from the queue. Must be called from one consumer thread.
+ *
+ * Returns when queue is empty and all producers which found queue not empty
+ * had their buffers consumed, so next push will raise doorbell again.
+ *
+ * @param queue Send queue
+ * @param cb Callback called for every buffer in order of push
+ * @param user_data Pointer passed to @a cb
+ *
+ * @return Number of buffers consumed
+ */
+TEOCLI_INTERNAL size_t teoLNullSendQueueDrain(teoLNullSendQueue *queue,
+                                              teoLNullSendQueueCb cb,
+                                              void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_QUEUE_H */
@@ -0,0 +1,442 @@
+/**
+ * \file   teonet_l0_client_race.c
+ *
+ * Racing connect to several L0 server endpoints.
+ *
+ * Endpoints are connected by teoLNullConnectAsync, next attempt starts when
+ * stagger interval of previous one expires or when all started attempts
+ * failed. Race does not block: it is driven by application event loop
+ * through teoLNullRaceGetPollFds, teoLNullRaceGetNextTimeoutUs and
+ * teoLNullRaceOn* functions, which pass descriptors and timers to
+ * teoLNullOn* functions of attempts. First attempt which completes its
+ * handshake wins and is handed over to application in its EV_L_CONNECTED
+ * event, other attempts are disconnected.
+ */
+
+#include "teonet_l0_client.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teobase/logging.h"
+#include "teobase/time.h"
+
+#include "teoccl/memory.h"
+
+// Maximum number of descriptors of one attempt: socket, send queue doorbell
+// and key exchange worker
+#define RACE_POLL_FDS 3
+
+extern int32_t teocliOpt_ConnectStaggerMs;
+
+/**
+ * Connect attempt to one endpoint
+ */
+typedef struct teoLNullRaceAttempt {
+    teoLNullRace *race;       ///< Race of attempt
+    teoLNullConnectData *con; ///< Connection, NULL if not started or freed
+    bool failed;              ///< Attempt got failed EV_L_CONNECTED
+    bool connected;           ///< Attempt got successful EV_L_CONNECTED
+} teoLNullRaceAttempt;
+
+struct teoLNullRace {
+    teoLNullEndpoint *endpoints;   ///< Copy of endpoints with server names
+    size_t endpoints_count;        ///< Number of endpoints
+    teoLNullRaceAttempt *attempts; ///< Attempt per endpoint
+    size_t started;                ///< Number of started attempts
+    uint64_t next_start;           ///< Time to start next attempt
+
+    teoLNullEventsCb event_cb; ///< Application event callback
+    void *user_data;           ///< Application user data
+
+    teoLNullRaceAttempt *result; ///< Attempt handed over to application
+    bool finished;               ///< Result is handed over
+    int dispatching;             ///< Race functions are running
+    bool destroyed;              ///< Destroyed while dispatching
+};
+
+/**
+ * Hand attempt connection over to application and send EV_L_CONNECTED to it
+ *
+ * Later events of connection, including data received together with
+ * handshake answer, go to application callback.
+ *
+ * @param race Race
+ * @param attempt Winner or last failed attempt
+ */
+static void _raceHandOver(teoLNullRace *race, teoLNullRaceAttempt *attempt) {
+    teoLNullConnectData *con = attempt->con;
+
+    race->result = attempt;
+    race->finished = true;
+
+    con->event_cb = race->event_cb;
+    con->user_data = race->user_data;
+    con->idle_at = 0;
+
+    // Attempt reset by server has not connected status
+    if (!attempt->connected && con->status >= 0) {
+        con->status = CON_STATUS_CONNECTION_ERROR;
+    }
+
+    if (race->event_cb != NULL) {
+        race->event_cb(con, EV_L_CONNECTED, &con->status, sizeof(con->status),
+                       race->user_data);
+    }
+}
+
+/**
+ * Event callback of attempts, events are not passed to application until
+ * attempt wins
+ *
+ * @param con Pointer to teoLNullConnectData of attempt
+ * @param event Event
+ * @param data Event data
+ * @param data_length Event data length
+ * @param user_data Pointer to teoLNullRaceAttempt
+ */
+static void _raceEventCb(void *con, teoLNullEvents event, void *data,
+                         size_t data_length, void *user_data) {
+    teoLNullRaceAttempt *attempt = (teoLNullRaceAttempt *)user_data;
+
+    // Event may come before teoLNullConnectAsync returned connection
+    if (attempt->con == NULL) { attempt->con = (teoLNullConnectData *)con; }
+
+    if (event == EV_L_CONNECTED &&
+        data_length == sizeof(teoLNullConnectionStatus)) {
+        if (*(teoLNullConnectionStatus *)data == CON_STATUS_CONNECTED) {
+            attempt->connected = true;
+            if (!attempt->race->finished) {
+                _raceHandOver(attempt->race, attempt);
+            }
+        } else {
+            attempt->failed = true;
+        }
+    } else if (event == EV_L_DISCONNECTED) {
+        attempt->failed = true;
+    }
+}
+
+/**
+ * Check if attempt is started and still connecting
+ *
+ * @param attempt Attempt
+ *
+ * @return true if attempt is running
+ */
+static inline bool _raceAttemptRunning(const teoLNullRaceAttempt *attempt) {
+    return attempt->con != NULL && !attempt->failed && !attempt->connected;
+}
+
+/**
+ * Disconnect attempts which are not handed over to application
+ *
+ * @param race Race
+ */
+static void _raceDisconnectLosers(teoLNullRace *race) {
+    for (size_t i = 0; i < race->started; ++i) {
+        teoLNullRaceAttempt *attempt = &race->attempts[i];
+        if (attempt == race->result || attempt->con == NULL) { continue; }
+
+        teoLNullDisconnect(attempt->con);
+        attempt->con = NULL;
+    }
+}
+
+/**
+ * Start attempts which are due and finish race when all attempts failed
+ *
+ * @param race Race
+ */
+static void _raceStep(teoLNullRace *race) {
+    while (!race->finished) {
+        size_t running = 0;
+        teoLNullRaceAttempt *last_failed = NULL;
+        for (size_t i = 0; i < race->started; ++i) {
+            if (race->attempts[i].failed) { last_failed = &race->attempts[i]; }
+            if (_raceAttemptRunning(&race->attempts[i])) { ++running; }
+        }
+
+        // Start next attempt after stagger or at once if all failed
+        const uint64_t now = teoGetTimestampFull();
+        if (race->started < race->endpoints_count &&
+            (running == 0 || now >= race->next_start)) {
+            const teoLNullEndpoint *endpoint =
+                &race->endpoints[race->started];
+            teoLNullRaceAttempt *attempt = &race->attempts[race->started++];
+
+            LTRACK_I("TeonetClient", "Connect attempt %u to %s:%d over %s",
+                     (unsigned)race->started, endpoint->server,
+                     (int)endpoint->port,
+                     endpoint->protocol == TCP ? "TCP" : "TR-UDP");
+
+            race->next_start =
+                now + (uint64_t)teocliOpt_ConnectStaggerMs * 1000;
+            attempt->con =
+                teoLNullConnectAsync(endpoint->server, endpoint->port,
+                                     _raceEventCb, attempt, endpoint->protocol);
+            continue;
+        }
+
+        // All attempts failed, last failed one is returned to application
+        if (running == 0 && last_failed != NULL) {
+            _raceHandOver(race, last_failed);
+        }
+        break;
+    }
+
+    if (race->finished) { _raceDisconnectLosers(race); }
+}
+
+/**
+ * Free race and its attempts but not connection handed over to application
+ *
+ * @param race Race
+ */
+static void _raceFree(teoLNullRace *race) {
+    _raceDisconnectLosers(race);
+
+    for (size_t i = 0; i < race->endpoints_count; ++i) {
+        free((char *)race->endpoints[i].server);
+    }
+    free(race->endpoints);
+    free(race->attempts);
+    free(race);
+}
+
+/**
+ * Leave race function, free race destroyed by application callback
+ *
+ * @param race Race
+ *
+ * @return true if race is running
+ */
+static bool _raceLeave(teoLNullRace *race) {
+    if (!race->destroyed) { _raceStep(race); }
+
+    if (--race->dispatching == 0 && race->destroyed) {
+        _raceFree(race);
+        return false;
+    }
+
+    return !race->finished;
+}
+
+/**
+ * Find running attempt watching descriptor
+ *
+ * @param race Race
+ * @param fd Descriptor returned by teoLNullRaceGetPollFds
+ *
+ * @return Attempt or NULL if descriptor is not watched by running attempt
+ */
+static teoLNullRaceAttempt *_raceFindAttempt(teoLNullRace *race,
+                                             teonetSocket fd) {
+    for (size_t i = 0; i < race->started; ++i) {
+        teoLNullRaceAttempt *attempt = &race->attempts[i];
+        if (!_raceAttemptRunning(attempt)) { continue; }
+
+        teoLNullPollFd poll_fds[RACE_POLL_FDS];
+        size_t n = teoLNullGetPollFds(attempt->con, poll_fds, RACE_POLL_FDS);
+        for (size_t j = 0; j < n && j < RACE_POLL_FDS; ++j) {
+            if (poll_fds[j].fd == fd) { return attempt; }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Start connect to first available endpoint without blocking
+ *
+ * Attempts are started in @a endpoints order with
+ * teoLNUllSetOption_ConnectStaggerMs delay and run in parallel, every attempt
+ * has its own teoLNUllSetOption_ConnectTimeoutMs. Race is driven by
+ * application event loop through teoLNullRaceGetPollFds,
+ * teoLNullRaceGetNextTimeoutUs and teoLNullRaceOn* functions. Events of
+ * attempts are not sent to @a event_cb. First attempt which completes its
+ * handshake sends EV_L_CONNECTED with its connection, from this event
+ * connection belongs to application and is driven by teoLNullGetPollFds and
+ * teoLNullOn* functions. If all attempts failed, last failed connection is
+ * sent with its failed status and should be disconnected by application.
+ *
+ * @param endpoints Endpoints to connect, in order of preference, copied
+ * @param endpoints_count Number of endpoints
+ * @param event_cb Pointer to event callback function
+ * @param user_data Pointer to user data which will be send to event callback
+ *
+ * @return Pointer to race which should be freed by teoLNullRaceDestroy or
+ *  NULL if @a endpoints_count is 0
+ */
+teoLNullRace *teoLNullConnectAny(const teoLNullEndpoint *endpoints,
+                                 size_t endpoints_count,
+                                 teoLNullEventsCb event_cb, void *user_data) {
+    if (endpoints_count == 0) { return NULL; }
+
+    teoLNullRace *race = (teoLNullRace *)ccl_malloc(sizeof(teoLNullRace));
+    memset(race, 0, sizeof(teoLNullRace));
+    race->endpoints_count = endpoints_count;
+    race->event_cb = event_cb;
+    race->user_data = user_data;
+
+    race->endpoints = (teoLNullEndpoint *)ccl_malloc(
+        endpoints_count * sizeof(teoLNullEndpoint));
+    race->attempts = (teoLNullRaceAttempt *)ccl_malloc(
+        endpoints_count * sizeof(teoLNullRaceAttempt));
+    memset(race->attempts, 0, endpoints_count * sizeof(teoLNullRaceAttempt));
+
+    for (size_t i = 0; i < endpoints_count; ++i) {
+        const size_t server_length = strlen(endpoints[i].server) + 1;
+        char *server = (char *)ccl_malloc(server_length);
+        memcpy(server, endpoints[i].server, server_length);
+
+        race->endpoints[i] = endpoints[i];
+        race->endpoints[i].server = server;
+        race->attempts[i].race = race;
+    }
+
+    // First attempt may fail or complete at once
+    ++race->dispatching;
+    _raceLeave(race);
+
+    return race;
+}
+
+/**
+ * Stop race and free it
+ *
+ * Running attempts are disconnected, connection handed over to application
+ * is not freed. Race may be destroyed from event callback.
+ *
+ * @param race Race to destroy, may be NULL
+ */
+void teoLNullRaceDestroy(teoLNullRace *race) {
+    if (race == NULL) { return; }
+
+    if (race->dispatching > 0) {
+        race->destroyed = true;
+        return;
+    }
+
+    _raceFree(race);
+}
+
+/**
+ * Get descriptors of running attempts to watch in application event loop
+ *
+ * Descriptors change while attempts connect, so they should be taken again
+ * after every teoLNullRaceOn* call.
+ *
+ * @param race Race
+ * @param fds Array to fill, may be NULL to get number of descriptors
+ * @param fds_length Length of @a fds array
+ *
+ * @return Number of descriptors, may be more than @a fds_length, 0 after race
+ *  is finished
+ */
+size_t teoLNullRaceGetPollFds(teoLNullRace *race, teoLNullPollFd *fds,
+                              size_t fds_length) {
+    size_t count = 0;
+    if (race->finished) { return count; }
+
+    for (size_t i = 0; i < race->started; ++i) {
+        teoLNullRaceAttempt *attempt = &race->attempts[i];
+        if (!_raceAttemptRunning(attempt)) { continue; }
+
+        teoLNullPollFd poll_fds[RACE_POLL_FDS];
+        size_t n = teoLNullGetPollFds(attempt->con, poll_fds, RACE_POLL_FDS);
+        for (size_t j = 0; j < n && j < RACE_POLL_FDS; ++j) {
+            if (fds != NULL && count < fds_length) { fds[count] = poll_fds[j]; }
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Get time to wait in application event loop before teoLNullRaceOnTimer call
+ *
+ * @param race Race
+ *
+ * @return Timeout in microseconds: time to start of next attempt or to
+ *  nearest timer of running attempts, 0 if teoLNullRaceOnTimer should be
+ *  called at once, UINT64_MAX after race is finished
+ */
+uint64_t teoLNullRaceGetNextTimeoutUs(teoLNullRace *race) {
+    uint64_t timeout_us = UINT64_MAX;
+    if (race->finished) { return timeout_us; }
+
+    if (race->started < race->endpoints_count) {
+        const uint64_t now = teoGetTimestampFull();
+        timeout_us = race->next_start > now ? race->next_start - now : 0;
+    }
+
+    for (size_t i = 0; i < race->started; ++i) {
+        teoLNullRaceAttempt *attempt = &race->attempts[i];
+        if (!_raceAttemptRunning(attempt)) { continue; }
+
+        uint64_t attempt_timeout = teoLNullGetNextTimeoutUs(attempt->con);
+        if (attempt_timeout < timeout_us) { timeout_us = attempt_timeout; }
+    }
+
+    return timeout_us;
+}
+
+/**
+ * Process readable descriptor of race without blocking
+ *
+ * @param race Race
+ * @param fd Readable descriptor returned by teoLNullRaceGetPollFds
+ *
+ * @return false if race is finished
+ */
+bool teoLNullRaceOnReadable(teoLNullRace *race, teonetSocket fd) {
+    ++race->dispatching;
+
+    // Errors are reported by processing of descriptor
+    teoLNullRaceAttempt *attempt = _raceFindAttempt(race, fd);
+    if (attempt != NULL) { teoLNullOnReadable(attempt->con, fd); }
+
+    return _raceLeave(race);
+}
+
+/**
+ * Process writable descriptor of race without blocking
+ *
+ * @param race Race
+ * @param fd Writable descriptor returned by teoLNullRaceGetPollFds
+ *
+ * @return false if race is finished
+ */
+bool teoLNullRaceOnWritable(teoLNullRace *race, teonetSocket fd) {
+    ++race->dispatching;
+
+    teoLNullRaceAttempt *attempt = _raceFindAttempt(race, fd);
+    if (attempt != NULL) { teoLNullOnWritable(attempt->con, fd); }
+
+    return _raceLeave(race);
+}
+
+/**
+ * Process race timers when teoLNullRaceGetNextTimeoutUs expires
+ *
+ * Starts next attempt after stagger interval and processes resends,
+ * deadlines and resolvers of running attempts. Early calls do nothing.
+ *
+ * @param race Race
+ *
+ * @return false if race is finished
+ */
+bool teoLNullRaceOnTimer(teoLNullRace *race) {
+    ++race->dispatching;
+
+    for (size_t i = 0; i < race->started && !race->finished; ++i) {
+        if (_raceAttemptRunning(&race->attempts[i])) {
+            teoLNullOnTimer(race->attempts[i].con);
+        }
+    }
+
+    return _raceLeave(race);
+}
@@ -0,0 +1,535 @@
+/**
+ * \file   teonet_l0_client_reactor.c
+ *
+ * Multi-connection reactor.
+ *
+ * Sockets of all registered connections, and send queue doorbells of TR-UDP
+ * connections, are watched by one level triggered epoll instance. Only
+ * connections returned by epoll_wait are processed, so work per wakeup does
+ * not depend on number of registered connections.
+ *
+ * TR-UDP resend and idle timers of all connections are kept in one timer
+ * wheel, reactor waits until socket input or the nearest timer.
+ */
+
+#include "teonet_l0_client_reactor.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teobase/platform.h"
+
+#if defined(TEONET_OS_LINUX) || defined(TEONET_OS_ANDROID)
+#include <sys/epoll.h>
+#include <unistd.h>
+#define HAVE_EPOLL 1
+#endif
+
+#include "teobase/logging.h"
+#include "teobase/time.h"
+
+#include "teoccl/memory.h"
+
+#include "teonet_l0_client_kex.h"
+#include "teonet_l0_client_timer.h"
+
+// Maximum number of socket events taken by one wait
+#define REACTOR_EVENTS_SIZE 256
+// Timer wheel resolution
+#define REACTOR_TIMER_TICK_US 1000
+// Connection without input during this interval gets EV_L_IDLE
+#define REACTOR_IDLE_INTERVAL_US 1000000
+// Maximum number of descriptors of one connection
+#define REACTOR_POLL_FDS 3
+// Tags of send queue doorbell, watched descriptor and key exchange worker in
+// event data, entries and watches are allocated by malloc and aligned
+#define REACTOR_DOORBELL_TAG ((uintptr_t)1)
+#define REACTOR_WATCH_TAG ((uintptr_t)2)
+#define REACTOR_KEX_TAG ((uintptr_t)4)
+#define REACTOR_TAG_MASK                                                       \
+    (REACTOR_DOORBELL_TAG | REACTOR_WATCH_TAG | REACTOR_KEX_TAG)
+
+struct teoLNullReactorEntry {
+    teoLNullReactor *reactor;   ///< Reactor of entry
+    teoLNullConnectData *con;   ///< Connection, NULL after removal
+    size_t index;               ///< Index in teoLNullReactor::entries
+    uint64_t last_input;        ///< Time of last connection input
+    teoLNullTimer resend_timer; ///< TR-UDP resend timer
+    teoLNullTimer idle_timer;   ///< Idle connection timer
+    struct teoLNullReactorEntry *next_removed; ///< Next removed entry
+};
+
+/**
+ * Descriptor watched by reactor owner
+ */
+typedef struct teoLNullReactorWatch {
+    teonetSocket fd;               ///< Watched descriptor
+    teoLNullReactorWatchCb cb;     ///< Callback called when fd is readable
+    void *user_data;               ///< Pointer passed to cb
+    struct teoLNullReactorWatch *next; ///< Next watch of reactor
+} teoLNullReactorWatch;
+
+struct teoLNullReactor {
+#if defined(HAVE_EPOLL)
+    int epoll_fd; ///< Epoll instance
+    struct epoll_event events[REACTOR_EVENTS_SIZE]; ///< Wait results
+#endif
+    teoLNullReactorEntry **entries; ///< Registered connections
+    size_t count;                   ///< Number of entries
+    size_t capacity;                ///< Allocated size of entries
+
+    teoLNullTimerWheel timers; ///< Timers of all connections
+
+    bool dispatching; ///< Entries are processed, removal is deferred
+    teoLNullReactorEntry *removed; ///< Entries removed during processing
+
+    teoLNullReactorWatch *watches; ///< Descriptors watched by reactor owner
+};
+
+#if defined(HAVE_EPOLL)
+
+teoLNullReactor *teoLNullReactorCreate(void) {
+    teoLNullReactor *reactor =
+        (teoLNullReactor *)ccl_malloc(sizeof(teoLNullReactor));
+    if (reactor == NULL) { return NULL; }
+
+    memset(reactor, 0, sizeof(teoLNullReactor));
+
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epoll_fd == -1) {
+        LTRACK_E("TeonetClient", "Failed to create epoll instance: %s",
+                 strerror(errno));
+        free(reactor);
+        return NULL;
+    }
+
+    teoLNullTimerWheelInit(&reactor->timers, REACTOR_TIMER_TICK_US,
+                           teoGetTimestampFull());
+
+    return reactor;
+}
+
+/**
+ * Remove entry from entries array and free it
+ *
+ * @param reactor Reactor
+ * @param entry Connection entry, removed from epoll already
+ */
+static void _reactorEntryFree(teoLNullReactor *reactor,
+                              teoLNullReactorEntry *entry) {
+    teoLNullReactorEntry *last = reactor->entries[--reactor->count];
+    reactor->entries[entry->index] = last;
+    last->index = entry->index;
+
+    free(entry);
+}
+
+/**
+ * Stop watching connection sockets and detach connection from entry
+ *
+ * Entry is freed at once or, during processing, after processing. Entry
+ * already detached by event callback is left as is.
+ *
+ * @param reactor Reactor
+ * @param entry Connection entry
+ */
+static void _reactorDetach(teoLNullReactor *reactor,
+                           teoLNullReactorEntry *entry) {
+    teoLNullConnectData *con = entry->con;
+    if (con == NULL) { return; }
+
+    teoLNullPollFd fds[REACTOR_POLL_FDS];
+    size_t count = teoLNullGetPollFds(con, fds, REACTOR_POLL_FDS);
+    for (size_t i = 0; i < count && i < REACTOR_POLL_FDS; ++i) {
+        epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fds[i].fd, NULL);
+    }
+
+    con->reactor = NULL;
+    con->reactor_entry = NULL;
+
+    entry->con = NULL;
+    teoLNullTimerStop(&reactor->timers, &entry->resend_timer);
+    teoLNullTimerStop(&reactor->timers, &entry->idle_timer);
+
+    if (reactor->dispatching) {
+        entry->next_removed = reactor->removed;
+        reactor->removed = entry;
+    } else {
+        _reactorEntryFree(reactor, entry);
+    }
+}
+
+void teoLNullReactorDestroy(teoLNullReactor *reactor) {
+    if (reactor == NULL) { return; }
+
+    while (reactor->count > 0) {
+        _reactorDetach(reactor, reactor->entries[reactor->count - 1]);
+    }
+
+    while (reactor->watches != NULL) {
+        teoLNullReactorWatch *watch = reactor->watches;
+        reactor->watches = watch->next;
+        free(watch);
+    }
+
+    close(reactor->epoll_fd);
+    free(reactor->entries);
+    free(reactor);
+}
+
+bool teoLNullReactorWatchFd(teoLNullReactor *reactor, teonetSocket fd,
+                            teoLNullReactorWatchCb cb, void *user_data) {
+    teoLNullReactorWatch *watch =
+        (teoLNullReactorWatch *)ccl_malloc(sizeof(teoLNullReactorWatch));
+    if (watch == NULL) { return false; }
+
+    watch->fd = fd;
+    watch->cb = cb;
+    watch->user_data = user_data;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = (void *)((uintptr_t)watch | REACTOR_WATCH_TAG);
+
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        LTRACK_E("TeonetClient", "Failed to add fd %d to reactor: %s",
+                 (int)fd, strerror(errno));
+        free(watch);
+        return false;
+    }
+
+    watch->next = reactor->watches;
+    reactor->watches = watch;
+
+    return true;
+}
+
+/**
+ * Start or stop TR-UDP resend timer of entry
+ *
+ * @param entry Connection entry
+ * @param timeout Time to next resend in microseconds or UINT32_MAX if there
+ *  is nothing to resend
+ */
+static void _reactorArmResend(teoLNullReactorEntry *entry, uint32_t timeout) {
+    teoLNullTimerWheel *timers = &entry->reactor->timers;
+
+    if (timeout == UINT32_MAX) {
+        teoLNullTimerStop(timers, &entry->resend_timer);
+    } else {
+        teoLNullTimerStart(timers, &entry->resend_timer,
+                           teoGetTimestampFull() + timeout);
+    }
+}
+
+/**
+ * TR-UDP resend timer callback
+ *
+ * @param timer Expired timer
+ * @param user_data Pointer to teoLNullReactorEntry
+ */
+static void _reactorResendTimer(teoLNullTimer *timer, void *user_data) {
+    teoLNullReactorEntry *entry = (teoLNullReactorEntry *)user_data;
+    teoLNullConnectData *con = entry->con;
+    (void)timer;
+
+    const uint32_t timeout = teoLNullProcessTimers(con);
+
+    // Event callback may remove the connection, its timers are stopped then
+    if (entry->con != con) { return; }
+
+    _reactorArmResend(entry, timeout);
+}
+
+/**
+ * Idle timer callback, sends EV_L_IDLE if connection had no input during
+ * idle interval
+ *
+ * @param timer Expired timer
+ * @param user_data Pointer to teoLNullReactorEntry
+ */
+static void _reactorIdleTimer(teoLNullTimer *timer, void *user_data) {
+    teoLNullReactorEntry *entry = (teoLNullReactorEntry *)user_data;
+    teoLNullReactor *reactor = entry->reactor;
+
+    // Input does not restart the timer, it is moved forward here
+    const uint64_t now = teoGetTimestampFull();
+    const uint64_t idle_at = entry->last_input + REACTOR_IDLE_INTERVAL_US;
+    if (idle_at > now) {
+        teoLNullTimerStart(&reactor->timers, timer, idle_at);
+        return;
+    }
+
+    teoLNullConnectData *con = entry->con;
+    const bool processed = teoLNullProcessIdle(con);
+
+    // Event callback may remove the connection, its timers are stopped then
+    if (entry->con != con) { return; }
+
+    if (!processed) {
+        _reactorDetach(reactor, entry);
+        return;
+    }
+
+    entry->last_input = now;
+    teoLNullTimerStart(&reactor->timers, timer,
+                       now + REACTOR_IDLE_INTERVAL_US);
+}
+
+bool teoLNullReactorAdd(teoLNullReactor *reactor, teoLNullConnectData *con) {
+    // Asynchronous connect should have its socket connected
+    if (con->reactor != NULL || con->fd < 0 ||
+        con->connect_state == CON_STATE_RESOLVING ||
+        con->connect_state == CON_STATE_CONNECTING) {
+        return false;
+    }
+
+    if (reactor->count == reactor->capacity) {
+        size_t capacity = reactor->capacity ? reactor->capacity * 2 : 64;
+        teoLNullReactorEntry **entries = (teoLNullReactorEntry **)ccl_realloc(
+            reactor->entries, capacity * sizeof(teoLNullReactorEntry *));
+        if (entries == NULL) { return false; }
+
+        reactor->entries = entries;
+        reactor->capacity = capacity;
+    }
+
+    teoLNullReactorEntry *entry =
+        (teoLNullReactorEntry *)ccl_malloc(sizeof(teoLNullReactorEntry));
+    if (entry == NULL) { return false; }
+
+    memset(entry, 0, sizeof(teoLNullReactorEntry));
+    entry->reactor = reactor;
+    entry->con = con;
+    entry->last_input = teoGetTimestampFull();
+    teoLNullTimerInit(&entry->resend_timer, _reactorResendTimer, entry);
+    teoLNullTimerInit(&entry->idle_timer, _reactorIdleTimer, entry);
+
+    // Connection socket, or io_uring descriptor, send queue doorbell and
+    // key exchange worker
+    teoLNullPollFd fds[REACTOR_POLL_FDS];
+    size_t count = teoLNullGetPollFds(con, fds, REACTOR_POLL_FDS);
+    if (count > REACTOR_POLL_FDS) { count = REACTOR_POLL_FDS; }
+
+    const teonetSocket kex_fd =
+        con->kex_job != NULL ? teoLNullKexJobFd(con->kex_job) : -1;
+    for (size_t i = 0; i < count; ++i) {
+        uintptr_t tag = 0;
+        if (fds[i].fd == kex_fd) {
+            tag = REACTOR_KEX_TAG;
+        } else if (i > 0) {
+            tag = REACTOR_DOORBELL_TAG;
+        }
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.ptr = (void *)((uintptr_t)entry | tag);
+
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fds[i].fd, &event) ==
+            -1) {
+            LTRACK_E("TeonetClient", "Failed to add fd %d to reactor: %s",
+                     (int)fds[i].fd, strerror(errno));
+            while (i-- > 0) {
+                epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fds[i].fd, NULL);
+            }
+            free(entry);
+            return false;
+        }
+    }
+
+    entry->index = reactor->count;
+    reactor->entries[reactor->count++] = entry;
+
+    con->reactor = reactor;
+    con->reactor_entry = entry;
+
+    teoLNullTimerStart(&reactor->timers, &entry->idle_timer,
+                       entry->last_input + REACTOR_IDLE_INTERVAL_US);
+
+    // Packets sent by connection handshake may wait for resend
+    _reactorArmResend(entry, teoLNullTimersTimeout(con));
+
+    return true;
+}
+
+void teoLNullReactorRemove(teoLNullReactor *reactor,
+                           teoLNullConnectData *con) {
+    if (con->reactor != reactor || con->reactor_entry == NULL) { return; }
+
+    _reactorDetach(reactor, con->reactor_entry);
+}
+
+void teoLNullReactorWatchKex(teoLNullReactor *reactor,
+                             teoLNullConnectData *con) {
+    if (con->reactor_entry == NULL || con->kex_job == NULL) { return; }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = (void *)((uintptr_t)con->reactor_entry | REACTOR_KEX_TAG);
+
+    // Idle timer takes worker result if descriptor can't be watched
+    teonetSocket fd = teoLNullKexJobFd(con->kex_job);
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        LTRACK_E("TeonetClient", "Failed to add fd %d to reactor: %s",
+                 (int)fd, strerror(errno));
+    }
+}
+
+void teoLNullReactorUnwatchKex(teoLNullReactor *reactor,
+                               teoLNullConnectData *con) {
+    if (con->kex_job == NULL) { return; }
+
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, teoLNullKexJobFd(con->kex_job),
+              NULL);
+}
+
+/**
+ * Calculate wait timeout limited by nearest timer
+ *
+ * @param reactor Reactor
+ * @param timeout Timeout requested by caller in ms, -1 for infinite
+ * @param now Current time
+ *
+ * @return Timeout in ms
+ */
+static int _reactorWaitTimeout(const teoLNullReactor *reactor, int timeout,
+                               uint64_t now) {
+    const uint64_t expires = teoLNullTimerWheelNextExpiry(&reactor->timers);
+    if (expires == UINT64_MAX) { return timeout; }
+    if (expires <= now) { return 0; }
+
+    uint64_t expires_ms = (expires - now + 999) / 1000;
+    if (timeout < 0 || expires_ms < (uint64_t)timeout) {
+        return (int)expires_ms;
+    }
+
+    return timeout;
+}
+
+int teoLNullReactorRun(teoLNullReactor *reactor, int timeout) {
+    uint64_t now = teoGetTimestampFull();
+
+    int ready = epoll_wait(reactor->epoll_fd, reactor->events,
+                           REACTOR_EVENTS_SIZE,
+                           _reactorWaitTimeout(reactor, timeout, now));
+    if (ready == -1) {
+        if (errno == EINTR) { return 0; }
+
+        LTRACK_E("TeonetClient", "epoll_wait failed with error %d: %s", errno,
+                 strerror(errno));
+        return -1;
+    }
+
+    reactor->dispatching = true;
+    now = teoGetTimestampFull();
+
+    for (int i = 0; i < ready; ++i) {
+        uintptr_t data = (uintptr_t)reactor->events[i].data.ptr;
+
+        if (data & REACTOR_WATCH_TAG) {
+            teoLNullReactorWatch *watch =
+                (teoLNullReactorWatch *)(data & ~REACTOR_TAG_MASK);
+            watch->cb(watch->user_data);
+            continue;
+        }
+
+        teoLNullReactorEntry *entry =
+            (teoLNullReactorEntry *)(data & ~REACTOR_TAG_MASK);
+
+        // Removed by previous event
+        teoLNullConnectData *con = entry->con;
+        if (con == NULL) { continue; }
+
+        teonetSocket fd = con->fd;
+        if (data & REACTOR_DOORBELL_TAG) {
+            fd = con->doorbell_fd[0];
+        } else if (data & REACTOR_KEX_TAG) {
+            // Job is released when its result is taken
+            if (con->kex_job == NULL) { continue; }
+            fd = teoLNullKexJobFd(con->kex_job);
+        }
+
+        entry->last_input = now;
+        const bool processed = teoLNullProcessReadable(con, fd);
+
+        // Event callback may remove the connection
+        if (entry->con != con) { continue; }
+
+        if (!processed) {
+            _reactorDetach(reactor, entry);
+            continue;
+        }
+
+        // Sent packets wait for acknowledge, connection is still registered
+        // here
+        if (!con->tcp_f) {
+            _reactorArmResend(entry, teoLNullTimersTimeout(con));
+        }
+    }
+
+    teoLNullTimerWheelAdvance(&reactor->timers, teoGetTimestampFull());
+
+    reactor->dispatching = false;
+
+    while (reactor->removed != NULL) {
+        teoLNullReactorEntry *entry = reactor->removed;
+        reactor->removed = entry->next_removed;
+        _reactorEntryFree(reactor, entry);
+    }
+
+    return ready;
+}
+
+#else
+
+teoLNullReactor *teoLNullReactorCreate(void) {
+    LTRACK_E("TeonetClient", "Reactor is not supported on this platform");
+    return NULL;
+}
+
+void teoLNullReactorDestroy(teoLNullReactor *reactor) { (void)reactor; }
+
+bool teoLNullReactorAdd(teoLNullReactor *reactor, teoLNullConnectData *con) {
+    (void)reactor;
+    (void)con;
+    return false;
+}
+
+void teoLNullReactorRemove(teoLNullReactor *reactor,
+                           teoLNullConnectData *con) {
+    (void)reactor;
+    (void)con;
+}
+
+void teoLNullReactorWatchKex(teoLNullReactor *reactor,
+                             teoLNullConnectData *con) {
+    (void)reactor;
+    (void)con;
+}
+
+void teoLNullReactorUnwatchKex(teoLNullReactor *reactor,
+                               teoLNullConnectData *con) {
+    (void)reactor;
+    (void)con;
+}
+
+bool teoLNullReactorWatchFd(teoLNullReactor *reactor, teonetSocket fd,
+                            teoLNullReactorWatchCb cb, void *user_data) {
+    (void)reactor;
+    (void)fd;
+    (void)cb;
+    (void)user_data;
+    return false;
+}
+
+int teoLNullReactorRun(teoLNullReactor *reactor, int timeout) {
+    (void)reactor;
+    (void)timeout;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,256 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_REACTOR_H
+#define TEONET_L0_CLIENT_REACTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teonet_l0_client.h"
+
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Multi-connection reactor
+/////////////////
+
+/**
+ * Create reactor
+ *
+ * Reactor waits for sockets of many TCP and TR-UDP connections on one epoll
+ * instance and processes only connections which have input, events are sent
+ * to connections teoLNullEventsCb callbacks. Connections are processed in
+ * thread which calls teoLNullReactorRun.
+ *
+ * @return Pointer to created reactor or NULL if failed or not supported on
+ *  this platform
+ */
+TEOCLI_API teoLNullReactor *teoLNullReactorCreate(void);
+
+/**
+ * Destroy reactor
+ *
+ * Registered connections are removed from reactor, but stay connected.
+ *
+ * @param reactor Reactor to destroy, may be NULL
+ */
+TEOCLI_API void teoLNullReactorDestroy(teoLNullReactor *reactor);
+
+/**
+ * Register connection in reactor
+ *
+ * Connection should not be used with teoLNullReadEventLoop after this call.
+ * teoLNullDisconnect removes connection from its reactor.
+ *
+ * @param reactor Reactor
+ * @param con Connected connection
+ *
+ * @return true on success or false if connection has no socket, waits for
+ *  resolver or TCP connect of teoLNullConnectAsync or already belongs to
+ *  reactor
+ */
+TEOCLI_API bool teoLNullReactorAdd(teoLNullReactor *reactor,
+                                   teoLNullConnectData *con);
+
+/**
+ * Remove connection from reactor
+ *
+ * May be called from event callback of any connection of this reactor.
+ *
+ * @param reactor Reactor
+ * @param con Connection registered in @a reactor
+ */
+TEOCLI_API void teoLNullReactorRemove(teoLNullReactor *reactor,
+                                      teoLNullConnectData *con);
+
+/**
+ * Wait for connections input during timeout and process ready connections
+ *
+ * Waits until connections input, nearest connection timer or timeout.
+ * Connections without input for a second get EV_L_IDLE event.
+ * Connections which got EV_L_DISCONNECTED are removed from reactor and may
+ * be freed by teoLNullDisconnect after this call returns. EV_L_TICK events
+ * are not sent.
+ *
+ * @param reactor Reactor
+ * @param timeout Timeout of wait in ms, -1 to wait for input or timers
+ *
+ * @return Number of processed socket events or -1 at error
+ */
+TEOCLI_API int teoLNullReactorRun(teoLNullReactor *reactor, int timeout);
+
+/////////////////
+// Sharded reactor threads
+/////////////////
+
+/**
+ * Create reactor threads
+ *
+ * Every thread runs its own reactor and owns connections added to it.
+ * Events of connection are sent from its owner thread.
+ *
+ * @param threads Number of threads, 0 to start thread per CPU
+ * @param pin_threads Pin every thread to its own CPU
+ *
+ * @return Pointer to created pool or NULL if failed or not supported on this
+ *  platform
+ */
+TEOCLI_API teoLNullReactorPool *teoLNullReactorPoolCreate(size_t threads,
+                                                          bool pin_threads);
+
+/**
+ * Stop reactor threads and destroy them
+ *
+ * Connections should be disconnected by teoLNullReactorPoolDisconnect
+ * before, connections left are removed from reactors but not freed.
+ *
+ * @param pool Pool to destroy, may be NULL
+ */
+TEOCLI_API void teoLNullReactorPoolDestroy(teoLNullReactorPool *pool);
+
+/**
+ * Pass connection to one of reactor threads
+ *
+ * Connection is owned by the thread until disconnected, it should be used
+ * by other threads only through teoLNullReactorPoolSend and
+ * teoLNullReactorPoolDisconnect.
+ *
+ * @param pool Reactor threads
+ * @param con Connected connection
+ * @param affinity_key Key to select thread by its hash, for example client
+ *  name, so the same key always gets the same thread. NULL to select threads
+ *  round-robin.
+ *
+ * @return true on success
+ */
+TEOCLI_API bool teoLNullReactorPoolAdd(teoLNullReactorPool *pool,
+                                       teoLNullConnectData *con,
+                                       const char *affinity_key);
+
+/**
+ * Send command to connection from any thread
+ *
+ * Packet is sent directly in connection owner thread, other threads pass it
+ * to owner thread through lock-free queue.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param cmd Command
+ * @param peer_name Peer name to send to
+ * @param data Pointer to data
+ * @param data_length Length of data
+ *
+ * @return Length of send or queued data or -1 at error
+ */
+TEOCLI_API ssize_t teoLNullReactorPoolSend(teoLNullConnectData *con,
+                                           uint8_t cmd, const char *peer_name,
+                                           const void *data,
+                                           size_t data_length);
+
+/**
+ * Disconnect and free connection from any thread
+ *
+ * Connection is freed by owner thread after packets queued before.
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+TEOCLI_API void teoLNullReactorPoolDisconnect(teoLNullConnectData *con);
+
+/**
+ * Watched descriptor callback
+ *
+ * @param user_data Pointer passed to teoLNullReactorWatchFd
+ */
+typedef void (*teoLNullReactorWatchCb)(void *user_data);
+
+/**
+ * Call callback from teoLNullReactorRun when descriptor is readable
+ *
+ * Watch stays until reactor is destroyed.
+ *
+ * @param reactor Reactor
+ * @param fd Descriptor to watch
+ * @param cb Callback
+ * @param user_data Pointer passed to @a cb
+ *
+ * @return true on success
+ */
+TEOCLI_INTERNAL bool teoLNullReactorWatchFd(teoLNullReactor *reactor,
+                                            teonetSocket fd,
+                                            teoLNullReactorWatchCb cb,
+                                            void *user_data);
+
+/**
+ * Watch key exchange worker descriptor of registered connection
+ *
+ * Worker descriptor is passed to teoLNullProcessReadable when worker
+ * finishes.
+ *
+ * @param reactor Reactor
+ * @param con Pointer to teoLNullConnectData with running key exchange job
+ */
+TEOCLI_INTERNAL void teoLNullReactorWatchKex(teoLNullReactor *reactor,
+                                             teoLNullConnectData *con);
+
+/**
+ * Stop watching key exchange worker descriptor before job is released
+ *
+ * @param reactor Reactor
+ * @param con Pointer to teoLNullConnectData with key exchange job
+ */
+TEOCLI_INTERNAL void teoLNullReactorUnwatchKex(teoLNullReactor *reactor,
+                                               teoLNullConnectData *con);
+
+/////////////////
+// Connection processing used by reactor
+/////////////////
+
+/**
+ * Process readable socket of connection without blocking
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param fd Readable socket: connection socket or send queue doorbell
+ *
+ * @return false if connection was closed
+ */
+TEOCLI_INTERNAL bool teoLNullProcessReadable(teoLNullConnectData *con,
+                                             teonetSocket fd);
+
+/**
+ * Resend TR-UDP packets which are due
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return Time to next resend in microseconds or UINT32_MAX if there is
+ *  nothing to resend
+ */
+TEOCLI_INTERNAL uint32_t teoLNullProcessTimers(teoLNullConnectData *con);
+
+/**
+ * Get time to next TR-UDP resend
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return Time to next resend in microseconds or UINT32_MAX if there is
+ *  nothing to resend
+ */
+TEOCLI_INTERNAL uint32_t teoLNullTimersTimeout(teoLNullConnectData *con);
+
+/**
+ * Send EV_L_IDLE event and keep TR-UDP connection alive
+ *
+ * @param con Pointer to teoLNullConnectData
+ *
+ * @return false if connection was closed
+ */
+TEOCLI_INTERNAL bool teoLNullProcessIdle(teoLNullConnectData *con);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_REACTOR_H */
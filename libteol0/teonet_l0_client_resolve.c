@@ -0,0 +1,220 @@
+/**
+ * \file   teonet_l0_client_resolve.c
+ *
+ * Asynchronous host name resolver used by teoLNullConnectAsync.
+ *
+ * getaddrinfo has no asynchronous variant, so host names are resolved by
+ * detached thread. Resolver is shared by the thread and the connection and
+ * freed by the last of them, so connection can be destroyed while thread is
+ * still waiting for DNS. Finished thread writes to a pipe watched by
+ * connection event loop.
+ */
+
+#include "teonet_l0_client_resolve.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teobase/platform.h"
+
+#if defined(TEONET_OS_WINDOWS)
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define HAVE_RESOLVER_THREAD 1
+#endif
+
+#include "teobase/logging.h"
+
+#include "teoccl/memory.h"
+
+/**
+ * Resolver data shared by connection and resolving thread
+ */
+struct teoLNullResolver {
+    struct sockaddr_in addr; ///< Resolved address
+    int result;              ///< 1 - resolved, 0 - in progress, -1 - failed
+#if defined(HAVE_RESOLVER_THREAD)
+    pthread_mutex_t mutex; ///< Protects result and refs
+    int refs;              ///< Number of owners: connection and thread
+    int pipe_fd[2];        ///< Finish notification pipe
+    uint16_t port;         ///< Server port
+    char host[];           ///< Server name
+#endif
+};
+
+/**
+ * Resolve host name to first IPv4 address by getaddrinfo
+ *
+ * @param host Server name
+ * @param port Server port
+ * @param addr Resolved address
+ *
+ * @return true on success
+ */
+static bool _resolverGetAddr(const char *host, uint16_t port,
+                             struct sockaddr_in *addr) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *info = NULL;
+    if (getaddrinfo(host, NULL, &hints, &info) != 0 || info == NULL) {
+        return false;
+    }
+
+    memcpy(addr, info->ai_addr, sizeof(*addr));
+    addr->sin_port = htons(port);
+    freeaddrinfo(info);
+
+    return true;
+}
+
+#if defined(HAVE_RESOLVER_THREAD)
+
+/**
+ * Drop one reference of resolver and free it if it was the last one
+ *
+ * @param resolver Resolver
+ */
+static void _resolverUnref(teoLNullResolver *resolver) {
+    pthread_mutex_lock(&resolver->mutex);
+    int refs = --resolver->refs;
+    pthread_mutex_unlock(&resolver->mutex);
+
+    if (refs > 0) { return; }
+
+    if (resolver->pipe_fd[0] != -1) { close(resolver->pipe_fd[0]); }
+    if (resolver->pipe_fd[1] != -1) { close(resolver->pipe_fd[1]); }
+    pthread_mutex_destroy(&resolver->mutex);
+    free(resolver);
+}
+
+/**
+ * Resolving thread
+ *
+ * @param arg Pointer to resolver
+ *
+ * @return NULL
+ */
+static void *_resolverThread(void *arg) {
+    teoLNullResolver *resolver = arg;
+
+    struct sockaddr_in addr;
+    int result =
+        _resolverGetAddr(resolver->host, resolver->port, &addr) ? 1 : -1;
+
+    pthread_mutex_lock(&resolver->mutex);
+    resolver->addr = addr;
+    resolver->result = result;
+    pthread_mutex_unlock(&resolver->mutex);
+
+    const char notify = 1;
+    if (write(resolver->pipe_fd[1], &notify, 1) != 1) {
+        LTRACK_E("TeonetClient", "Failed to notify resolver pipe");
+    }
+
+    _resolverUnref(resolver);
+    return NULL;
+}
+
+#endif
+
+teoLNullResolver *teoLNullResolverStart(const char *host, uint16_t port) {
+    const size_t host_length = strlen(host) + 1;
+    teoLNullResolver *resolver =
+        ccl_malloc(sizeof(teoLNullResolver) + host_length);
+    if (resolver == NULL) {
+        LTRACK_E("TeonetClient", "Failed to allocate resolver");
+        return NULL;
+    }
+    memset(resolver, 0, sizeof(teoLNullResolver));
+    resolver->addr.sin_family = AF_INET;
+    resolver->addr.sin_port = htons(port);
+
+    // Numeric address does not need DNS
+    if (inet_pton(AF_INET, host, &resolver->addr.sin_addr) == 1) {
+        resolver->result = 1;
+#if defined(HAVE_RESOLVER_THREAD)
+        resolver->refs = 1;
+        resolver->pipe_fd[0] = -1;
+        resolver->pipe_fd[1] = -1;
+        pthread_mutex_init(&resolver->mutex, NULL);
+#endif
+        return resolver;
+    }
+
+#if defined(HAVE_RESOLVER_THREAD)
+    resolver->refs = 2;
+    resolver->port = port;
+    memcpy(resolver->host, host, host_length);
+    pthread_mutex_init(&resolver->mutex, NULL);
+
+    if (pipe(resolver->pipe_fd) == -1) {
+        LTRACK_E("TeonetClient", "Failed to create resolver pipe");
+        pthread_mutex_destroy(&resolver->mutex);
+        free(resolver);
+        return NULL;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    pthread_t thread;
+    int rc = pthread_create(&thread, &attr, _resolverThread, resolver);
+    pthread_attr_destroy(&attr);
+
+    if (rc != 0) {
+        LTRACK_E("TeonetClient", "Failed to start resolver thread");
+        resolver->refs = 1;
+        _resolverUnref(resolver);
+        return NULL;
+    }
+#else
+    resolver->result =
+        _resolverGetAddr(host, port, &resolver->addr) ? 1 : -1;
+#endif
+
+    return resolver;
+}
+
+teonetSocket teoLNullResolverFd(const teoLNullResolver *resolver) {
+#if defined(HAVE_RESOLVER_THREAD)
+    if (resolver == NULL) { return -1; }
+    return resolver->pipe_fd[0];
+#else
+    (void)resolver;
+    return -1;
+#endif
+}
+
+int teoLNullResolverResult(teoLNullResolver *resolver,
+                           struct sockaddr_in *addr) {
+#if defined(HAVE_RESOLVER_THREAD)
+    pthread_mutex_lock(&resolver->mutex);
+#endif
+    int result = resolver->result;
+    if (result == 1) { *addr = resolver->addr; }
+#if defined(HAVE_RESOLVER_THREAD)
+    pthread_mutex_unlock(&resolver->mutex);
+#endif
+
+    return result;
+}
+
+void teoLNullResolverRelease(teoLNullResolver *resolver) {
+    if (resolver == NULL) { return; }
+
+#if defined(HAVE_RESOLVER_THREAD)
+    _resolverUnref(resolver);
+#else
+    free(resolver);
+#endif
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_RESOLVE_H
+#define TEONET_L0_CLIENT_RESOLVE_H
+
+#include <stdint.h>
+
+#include "teobase/socket.h"
+
+#include "teocli_api.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Asynchronous host name resolver
+/////////////////
+
+// forward declaration, complete type in libteol0/teonet_l0_client_resolve.c
+typedef struct teoLNullResolver teoLNullResolver;
+
+/**
+ * Start resolving server address
+ *
+ * Numeric addresses are resolved at once, host names are resolved by
+ * getaddrinfo in separate thread. Platforms without threads resolve
+ * synchronously.
+ *
+ * @param host Server IP or name
+ * @param port Server port
+ *
+ * @return Pointer to resolver or NULL if failed
+ */
+TEOCLI_INTERNAL teoLNullResolver *teoLNullResolverStart(const char *host,
+                                                        uint16_t port);
+
+/**
+ * Get descriptor which becomes readable when resolving is finished
+ *
+ * @param resolver Resolver, may be NULL
+ *
+ * @return Descriptor or -1 if result is ready or @a resolver is NULL
+ */
+TEOCLI_INTERNAL teonetSocket
+teoLNullResolverFd(const teoLNullResolver *resolver);
+
+/**
+ * Get resolving result without waiting
+ *
+ * @param resolver Resolver
+ * @param addr Resolved IPv4 address and port
+ *
+ * @return 1 if address is resolved, 0 if resolving is not finished or -1 if
+ *  host was not found
+ */
+TEOCLI_INTERNAL int teoLNullResolverResult(teoLNullResolver *resolver,
+                                           struct sockaddr_in *addr);
+
+/**
+ * Release resolver, not finished resolving thread frees it when done
+ *
+ * @param resolver Resolver, may be NULL
+ */
+TEOCLI_INTERNAL void teoLNullResolverRelease(teoLNullResolver *resolver);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_RESOLVE_H */
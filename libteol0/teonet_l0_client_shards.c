@@ -0,0 +1,480 @@
+/**
+ * \file   teonet_l0_client_shards.c
+ *
+ * Sharded reactor threads.
+ *
+ * Every shard is a thread running its own teoLNullReactor, connections are
+ * owned by exactly one shard and processed only by its thread. Other threads
+ * pass commands (register, send, disconnect) to the owning shard through its
+ * lock-free send queue, the queue doorbell is watched by shard reactor.
+ *
+ * Consecutive queued packets of one connection are sent by one
+ * teoLNullSendBatch, so a shard woken once for many packets makes one system
+ * call per connection instead of one per packet.
+ */
+
+// pthread_setaffinity_np is GNU extension
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "teonet_l0_client_reactor.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teobase/platform.h"
+
+#include "teonet_l0_client_crypt.h"
+#include "teonet_l0_client_queue.h"
+
+#if defined(TEONET_OS_LINUX) || defined(TEONET_OS_ANDROID)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#define HAVE_SHARDS 1
+#endif
+
+#include "teobase/logging.h"
+
+#include "teoccl/memory.h"
+
+// Reactor wait timeout of shard thread, ms
+#define SHARD_WAIT_TIMEOUT 100
+// Maximum number of queued packets sent by one teoLNullSendBatch
+#define SHARD_BATCH_SIZE 64
+
+extern int32_t teocliOpt_SendQueueSize;
+
+#if defined(HAVE_SHARDS)
+
+/**
+ * Shard command types
+ */
+typedef enum teoLNullShardCommandType {
+    SHARD_ADD,        ///< Register connection in shard reactor
+    SHARD_SEND,       ///< Send packet to connection
+    SHARD_DISCONNECT, ///< Disconnect and free connection
+    SHARD_STOP,       ///< Stop shard thread
+} teoLNullShardCommandType;
+
+/**
+ * Command passed to shard thread, packet data follows the header
+ */
+typedef struct teoLNullShardCommand {
+    teoLNullShardCommandType type;
+    teoLNullConnectData *con;
+    uint8_t cmd;             ///< Packet command
+    size_t peer_name_length; ///< Peer name length with trailing zero
+    size_t data_length;      ///< Packet data length
+    char payload[];          ///< Peer name, then packet data
+} teoLNullShardCommand;
+
+struct teoLNullShard {
+    teoLNullReactorPool *pool;
+    teoLNullReactor *reactor;      ///< Reactor of this shard
+    teoLNullSendQueue *commands;   ///< Commands from other threads
+    int doorbell;                  ///< Commands queue eventfd
+    pthread_t thread;              ///< Shard thread
+    bool started;                  ///< Thread was created
+    bool running;                  ///< Cleared by SHARD_STOP
+    int cpu;                       ///< CPU to pin thread to or -1
+    teoLNullShardCommand *batch[SHARD_BATCH_SIZE]; ///< Queued SHARD_SEND
+                                                   ///< commands of one
+                                                   ///< connection
+    size_t batch_count;            ///< Number of commands in batch
+};
+
+struct teoLNullReactorPool {
+    teoLNullShard *shards;
+    size_t count;
+    size_t next; ///< Next shard for round-robin placement
+};
+
+/**
+ * Send command to shard thread
+ *
+ * @param shard Shard
+ * @param command Command allocated with ccl_malloc, shard takes ownership
+ * @param length Command length
+ */
+static void _shardPost(teoLNullShard *shard, teoLNullShardCommand *command,
+                       size_t length) {
+    bool raise_doorbell = false;
+
+    while (!teoLNullSendQueuePush(shard->commands, (char *)command, length,
+                                  &raise_doorbell)) {
+        sched_yield();
+    }
+
+    if (raise_doorbell) {
+        uint64_t value = 1;
+        if (write(shard->doorbell, &value, sizeof(value)) == -1 &&
+            errno != EAGAIN) {
+            LTRACK_E("TeonetClient", "Failed to raise shard doorbell: %s",
+                     strerror(errno));
+        }
+    }
+}
+
+/**
+ * Create command without packet data
+ */
+static teoLNullShardCommand *_shardCommand(teoLNullShardCommandType type,
+                                           teoLNullConnectData *con) {
+    teoLNullShardCommand *command =
+        (teoLNullShardCommand *)ccl_malloc(sizeof(teoLNullShardCommand));
+    if (command == NULL) { return NULL; }
+
+    memset(command, 0, sizeof(teoLNullShardCommand));
+    command->type = type;
+    command->con = con;
+
+    return command;
+}
+
+/**
+ * Send batched packets and free their commands
+ *
+ * @param shard Shard
+ */
+static void _shardFlush(teoLNullShard *shard) {
+    const size_t count = shard->batch_count;
+    if (count == 0) { return; }
+
+    teoLNullConnectData *con = shard->batch[0]->con;
+    const size_t overhead = teoLNullEncryptionOverhead(con->client_crypt);
+    teoLNullSendItem items[SHARD_BATCH_SIZE];
+    size_t valid = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const teoLNullShardCommand *command = shard->batch[i];
+        const char *peer_name = command->payload;
+        const uint8_t *data =
+            (const uint8_t *)command->payload + command->peer_name_length;
+
+        // Batch sends nothing if any packet is too long, such packets are
+        // rejected and logged by teoLNullSend
+        if (command->peer_name_length > UINT8_MAX ||
+            command->data_length + overhead > UINT16_MAX) {
+            teoLNullSend(con, command->cmd, peer_name, data,
+                         command->data_length);
+            continue;
+        }
+
+        items[valid].cmd = command->cmd;
+        items[valid].peer_name = peer_name;
+        items[valid].data = data;
+        items[valid].data_length = command->data_length;
+        ++valid;
+    }
+
+    if (valid == 1) {
+        teoLNullSend(con, items[0].cmd, items[0].peer_name, items[0].data,
+                     items[0].data_length);
+    } else if (valid > 1) {
+        teoLNullSendBatch(con, items, valid);
+    }
+
+    for (size_t i = 0; i < count; ++i) { free(shard->batch[i]); }
+    shard->batch_count = 0;
+}
+
+/**
+ * Execute command in shard thread
+ *
+ * @param data teoLNullShardCommand, freed after execution
+ * @param data_length Command length
+ * @param user_data Pointer to teoLNullShard
+ */
+static void _shardExecute(char *data, size_t data_length, void *user_data) {
+    teoLNullShard *shard = (teoLNullShard *)user_data;
+    teoLNullShardCommand *command = (teoLNullShardCommand *)data;
+    (void)data_length;
+
+    // Batched packets are sent before other commands to keep order
+    if (command->type != SHARD_SEND) { _shardFlush(shard); }
+
+    switch (command->type) {
+    case SHARD_ADD:
+        if (!teoLNullReactorAdd(shard->reactor, command->con)) {
+            LTRACK_E("TeonetClient", "Failed to add connection to shard");
+        }
+        break;
+
+    case SHARD_SEND:
+        if (shard->batch_count == SHARD_BATCH_SIZE ||
+            (shard->batch_count > 0 &&
+             shard->batch[0]->con != command->con)) {
+            _shardFlush(shard);
+        }
+        // Command is freed by _shardFlush
+        shard->batch[shard->batch_count++] = command;
+        return;
+
+    case SHARD_DISCONNECT: teoLNullDisconnect(command->con); break;
+
+    case SHARD_STOP: shard->running = false; break;
+    }
+
+    free(command);
+}
+
+/**
+ * Shard doorbell callback, executes queued commands
+ *
+ * @param user_data Pointer to teoLNullShard
+ */
+static void _shardDoorbell(void *user_data) {
+    teoLNullShard *shard = (teoLNullShard *)user_data;
+
+    uint64_t value;
+    if (read(shard->doorbell, &value, sizeof(value)) == -1 &&
+        errno != EAGAIN) {
+        LTRACK_E("TeonetClient", "Failed to reset shard doorbell: %s",
+                 strerror(errno));
+    }
+
+    teoLNullSendQueueDrain(shard->commands, _shardExecute, shard);
+    _shardFlush(shard);
+}
+
+/**
+ * Shard thread function
+ *
+ * @param arg Pointer to teoLNullShard
+ */
+static void *_shardThread(void *arg) {
+    teoLNullShard *shard = (teoLNullShard *)arg;
+
+    if (shard->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(shard->cpu, &cpus);
+
+        int result =
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result != 0) {
+            LTRACK_E("TeonetClient", "Failed to pin shard to CPU %d: %s",
+                     shard->cpu, strerror(result));
+        }
+    }
+
+    while (shard->running) {
+        if (teoLNullReactorRun(shard->reactor, SHARD_WAIT_TIMEOUT) == -1) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Free shard resources, thread should be stopped
+ */
+static void _shardFree(teoLNullShard *shard) {
+    teoLNullReactorDestroy(shard->reactor);
+    teoLNullSendQueueDestroy(shard->commands);
+    if (shard->doorbell != -1) { close(shard->doorbell); }
+}
+
+teoLNullReactorPool *teoLNullReactorPoolCreate(size_t threads,
+                                               bool pin_threads) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) { cpus = 1; }
+    if (threads == 0) { threads = (size_t)cpus; }
+
+    teoLNullReactorPool *pool =
+        (teoLNullReactorPool *)ccl_malloc(sizeof(teoLNullReactorPool));
+    if (pool == NULL) { return NULL; }
+
+    pool->shards =
+        (teoLNullShard *)ccl_malloc(threads * sizeof(teoLNullShard));
+    if (pool->shards == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    memset(pool->shards, 0, threads * sizeof(teoLNullShard));
+    pool->count = 0;
+    pool->next = 0;
+
+    for (size_t i = 0; i < threads; ++i) {
+        teoLNullShard *shard = &pool->shards[i];
+        shard->pool = pool;
+        shard->cpu = pin_threads ? (int)(i % (size_t)cpus) : -1;
+        shard->running = true;
+        shard->reactor = teoLNullReactorCreate();
+        shard->commands = teoLNullSendQueueCreate(teocliOpt_SendQueueSize);
+        shard->doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        ++pool->count;
+
+        if (shard->reactor == NULL || shard->commands == NULL ||
+            shard->doorbell == -1 ||
+            !teoLNullReactorWatchFd(shard->reactor, shard->doorbell,
+                                    _shardDoorbell, shard)) {
+            LTRACK_E("TeonetClient", "Failed to create shard %u",
+                     (uint32_t)i);
+            teoLNullReactorPoolDestroy(pool);
+            return NULL;
+        }
+
+        if (pthread_create(&shard->thread, NULL, _shardThread, shard) != 0) {
+            LTRACK_E("TeonetClient", "Failed to start shard %u thread",
+                     (uint32_t)i);
+            teoLNullReactorPoolDestroy(pool);
+            return NULL;
+        }
+        shard->started = true;
+    }
+
+    return pool;
+}
+
+void teoLNullReactorPoolDestroy(teoLNullReactorPool *pool) {
+    if (pool == NULL) { return; }
+
+    for (size_t i = 0; i < pool->count; ++i) {
+        teoLNullShard *shard = &pool->shards[i];
+        if (!shard->started) { continue; }
+
+        teoLNullShardCommand *command = _shardCommand(SHARD_STOP, NULL);
+        while (command == NULL) {
+            sched_yield();
+            command = _shardCommand(SHARD_STOP, NULL);
+        }
+        _shardPost(shard, command, sizeof(teoLNullShardCommand));
+    }
+
+    for (size_t i = 0; i < pool->count; ++i) {
+        teoLNullShard *shard = &pool->shards[i];
+        if (shard->started) { pthread_join(shard->thread, NULL); }
+        _shardFree(shard);
+    }
+
+    free(pool->shards);
+    free(pool);
+}
+
+/**
+ * Hash connection affinity key
+ */
+static uint32_t _shardKeyHash(const char *key) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (; *key; ++key) {
+        hash ^= (uint8_t)*key;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+bool teoLNullReactorPoolAdd(teoLNullReactorPool *pool,
+                            teoLNullConnectData *con,
+                            const char *affinity_key) {
+    if (con->shard != NULL || con->reactor != NULL || con->fd < 0) {
+        return false;
+    }
+
+    size_t index;
+    if (affinity_key != NULL) {
+        index = _shardKeyHash(affinity_key) % pool->count;
+    } else {
+        index = pool->next++ % pool->count;
+    }
+
+    teoLNullShardCommand *command = _shardCommand(SHARD_ADD, con);
+    if (command == NULL) { return false; }
+
+    con->shard = &pool->shards[index];
+    _shardPost(con->shard, command, sizeof(teoLNullShardCommand));
+
+    return true;
+}
+
+/**
+ * Check if current thread is connection shard thread
+ */
+static bool _shardIsOwner(const teoLNullConnectData *con) {
+    return pthread_equal(con->shard->thread, pthread_self());
+}
+
+ssize_t teoLNullReactorPoolSend(teoLNullConnectData *con, uint8_t cmd,
+                                const char *peer_name, const void *data,
+                                size_t data_length) {
+    if (con->shard == NULL || _shardIsOwner(con)) {
+        return teoLNullSend(con, cmd, peer_name, data, data_length);
+    }
+
+    const size_t peer_name_length = strlen(peer_name) + 1;
+    const size_t length =
+        sizeof(teoLNullShardCommand) + peer_name_length + data_length;
+
+    teoLNullShardCommand *command = (teoLNullShardCommand *)ccl_malloc(length);
+    if (command == NULL) { return -1; }
+
+    command->type = SHARD_SEND;
+    command->con = con;
+    command->cmd = cmd;
+    command->peer_name_length = peer_name_length;
+    command->data_length = data_length;
+    memcpy(command->payload, peer_name, peer_name_length);
+    if (data_length) {
+        memcpy(command->payload + peer_name_length, data, data_length);
+    }
+
+    _shardPost(con->shard, command, length);
+
+    return (ssize_t)data_length;
+}
+
+void teoLNullReactorPoolDisconnect(teoLNullConnectData *con) {
+    if (con->shard == NULL || _shardIsOwner(con)) {
+        teoLNullDisconnect(con);
+        return;
+    }
+
+    teoLNullShardCommand *command = _shardCommand(SHARD_DISCONNECT, con);
+    while (command == NULL) {
+        sched_yield();
+        command = _shardCommand(SHARD_DISCONNECT, con);
+    }
+
+    _shardPost(con->shard, command, sizeof(teoLNullShardCommand));
+}
+
+#else
+
+teoLNullReactorPool *teoLNullReactorPoolCreate(size_t threads,
+                                               bool pin_threads) {
+    (void)threads;
+    (void)pin_threads;
+
+    LTRACK_E("TeonetClient", "Reactor is not supported on this platform");
+    return NULL;
+}
+
+void teoLNullReactorPoolDestroy(teoLNullReactorPool *pool) { (void)pool; }
+
+bool teoLNullReactorPoolAdd(teoLNullReactorPool *pool,
+                            teoLNullConnectData *con,
+                            const char *affinity_key) {
+    (void)pool;
+    (void)con;
+    (void)affinity_key;
+    return false;
+}
+
+ssize_t teoLNullReactorPoolSend(teoLNullConnectData *con, uint8_t cmd,
+                                const char *peer_name, const void *data,
+                                size_t data_length) {
+    return teoLNullSend(con, cmd, peer_name, data, data_length);
+}
+
+void teoLNullReactorPoolDisconnect(teoLNullConnectData *con) {
+    teoLNullDisconnect(con);
+}
+
+#endif
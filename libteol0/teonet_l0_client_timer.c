@@ -0,0 +1,266 @@
+/**
+ * \file   teonet_l0_client_timer.c
+ *
+ * Hierarchical timer wheel.
+ *
+ * Timer is placed to level by distance to its expire tick and to slot by
+ * expire tick bits of this level, so start and stop are O(1). Every level
+ * has bit mask of non empty slots, so wheel jumps directly to the next tick
+ * which has timers to expire or to move down instead of visiting every tick.
+ * Every timer is moved down at most TIMER_WHEEL_LEVELS - 1 times.
+ */
+
+#include "teonet_l0_client_timer.h"
+
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_SHIFT(level) ((level)*TIMER_WHEEL_SLOT_BITS)
+// Timer is not in wheel slot
+#define LEVEL_NONE TIMER_WHEEL_LEVELS
+// Maximum distance to expire tick, farther timers are moved down repeatedly
+#define MAX_DELTA                                                              \
+    ((UINT64_C(1) << LEVEL_SHIFT(TIMER_WHEEL_LEVELS)) - 1)
+
+/**
+ * Number of trailing zero bits of non zero value
+ */
+static inline unsigned _countTrailingZeros(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctzll(value);
+#endif
+}
+
+static inline void _listInit(teoLNullTimer *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static inline bool _listEmpty(const teoLNullTimer *head) {
+    return head->next == head;
+}
+
+static inline void _listAppend(teoLNullTimer *head, teoLNullTimer *timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+static inline void _listUnlink(teoLNullTimer *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer;
+    timer->prev = timer;
+}
+
+/**
+ * Move all timers of slot to empty list, timers are marked as out of slot
+ */
+static void _slotTake(teoLNullTimerWheel *wheel, unsigned level,
+                      unsigned slot, teoLNullTimer *list) {
+    teoLNullTimer *head = &wheel->slots[level][slot];
+
+    _listInit(list);
+    if (_listEmpty(head)) { return; }
+
+    list->next = head->next;
+    list->prev = head->prev;
+    list->next->prev = list;
+    list->prev->next = list;
+    _listInit(head);
+    wheel->occupied[level] &= ~(UINT64_C(1) << slot);
+
+    for (teoLNullTimer *timer = list->next; timer != list;
+         timer = timer->next) {
+        timer->level = LEVEL_NONE;
+    }
+}
+
+/**
+ * Remove timer from its slot or list
+ */
+static void _timerUnlink(teoLNullTimerWheel *wheel, teoLNullTimer *timer) {
+    _listUnlink(timer);
+
+    if (timer->level != LEVEL_NONE &&
+        _listEmpty(&wheel->slots[timer->level][timer->slot])) {
+        wheel->occupied[timer->level] &= ~(UINT64_C(1) << timer->slot);
+    }
+
+    timer->level = LEVEL_NONE;
+}
+
+/**
+ * Put timer to slot by distance from current tick to its expire tick
+ */
+static void _timerInsert(teoLNullTimerWheel *wheel, teoLNullTimer *timer) {
+    uint64_t tick = timer->expires_tick;
+    if (tick < wheel->now_tick) { tick = wheel->now_tick; }
+    if (tick - wheel->now_tick > MAX_DELTA) {
+        tick = wheel->now_tick + MAX_DELTA;
+    }
+
+    const uint64_t delta = tick - wheel->now_tick;
+
+    unsigned level = 0;
+    while (level + 1 < TIMER_WHEEL_LEVELS &&
+           delta >= (UINT64_C(1) << LEVEL_SHIFT(level + 1))) {
+        ++level;
+    }
+
+    const unsigned slot = (unsigned)(tick >> LEVEL_SHIFT(level)) & SLOT_MASK;
+
+    timer->level = (uint8_t)level;
+    timer->slot = (uint8_t)slot;
+    _listAppend(&wheel->slots[level][slot], timer);
+    wheel->occupied[level] |= UINT64_C(1) << slot;
+}
+
+void teoLNullTimerWheelInit(teoLNullTimerWheel *wheel, uint64_t tick_us,
+                            uint64_t now) {
+    memset(wheel, 0, sizeof(teoLNullTimerWheel));
+    wheel->tick_us = tick_us ? tick_us : 1;
+    wheel->now_tick = now / wheel->tick_us;
+
+    for (unsigned level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        for (unsigned slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+            _listInit(&wheel->slots[level][slot]);
+        }
+    }
+}
+
+void teoLNullTimerInit(teoLNullTimer *timer, teoLNullTimerCb cb,
+                       void *user_data) {
+    memset(timer, 0, sizeof(teoLNullTimer));
+    _listInit(timer);
+    timer->level = LEVEL_NONE;
+    timer->cb = cb;
+    timer->user_data = user_data;
+}
+
+void teoLNullTimerStart(teoLNullTimerWheel *wheel, teoLNullTimer *timer,
+                        uint64_t expires) {
+    teoLNullTimerStop(wheel, timer);
+
+    // Current tick is processed already
+    uint64_t tick = expires / wheel->tick_us + (expires % wheel->tick_us != 0);
+    if (tick <= wheel->now_tick) { tick = wheel->now_tick + 1; }
+
+    timer->expires_tick = tick;
+    timer->armed = true;
+    ++wheel->count;
+
+    _timerInsert(wheel, timer);
+}
+
+void teoLNullTimerStop(teoLNullTimerWheel *wheel, teoLNullTimer *timer) {
+    if (!timer->armed) { return; }
+
+    _timerUnlink(wheel, timer);
+    timer->armed = false;
+    --wheel->count;
+}
+
+/**
+ * Find next tick when level 0 slot expires or upper level slot moves down
+ *
+ * @return Tick or UINT64_MAX if wheel is empty
+ */
+static uint64_t _nextEventTick(const teoLNullTimerWheel *wheel) {
+    uint64_t next = UINT64_MAX;
+
+    for (unsigned level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        const uint64_t occupied = wheel->occupied[level];
+        if (occupied == 0) { continue; }
+
+        const uint64_t base = wheel->now_tick >> LEVEL_SHIFT(level);
+
+        // Slots after current one, current slot is one revolution ahead
+        const unsigned first = (unsigned)(base + 1) & SLOT_MASK;
+        uint64_t rotated = occupied;
+        if (first) {
+            rotated = (occupied >> first) |
+                      (occupied << (TIMER_WHEEL_SLOTS - first));
+        }
+
+        const uint64_t tick = (base + 1 + _countTrailingZeros(rotated))
+                              << LEVEL_SHIFT(level);
+        if (tick < next) { next = tick; }
+    }
+
+    return next;
+}
+
+/**
+ * Move timers of upper level slots reached at tick down, then call
+ * callbacks of level 0 slot timers
+ *
+ * @return Number of expired timers
+ */
+static size_t _processTick(teoLNullTimerWheel *wheel, uint64_t tick) {
+    teoLNullTimer list;
+
+    for (unsigned level = TIMER_WHEEL_LEVELS - 1; level > 0; --level) {
+        const uint64_t low_mask = (UINT64_C(1) << LEVEL_SHIFT(level)) - 1;
+        if (tick & low_mask) { continue; }
+
+        unsigned slot = (unsigned)(tick >> LEVEL_SHIFT(level)) & SLOT_MASK;
+        _slotTake(wheel, level, slot, &list);
+
+        while (!_listEmpty(&list)) {
+            teoLNullTimer *timer = list.next;
+            _listUnlink(timer);
+            _timerInsert(wheel, timer);
+        }
+    }
+
+    size_t expired = 0;
+    _slotTake(wheel, 0, (unsigned)tick & SLOT_MASK, &list);
+
+    // Callbacks may stop other timers of the list or start them again
+    while (!_listEmpty(&list)) {
+        teoLNullTimer *timer = list.next;
+        _listUnlink(timer);
+        timer->armed = false;
+        --wheel->count;
+        ++expired;
+
+        timer->cb(timer, timer->user_data);
+    }
+
+    return expired;
+}
+
+size_t teoLNullTimerWheelAdvance(teoLNullTimerWheel *wheel, uint64_t now) {
+    const uint64_t target = now / wheel->tick_us;
+    size_t expired = 0;
+
+    while (wheel->now_tick < target) {
+        uint64_t next = _nextEventTick(wheel);
+        if (next > target) {
+            wheel->now_tick = target;
+            break;
+        }
+
+        wheel->now_tick = next;
+        expired += _processTick(wheel, next);
+    }
+
+    return expired;
+}
+
+uint64_t teoLNullTimerWheelNextExpiry(const teoLNullTimerWheel *wheel) {
+    uint64_t next = _nextEventTick(wheel);
+    if (next == UINT64_MAX) { return UINT64_MAX; }
+
+    return next * wheel->tick_us;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_TIMER_H
+#define TEONET_L0_CLIENT_TIMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Hierarchical timer wheel
+/////////////////
+
+// Number of wheel levels and slots per level
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+
+typedef struct teoLNullTimer teoLNullTimer;
+
+/**
+ * Timer callback
+ *
+ * Timer is stopped before callback is called and may be started again by it.
+ *
+ * @param timer Expired timer
+ * @param user_data Pointer passed to teoLNullTimerInit
+ */
+typedef void (*teoLNullTimerCb)(teoLNullTimer *timer, void *user_data);
+
+/**
+ * Timer, embedded into its owner structure
+ */
+struct teoLNullTimer {
+    teoLNullTimer *next;   ///< Next timer in slot list
+    teoLNullTimer *prev;   ///< Previous timer in slot list
+    uint64_t expires_tick; ///< Tick when timer expires
+    uint8_t level;         ///< Wheel level of slot
+    uint8_t slot;          ///< Slot index in level
+    bool armed;            ///< Timer is started
+    teoLNullTimerCb cb;    ///< Expire callback
+    void *user_data;       ///< Pointer passed to cb
+};
+
+/**
+ * Timer wheel
+ *
+ * Level 0 slots hold timers expiring during next TIMER_WHEEL_SLOTS ticks,
+ * every next level slot covers whole previous level. Timers of upper level
+ * slot are moved down when wheel reaches that slot.
+ */
+typedef struct teoLNullTimerWheel {
+    uint64_t tick_us;  ///< Tick length in microseconds
+    uint64_t now_tick; ///< Last processed tick
+    size_t count;      ///< Number of started timers
+    uint64_t occupied[TIMER_WHEEL_LEVELS]; ///< Bit mask of non empty slots
+    teoLNullTimer slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; ///< Slot
+                                                ///< list heads
+} teoLNullTimerWheel;
+
+/**
+ * Initialize timer wheel
+ *
+ * @param wheel Timer wheel
+ * @param tick_us Timer resolution in microseconds
+ * @param now Current time in microseconds
+ */
+TEOCLI_INTERNAL void teoLNullTimerWheelInit(teoLNullTimerWheel *wheel,
+                                            uint64_t tick_us, uint64_t now);
+
+/**
+ * Initialize stopped timer
+ *
+ * @param timer Timer
+ * @param cb Expire callback
+ * @param user_data Pointer passed to @a cb
+ */
+TEOCLI_INTERNAL void teoLNullTimerInit(teoLNullTimer *timer,
+                                       teoLNullTimerCb cb, void *user_data);
+
+/**
+ * Start or restart timer
+ *
+ * Timer expires not earlier than @a expires and not later than one tick
+ * after it.
+ *
+ * @param wheel Timer wheel
+ * @param timer Timer
+ * @param expires Expire time in microseconds
+ */
+TEOCLI_INTERNAL void teoLNullTimerStart(teoLNullTimerWheel *wheel,
+                                        teoLNullTimer *timer,
+                                        uint64_t expires);
+
+/**
+ * Stop timer, does nothing if timer is not started
+ *
+ * @param wheel Timer wheel
+ * @param timer Timer
+ */
+TEOCLI_INTERNAL void teoLNullTimerStop(teoLNullTimerWheel *wheel,
+                                       teoLNullTimer *timer);
+
+/**
+ * Call callbacks of expired timers
+ *
+ * @param wheel Timer wheel
+ * @param now Current time in microseconds
+ *
+ * @return Number of expired timers
+ */
+TEOCLI_INTERNAL size_t teoLNullTimerWheelAdvance(teoLNullTimerWheel *wheel,
+                                                 uint64_t now);
+
+/**
+ * Get time when wheel should be advanced next time
+ *
+ * This is expire time of the nearest timer or earlier time when upper level
+ * slot holding it is moved down.
+ *
+ * @param wheel Timer wheel
+ *
+ * @return Time in microseconds or UINT64_MAX if no timers are started
+ */
+TEOCLI_INTERNAL uint64_t
+teoLNullTimerWheelNextExpiry(const teoLNullTimerWheel *wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_TIMER_H */
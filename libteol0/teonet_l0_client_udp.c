@@ -0,0 +1,415 @@
+/**
+ * \file   teonet_l0_client_udp.c
+ *
+ * Batched UDP socket input and output.
+ *
+ * On Linux datagrams are received with recvmmsg into preallocated vector of
+ * buffers, so many datagrams cost one system call. On other platforms
+ * datagrams are received one by one with recvfrom into the same buffers.
+ *
+ * Outgoing datagrams are collected and sent with sendmmsg. Equal sized
+ * datagrams to the same address may be sent as one UDP_SEGMENT (generic
+ * segmentation offload) message, kernel splits it to datagrams.
+ */
+
+// recvmmsg and sendmmsg are GNU extensions
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "teonet_l0_client_udp.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teobase/platform.h"
+
+#include "teoccl/memory.h"
+
+#if defined(TEONET_OS_LINUX) || defined(TEONET_OS_ANDROID)
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#define HAVE_RECVMMSG 1
+
+#if !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif
+#if !defined(SOL_UDP)
+#define SOL_UDP IPPROTO_UDP
+#endif
+// Kernel limits of one UDP_SEGMENT message
+#define UDP_MAX_SEGMENTS 64
+#define UDP_MAX_SEGMENTED_SIZE 65000
+#endif
+
+struct teoLNullUdpReceiver {
+    size_t batch_size;            ///< Number of datagram buffers
+    size_t datagram_size;         ///< Size of one datagram buffer
+    uint8_t *buffers;             ///< Datagram buffers
+    struct sockaddr_in *addrs;    ///< Datagram source addresses
+#if defined(HAVE_RECVMMSG)
+    struct iovec *iovs;           ///< One iovec per datagram buffer
+    struct mmsghdr *msgs;         ///< recvmmsg message vector
+#endif
+};
+
+teoLNullUdpReceiver *teoLNullUdpReceiverCreate(size_t batch_size,
+                                               size_t datagram_size) {
+    if (batch_size == 0) { batch_size = 1; }
+
+    teoLNullUdpReceiver *receiver =
+        (teoLNullUdpReceiver *)ccl_malloc(sizeof(teoLNullUdpReceiver));
+    if (receiver == NULL) { return NULL; }
+
+    receiver->batch_size = batch_size;
+    receiver->datagram_size = datagram_size;
+    receiver->buffers = (uint8_t *)ccl_malloc(batch_size * datagram_size);
+    receiver->addrs = (struct sockaddr_in *)ccl_malloc(
+        batch_size * sizeof(struct sockaddr_in));
+
+#if defined(HAVE_RECVMMSG)
+    receiver->iovs =
+        (struct iovec *)ccl_malloc(batch_size * sizeof(struct iovec));
+    receiver->msgs =
+        (struct mmsghdr *)ccl_malloc(batch_size * sizeof(struct mmsghdr));
+
+    if (receiver->iovs == NULL || receiver->msgs == NULL) {
+        teoLNullUdpReceiverDestroy(receiver);
+        return NULL;
+    }
+
+    memset(receiver->msgs, 0, batch_size * sizeof(struct mmsghdr));
+    for (size_t i = 0; i < batch_size; ++i) {
+        receiver->iovs[i].iov_base = receiver->buffers + i * datagram_size;
+        receiver->iovs[i].iov_len = datagram_size;
+        receiver->msgs[i].msg_hdr.msg_iov = &receiver->iovs[i];
+        receiver->msgs[i].msg_hdr.msg_iovlen = 1;
+        receiver->msgs[i].msg_hdr.msg_name = &receiver->addrs[i];
+    }
+#endif
+
+    if (receiver->buffers == NULL || receiver->addrs == NULL) {
+        teoLNullUdpReceiverDestroy(receiver);
+        return NULL;
+    }
+
+    return receiver;
+}
+
+void teoLNullUdpReceiverDestroy(teoLNullUdpReceiver *receiver) {
+    if (receiver == NULL) { return; }
+
+#if defined(HAVE_RECVMMSG)
+    free(receiver->msgs);
+    free(receiver->iovs);
+#endif
+    free(receiver->addrs);
+    free(receiver->buffers);
+    free(receiver);
+}
+
+/**
+ * Check if last socket error means that there is no data to receive
+ */
+static int _udpWouldBlock(void) {
+#if defined(TEONET_OS_WINDOWS)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#elif defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#else
+    return errno == EAGAIN;
+#endif
+}
+
+int teoLNullUdpReceive(teoLNullUdpReceiver *receiver, teonetSocket fd,
+                       int max_count, teoLNullUdpReceiveCb cb,
+                       void *user_data) {
+    if (max_count <= 0) { return 0; }
+
+    unsigned int vlen = (unsigned int)receiver->batch_size;
+    if ((unsigned int)max_count < vlen) { vlen = (unsigned int)max_count; }
+
+#if defined(HAVE_RECVMMSG)
+    // Kernel overwrites address length of every received message
+    for (unsigned int i = 0; i < vlen; ++i) {
+        receiver->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+
+    int received;
+    do {
+        received = recvmmsg(fd, receiver->msgs, vlen, MSG_DONTWAIT, NULL);
+    } while (received == -1 && errno == EINTR);
+
+    if (received == -1) { return _udpWouldBlock() ? 0 : -1; }
+
+    for (int i = 0; i < received; ++i) {
+        cb(receiver->iovs[i].iov_base, receiver->msgs[i].msg_len,
+           &receiver->addrs[i], user_data);
+    }
+
+    return received;
+#else
+    int received = 0;
+    for (unsigned int i = 0; i < vlen; ++i) {
+        uint8_t *buffer = receiver->buffers + i * receiver->datagram_size;
+        socklen_t addr_len = sizeof(struct sockaddr_in);
+
+        ssize_t length =
+            recvfrom(fd, (char *)buffer, (int)receiver->datagram_size, 0,
+                     (struct sockaddr *)&receiver->addrs[i], &addr_len);
+        if (length < 0) {
+            if (received > 0 || _udpWouldBlock()) { break; }
+            return -1;
+        }
+
+        cb(buffer, (size_t)length, &receiver->addrs[i], user_data);
+        ++received;
+    }
+
+    return received;
+#endif
+}
+
+/**
+ * Collected datagram
+ */
+typedef struct teoLNullUdpDatagram {
+    size_t offset;           ///< Offset of datagram data in sender buffer
+    size_t length;           ///< Datagram length
+    struct sockaddr_in addr; ///< Destination address
+} teoLNullUdpDatagram;
+
+struct teoLNullUdpSender {
+    size_t capacity;                 ///< Maximum number of datagrams
+    size_t count;                    ///< Number of collected datagrams
+    size_t buffer_size;              ///< Size of datagrams data buffer
+    size_t buffer_used;              ///< Used part of data buffer
+    uint8_t *buffer;                 ///< Datagrams data, packed one by one
+    teoLNullUdpDatagram *datagrams;  ///< Collected datagrams
+    bool segment_offload_failed;     ///< Kernel does not accept UDP_SEGMENT
+#if defined(HAVE_RECVMMSG)
+    struct iovec *iovs;              ///< One iovec per message
+    struct mmsghdr *msgs;            ///< sendmmsg message vector
+    size_t *msg_first;               ///< First datagram of every message
+    uint8_t *controls;               ///< UDP_SEGMENT control message buffers
+#endif
+};
+
+#if defined(HAVE_RECVMMSG)
+#define SEGMENT_CONTROL_SIZE CMSG_SPACE(sizeof(uint16_t))
+#endif
+
+teoLNullUdpSender *teoLNullUdpSenderCreate(size_t capacity,
+                                           size_t buffer_size) {
+    if (capacity == 0) { capacity = 1; }
+
+    teoLNullUdpSender *sender =
+        (teoLNullUdpSender *)ccl_malloc(sizeof(teoLNullUdpSender));
+    if (sender == NULL) { return NULL; }
+
+    memset(sender, 0, sizeof(teoLNullUdpSender));
+    sender->capacity = capacity;
+    sender->buffer_size = buffer_size;
+    sender->buffer = (uint8_t *)ccl_malloc(buffer_size);
+    sender->datagrams = (teoLNullUdpDatagram *)ccl_malloc(
+        capacity * sizeof(teoLNullUdpDatagram));
+
+#if defined(HAVE_RECVMMSG)
+    sender->iovs = (struct iovec *)ccl_malloc(capacity * sizeof(struct iovec));
+    sender->msgs =
+        (struct mmsghdr *)ccl_malloc(capacity * sizeof(struct mmsghdr));
+    sender->msg_first = (size_t *)ccl_malloc(capacity * sizeof(size_t));
+    sender->controls = (uint8_t *)ccl_malloc(capacity * SEGMENT_CONTROL_SIZE);
+
+    if (sender->iovs == NULL || sender->msgs == NULL ||
+        sender->msg_first == NULL || sender->controls == NULL) {
+        teoLNullUdpSenderDestroy(sender);
+        return NULL;
+    }
+#endif
+
+    if (sender->buffer == NULL || sender->datagrams == NULL) {
+        teoLNullUdpSenderDestroy(sender);
+        return NULL;
+    }
+
+    return sender;
+}
+
+void teoLNullUdpSenderDestroy(teoLNullUdpSender *sender) {
+    if (sender == NULL) { return; }
+
+#if defined(HAVE_RECVMMSG)
+    free(sender->controls);
+    free(sender->msg_first);
+    free(sender->msgs);
+    free(sender->iovs);
+#endif
+    free(sender->datagrams);
+    free(sender->buffer);
+    free(sender);
+}
+
+bool teoLNullUdpSenderAdd(teoLNullUdpSender *sender, teonetSocket fd,
+                          const void *data, size_t data_length,
+                          const struct sockaddr_in *addr,
+                          bool segment_offload) {
+    if (data_length > sender->buffer_size) { return false; }
+
+    if (sender->count == sender->capacity ||
+        sender->buffer_used + data_length > sender->buffer_size) {
+        teoLNullUdpSenderFlush(sender, fd, segment_offload);
+    }
+
+    teoLNullUdpDatagram *datagram = &sender->datagrams[sender->count++];
+    datagram->offset = sender->buffer_used;
+    datagram->length = data_length;
+    datagram->addr = *addr;
+
+    memcpy(sender->buffer + sender->buffer_used, data, data_length);
+    sender->buffer_used += data_length;
+
+    return true;
+}
+
+#if defined(HAVE_RECVMMSG)
+/**
+ * Count datagrams which can be sent as one UDP_SEGMENT message
+ *
+ * All datagrams but the last one should be of the first datagram size, last
+ * one may be shorter.
+ *
+ * @return Number of datagrams starting from @a first
+ */
+static size_t _udpSegmentCount(const teoLNullUdpSender *sender,
+                               size_t first) {
+    const teoLNullUdpDatagram *head = &sender->datagrams[first];
+    size_t total = head->length;
+    size_t segments = 1;
+
+    while (first + segments < sender->count && segments < UDP_MAX_SEGMENTS) {
+        const teoLNullUdpDatagram *next = &sender->datagrams[first + segments];
+        const teoLNullUdpDatagram *last = next - 1;
+
+        if (last->length != head->length || next->length > head->length ||
+            total + next->length > UDP_MAX_SEGMENTED_SIZE ||
+            next->addr.sin_port != head->addr.sin_port ||
+            next->addr.sin_addr.s_addr != head->addr.sin_addr.s_addr) {
+            break;
+        }
+
+        total += next->length;
+        ++segments;
+    }
+
+    return segments;
+}
+
+/**
+ * Fill sendmmsg message vector from collected datagrams
+ *
+ * @return Number of messages
+ */
+static unsigned int _udpBuildMessages(teoLNullUdpSender *sender, size_t first,
+                                      bool segment_offload) {
+    unsigned int nmsgs = 0;
+
+    for (size_t i = first; i < sender->count; ++nmsgs) {
+        const teoLNullUdpDatagram *datagram = &sender->datagrams[i];
+        const size_t segments =
+            segment_offload ? _udpSegmentCount(sender, i) : 1;
+
+        struct msghdr *hdr = &sender->msgs[nmsgs].msg_hdr;
+        memset(hdr, 0, sizeof(*hdr));
+
+        // Datagrams are packed one by one, so segments are contiguous
+        sender->iovs[nmsgs].iov_base = sender->buffer + datagram->offset;
+        sender->iovs[nmsgs].iov_len =
+            sender->datagrams[i + segments - 1].offset +
+            sender->datagrams[i + segments - 1].length - datagram->offset;
+
+        hdr->msg_iov = &sender->iovs[nmsgs];
+        hdr->msg_iovlen = 1;
+        hdr->msg_name = (void *)&datagram->addr;
+        hdr->msg_namelen = sizeof(datagram->addr);
+
+        if (segments > 1) {
+            uint8_t *control = sender->controls + nmsgs * SEGMENT_CONTROL_SIZE;
+            memset(control, 0, SEGMENT_CONTROL_SIZE);
+            hdr->msg_control = control;
+            hdr->msg_controllen = SEGMENT_CONTROL_SIZE;
+
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+            uint16_t segment_size = (uint16_t)datagram->length;
+            memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+        }
+
+        sender->msg_first[nmsgs] = i;
+        i += segments;
+    }
+
+    return nmsgs;
+}
+#endif
+
+int teoLNullUdpSenderFlush(teoLNullUdpSender *sender, teonetSocket fd,
+                           bool segment_offload) {
+    int calls = 0;
+
+#if defined(HAVE_RECVMMSG)
+    segment_offload = segment_offload && !sender->segment_offload_failed;
+
+    size_t first = 0;
+    while (first < sender->count) {
+        unsigned int nmsgs = _udpBuildMessages(sender, first, segment_offload);
+
+        int sent;
+        do {
+            sent = sendmmsg(fd, sender->msgs, nmsgs, 0);
+        } while (sent == -1 && errno == EINTR);
+        ++calls;
+
+        if (sent > 0) {
+            first = ((unsigned int)sent < nmsgs) ? sender->msg_first[sent]
+                                                 : sender->count;
+            continue;
+        }
+
+        // Kernel or device without segmentation offload, resend first
+        // message as separate datagrams
+        if (sender->msgs[0].msg_hdr.msg_control != NULL &&
+            (errno == EINVAL || errno == EIO || errno == ENOPROTOOPT ||
+             errno == EOPNOTSUPP)) {
+            sender->segment_offload_failed = true;
+            segment_offload = false;
+            continue;
+        }
+
+        // Drop datagrams of failed message like single sendto does, TR-UDP
+        // resends reliable packets
+        first = (nmsgs > 1) ? sender->msg_first[1] : sender->count;
+    }
+#else
+    (void)segment_offload;
+
+    for (size_t i = 0; i < sender->count; ++i) {
+        const teoLNullUdpDatagram *datagram = &sender->datagrams[i];
+        sendto(fd, (const char *)sender->buffer + datagram->offset,
+               (int)datagram->length, 0,
+               (const struct sockaddr *)&datagram->addr,
+               sizeof(datagram->addr));
+        ++calls;
+    }
+#endif
+
+    sender->count = 0;
+    sender->buffer_used = 0;
+
+    return calls;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_UDP_H
+#define TEONET_L0_CLIENT_UDP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teobase/socket.h"
+
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Batched UDP socket input and output
+/////////////////
+
+// forward declaration, complete type in libteol0/teonet_l0_client_udp.c
+typedef struct teoLNullUdpReceiver teoLNullUdpReceiver;
+
+/**
+ * Received datagram callback
+ *
+ * @param data Datagram data, valid until callback returns
+ * @param data_length Length of @a data
+ * @param addr Datagram source address
+ * @param user_data Pointer passed to teoLNullUdpReceive
+ */
+typedef void (*teoLNullUdpReceiveCb)(void *data, size_t data_length,
+                                     struct sockaddr_in *addr,
+                                     void *user_data);
+
+/**
+ * Create UDP receiver with preallocated datagram buffers
+ *
+ * @param batch_size Maximum number of datagrams received by one system call
+ * @param datagram_size Size of one datagram buffer
+ *
+ * @return Pointer to created receiver or NULL if failed
+ */
+TEOCLI_INTERNAL teoLNullUdpReceiver *
+teoLNullUdpReceiverCreate(size_t batch_size, size_t datagram_size);
+
+/**
+ * Destroy UDP receiver
+ *
+ * @param receiver Receiver to destroy, may be NULL
+ */
+TEOCLI_INTERNAL void teoLNullUdpReceiverDestroy(teoLNullUdpReceiver *receiver);
+
+/**
+ * Receive available datagrams from non blocking socket
+ *
+ * Up to batch size datagrams are received with one recvmmsg call where it is
+ * available, otherwise datagrams are received one by one.
+ *
+ * @param receiver UDP receiver
+ * @param fd Socket to receive from
+ * @param max_count Maximum number of datagrams to receive
+ * @param cb Callback called for every received datagram
+ * @param user_data Pointer passed to @a cb
+ *
+ * @return Number of received datagrams, 0 if there is no datagram to receive
+ *  or -1 at error (errno or WSAGetLastError() is set)
+ */
+TEOCLI_INTERNAL int teoLNullUdpReceive(teoLNullUdpReceiver *receiver,
+                                       teonetSocket fd, int max_count,
+                                       teoLNullUdpReceiveCb cb,
+                                       void *user_data);
+
+// forward declaration, complete type in libteol0/teonet_l0_client_udp.c
+typedef struct teoLNullUdpSender teoLNullUdpSender;
+
+/**
+ * Create UDP sender collecting datagrams to send them together
+ *
+ * @param capacity Maximum number of collected datagrams
+ * @param buffer_size Size of buffer for collected datagrams data
+ *
+ * @return Pointer to created sender or NULL if failed
+ */
+TEOCLI_INTERNAL teoLNullUdpSender *teoLNullUdpSenderCreate(size_t capacity,
+                                                           size_t buffer_size);
+
+/**
+ * Destroy UDP sender, collected datagrams are dropped
+ *
+ * @param sender Sender to destroy, may be NULL
+ */
+TEOCLI_INTERNAL void teoLNullUdpSenderDestroy(teoLNullUdpSender *sender);
+
+/**
+ * Copy datagram to sender, sender is flushed first if it is full
+ *
+ * @param sender UDP sender
+ * @param fd Socket to flush collected datagrams to
+ * @param data Datagram data
+ * @param data_length Length of @a data
+ * @param addr Destination address
+ * @param segment_offload Use UDP generic segmentation offload if flushed
+ *
+ * @return true if datagram is collected or false if it is too large to be
+ *  collected (caller should send it directly)
+ */
+TEOCLI_INTERNAL bool teoLNullUdpSenderAdd(teoLNullUdpSender *sender,
+                                          teonetSocket fd, const void *data,
+                                          size_t data_length,
+                                          const struct sockaddr_in *addr,
+                                          bool segment_offload);
+
+/**
+ * Send all collected datagrams
+ *
+ * Datagrams are sent with one sendmmsg call where it is available, otherwise
+ * one by one. With @a segment_offload equal sized datagrams sent one after
+ * another to the same address are passed to kernel as one UDP_SEGMENT send
+ * where it is supported.
+ *
+ * @param sender UDP sender
+ * @param fd Socket to send to
+ * @param segment_offload Use UDP generic segmentation offload
+ *
+ * @return Number of system calls made
+ */
+TEOCLI_INTERNAL int teoLNullUdpSenderFlush(teoLNullUdpSender *sender,
+                                           teonetSocket fd,
+                                           bool segment_offload);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_UDP_H */
@@ -0,0 +1,899 @@
+/**
+ * \file   teonet_l0_client_uring.c
+ *
+ * io_uring socket backend.
+ *
+ * Ring is used by raw system calls, so library does not depend on liburing.
+ * Connection socket is received by multishot recv (TCP) or recvmsg (UDP)
+ * into buffers of provided buffer ring, one wait returns all received data.
+ * Sent data is copied to send slots and submitted together. TCP sends of one
+ * submit are linked, so kernel keeps their order, and next TCP submit waits
+ * until previous chain is completed.
+ */
+
+#include "teonet_l0_client_uring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teobase/platform.h"
+
+#if defined(TEONET_OS_LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// Multishot receive is the newest feature used
+#if defined(IORING_RECV_MULTISHOT)
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#if defined(HAVE_IO_URING)
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "teobase/logging.h"
+
+#include "teoccl/memory.h"
+
+#if defined(HAVE_IO_URING)
+
+// Submission queue size
+#define URING_ENTRIES 256
+// Completion queue size, multishot receives post many completions
+#define URING_CQ_ENTRIES 1024
+// Number of provided receive buffers, power of two
+#define URING_BUFFERS 64
+// Provided receive buffers group
+#define URING_BUFFER_GROUP 0
+// Number of send slots
+#define URING_SEND_SLOTS 256
+// Wait for not completed sends before ring is closed
+#define URING_DRAIN_ATTEMPTS 10
+#define URING_DRAIN_TIMEOUT_US 100000
+
+// Completion tags in user_data, send completions have slot index in upper
+// bits
+#define URING_TAG_NONE 0 ///< Completion is processed already
+#define URING_TAG_RECV 1
+#define URING_TAG_WATCH 2
+#define URING_TAG_SEND 3
+#define URING_TAG_MASK 3
+#define URING_TAG_BITS 2
+
+/**
+ * Data queued to send
+ */
+typedef struct teoLNullUringSlot {
+    uint8_t *data;           ///< Copy of sent data
+    size_t capacity;         ///< Allocated size of data
+    size_t length;           ///< Length of data
+    struct iovec iov;        ///< Datagram buffer
+    struct msghdr msg;       ///< Datagram header
+    struct sockaddr_in addr; ///< Datagram destination
+    int next;                ///< Next slot in free or pending list, -1 at end
+} teoLNullUringSlot;
+
+struct teoLNullUring {
+    int ring_fd;       ///< Ring descriptor
+    teonetSocket fd;   ///< Connection socket
+    bool datagram;     ///< fd is UDP socket
+
+    void *sq_ring;       ///< Mapped submission queue ring
+    size_t sq_ring_size; ///< Size of sq_ring mapping
+    void *cq_ring;       ///< Mapped completion queue ring, may be sq_ring
+    size_t cq_ring_size; ///< Size of cq_ring mapping, 0 if it is sq_ring
+    struct io_uring_sqe *sqes; ///< Mapped submission queue entries
+    size_t sqes_size;          ///< Size of sqes mapping
+
+    unsigned *sq_head;      ///< Submission queue head, moved by kernel
+    unsigned *sq_tail;      ///< Submission queue tail
+    unsigned sq_mask;       ///< Submission queue index mask
+    unsigned sq_entries;    ///< Submission queue size
+    unsigned sq_local_tail; ///< Tail including not published entries
+    unsigned *cq_head;      ///< Completion queue head
+    unsigned *cq_tail;      ///< Completion queue tail, moved by kernel
+    unsigned cq_mask;       ///< Completion queue index mask
+    struct io_uring_cqe *cqes; ///< Completion queue entries
+
+    struct io_uring_buf_ring *buf_ring; ///< Provided receive buffers ring
+    size_t buf_ring_size;               ///< Size of buf_ring mapping
+    uint16_t buf_tail;   ///< Buffer ring tail including not published
+    uint8_t *buffers;    ///< Receive buffers
+    size_t buffer_size;  ///< Size of one receive buffer
+
+    struct msghdr recv_msg; ///< Datagram receive header layout
+    bool recv_armed;        ///< Receive request is active
+    bool recv_multishot;    ///< Kernel supports multishot receive
+    bool closed;            ///< TCP socket closed or failed
+
+    int watch_fd;     ///< Descriptor watched by poll, -1 if none
+    bool watch_armed; ///< Poll request is active
+
+    teoLNullUringSlot slots[URING_SEND_SLOTS]; ///< Send slots
+    int free_slot;         ///< First free slot, -1 if none
+    int pending_head;      ///< First slot waiting for submit, -1 if none
+    int pending_tail;      ///< Last slot waiting for submit
+    unsigned sends_inflight; ///< Submitted not completed sends
+};
+
+static inline int _uringSetup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int _uringEnter(int ring_fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags,
+                              const void *arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                        flags, arg, arg_size);
+}
+
+static inline int _uringRegister(int ring_fd, unsigned opcode, void *arg,
+                                 unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg,
+                        nr_args);
+}
+
+/**
+ * Pass prepared submission entries to kernel, optionally wait for
+ * completions
+ *
+ * @param uring Ring
+ * @param min_complete Number of completions in queue to wait for, 0 to not
+ *  wait
+ * @param timeout Wait timeout in microseconds, negative for infinite
+ *
+ * @return 0 on success or -1 at error (errno is set, ETIME at timeout)
+ */
+static int _uringFlush(teoLNullUring *uring, unsigned min_complete,
+                       int64_t timeout) {
+    __atomic_store_n(uring->sq_tail, uring->sq_local_tail, __ATOMIC_RELEASE);
+
+    for (;;) {
+        unsigned to_submit =
+            uring->sq_local_tail -
+            __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+        if (to_submit == 0 && min_complete == 0) { return 0; }
+
+        unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        const void *argp = NULL;
+        size_t arg_size = 0;
+
+        if (min_complete && timeout >= 0) {
+            ts.tv_sec = timeout / 1000000;
+            ts.tv_nsec = (timeout % 1000000) * 1000;
+            memset(&arg, 0, sizeof(arg));
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+            argp = &arg;
+            arg_size = sizeof(arg);
+            flags |= IORING_ENTER_EXT_ARG;
+        }
+
+        int rc =
+            _uringEnter(uring->ring_fd, to_submit, min_complete, flags, argp,
+                        arg_size);
+        if (rc >= 0) { return 0; }
+
+        // Interrupted submit is repeated, interrupted wait returns
+        if (errno == EINTR && min_complete == 0) { continue; }
+
+        return -1;
+    }
+}
+
+/**
+ * Get free submission queue entry
+ *
+ * @param uring Ring
+ *
+ * @return Cleared entry
+ */
+static struct io_uring_sqe *_uringGetSqe(teoLNullUring *uring) {
+    while (uring->sq_local_tail -
+               __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) >=
+           uring->sq_entries) {
+        if (_uringFlush(uring, 0, 0) == -1) {
+            LTRACK_E("TeonetClient", "io_uring submit failed: %s",
+                     strerror(errno));
+        }
+    }
+
+    struct io_uring_sqe *sqe =
+        &uring->sqes[uring->sq_local_tail & uring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ++uring->sq_local_tail;
+
+    return sqe;
+}
+
+/**
+ * Number of free submission queue entries
+ */
+static inline unsigned _uringSqSpace(const teoLNullUring *uring) {
+    return uring->sq_entries -
+           (uring->sq_local_tail -
+            __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Start receive request of connection socket
+ *
+ * @param uring Ring
+ */
+static void _uringArmRecv(teoLNullUring *uring) {
+    struct io_uring_sqe *sqe = _uringGetSqe(uring);
+
+    sqe->opcode = uring->datagram ? IORING_OP_RECVMSG : IORING_OP_RECV;
+    sqe->fd = uring->fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->ioprio = uring->recv_multishot ? IORING_RECV_MULTISHOT : 0;
+    sqe->user_data = URING_TAG_RECV;
+
+    if (uring->datagram) {
+        sqe->addr = (uint64_t)(uintptr_t)&uring->recv_msg;
+        sqe->len = 1;
+    }
+
+    uring->recv_armed = true;
+}
+
+/**
+ * Start multishot poll request of watched descriptor
+ *
+ * @param uring Ring
+ */
+static void _uringArmWatch(teoLNullUring *uring) {
+    struct io_uring_sqe *sqe = _uringGetSqe(uring);
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = uring->watch_fd;
+    sqe->len = IORING_POLL_ADD_MULTI;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    sqe->poll32_events = ((uint32_t)POLLIN << 16) | ((uint32_t)POLLIN >> 16);
+#else
+    sqe->poll32_events = POLLIN;
+#endif
+    sqe->user_data = URING_TAG_WATCH;
+
+    uring->watch_armed = true;
+}
+
+/**
+ * Give receive buffer to kernel, buffer is available after
+ * _uringBuffersPublish
+ *
+ * @param uring Ring
+ * @param bid Buffer index
+ */
+static void _uringBufferGive(teoLNullUring *uring, uint16_t bid) {
+    struct io_uring_buf *buf =
+        &uring->buf_ring->bufs[uring->buf_tail & (URING_BUFFERS - 1)];
+
+    buf->addr =
+        (uint64_t)(uintptr_t)(uring->buffers + bid * uring->buffer_size);
+    buf->len = (uint32_t)uring->buffer_size;
+    buf->bid = bid;
+    ++uring->buf_tail;
+}
+
+static inline void _uringBuffersPublish(teoLNullUring *uring) {
+    __atomic_store_n(&uring->buf_ring->tail, uring->buf_tail,
+                     __ATOMIC_RELEASE);
+}
+
+/**
+ * Free send slot of completed send
+ *
+ * Failed or short TCP send cancels the rest of its chain, so stream has a
+ * gap and connection is marked closed.
+ *
+ * @param uring Ring
+ * @param index Slot index
+ * @param res Send result
+ */
+static void _uringSendComplete(teoLNullUring *uring, int index, int32_t res) {
+    teoLNullUringSlot *slot = &uring->slots[index];
+
+    if (res < 0 && res != -ECANCELED) {
+        LTRACK_E("TeonetClient", "io_uring send of %u bytes failed: %s",
+                 (uint32_t)slot->length, strerror(-res));
+    } else if (res >= 0 && (size_t)res != slot->length) {
+        LTRACK_E("TeonetClient", "io_uring sent %d of %u bytes", (int)res,
+                 (uint32_t)slot->length);
+    }
+
+    if (!uring->datagram && (res < 0 || (size_t)res != slot->length)) {
+        uring->closed = true;
+    }
+
+    slot->next = uring->free_slot;
+    uring->free_slot = index;
+    --uring->sends_inflight;
+}
+
+/**
+ * Process send completions without consuming other completions
+ *
+ * Send completions are marked as processed and left in completion queue,
+ * so receive completions stay in order for teoLNullUringProcess.
+ *
+ * @param uring Ring
+ */
+static void _uringScanSends(teoLNullUring *uring) {
+    unsigned head = *uring->cq_head;
+    const unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    bool leading = true;
+
+    for (; head != tail; ++head) {
+        struct io_uring_cqe *cqe = &uring->cqes[head & uring->cq_mask];
+        const uint64_t tag = cqe->user_data & URING_TAG_MASK;
+
+        if (tag == URING_TAG_SEND) {
+            _uringSendComplete(uring,
+                               (int)(cqe->user_data >> URING_TAG_BITS),
+                               cqe->res);
+            cqe->user_data = URING_TAG_NONE;
+        } else if (tag != URING_TAG_NONE) {
+            leading = false;
+        }
+
+        // Processed completions at queue head are consumed
+        if (leading) {
+            __atomic_store_n(uring->cq_head, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+/**
+ * Prepare submission entries of queued sends
+ *
+ * @param uring Ring
+ *
+ * @return Number of prepared sends
+ */
+static int _uringPrepareSends(teoLNullUring *uring) {
+    if (uring->pending_head == -1) { return 0; }
+
+    // Data after gap in closed stream is not sent
+    if (!uring->datagram && uring->closed) { return 0; }
+
+    // Previous TCP chain may be still waiting for socket buffer
+    if (!uring->datagram && uring->sends_inflight > 0) {
+        _uringScanSends(uring);
+        if (uring->sends_inflight > 0) { return 0; }
+    }
+
+    struct io_uring_sqe *last = NULL;
+    unsigned space = _uringSqSpace(uring);
+    int count = 0;
+
+    while (uring->pending_head != -1 && space > 0) {
+        const int index = uring->pending_head;
+        teoLNullUringSlot *slot = &uring->slots[index];
+        uring->pending_head = slot->next;
+
+        struct io_uring_sqe *sqe = _uringGetSqe(uring);
+        sqe->fd = uring->fd;
+        sqe->user_data =
+            ((uint64_t)index << URING_TAG_BITS) | URING_TAG_SEND;
+
+        if (uring->datagram) {
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = (uint64_t)(uintptr_t)&slot->msg;
+            sqe->len = 1;
+        } else {
+            sqe->opcode = IORING_OP_SEND;
+            sqe->addr = (uint64_t)(uintptr_t)slot->data;
+            sqe->len = (uint32_t)slot->length;
+            sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+            sqe->flags = IOSQE_IO_LINK;
+            last = sqe;
+        }
+
+        ++uring->sends_inflight;
+        ++count;
+        --space;
+    }
+
+    // Chain ends at last send of this submit
+    if (last != NULL) { last->flags &= ~IOSQE_IO_LINK; }
+
+    return count;
+}
+
+/**
+ * Process receive completion
+ *
+ * @return 1 if data was passed to callback or 0
+ */
+static int _uringRecvComplete(teoLNullUring *uring,
+                              const struct io_uring_cqe *cqe,
+                              teoLNullUdpReceiveCb recv_cb, void *user_data) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) { uring->recv_armed = false; }
+
+    if (cqe->res < 0) {
+        const int error = -cqe->res;
+
+        // Buffers are given back and receive is started again after
+        // processing
+        if (error == ENOBUFS || error == EINTR || error == EAGAIN) {
+            return 0;
+        }
+
+        if (error == EINVAL && uring->recv_multishot) {
+            LTRACK("TeonetClient",
+                   "io_uring multishot receive is not supported, using "
+                   "single shot receive");
+            uring->recv_multishot = false;
+            return 0;
+        }
+
+        LTRACK_E("TeonetClient", "io_uring receive failed: %s",
+                 strerror(error));
+        if (!uring->datagram) { uring->closed = true; }
+        return 0;
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+        if (cqe->res == 0 && !uring->datagram) { uring->closed = true; }
+        return 0;
+    }
+
+    const uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    uint8_t *buffer = uring->buffers + bid * uring->buffer_size;
+    int delivered = 0;
+
+    if (uring->datagram) {
+        const struct io_uring_recvmsg_out *out =
+            (const struct io_uring_recvmsg_out *)buffer;
+        const size_t header = sizeof(*out) + uring->recv_msg.msg_namelen +
+                              uring->recv_msg.msg_controllen;
+
+        if ((size_t)cqe->res < header || (out->flags & MSG_TRUNC)) {
+            LTRACK_E("TeonetClient", "io_uring dropped truncated datagram");
+        } else {
+            recv_cb(buffer + header, (size_t)cqe->res - header,
+                    (struct sockaddr_in *)(buffer + sizeof(*out)), user_data);
+            delivered = 1;
+        }
+    } else if (cqe->res == 0) {
+        uring->closed = true;
+    } else {
+        recv_cb(buffer, (size_t)cqe->res, NULL, user_data);
+        delivered = 1;
+    }
+
+    _uringBufferGive(uring, bid);
+
+    return delivered;
+}
+
+teoLNullUring *teoLNullUringCreate(teonetSocket fd, bool datagram,
+                                   size_t buffer_size) {
+    teoLNullUring *uring = (teoLNullUring *)ccl_malloc(sizeof(teoLNullUring));
+    if (uring == NULL) { return NULL; }
+
+    memset(uring, 0, sizeof(teoLNullUring));
+    uring->fd = fd;
+    uring->datagram = datagram;
+    uring->watch_fd = -1;
+    uring->recv_multishot = true;
+    uring->pending_head = -1;
+    uring->pending_tail = -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_CQ_ENTRIES;
+
+    uring->ring_fd = _uringSetup(URING_ENTRIES, &params);
+    if (uring->ring_fd == -1) {
+        LTRACK_E("TeonetClient", "io_uring is not available: %s",
+                 strerror(errno));
+        free(uring);
+        return NULL;
+    }
+
+    const uint32_t required = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required) {
+        LTRACK_E("TeonetClient", "io_uring of this kernel is too old");
+        teoLNullUringDestroy(uring);
+        return NULL;
+    }
+
+    uring->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq_ring_size > uring->sq_ring_size) {
+            uring->sq_ring_size = cq_ring_size;
+        }
+    } else {
+        uring->cq_ring_size = cq_ring_size;
+    }
+
+    uring->sq_ring = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, uring->ring_fd,
+                          IORING_OFF_SQ_RING);
+    if (uring->sq_ring == MAP_FAILED) {
+        uring->sq_ring = NULL;
+        LTRACK_E("TeonetClient", "io_uring mmap failed: %s", strerror(errno));
+        teoLNullUringDestroy(uring);
+        return NULL;
+    }
+
+    uring->cq_ring = uring->sq_ring;
+    if (uring->cq_ring_size) {
+        uring->cq_ring = mmap(NULL, uring->cq_ring_size,
+                              PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              uring->ring_fd, IORING_OFF_CQ_RING);
+        if (uring->cq_ring == MAP_FAILED) {
+            uring->cq_ring = NULL;
+            LTRACK_E("TeonetClient", "io_uring mmap failed: %s",
+                     strerror(errno));
+            teoLNullUringDestroy(uring);
+            return NULL;
+        }
+    }
+
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = (struct io_uring_sqe *)mmap(
+        NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQES);
+    if (uring->sqes == MAP_FAILED) {
+        uring->sqes = NULL;
+        LTRACK_E("TeonetClient", "io_uring mmap failed: %s", strerror(errno));
+        teoLNullUringDestroy(uring);
+        return NULL;
+    }
+
+    uint8_t *sq = (uint8_t *)uring->sq_ring;
+    uring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    uring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    uring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    uring->sq_entries = *(unsigned *)(sq + params.sq_off.ring_entries);
+    uring->sq_local_tail = *uring->sq_tail;
+
+    // Submission entries are used in ring order
+    unsigned *sq_array = (unsigned *)(sq + params.sq_off.array);
+    for (unsigned i = 0; i < uring->sq_entries; ++i) { sq_array[i] = i; }
+
+    uint8_t *cq = (uint8_t *)uring->cq_ring;
+    uring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    uring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    uring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // Provided receive buffers
+    uring->buffer_size = buffer_size;
+    uring->buffers = (uint8_t *)ccl_malloc(URING_BUFFERS * buffer_size);
+    uring->buf_ring_size = URING_BUFFERS * sizeof(struct io_uring_buf);
+    uring->buf_ring = (struct io_uring_buf_ring *)mmap(
+        NULL, uring->buf_ring_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (uring->buf_ring == MAP_FAILED) {
+        uring->buf_ring = NULL;
+        LTRACK_E("TeonetClient", "io_uring buffer ring allocation failed");
+        teoLNullUringDestroy(uring);
+        return NULL;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)uring->buf_ring;
+    reg.ring_entries = URING_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (uring->buffers == NULL ||
+        _uringRegister(uring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) ==
+            -1) {
+        LTRACK_E("TeonetClient", "io_uring buffer ring register failed: %s",
+                 strerror(errno));
+        teoLNullUringDestroy(uring);
+        return NULL;
+    }
+
+    for (uint16_t bid = 0; bid < URING_BUFFERS; ++bid) {
+        _uringBufferGive(uring, bid);
+    }
+    _uringBuffersPublish(uring);
+
+    // Send slots are free
+    for (int i = 0; i < URING_SEND_SLOTS; ++i) {
+        uring->slots[i].next = i + 1 < URING_SEND_SLOTS ? i + 1 : -1;
+    }
+    uring->free_slot = 0;
+
+    // Received datagram is preceded by io_uring_recvmsg_out and source address
+    uring->recv_msg.msg_namelen = sizeof(struct sockaddr_in);
+
+    _uringArmRecv(uring);
+    if (_uringFlush(uring, 0, 0) == -1) {
+        LTRACK_E("TeonetClient", "io_uring submit failed: %s",
+                 strerror(errno));
+        teoLNullUringDestroy(uring);
+        return NULL;
+    }
+
+    return uring;
+}
+
+/**
+ * Wait for queued sends to complete before ring is closed
+ *
+ * @param uring Ring
+ */
+static void _uringDrainSends(teoLNullUring *uring) {
+    for (int attempt = 0; attempt < URING_DRAIN_ATTEMPTS; ++attempt) {
+        _uringPrepareSends(uring);
+        if (uring->sends_inflight == 0) { return; }
+
+        const unsigned ready =
+            __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE) -
+            *uring->cq_head;
+        if (_uringFlush(uring, ready + 1, URING_DRAIN_TIMEOUT_US) == -1 &&
+            errno != ETIME && errno != EINTR) {
+            return;
+        }
+        _uringScanSends(uring);
+    }
+}
+
+void teoLNullUringDestroy(teoLNullUring *uring) {
+    if (uring == NULL) { return; }
+
+    // Closing ring cancels its requests
+    if (uring->cqes != NULL && uring->sqes != NULL) { _uringDrainSends(uring); }
+    if (uring->ring_fd != -1) { close(uring->ring_fd); }
+
+    if (uring->sqes != NULL) { munmap(uring->sqes, uring->sqes_size); }
+    if (uring->cq_ring_size && uring->cq_ring != NULL) {
+        munmap(uring->cq_ring, uring->cq_ring_size);
+    }
+    if (uring->sq_ring != NULL) { munmap(uring->sq_ring, uring->sq_ring_size); }
+    if (uring->buf_ring != NULL) {
+        munmap(uring->buf_ring, uring->buf_ring_size);
+    }
+
+    for (int i = 0; i < URING_SEND_SLOTS; ++i) {
+        if (uring->slots[i].data != NULL) { free(uring->slots[i].data); }
+    }
+
+    if (uring->buffers != NULL) { free(uring->buffers); }
+    free(uring);
+}
+
+teonetSocket teoLNullUringFd(const teoLNullUring *uring) {
+    return uring->ring_fd;
+}
+
+bool teoLNullUringWatch(teoLNullUring *uring, int fd) {
+    uring->watch_fd = fd;
+    _uringArmWatch(uring);
+
+    if (_uringFlush(uring, 0, 0) == -1) {
+        LTRACK_E("TeonetClient", "io_uring submit failed: %s",
+                 strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool teoLNullUringSend(teoLNullUring *uring, const struct iovec *parts, int n,
+                       const struct sockaddr_in *addr) {
+    if (!uring->datagram && uring->closed) { return false; }
+
+    // All slots are used: wait for sends to complete
+    while (uring->free_slot == -1) {
+        if (!uring->datagram && uring->closed) { return false; }
+        if (_uringPrepareSends(uring) > 0 || uring->free_slot == -1) {
+            const unsigned ready =
+                __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE) -
+                *uring->cq_head;
+            if (_uringFlush(uring, ready + 1, -1) == -1 && errno != EINTR) {
+                LTRACK_E("TeonetClient", "io_uring wait failed: %s",
+                         strerror(errno));
+                return false;
+            }
+        }
+        _uringScanSends(uring);
+    }
+
+    size_t length = 0;
+    for (int i = 0; i < n; ++i) { length += parts[i].iov_len; }
+
+    const int index = uring->free_slot;
+    teoLNullUringSlot *slot = &uring->slots[index];
+
+    if (slot->capacity < length) {
+        uint8_t *data = (uint8_t *)ccl_realloc(slot->data, length);
+        if (data == NULL) { return false; }
+
+        slot->data = data;
+        slot->capacity = length;
+    }
+
+    uring->free_slot = slot->next;
+
+    size_t offset = 0;
+    for (int i = 0; i < n; ++i) {
+        memcpy(slot->data + offset, parts[i].iov_base, parts[i].iov_len);
+        offset += parts[i].iov_len;
+    }
+    slot->length = length;
+
+    if (uring->datagram) {
+        slot->addr = *addr;
+        slot->iov.iov_base = slot->data;
+        slot->iov.iov_len = length;
+        memset(&slot->msg, 0, sizeof(slot->msg));
+        slot->msg.msg_name = &slot->addr;
+        slot->msg.msg_namelen = sizeof(slot->addr);
+        slot->msg.msg_iov = &slot->iov;
+        slot->msg.msg_iovlen = 1;
+    }
+
+    slot->next = -1;
+    if (uring->pending_head == -1) {
+        uring->pending_head = index;
+    } else {
+        uring->slots[uring->pending_tail].next = index;
+    }
+    uring->pending_tail = index;
+
+    return true;
+}
+
+int teoLNullUringSubmit(teoLNullUring *uring) {
+    int count = _uringPrepareSends(uring);
+
+    if (_uringFlush(uring, 0, 0) == -1) {
+        LTRACK_E("TeonetClient", "io_uring submit failed: %s",
+                 strerror(errno));
+        return -1;
+    }
+
+    return count;
+}
+
+int teoLNullUringProcess(teoLNullUring *uring, int64_t timeout,
+                         teoLNullUdpReceiveCb recv_cb,
+                         teoLNullUringWatchCb watch_cb, void *user_data) {
+    _uringPrepareSends(uring);
+
+    // Queued sends are submitted by the same system call which waits
+    const bool empty = *uring->cq_head ==
+                       __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    if (_uringFlush(uring, empty && timeout != 0 ? 1 : 0, timeout) == -1) {
+        if (errno == ETIME || errno == EINTR) { return 0; }
+
+        LTRACK_E("TeonetClient", "io_uring wait failed: %s", strerror(errno));
+        return -1;
+    }
+
+    int processed = 0;
+
+    for (;;) {
+        const unsigned head = *uring->cq_head;
+        if (head == __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        // Entry is consumed before callbacks, they may send and scan queue
+        const struct io_uring_cqe cqe = uring->cqes[head & uring->cq_mask];
+        __atomic_store_n(uring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+        switch (cqe.user_data & URING_TAG_MASK) {
+        case URING_TAG_SEND:
+            _uringSendComplete(uring, (int)(cqe.user_data >> URING_TAG_BITS),
+                               cqe.res);
+            break;
+
+        case URING_TAG_RECV:
+            if (!uring->closed) {
+                processed += _uringRecvComplete(uring, &cqe, recv_cb,
+                                                user_data);
+            }
+            break;
+
+        case URING_TAG_WATCH:
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                uring->watch_armed = false;
+            }
+            if (cqe.res > 0 && watch_cb != NULL) {
+                watch_cb(user_data);
+                ++processed;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    _uringBuffersPublish(uring);
+
+    // Requests ended by error or by lack of buffers are started again
+    if (!uring->recv_armed && !uring->closed) { _uringArmRecv(uring); }
+    if (!uring->watch_armed && uring->watch_fd != -1) {
+        _uringArmWatch(uring);
+    }
+
+    _uringPrepareSends(uring);
+    if (_uringFlush(uring, 0, 0) == -1) {
+        LTRACK_E("TeonetClient", "io_uring submit failed: %s",
+                 strerror(errno));
+        return -1;
+    }
+
+    return processed;
+}
+
+bool teoLNullUringClosed(const teoLNullUring *uring) { return uring->closed; }
+
+#else
+
+teoLNullUring *teoLNullUringCreate(teonetSocket fd, bool datagram,
+                                   size_t buffer_size) {
+    (void)fd;
+    (void)datagram;
+    (void)buffer_size;
+    LTRACK_E("TeonetClient", "io_uring is not supported on this platform");
+    return NULL;
+}
+
+void teoLNullUringDestroy(teoLNullUring *uring) { (void)uring; }
+
+teonetSocket teoLNullUringFd(const teoLNullUring *uring) {
+    (void)uring;
+    return TEOSOCK_INVALID_SOCKET;
+}
+
+bool teoLNullUringWatch(teoLNullUring *uring, int fd) {
+    (void)uring;
+    (void)fd;
+    return false;
+}
+
+bool teoLNullUringSend(teoLNullUring *uring, const struct iovec *parts, int n,
+                       const struct sockaddr_in *addr) {
+    (void)uring;
+    (void)parts;
+    (void)n;
+    (void)addr;
+    return false;
+}
+
+int teoLNullUringSubmit(teoLNullUring *uring) {
+    (void)uring;
+    return -1;
+}
+
+int teoLNullUringProcess(teoLNullUring *uring, int64_t timeout,
+                         teoLNullUdpReceiveCb recv_cb,
+                         teoLNullUringWatchCb watch_cb, void *user_data) {
+    (void)uring;
+    (void)timeout;
+    (void)recv_cb;
+    (void)watch_cb;
+    (void)user_data;
+    return -1;
+}
+
+bool teoLNullUringClosed(const teoLNullUring *uring) {
+    (void)uring;
+    return true;
+}
+
+#endif
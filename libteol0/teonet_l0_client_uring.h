@@ -0,0 +1,143 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_URING_H
+#define TEONET_L0_CLIENT_URING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teobase/socket.h"
+
+#include "teonet_l0_client.h"
+#include "teonet_l0_client_udp.h"
+
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// io_uring socket backend
+/////////////////
+
+/**
+ * Watched descriptor callback
+ *
+ * @param user_data Pointer passed to teoLNullUringProcess
+ */
+typedef void (*teoLNullUringWatchCb)(void *user_data);
+
+/**
+ * Create io_uring for connection socket
+ *
+ * Socket is received by multishot receive into buffers provided to kernel by
+ * buffer ring, so one wait returns all received data without receive system
+ * calls.
+ *
+ * @param fd Connected TCP socket or bound UDP socket
+ * @param datagram UDP socket, datagrams are received with source address
+ * @param buffer_size Size of one receive buffer
+ *
+ * @return Pointer to created ring or NULL if io_uring or features used are
+ *  not supported by kernel or platform
+ */
+TEOCLI_INTERNAL teoLNullUring *teoLNullUringCreate(teonetSocket fd,
+                                                   bool datagram,
+                                                   size_t buffer_size);
+
+/**
+ * Destroy io_uring, pending sends are canceled
+ *
+ * @param uring Ring to destroy, may be NULL
+ */
+TEOCLI_INTERNAL void teoLNullUringDestroy(teoLNullUring *uring);
+
+/**
+ * Get ring descriptor which is readable when ring has completions
+ *
+ * @param uring Ring
+ *
+ * @return Ring descriptor
+ */
+TEOCLI_INTERNAL teonetSocket teoLNullUringFd(const teoLNullUring *uring);
+
+/**
+ * Watch descriptor readability by multishot poll in ring
+ *
+ * @param uring Ring
+ * @param fd Descriptor to watch, teoLNullUringProcess calls watch callback
+ *  when it becomes readable
+ *
+ * @return true on success
+ */
+TEOCLI_INTERNAL bool teoLNullUringWatch(teoLNullUring *uring, int fd);
+
+/**
+ * Queue data to send
+ *
+ * Data is copied and sent by next teoLNullUringSubmit or
+ * teoLNullUringProcess call. TCP data is sent in order: sends submitted
+ * together are linked, next submit waits for previous sends to complete.
+ * Waits for completions if too many sends are not completed.
+ *
+ * @param uring Ring
+ * @param parts Data buffers
+ * @param n Number of buffers in @a parts
+ * @param addr Datagram destination for UDP socket, NULL for TCP
+ *
+ * @return true on success, false at error or if TCP connection is closed
+ */
+TEOCLI_INTERNAL bool teoLNullUringSend(teoLNullUring *uring,
+                                       const struct iovec *parts, int n,
+                                       const struct sockaddr_in *addr);
+
+/**
+ * Submit queued sends by one system call
+ *
+ * @param uring Ring
+ *
+ * @return Number of submitted sends or -1 at error
+ */
+TEOCLI_INTERNAL int teoLNullUringSubmit(teoLNullUring *uring);
+
+/**
+ * Wait for ring completions during timeout and process them
+ *
+ * Received data is passed to @a recv_cb, buffers are given back to kernel
+ * after callback returns. Queued sends are submitted.
+ *
+ * @param uring Ring
+ * @param timeout Timeout in microseconds, 0 to process completions without
+ *  waiting or negative value to wait without timeout
+ * @param recv_cb Received data callback, source address is NULL for TCP
+ * @param watch_cb Watched descriptor callback, may be NULL
+ * @param user_data Pointer passed to callbacks
+ *
+ * @return Number of processed receive and watch completions, 0 at timeout
+ *  or -1 at error
+ */
+TEOCLI_INTERNAL int teoLNullUringProcess(teoLNullUring *uring,
+                                         int64_t timeout,
+                                         teoLNullUdpReceiveCb recv_cb,
+                                         teoLNullUringWatchCb watch_cb,
+                                         void *user_data);
+
+/**
+ * Check if TCP socket was closed by peer or failed
+ *
+ * Failed or short send closes TCP connection too, as sent stream would
+ * have a gap.
+ *
+ * @param uring Ring
+ *
+ * @return true if no more data will be received
+ */
+TEOCLI_INTERNAL bool teoLNullUringClosed(const teoLNullUring *uring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_URING_H */
@@ -5,6 +5,102 @@
 #include <string.h>
 #include <assert.h>
 #include "tinycrypt.h"
+#include "tinycrypt_aesni.h"
+
+static AES128_1_Backend aes_backend = AES128_1_BACKEND_AUTO;
+
+int AES128_1_SetBackend(AES128_1_Backend backend) {
+  if (backend == AES128_1_BACKEND_AESNI && !AES128_aesni_supported()) {
+    return 0;
+  }
+  aes_backend = backend;
+  return 1;
+}
+
+static int use_aesni(void) {
+  return aes_backend != AES128_1_BACKEND_PORTABLE && AES128_aesni_supported();
+}
+
+/// CTR mode over message with the selected AES implementation
+static void xcrypt_ctr(const AES128_1_Engine* engine, const uint8_t* iv,
+                       uint8_t* message, size_t message_len) {
+  if (use_aesni()) {
+    AES128_CTR_xcrypt_aesni(engine->ctx.RoundKey, iv, message, message_len);
+    return;
+  }
+
+  // tiny-AES-c keeps counter in context, shared engine is left unchanged
+  struct AES_ctx ctx = engine->ctx;
+  AES_ctx_set_iv(&ctx, iv);
+  AES_CTR_xcrypt_buffer(&ctx, message, message_len);
+  zero_bytes((uint8_t*)&ctx, sizeof(ctx));
+}
+
+/// CTR mode copying src to dst from offset of message, with byte sums
+static void xcrypt_ctr_copy(const AES128_1_Engine* engine, const uint8_t* iv,
+                            size_t offset, const uint8_t* src, uint8_t* dst,
+                            size_t len, uint32_t* src_sum, uint32_t* dst_sum) {
+  // counter block of offset is iv + offset / AES_BLOCKLEN, big-endian
+  uint8_t counter[AES_BLOCKLEN];
+  memcpy(counter, iv, sizeof(counter));
+  size_t carry = offset / AES_BLOCKLEN;
+  for (int it = AES_BLOCKLEN - 1; it >= 0 && carry != 0; --it) {
+    carry += counter[it];
+    counter[it] = (uint8_t)carry;
+    carry >>= 8;
+  }
+  size_t skip = offset % AES_BLOCKLEN;
+
+  if (use_aesni()) {
+    AES128_CTR_xcrypt_copy_aesni(engine->ctx.RoundKey, counter, skip, src, dst,
+                                 len, src_sum, dst_sum);
+    return;
+  }
+
+  struct AES_ctx ctx = engine->ctx;
+  AES_ctx_set_iv(&ctx, counter);
+
+  uint32_t src_total = 0;
+  uint32_t dst_total = 0;
+  uint8_t keystream[AES_BLOCKLEN];
+  while (len > 0) {
+    // keystream block is encryption of zeros, context moves to next counter
+    zero_bytes(keystream, sizeof(keystream));
+    AES_CTR_xcrypt_buffer(&ctx, keystream, sizeof(keystream));
+    for (size_t it = skip; it < sizeof(keystream) && len > 0; ++it, --len) {
+      uint8_t in = *src++;
+      uint8_t out = in ^ keystream[it];
+      *dst++ = out;
+      src_total += in;
+      dst_total += out;
+    }
+    skip = 0;
+  }
+  zero_bytes(keystream, sizeof(keystream));
+  zero_bytes((uint8_t*)&ctx, sizeof(ctx));
+
+  if (src_sum != NULL) {
+    *src_sum += src_total;
+  }
+  if (dst_sum != NULL) {
+    *dst_sum += dst_total;
+  }
+}
+
+void AES128_1_EngineCreate(AES128_1_Engine* engine, const AES128_1_KEY* key) {
+  static_assert(sizeof(engine->ctx.RoundKey) == AES128_AESNI_SCHEDULE_SIZE,
+                "Must be equivalent");
+  zero_bytes((uint8_t*)engine, sizeof(*engine));
+  if (use_aesni()) {
+    AES128_aesni_expand_key(key->data, engine->ctx.RoundKey);
+  } else {
+    AES_init_ctx(&engine->ctx, key->data);
+  }
+}
+
+void AES128_1_EngineDestroy(AES128_1_Engine* engine) {
+  zero_bytes((uint8_t*)engine, sizeof(*engine));
+}
 
 void randomize_bytes(volatile uint8_t* bytes, size_t size) {
   // random source via traits/strategy
@@ -78,23 +174,29 @@ const char* initApplyRemoteKey(PeerKeyset* keys, const ECDHPubkey* remote,
   return NULL;
 };
 
-void HMAC_AES128_1(const AES128_1_KEY* key, uint8_t* message,
-                   size_t message_len) {
+void AES128_1_EngineHMAC(const AES128_1_Engine* engine, uint8_t* message,
+                         size_t message_len) {
   AES128_1_BLOCK iv;
 
-  static_assert(sizeof(key->data) == AES_KEYLEN, "Must be equivalent");
   static_assert(sizeof(iv.data) == AES_BLOCKLEN, "Must be equivalent");
 
   zero_bytes(iv.data, sizeof(iv.data));
 
-  struct AES_ctx ctx;
-  AES_init_ctx_iv(&ctx, key->data, iv.data);
-  AES_CTR_xcrypt_buffer(&ctx, message, message_len);
+  xcrypt_ctr(engine, iv.data, message, message_len);
 }
 
-void XCrypt_AES128_1(const AES128_1_KEY* key, uint32_t nonce, uint8_t* message,
-                     size_t message_len) {
+void HMAC_AES128_1(const AES128_1_KEY* key, uint8_t* message,
+                   size_t message_len) {
   static_assert(sizeof(key->data) == AES_KEYLEN, "Must be equivalent");
+
+  AES128_1_Engine engine;
+  AES128_1_EngineCreate(&engine, key);
+  AES128_1_EngineHMAC(&engine, message, message_len);
+  AES128_1_EngineDestroy(&engine);
+}
+
+/// CTR initial counter block of message with nonce
+static void nonce_iv(uint32_t nonce, AES128_1_BLOCK* iv) {
   // HINT hardcoded init vector
   static uint8_t hardIv[] = {
       0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
@@ -102,17 +204,172 @@ void XCrypt_AES128_1(const AES128_1_KEY* key, uint32_t nonce, uint8_t* message,
   };
   static_assert(sizeof(hardIv) == AES_BLOCKLEN, "Must be equivalent");
 
+  static_assert(sizeof(iv->data) == AES_BLOCKLEN, "Must be equivalent");
+  memcpy(iv->data, hardIv, sizeof(iv->data));
+
+  static_assert(sizeof(iv->data) > sizeof(nonce), "counter must fit in IV");
+  const size_t ofs = sizeof(iv->data) - sizeof(nonce);
+  xor_bytes(iv->data + ofs, (const uint8_t*)(&nonce), sizeof(nonce));
+}
+
+void AES128_1_EngineXCrypt(const AES128_1_Engine* engine, uint32_t nonce,
+                           uint8_t* message, size_t message_len) {
   AES128_1_BLOCK iv;
-  static_assert(sizeof(iv.data) == AES_BLOCKLEN, "Must be equivalent");
-  memcpy(iv.data, hardIv, sizeof(iv.data));
+  nonce_iv(nonce, &iv);
 
-  static_assert(sizeof(iv.data) > sizeof(nonce), "counter must fit in IV");
-  const size_t ofs = sizeof(iv.data) - sizeof(nonce);
-  xor_bytes(iv.data + ofs, (const uint8_t*)(&nonce), sizeof(nonce));
+  xcrypt_ctr(engine, iv.data, message, message_len);
+}
 
-  struct AES_ctx ctx;
-  AES_init_ctx_iv(&ctx, key->data, iv.data);
-  AES_CTR_xcrypt_buffer(&ctx, message, message_len);
+void AES128_1_EngineXCryptCopy(const AES128_1_Engine* engine, uint32_t nonce,
+                               size_t offset, const uint8_t* src, uint8_t* dst,
+                               size_t len, uint32_t* src_sum,
+                               uint32_t* dst_sum) {
+  AES128_1_BLOCK iv;
+  nonce_iv(nonce, &iv);
+
+  xcrypt_ctr_copy(engine, iv.data, offset, src, dst, len, src_sum, dst_sum);
+}
+
+void XCrypt_AES128_1(const AES128_1_KEY* key, uint32_t nonce, uint8_t* message,
+                     size_t message_len) {
+  static_assert(sizeof(key->data) == AES_KEYLEN, "Must be equivalent");
+
+  AES128_1_Engine engine;
+  AES128_1_EngineCreate(&engine, key);
+  AES128_1_EngineXCrypt(&engine, nonce, message, message_len);
+  AES128_1_EngineDestroy(&engine);
+}
+
+/// load 16 bytes as two big-endian integers
+static void load_be128(const uint8_t* bytes, uint64_t* hi, uint64_t* lo) {
+  *hi = 0;
+  *lo = 0;
+  for (int it = 0; it < 8; ++it) {
+    *hi = (*hi << 8) | bytes[it];
+    *lo = (*lo << 8) | bytes[it + 8];
+  }
+}
+
+static void store_be128(uint8_t* bytes, uint64_t hi, uint64_t lo) {
+  for (int it = 7; it >= 0; --it) {
+    bytes[it] = (uint8_t)hi;
+    bytes[it + 8] = (uint8_t)lo;
+    hi >>= 8;
+    lo >>= 8;
+  }
+}
+
+/// GF(2^128) multiplication x = x * h bit by bit, NIST SP 800-38D
+/// algorithm 1
+static void gf_mul_portable(uint8_t* x, const uint8_t* h) {
+  uint64_t x_hi, x_lo, v_hi, v_lo;
+  load_be128(x, &x_hi, &x_lo);
+  load_be128(h, &v_hi, &v_lo);
+
+  uint64_t z_hi = 0;
+  uint64_t z_lo = 0;
+  for (int it = 0; it < 128; ++it) {
+    uint64_t bit = it < 64 ? (x_hi >> (63 - it)) & 1 : (x_lo >> (127 - it)) & 1;
+    uint64_t mask = 0 - bit;
+    z_hi ^= v_hi & mask;
+    z_lo ^= v_lo & mask;
+
+    uint64_t reduce = 0 - (v_lo & 1);
+    v_lo = (v_lo >> 1) | (v_hi << 63);
+    v_hi = (v_hi >> 1) ^ (0xe100000000000000ULL & reduce);
+  }
+
+  store_be128(x, z_hi, z_lo);
+}
+
+/// GHASH state update over data, last partial block is padded with zeros
+static void ghash(const AES128_GCM_Engine* engine, uint8_t* state,
+                  const uint8_t* data, size_t len) {
+  if (use_aesni() && GHASH_pclmul_supported()) {
+    GHASH_pclmul(engine->hash_key.data, state, data, len);
+    return;
+  }
+
+  while (len > 0) {
+    size_t block_len = len < AES_BLOCKLEN ? len : AES_BLOCKLEN;
+    xor_bytes(state, data, block_len);
+    gf_mul_portable(state, engine->hash_key.data);
+    data += block_len;
+    len -= block_len;
+  }
+}
+
+/// counter block J0 = iv || 1, data is encrypted from J0 + 1
+static void gcm_j0(const uint8_t* iv, AES128_1_BLOCK* j0) {
+  static_assert(AES128_GCM_IV_SIZE + 4 == AES_BLOCKLEN, "Must be equivalent");
+  memcpy(j0->data, iv, AES128_GCM_IV_SIZE);
+  j0->data[12] = 0;
+  j0->data[13] = 0;
+  j0->data[14] = 0;
+  j0->data[15] = 1;
+}
+
+void AES128_GCM_EngineCreate(AES128_GCM_Engine* engine,
+                             const AES128_1_KEY* key) {
+  AES128_1_EngineCreate(&engine->aes, key);
+
+  AES128_1_BLOCK zero;
+  zero_bytes(zero.data, sizeof(zero.data));
+  zero_bytes(engine->hash_key.data, sizeof(engine->hash_key.data));
+  xcrypt_ctr(&engine->aes, zero.data, engine->hash_key.data,
+             sizeof(engine->hash_key.data));
+}
+
+void AES128_GCM_XCryptCopy(const AES128_GCM_Engine* engine, const uint8_t* iv,
+                           size_t offset, const uint8_t* src, uint8_t* dst,
+                           size_t len, uint32_t* src_sum, uint32_t* dst_sum) {
+  // GCM increments only low 32 bits of counter, 128-bit increment of CTR
+  // kernels is the same while message is shorter than 2^32 - 2 blocks
+  AES128_1_BLOCK counter;
+  gcm_j0(iv, &counter);
+  counter.data[15] = 2;
+
+  xcrypt_ctr_copy(&engine->aes, counter.data, offset, src, dst, len, src_sum,
+                  dst_sum);
+}
+
+void AES128_GCM_Tag(const AES128_GCM_Engine* engine, const uint8_t* iv,
+                    const uint8_t* aad, size_t aad_len,
+                    const uint8_t* ciphertext, size_t len, uint8_t* tag) {
+  AES128_1_BLOCK state;
+  zero_bytes(state.data, sizeof(state.data));
+  ghash(engine, state.data, aad, aad_len);
+  ghash(engine, state.data, ciphertext, len);
+
+  AES128_1_BLOCK lengths;
+  store_be128(lengths.data, (uint64_t)aad_len * 8, (uint64_t)len * 8);
+  ghash(engine, state.data, lengths.data, sizeof(lengths.data));
+
+  // tag = GHASH ^ AES(K, J0)
+  AES128_1_BLOCK j0;
+  gcm_j0(iv, &j0);
+  xcrypt_ctr(&engine->aes, j0.data, state.data, sizeof(state.data));
+
+  memcpy(tag, state.data, AES128_GCM_TAG_SIZE);
+  zero_bytes(state.data, sizeof(state.data));
+}
+
+int AES128_GCM_Check(const AES128_GCM_Engine* engine, const uint8_t* iv,
+                     const uint8_t* aad, size_t aad_len,
+                     const uint8_t* ciphertext, size_t len,
+                     const uint8_t* tag) {
+  uint8_t expected[AES128_GCM_TAG_SIZE];
+  AES128_GCM_Tag(engine, iv, aad, aad_len, ciphertext, len, expected);
+
+  uint8_t diff = 0;
+  for (size_t it = 0; it < sizeof(expected); ++it) {
+    diff |= expected[it] ^ tag[it];
+  }
+  return diff == 0;
+}
+
+void AES128_GCM_EngineDestroy(AES128_GCM_Engine* engine) {
+  zero_bytes((uint8_t*)engine, sizeof(*engine));
 }
 
 // TODO add different algos
@@ -121,6 +378,10 @@ void PBKDF2_AES128_1(const AES128_1_KEY* key, const AES128_1_BLOCK* salt,
   static_assert(sizeof(key->data) == AES_KEYLEN, "Must be equivalent");
   static_assert(sizeof(salt->data) == AES_BLOCKLEN, "Must be equivalent");
 
+  // key is expanded once for all n_rounds * blocks HMAC calls
+  AES128_1_Engine engine;
+  AES128_1_EngineCreate(&engine, key);
+
   AES128_1_BLOCK U_n;
   uint64_t curRound = 1;
   static_assert(sizeof(U_n.data) > sizeof(curRound), "counter must fit in IV");
@@ -138,7 +399,7 @@ void PBKDF2_AES128_1(const AES128_1_KEY* key, const AES128_1_BLOCK* salt,
     AES128_1_BLOCK T_i;
     zero_bytes(T_i.data, sizeof(T_i.data));
     for (int N = 1; N <= n_rounds; ++N) {
-      HMAC_AES128_1(key, U_n.data, sizeof(U_n.data));
+      AES128_1_EngineHMAC(&engine, U_n.data, sizeof(U_n.data));
       xor_bytes(T_i.data, U_n.data, sizeof(U_n.data));
     }
 
@@ -150,4 +411,6 @@ void PBKDF2_AES128_1(const AES128_1_KEY* key, const AES128_1_BLOCK* salt,
     writePos += writeLen;
     curRound++;
   }
+
+  AES128_1_EngineDestroy(&engine);
 }
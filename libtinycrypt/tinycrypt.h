@@ -70,6 +70,84 @@ void XCrypt_AES128_1(const AES128_1_KEY* key, uint32_t nonce, uint8_t* message,
 void PBKDF2_AES128_1(const AES128_1_KEY* key, const AES128_1_BLOCK* salt,
                      int n_rounds, uint8_t* derived_key, size_t dk_len);
 
+/// AES key with expanded round keys, made once per key instead of once per
+/// message. Contains no pointers, may be copied. Round keys have the same
+/// layout in all implementations.
+typedef struct {
+  struct AES_ctx ctx;
+} AES128_1_Engine;
+
+///< expand key to engine round keys
+void AES128_1_EngineCreate(AES128_1_Engine* engine, const AES128_1_KEY* key);
+
+///< same as XCrypt_AES128_1 with engine key, engine isn't changed so it may
+///< be used by several threads
+void AES128_1_EngineXCrypt(const AES128_1_Engine* engine, uint32_t nonce,
+                           uint8_t* message, size_t message_len);
+
+///< AES128_1_EngineXCrypt of message part in one pass: reads len bytes at
+///< src and writes them to dst, offset is position of src in message so
+///< message may be processed by parts. src may be equal to dst. Sums of src
+///< and dst bytes are added to src_sum and dst_sum, both may be NULL.
+void AES128_1_EngineXCryptCopy(const AES128_1_Engine* engine, uint32_t nonce,
+                               size_t offset, const uint8_t* src, uint8_t* dst,
+                               size_t len, uint32_t* src_sum,
+                               uint32_t* dst_sum);
+
+///< same as HMAC_AES128_1 with engine key
+void AES128_1_EngineHMAC(const AES128_1_Engine* engine, uint8_t* message,
+                         size_t message_len);
+
+///< wipe engine round keys
+void AES128_1_EngineDestroy(AES128_1_Engine* engine);
+
+#define AES128_GCM_IV_SIZE 12
+#define AES128_GCM_TAG_SIZE 16
+
+/// AES-128-GCM key: expanded AES key and GHASH key H = AES(K, 0)
+typedef struct {
+  AES128_1_Engine aes;
+  AES128_1_BLOCK hash_key;
+} AES128_GCM_Engine;
+
+///< expand key and compute GHASH key
+void AES128_GCM_EngineCreate(AES128_GCM_Engine* engine,
+                             const AES128_1_KEY* key);
+
+///< GCM encryption/decryption of message part, arguments are the same as of
+///< AES128_1_EngineXCryptCopy. iv has AES128_GCM_IV_SIZE bytes, message must
+///< be shorter than 64 GB.
+void AES128_GCM_XCryptCopy(const AES128_GCM_Engine* engine, const uint8_t* iv,
+                           size_t offset, const uint8_t* src, uint8_t* dst,
+                           size_t len, uint32_t* src_sum, uint32_t* dst_sum);
+
+///< compute AES128_GCM_TAG_SIZE bytes tag of additional data aad and
+///< ciphertext
+void AES128_GCM_Tag(const AES128_GCM_Engine* engine, const uint8_t* iv,
+                    const uint8_t* aad, size_t aad_len,
+                    const uint8_t* ciphertext, size_t len, uint8_t* tag);
+
+///< returns nonzero if tag is valid for aad and ciphertext, compares in
+///< constant time
+int AES128_GCM_Check(const AES128_GCM_Engine* engine, const uint8_t* iv,
+                     const uint8_t* aad, size_t aad_len,
+                     const uint8_t* ciphertext, size_t len,
+                     const uint8_t* tag);
+
+///< wipe engine keys
+void AES128_GCM_EngineDestroy(AES128_GCM_Engine* engine);
+
+/// AES implementation used by XCrypt_AES128_1, HMAC_AES128_1 and engines,
+/// all of them give identical output
+typedef enum {
+  AES128_1_BACKEND_AUTO,      ///< AES-NI if CPU supports it, portable else
+  AES128_1_BACKEND_PORTABLE,  ///< tiny-AES-c, bitwise GHASH
+  AES128_1_BACKEND_AESNI,     ///< AES-NI, pipelined CTR, PCLMULQDQ GHASH
+} AES128_1_Backend;
+
+///< select AES implementation, returns zero if CPU doesn't support it
+int AES128_1_SetBackend(AES128_1_Backend backend);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,339 @@
+#include <stdint.h>
+#include <string.h>
+#include "tinycrypt_aesni.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define TINYCRYPT_HAVE_AESNI 1
+#endif
+
+#if defined(TINYCRYPT_HAVE_AESNI)
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <stdlib.h>
+#define AESNI_TARGET
+#define PCLMUL_TARGET
+#define bswap64(x) _byteswap_uint64(x)
+#else
+#include <cpuid.h>
+// functions using AES-NI are compiled for it without global -maes, so the
+// library still runs on CPUs without AES-NI
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+#define PCLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+#define bswap64(x) __builtin_bswap64(x)
+#endif
+
+// number of counter blocks encrypted in parallel, AES-NI latency is hidden
+// by independent blocks
+#define AESNI_PIPELINE 8
+#define AES128_ROUNDS 10
+
+int AES128_aesni_supported(void) {
+  static volatile int supported = -1;
+  if (supported < 0) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    supported = (info[2] & (1 << 25)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    supported = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) != 0;
+#endif
+  }
+  return supported;
+}
+
+AESNI_TARGET static inline __m128i expand_step(__m128i key, __m128i assist) {
+  assist = _mm_shuffle_epi32(assist, _MM_SHUFFLE(3, 3, 3, 3));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, assist);
+}
+
+// round constant must be immediate
+#define EXPAND_KEY(rk, i, rcon) \
+  rk[i] = expand_step(rk[i - 1], _mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+AESNI_TARGET void AES128_aesni_expand_key(const uint8_t* key,
+                                          uint8_t* round_keys) {
+  __m128i rk[AES128_ROUNDS + 1];
+  rk[0] = _mm_loadu_si128((const __m128i*)key);
+  EXPAND_KEY(rk, 1, 0x01);
+  EXPAND_KEY(rk, 2, 0x02);
+  EXPAND_KEY(rk, 3, 0x04);
+  EXPAND_KEY(rk, 4, 0x08);
+  EXPAND_KEY(rk, 5, 0x10);
+  EXPAND_KEY(rk, 6, 0x20);
+  EXPAND_KEY(rk, 7, 0x40);
+  EXPAND_KEY(rk, 8, 0x80);
+  EXPAND_KEY(rk, 9, 0x1b);
+  EXPAND_KEY(rk, 10, 0x36);
+
+  for (int round = 0; round <= AES128_ROUNDS; ++round) {
+    _mm_storeu_si128((__m128i*)round_keys + round, rk[round]);
+  }
+}
+
+/// big-endian 128-bit counter block kept as two native integers
+typedef struct {
+  uint64_t hi;
+  uint64_t lo;
+} CtrBlock;
+
+AESNI_TARGET static inline __m128i ctr_next(CtrBlock* ctr) {
+  __m128i block = _mm_set_epi64x((long long)bswap64(ctr->lo),
+                                 (long long)bswap64(ctr->hi));
+  if (++ctr->lo == 0) {
+    ++ctr->hi;
+  }
+  return block;
+}
+
+AESNI_TARGET static inline __m128i encrypt_block(const __m128i* rk,
+                                                 __m128i block) {
+  block = _mm_xor_si128(block, rk[0]);
+  for (int round = 1; round < AES128_ROUNDS; ++round) {
+    block = _mm_aesenc_si128(block, rk[round]);
+  }
+  return _mm_aesenclast_si128(block, rk[AES128_ROUNDS]);
+}
+
+/// xor block of src with keystream to dst, add byte sums to accumulators
+AESNI_TARGET static inline void xor_block(const uint8_t* src, uint8_t* dst,
+                                          __m128i keystream, __m128i* src_acc,
+                                          __m128i* dst_acc) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i in = _mm_loadu_si128((const __m128i*)src);
+  __m128i out = _mm_xor_si128(in, keystream);
+  _mm_storeu_si128((__m128i*)dst, out);
+  *src_acc = _mm_add_epi64(*src_acc, _mm_sad_epu8(in, zero));
+  *dst_acc = _mm_add_epi64(*dst_acc, _mm_sad_epu8(out, zero));
+}
+
+/// xor len bytes of src with keystream to dst, add byte sums to totals
+static inline void xor_tail(const uint8_t* src, uint8_t* dst,
+                            const uint8_t* keystream, size_t len,
+                            uint64_t* src_total, uint64_t* dst_total) {
+  for (size_t it = 0; it < len; ++it) {
+    uint8_t in = src[it];
+    uint8_t out = in ^ keystream[it];
+    dst[it] = out;
+    *src_total += in;
+    *dst_total += out;
+  }
+}
+
+/// sum of two 64-bit lanes modulo 2^32, enough for 32-bit sums
+AESNI_TARGET static inline uint32_t acc_total(__m128i acc) {
+  return (uint32_t)_mm_cvtsi128_si32(acc) +
+         (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+}
+
+AESNI_TARGET void AES128_CTR_xcrypt_copy_aesni(const uint8_t* round_keys,
+                                               const uint8_t* iv, size_t skip,
+                                               const uint8_t* src,
+                                               uint8_t* dst, size_t len,
+                                               uint32_t* src_sum,
+                                               uint32_t* dst_sum) {
+  __m128i rk[AES128_ROUNDS + 1];
+  for (int round = 0; round <= AES128_ROUNDS; ++round) {
+    rk[round] = _mm_loadu_si128((const __m128i*)round_keys + round);
+  }
+
+  CtrBlock ctr;
+  uint64_t part;
+  memcpy(&part, iv, sizeof(part));
+  ctr.hi = bswap64(part);
+  memcpy(&part, iv + sizeof(part), sizeof(part));
+  ctr.lo = bswap64(part);
+
+  // sums of whole blocks are kept in vector lanes, of single bytes in totals
+  __m128i src_acc = _mm_setzero_si128();
+  __m128i dst_acc = _mm_setzero_si128();
+  uint64_t src_total = 0;
+  uint64_t dst_total = 0;
+
+  if (skip > 0 && len > 0) {
+    uint8_t keystream[sizeof(__m128i)];
+    _mm_storeu_si128((__m128i*)keystream, encrypt_block(rk, ctr_next(&ctr)));
+    size_t head = sizeof(__m128i) - skip;
+    if (head > len) {
+      head = len;
+    }
+    xor_tail(src, dst, keystream + skip, head, &src_total, &dst_total);
+    src += head;
+    dst += head;
+    len -= head;
+  }
+
+  const size_t pipeline_len = AESNI_PIPELINE * sizeof(__m128i);
+  for (; len >= pipeline_len;
+       src += pipeline_len, dst += pipeline_len, len -= pipeline_len) {
+    __m128i blocks[AESNI_PIPELINE];
+    for (int i = 0; i < AESNI_PIPELINE; ++i) {
+      blocks[i] = _mm_xor_si128(ctr_next(&ctr), rk[0]);
+    }
+    for (int round = 1; round < AES128_ROUNDS; ++round) {
+      for (int i = 0; i < AESNI_PIPELINE; ++i) {
+        blocks[i] = _mm_aesenc_si128(blocks[i], rk[round]);
+      }
+    }
+    for (int i = 0; i < AESNI_PIPELINE; ++i) {
+      blocks[i] = _mm_aesenclast_si128(blocks[i], rk[AES128_ROUNDS]);
+      xor_block(src + i * sizeof(__m128i), dst + i * sizeof(__m128i),
+                blocks[i], &src_acc, &dst_acc);
+    }
+  }
+
+  for (; len >= sizeof(__m128i);
+       src += sizeof(__m128i), dst += sizeof(__m128i), len -= sizeof(__m128i)) {
+    xor_block(src, dst, encrypt_block(rk, ctr_next(&ctr)), &src_acc,
+              &dst_acc);
+  }
+
+  if (len > 0) {
+    uint8_t keystream[sizeof(__m128i)];
+    _mm_storeu_si128((__m128i*)keystream, encrypt_block(rk, ctr_next(&ctr)));
+    xor_tail(src, dst, keystream, len, &src_total, &dst_total);
+  }
+
+  if (src_sum != NULL) {
+    *src_sum += (uint32_t)(src_total + acc_total(src_acc));
+  }
+  if (dst_sum != NULL) {
+    *dst_sum += (uint32_t)(dst_total + acc_total(dst_acc));
+  }
+}
+
+void AES128_CTR_xcrypt_aesni(const uint8_t* round_keys, const uint8_t* iv,
+                             uint8_t* message, size_t message_len) {
+  AES128_CTR_xcrypt_copy_aesni(round_keys, iv, 0, message, message,
+                               message_len, NULL, NULL);
+}
+
+int GHASH_pclmul_supported(void) {
+  static volatile int supported = -1;
+  if (supported < 0) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    supported = (info[2] & (1 << 1)) != 0 && (info[2] & (1 << 9)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    supported = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+                (ecx & bit_PCLMUL) != 0 && (ecx & bit_SSSE3) != 0;
+#endif
+  }
+  return supported;
+}
+
+/// GF(2^128) multiplication of byte-reflected operands, Intel carry-less
+/// multiplication white paper algorithm with shift and reduction
+PCLMUL_TARGET static inline __m128i gf_mul(__m128i a, __m128i b) {
+  __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+  __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                              _mm_clmulepi64_si128(a, b, 0x01));
+  __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+  lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+  hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+  // shift 256-bit product left by one bit, GCM bit order is reflected
+  __m128i lo_carry = _mm_srli_epi32(lo, 31);
+  __m128i hi_carry = _mm_srli_epi32(hi, 31);
+  lo = _mm_slli_epi32(lo, 1);
+  hi = _mm_slli_epi32(hi, 1);
+  __m128i cross = _mm_srli_si128(lo_carry, 12);
+  hi_carry = _mm_slli_si128(hi_carry, 4);
+  lo_carry = _mm_slli_si128(lo_carry, 4);
+  lo = _mm_or_si128(lo, lo_carry);
+  hi = _mm_or_si128(_mm_or_si128(hi, hi_carry), cross);
+
+  // reduce modulo x^128 + x^7 + x^2 + x + 1
+  __m128i t = _mm_xor_si128(
+      _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+      _mm_slli_epi32(lo, 25));
+  __m128i t_hi = _mm_srli_si128(t, 4);
+  lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+  __m128i r = _mm_xor_si128(
+      _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+      _mm_srli_epi32(lo, 7));
+  r = _mm_xor_si128(r, t_hi);
+  lo = _mm_xor_si128(lo, r);
+  return _mm_xor_si128(hi, lo);
+}
+
+PCLMUL_TARGET void GHASH_pclmul(const uint8_t* hash_key, uint8_t* state,
+                                const uint8_t* data, size_t len) {
+  const __m128i reflect =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  __m128i h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)hash_key),
+                               reflect);
+  __m128i x =
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)state), reflect);
+
+  for (; len >= sizeof(__m128i);
+       data += sizeof(__m128i), len -= sizeof(__m128i)) {
+    __m128i block =
+        _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), reflect);
+    x = gf_mul(_mm_xor_si128(x, block), h);
+  }
+
+  if (len > 0) {
+    uint8_t padded[sizeof(__m128i)] = {0};
+    memcpy(padded, data, len);
+    __m128i block =
+        _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)padded), reflect);
+    x = gf_mul(_mm_xor_si128(x, block), h);
+  }
+
+  _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi8(x, reflect));
+}
+
+#else
+
+int AES128_aesni_supported(void) { return 0; }
+
+void AES128_aesni_expand_key(const uint8_t* key, uint8_t* round_keys) {
+  (void)key;
+  (void)round_keys;
+}
+
+void AES128_CTR_xcrypt_aesni(const uint8_t* round_keys, const uint8_t* iv,
+                             uint8_t* message, size_t message_len) {
+  (void)round_keys;
+  (void)iv;
+  (void)message;
+  (void)message_len;
+}
+
+int GHASH_pclmul_supported(void) { return 0; }
+
+void GHASH_pclmul(const uint8_t* hash_key, uint8_t* state, const uint8_t* data,
+                  size_t len) {
+  (void)hash_key;
+  (void)state;
+  (void)data;
+  (void)len;
+}
+
+void AES128_CTR_xcrypt_copy_aesni(const uint8_t* round_keys, const uint8_t* iv,
+                                  size_t skip, const uint8_t* src,
+                                  uint8_t* dst, size_t len, uint32_t* src_sum,
+                                  uint32_t* dst_sum) {
+  (void)round_keys;
+  (void)iv;
+  (void)skip;
+  (void)src;
+  (void)dst;
+  (void)len;
+  (void)src_sum;
+  (void)dst_sum;
+}
+
+#endif
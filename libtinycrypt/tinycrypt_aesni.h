@@ -0,0 +1,47 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/// size of AES-128 round keys: 11 blocks of 16 bytes
+#define AES128_AESNI_SCHEDULE_SIZE 176
+
+/// returns nonzero if CPU supports AES-NI instructions, checked once
+int AES128_aesni_supported(void);
+
+/// expand AES-128 key to round_keys of AES128_AESNI_SCHEDULE_SIZE bytes. Must
+/// be called only if AES128_aesni_supported returns nonzero.
+void AES128_aesni_expand_key(const uint8_t* key, uint8_t* round_keys);
+
+/// AES-128 CTR encryption/decryption with AES-NI, byte-identical to
+/// AES_CTR_xcrypt_buffer of tiny-AES-c: counter block starts from iv and is
+/// incremented as 128-bit big-endian integer. round_keys are made by
+/// AES128_aesni_expand_key.
+void AES128_CTR_xcrypt_aesni(const uint8_t* round_keys, const uint8_t* iv,
+                             uint8_t* message, size_t message_len);
+
+/// AES-128 CTR with AES-NI reading src and writing dst in one pass, src may
+/// be equal to dst. First skip bytes (less than 16) of iv block keystream are
+/// not used. Sums of src and dst bytes are added to src_sum and dst_sum, both
+/// may be NULL.
+void AES128_CTR_xcrypt_copy_aesni(const uint8_t* round_keys, const uint8_t* iv,
+                                  size_t skip, const uint8_t* src,
+                                  uint8_t* dst, size_t len, uint32_t* src_sum,
+                                  uint32_t* dst_sum);
+
+/// returns nonzero if CPU supports PCLMULQDQ and SSSE3 instructions used by
+/// GHASH_pclmul, checked once
+int GHASH_pclmul_supported(void);
+
+/// GCM GHASH with carry-less multiplication: state = (state ^ block) * H for
+/// every 16-byte block of data, last partial block is padded with zeros.
+/// Must be called only if GHASH_pclmul_supported returns nonzero.
+void GHASH_pclmul(const uint8_t* hash_key, uint8_t* state, const uint8_t* data,
+                  size_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
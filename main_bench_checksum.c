@@ -0,0 +1,162 @@
+/**
+ * \file   main_bench_checksum.c
+ *
+ * \example main_bench_checksum.c
+ *
+ * This is benchmark of Teocli library packet byte checksum. Application
+ * checks that SSE2 and AVX2 implementations of get_byte_checksum and of
+ * copying checksum give bit-identical results to scalar one for every length
+ * up to 1 KB and every misalignment of the buffer, then shows throughput of
+ * each implementation for buffers from 64 B to 64 KB.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_bench_checksum [megabytes]
+ *
+ * **Example:** ./teocli_bench_checksum 1024
+ *
+ * Megabytes are summed for every buffer size and implementation. Exit code is
+ * nonzero if implementations give different results.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libteol0/teonet_l0_client.h"
+
+// Longest buffer compared byte by byte with every misalignment
+#define CHECK_MAX_LENGTH 1024
+// Misalignments of compared buffers, covers AVX2 load width
+#define CHECK_MAX_OFFSET 64
+// Largest benchmarked buffer
+#define BENCH_MAX_LENGTH (64 * 1024)
+
+static const struct {
+    teoLNullChecksumBackend backend;
+    const char *name;
+} backends[] = {
+    {CHECKSUM_BACKEND_SCALAR, "scalar"},
+    {CHECKSUM_BACKEND_SSE2, "SSE2"},
+    {CHECKSUM_BACKEND_AVX2, "AVX2"},
+};
+#define BACKENDS_COUNT (sizeof(backends) / sizeof(backends[0]))
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Compare checksums and copies of backend with scalar ones
+ *
+ * @return Number of mismatches
+ */
+static size_t check(teoLNullChecksumBackend backend, const char *name,
+                    const uint8_t *data) {
+    static uint8_t dest[CHECK_MAX_LENGTH + CHECK_MAX_OFFSET];
+    size_t mismatches = 0;
+
+    for (size_t offset = 0; offset < CHECK_MAX_OFFSET; ++offset) {
+        for (size_t length = 0; length <= CHECK_MAX_LENGTH; ++length) {
+            const uint8_t *src = data + offset;
+
+            teoLNullChecksumSetBackend(CHECKSUM_BACKEND_SCALAR);
+            const uint8_t expected = get_byte_checksum(src, length);
+
+            teoLNullChecksumSetBackend(backend);
+            const uint8_t sum = get_byte_checksum(src, length);
+
+            // Destination is misaligned differently from source
+            uint8_t *to = dest + (CHECK_MAX_OFFSET - 1 - offset);
+            memset(dest, 0, sizeof(dest));
+            const uint8_t copy_sum = teoLNullCopyByteChecksum(to, src, length);
+
+            if (sum != expected || copy_sum != expected ||
+                memcmp(to, src, length) != 0) {
+                if (mismatches == 0) {
+                    printf("%s: mismatch at length %zu offset %zu: "
+                           "%02x/%02x expected %02x\n",
+                           name, length, offset, sum, copy_sum, expected);
+                }
+                ++mismatches;
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+/**
+ * Sum buffer @a rounds times
+ *
+ * @return Throughput in GB/s
+ */
+static double run(const uint8_t *data, size_t size, size_t rounds) {
+    volatile uint8_t sink = 0;
+
+    uint64_t started = now_ns();
+    for (size_t i = 0; i < rounds; ++i) {
+        sink += get_byte_checksum(data, size);
+    }
+    uint64_t elapsed = now_ns() - started;
+    (void)sink;
+
+    return (double)size * rounds / (double)elapsed;
+}
+
+int main(int argc, char **argv) {
+    const size_t megabytes = argc > 1 ? (size_t)atol(argv[1]) : 1024;
+
+    uint8_t *data = malloc(BENCH_MAX_LENGTH + CHECK_MAX_OFFSET);
+    srand((unsigned)time(NULL));
+    for (size_t i = 0; i < BENCH_MAX_LENGTH + CHECK_MAX_OFFSET; ++i) {
+        data[i] = (uint8_t)rand();
+    }
+
+    int supported[BACKENDS_COUNT];
+    int result = 0;
+    for (size_t b = 0; b < BACKENDS_COUNT; ++b) {
+        supported[b] = teoLNullChecksumSetBackend(backends[b].backend);
+        if (!supported[b]) {
+            printf("%s: not supported\n", backends[b].name);
+            continue;
+        }
+
+        size_t mismatches = check(backends[b].backend, backends[b].name, data);
+        printf("%s: %zu mismatches\n", backends[b].name, mismatches);
+        if (mismatches != 0) { result = 1; }
+    }
+
+    printf("%zu MB per run\n%8s", megabytes, "size");
+    for (size_t b = 0; b < BACKENDS_COUNT; ++b) {
+        printf(" %10s GB/s", backends[b].name);
+    }
+    printf("\n");
+
+    for (size_t size = 64; size <= BENCH_MAX_LENGTH; size *= 4) {
+        size_t rounds = megabytes * 1000000 / size;
+        if (rounds == 0) { rounds = 1; }
+
+        printf("%8zu", size);
+        for (size_t b = 0; b < BACKENDS_COUNT; ++b) {
+            double gbs = 0;
+            if (supported[b]) {
+                teoLNullChecksumSetBackend(backends[b].backend);
+                gbs = run(data, size, rounds);
+            }
+            printf(" %15.2f", gbs);
+        }
+        printf("\n");
+    }
+
+    teoLNullChecksumSetBackend(CHECKSUM_BACKEND_AUTO);
+    free(data);
+
+    return result;
+}
@@ -0,0 +1,107 @@
+/**
+ * \file   main_bench_crypt.c
+ *
+ * \example main_bench_crypt.c
+ *
+ * This is benchmark of Teocli library packet encryption. Application
+ * encrypts buffers of typical packet sizes by session engine like
+ * teoLNullPacketEncrypt does, with portable tiny-AES-c and AES-NI
+ * implementations, checks that both give the same ciphertext and shows
+ * throughput of each one.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_bench_crypt [megabytes]
+ *
+ * **Example:** ./teocli_bench_crypt 256
+ *
+ * Megabytes are encrypted for every buffer size and implementation.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libtinycrypt/tinycrypt.h"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Encrypt buffer @a rounds times with new nonce every time like packets of
+ * one session
+ *
+ * @return Throughput in MB/s
+ */
+static double run(AES128_1_Backend backend, const AES128_1_KEY *key,
+                  uint8_t *data, size_t size, size_t rounds) {
+    AES128_1_SetBackend(backend);
+
+    // Key is expanded once per session
+    AES128_1_Engine engine;
+    AES128_1_EngineCreate(&engine, key);
+
+    uint64_t started = now_ns();
+    for (size_t i = 0; i < rounds; ++i) {
+        AES128_1_EngineXCrypt(&engine, (uint32_t)i + 1, data, size);
+    }
+    uint64_t elapsed = now_ns() - started;
+
+    AES128_1_EngineDestroy(&engine);
+
+    return (double)size * rounds / 1e6 / ((double)elapsed / 1e9);
+}
+
+int main(int argc, char **argv) {
+    const size_t megabytes = argc > 1 ? (size_t)atol(argv[1]) : 256;
+    static const size_t sizes[] = {64, 512, 1400, 16384};
+
+    AES128_1_KEY key;
+    randomize_bytes(key.data, sizeof(key.data));
+
+    const int have_aesni = AES128_1_SetBackend(AES128_1_BACKEND_AESNI);
+    printf("%zu MB per run, AES-NI %s\n", megabytes,
+           have_aesni ? "supported" : "not supported");
+    printf("%8s %16s %16s\n", "size", "portable MB/s", "AES-NI MB/s");
+
+    int result = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        const size_t size = sizes[s];
+        uint8_t *portable = malloc(size);
+        uint8_t *aesni = malloc(size);
+        randomize_bytes(portable, size);
+        memcpy(aesni, portable, size);
+
+        size_t rounds = megabytes * 1000000 / size;
+        if (rounds == 0) { rounds = 1; }
+
+        double portable_mbs =
+            run(AES128_1_BACKEND_PORTABLE, &key, portable, size, rounds);
+        double aesni_mbs = 0;
+        if (have_aesni) {
+            aesni_mbs = run(AES128_1_BACKEND_AESNI, &key, aesni, size, rounds);
+
+            // Both buffers got the same sequence of encryptions
+            if (memcmp(portable, aesni, size) != 0) {
+                printf("%8zu: ciphertext mismatch\n", size);
+                result = 1;
+            }
+        }
+
+        printf("%8zu %16.1f %16.1f\n", size, portable_mbs, aesni_mbs);
+
+        free(portable);
+        free(aesni);
+    }
+
+    AES128_1_SetBackend(AES128_1_BACKEND_AUTO);
+
+    return result;
+}
@@ -0,0 +1,116 @@
+/**
+ * \file   main_bench_keypool.c
+ *
+ * \example main_bench_keypool.c
+ *
+ * This is benchmark of Teocli library ECDH key pool. Application creates
+ * encryption contexts like connect path does in bursts of reconnects, with
+ * key pool disabled and with pool of burst depth, and shows median and p99
+ * time of context creation. Pool is refilled between bursts.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_bench_keypool [bursts] [burst_size]
+ *
+ * **Example:** ./teocli_bench_keypool 20 16
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+#include "libteol0/teonet_l0_client_options.h"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Create contexts in bursts and show percentiles of creation time
+ *
+ * @param name Name of run
+ * @param depth Key pool depth, 0 to disable pool
+ * @param bursts Number of bursts
+ * @param burst_size Contexts created in one burst
+ *
+ * @return true if all contexts are created
+ */
+static bool run(const char *name, int32_t depth, size_t bursts,
+                size_t burst_size) {
+    const teoLNullEncryptionProtocol enc_proto = ENC_PROTO_ECDH_AES_128_GCM_V2;
+    const size_t ctx_size = teoLNullEncryptionContextSize(enc_proto);
+    const size_t samples = bursts * burst_size;
+    uint64_t *times = (uint64_t *)malloc(samples * sizeof(uint64_t));
+    teoLNullEncryptionContext ctx;
+    bool ok = times != NULL;
+
+    teoLNUllSetOption_KeyPoolDepth(depth);
+
+    for (size_t i = 0; ok && i < bursts; ++i) {
+        // Let pool thread refill pool like between reconnect storms
+        if (depth > 0) { usleep(200000); }
+
+        for (size_t j = 0; ok && j < burst_size; ++j) {
+            const uint64_t started = now_ns();
+            ok = teoLNullEncryptionContextCreate(enc_proto, (uint8_t *)&ctx,
+                                                 ctx_size) != 0;
+            times[i * burst_size + j] = now_ns() - started;
+            teoLNullEncryptionContextDestroy(&ctx);
+        }
+    }
+
+    teoLNUllSetOption_KeyPoolDepth(0);
+
+    if (!ok) {
+        printf("%-20s context creation failed\n", name);
+        free(times);
+        return false;
+    }
+
+    qsort(times, samples, sizeof(uint64_t), compare_u64);
+    printf("%-20s %12.1f %12.1f %12.1f\n", name,
+           (double)times[samples / 2] / 1000.0,
+           (double)times[samples * 99 / 100] / 1000.0,
+           (double)times[samples - 1] / 1000.0);
+
+    free(times);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t bursts = argc > 1 ? (size_t)atol(argv[1]) : 20;
+    size_t burst_size = argc > 2 ? (size_t)atol(argv[2]) : 16;
+    if (bursts == 0) { bursts = 1; }
+    if (burst_size == 0) { burst_size = 1; }
+
+    teoLNullInit();
+
+    printf("%zu bursts of %zu contexts, creation time in us\n", bursts,
+           burst_size);
+    printf("%-20s %12s %12s %12s\n", "key pool", "median", "p99", "max");
+
+    int result = 0;
+    if (!run("disabled", 0, bursts, burst_size)) { result = 1; }
+    if (!run("burst depth", (int32_t)burst_size, bursts, burst_size)) {
+        result = 1;
+    }
+
+    teoLNullCleanup();
+
+    return result;
+}
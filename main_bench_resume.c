@@ -0,0 +1,260 @@
+/**
+ * \file   main_bench_resume.c
+ *
+ * \example main_bench_resume.c
+ *
+ * This is test peer and benchmark of Teocli library session resumption.
+ * Application plays both sides of key exchange in one process: client side
+ * uses the same functions as connection does, server side answers KEX like
+ * L0 server. For ENC_PROTO_ECDH_AES_128_V1 and ENC_PROTO_ECDH_AES_128_GCM_V2
+ * sessions it:
+ *
+ * *  Makes full ECDH key exchange, exports session ticket on both sides and
+ *    checks that tickets are equal
+ * *  Resumes session by ENC_PROTO_ECDH_AES_128_RESUME_V1 KEX answered by
+ *    teoLNullEncryptionContextAcceptResume, checks that resumed session
+ *    keeps protocol of ticket and packets sent both ways are decrypted
+ * *  Shows handshakes per second of full and resumed key exchange
+ *
+ * Application exits with non-zero status if any check failed.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_bench_resume [handshakes]
+ *
+ * **Example:** ./teocli_bench_resume 200
+ */
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+
+// User command of test packets
+#define CMD_BENCH 129
+// Peer name of test packets
+#define PEER_NAME "resume-peer"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Full key exchange: client sends ECDH public key and salt, server applies
+ * them and answers with its public key and the same salt
+ *
+ * @return true if both sides established session
+ */
+static bool full_kex(teoLNullEncryptionProtocol enc_proto,
+                     teoLNullEncryptionContext *client,
+                     teoLNullEncryptionContext *server) {
+    const size_t ctx_size = teoLNullEncryptionContextSize(enc_proto);
+    const size_t kex_size = teoLNullKEXBufferSize(enc_proto);
+    uint8_t request[kex_size];
+    uint8_t answer[kex_size];
+
+    if (teoLNullEncryptionContextCreate(enc_proto, (uint8_t *)client,
+                                        ctx_size) == 0 ||
+        teoLNullEncryptionContextCreate(enc_proto, (uint8_t *)server,
+                                        ctx_size) == 0) {
+        return false;
+    }
+    server->server_side = true;
+
+    teoLNullKEXCreate(client, request, kex_size);
+    KeyExchangePayload_Common *kex =
+        teoLNullKEXGetFromPayload(request, kex_size);
+    if (kex == NULL || !teoLNullKEXValidate(server, kex, kex_size) ||
+        !teoLNullEncryptionContextApplyKEX(server, kex, kex_size)) {
+        return false;
+    }
+
+    teoLNullKEXCreate(server, answer, kex_size);
+    kex = teoLNullKEXGetFromPayload(answer, kex_size);
+
+    return kex != NULL && teoLNullKEXValidate(client, kex, kex_size) &&
+           teoLNullEncryptionContextApplyKEX(client, kex, kex_size);
+}
+
+/**
+ * Resume key exchange: client sends ticket id and salt, server finds ticket
+ * and answers with its salt
+ *
+ * @return true if both sides established session
+ */
+static bool resume_kex(const teoLNullSessionTicket *client_ticket,
+                       const teoLNullSessionTicket *server_ticket,
+                       teoLNullEncryptionContext *client,
+                       teoLNullEncryptionContext *server) {
+    const size_t ctx_size =
+        teoLNullEncryptionContextSize(ENC_PROTO_ECDH_AES_128_RESUME_V1);
+    const size_t kex_size =
+        teoLNullKEXBufferSize(ENC_PROTO_ECDH_AES_128_RESUME_V1);
+    uint8_t request[kex_size];
+    uint8_t answer[kex_size];
+
+    if (teoLNullEncryptionContextCreateResume(client_ticket, (uint8_t *)client,
+                                              ctx_size) == 0) {
+        return false;
+    }
+
+    teoLNullKEXCreate(client, request, kex_size);
+    KeyExchangePayload_Common *kex =
+        teoLNullKEXGetFromPayload(request, kex_size);
+    if (kex == NULL || !teoLNullKEXValidate(NULL, kex, kex_size)) {
+        return false;
+    }
+
+    // Server finds ticket by its id
+    const uint8_t *ticket_id = teoLNullKEXResumeTicketId(kex, kex_size);
+    if (ticket_id == NULL ||
+        memcmp(ticket_id, server_ticket->id, sizeof(server_ticket->id)) != 0) {
+        return false;
+    }
+
+    if (teoLNullEncryptionContextAcceptResume(server_ticket, kex, kex_size,
+                                              answer, kex_size,
+                                              (uint8_t *)server,
+                                              ctx_size) == 0) {
+        return false;
+    }
+
+    kex = teoLNullKEXGetFromPayload(answer, kex_size);
+
+    return kex != NULL && teoLNullKEXValidate(client, kex, kex_size) &&
+           teoLNullEncryptionContextApplyKEX(client, kex, kex_size);
+}
+
+/**
+ * Send packet from one side to another and check it is decrypted
+ *
+ * @return true if packet is encrypted and decrypted to the same data
+ */
+static bool packet_check(teoLNullEncryptionContext *from,
+                         teoLNullEncryptionContext *to) {
+    static const char data[] = "resumed session data";
+    uint8_t buffer[teoLNullBufferSize(sizeof(PEER_NAME), sizeof(data)) +
+                   TEOLNULL_AEAD_TAG_SIZE + TEOLNULL_EXPLICIT_NONCE_SIZE];
+    memset(buffer, 0, sizeof(buffer));
+
+    teoLNullCPacket *packet = (teoLNullCPacket *)buffer;
+    packet->cmd = CMD_BENCH;
+    packet->peer_name_length = sizeof(PEER_NAME);
+    packet->data_length = sizeof(data);
+    memcpy(packet->peer_name, PEER_NAME, sizeof(PEER_NAME));
+    memcpy(teoLNullPacketGetPayload(packet), data, sizeof(data));
+
+    teoLNullPacketEncrypt(from, packet);
+    if (!teoLNullPacketIsEncrypted(packet) ||
+        memcmp(teoLNullPacketGetPayload(packet), data, sizeof(data)) == 0) {
+        return false;
+    }
+
+    return teoLNullPacketDecrypt(to, packet) &&
+           packet->data_length == sizeof(data) &&
+           memcmp(teoLNullPacketGetPayload(packet), data, sizeof(data)) == 0;
+}
+
+/**
+ * Check full and resumed sessions of protocol and measure handshakes
+ *
+ * @return true if all checks passed
+ */
+static bool run(teoLNullEncryptionProtocol enc_proto, size_t handshakes) {
+    teoLNullEncryptionContext client, server;
+    teoLNullEncryptionContext resumed_client, resumed_server;
+    teoLNullSessionTicket client_ticket, server_ticket;
+    const char *name = STRING_teoLNullEncryptionProtocol(enc_proto);
+
+    if (!full_kex(enc_proto, &client, &server) ||
+        !teoLNullEncryptionContextExportTicket(&client, &client_ticket) ||
+        !teoLNullEncryptionContextExportTicket(&server, &server_ticket)) {
+        printf("%-30s full key exchange failed\n", name);
+        return false;
+    }
+
+    bool ok = packet_check(&client, &server) && packet_check(&server, &client);
+    ok = ok && memcmp(client_ticket.id, server_ticket.id,
+                      sizeof(client_ticket.id)) == 0 &&
+         memcmp(client_ticket.key.data, server_ticket.key.data,
+                sizeof(client_ticket.key.data)) == 0 &&
+         client_ticket.protocol == enc_proto &&
+         server_ticket.protocol == enc_proto;
+    if (!ok) {
+        printf("%-30s full session check failed\n", name);
+        return false;
+    }
+
+    if (!resume_kex(&client_ticket, &server_ticket, &resumed_client,
+                    &resumed_server)) {
+        printf("%-30s resume key exchange failed\n", name);
+        return false;
+    }
+
+    // Resumed session keeps protocol of ticket
+    ok = resumed_client.enc_proto == enc_proto &&
+         resumed_server.enc_proto == enc_proto &&
+         teoLNullEncryptionOverhead(&resumed_client) ==
+             teoLNullEncryptionOverhead(&client);
+    for (int i = 0; ok && i < 4; ++i) {
+        ok = packet_check(&resumed_client, &resumed_server) &&
+             packet_check(&resumed_server, &resumed_client);
+    }
+    if (!ok) {
+        printf("%-30s resumed session check failed\n", name);
+        return false;
+    }
+
+    teoLNullEncryptionContextDestroy(&resumed_client);
+    teoLNullEncryptionContextDestroy(&resumed_server);
+    teoLNullEncryptionContextDestroy(&client);
+    teoLNullEncryptionContextDestroy(&server);
+
+    uint64_t started = now_ns();
+    for (size_t i = 0; i < handshakes; ++i) {
+        full_kex(enc_proto, &client, &server);
+        teoLNullEncryptionContextDestroy(&client);
+        teoLNullEncryptionContextDestroy(&server);
+    }
+    const double full_rate =
+        (double)handshakes / ((double)(now_ns() - started) / 1e9);
+
+    started = now_ns();
+    for (size_t i = 0; i < handshakes; ++i) {
+        resume_kex(&client_ticket, &server_ticket, &resumed_client,
+                   &resumed_server);
+        teoLNullEncryptionContextDestroy(&resumed_client);
+        teoLNullEncryptionContextDestroy(&resumed_server);
+    }
+    const double resume_rate =
+        (double)handshakes / ((double)(now_ns() - started) / 1e9);
+
+    printf("%-30s %12.0f %12.0f %8.1fx\n", name, full_rate, resume_rate,
+           resume_rate / full_rate);
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t handshakes = argc > 1 ? (size_t)atol(argv[1]) : 200;
+    if (handshakes == 0) { handshakes = 1; }
+
+    printf("%zu handshakes per run, both sides in one thread\n", handshakes);
+    printf("%-30s %12s %12s %9s\n", "protocol", "full/s", "resumed/s",
+           "speedup");
+
+    int result = 0;
+    if (!run(ENC_PROTO_ECDH_AES_128_V1, handshakes)) { result = 1; }
+    if (!run(ENC_PROTO_ECDH_AES_128_GCM_V2, handshakes)) { result = 1; }
+
+    return result;
+}
@@ -0,0 +1,327 @@
+/**
+ * \file   main_bench_shards.c
+ *
+ * \example main_bench_shards.c
+ *
+ * This is benchmark of Teocli library sharded reactor threads. Application
+ * starts loopback TCP echo server with one thread per CPU, connects number of
+ * connections, adds them to teoLNullReactorPool and sends packets to them by
+ * teoLNullReactorPoolSend from several sender threads. Every run uses twice
+ * more shards than previous one, up to number of CPUs (at least 4 shards),
+ * and shows echoed messages per second.
+ *
+ * Shards scale with CPU cores: on one CPU all shard threads share the core,
+ * so more shards only add thread switches and doorbell wakeups.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_bench_shards [connections] [senders] [messages]
+ *
+ * **Example:** ./teocli_bench_shards 200 4 1000000
+ *
+ * Messages is total number of echoed messages of every run. Linux only.
+ */
+
+#define _GNU_SOURCE
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+#include "libteol0/teonet_l0_client_options.h"
+#include "libteol0/teonet_l0_client_reactor.h"
+
+// User command of benchmark packets
+#define CMD_BENCH 129
+// Packet data size
+#define DATA_SIZE 64
+// Messages sent and not echoed yet, limits memory of shard queues
+#define SEND_WINDOW 4096
+// Run is stopped if echoes stop coming for this time, ns
+#define STALL_TIMEOUT_NS 5000000000ull
+
+/////////////////
+// Loopback echo server
+/////////////////
+
+/**
+ * Echo server thread, connections are shared by threads by SO_REUSEPORT
+ */
+static void *echo_server(void *arg) {
+    int listen_fd = *(int *)arg;
+
+    int epoll_fd = epoll_create1(0);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+
+    char buffer[65536];
+    struct epoll_event events[64];
+    for (;;) {
+        int ready = epoll_wait(epoll_fd, events, 64, -1);
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd) {
+                int con_fd = accept(listen_fd, NULL, NULL);
+                if (con_fd == -1) { continue; }
+                event.data.fd = con_fd;
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, con_fd, &event);
+                continue;
+            }
+
+            ssize_t rc = recv(fd, buffer, sizeof(buffer), 0);
+            if (rc <= 0) {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+                close(fd);
+                continue;
+            }
+
+            ssize_t sent = 0;
+            while (sent < rc) {
+                ssize_t snd = send(fd, buffer + sent, rc - sent, MSG_NOSIGNAL);
+                if (snd <= 0) { break; }
+                sent += snd;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Start echo server threads listening one loopback port
+ *
+ * @return Port or -1 at error
+ */
+static int echo_start(long threads) {
+    int port = 0;
+
+    for (long i = 0; i < threads; ++i) {
+        int *listen_fd = malloc(sizeof(int));
+        *listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(*listen_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)port);
+        socklen_t addr_len = sizeof(addr);
+        if (bind(*listen_fd, (struct sockaddr *)&addr, addr_len) == -1 ||
+            listen(*listen_fd, 1024) == -1 ||
+            getsockname(*listen_fd, (struct sockaddr *)&addr, &addr_len) ==
+                -1) {
+            perror("echo server");
+            return -1;
+        }
+        port = ntohs(addr.sin_port);
+
+        pthread_t server;
+        pthread_create(&server, NULL, echo_server, listen_fd);
+        pthread_detach(server);
+    }
+
+    return port;
+}
+
+/////////////////
+// Benchmark
+/////////////////
+
+struct bench {
+    teoLNullConnectData **cons; ///< Connections
+    size_t connections;         ///< Number of connections
+    size_t senders;             ///< Number of sender threads
+    size_t messages;            ///< Messages of every run
+    uint64_t sent;              ///< Messages sent, atomic
+    uint64_t received;          ///< Messages echoed, atomic
+    bool stop;                  ///< Stop senders of stalled run, atomic
+};
+
+struct sender {
+    struct bench *b;
+    size_t index; ///< Sender index, sends to every senders-th connection
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Connection event callback, called by shard threads
+ */
+static void event_cb(void *con, teoLNullEvents event, void *data,
+                     size_t data_len, void *user_data) {
+    struct bench *b = user_data;
+    (void)con;
+    (void)data_len;
+
+    if (event != EV_L_RECEIVED) { return; }
+
+    teoLNullCPacket *cp = data;
+    if (cp->cmd != CMD_BENCH) { return; }
+
+    __atomic_add_fetch(&b->received, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Sender thread, sends its share of messages to its connections in turn
+ */
+static void *sender_thread(void *arg) {
+    struct sender *s = arg;
+    struct bench *b = s->b;
+    uint8_t data[DATA_SIZE];
+    memset(data, 0, sizeof(data));
+
+    size_t count = b->messages / b->senders;
+    if (s->index < b->messages % b->senders) { ++count; }
+
+    size_t con_index = s->index;
+    for (size_t i = 0; i < count; ++i) {
+        while (__atomic_load_n(&b->sent, __ATOMIC_RELAXED) -
+                   __atomic_load_n(&b->received, __ATOMIC_RELAXED) >=
+               SEND_WINDOW) {
+            if (__atomic_load_n(&b->stop, __ATOMIC_RELAXED)) { return NULL; }
+            sched_yield();
+        }
+
+        __atomic_add_fetch(&b->sent, 1, __ATOMIC_RELAXED);
+        teoLNullReactorPoolSend(b->cons[con_index], CMD_BENCH, "bench", data,
+                                sizeof(data));
+
+        con_index += b->senders;
+        if (con_index >= b->connections) { con_index = s->index; }
+    }
+
+    return NULL;
+}
+
+/**
+ * Echo messages through pool of @a shards shards
+ *
+ * @return Messages per second or 0 at error
+ */
+static double run(struct bench *b, int port, size_t shards) {
+    teoLNullReactorPool *pool = teoLNullReactorPoolCreate(shards, false);
+    if (pool == NULL) { return 0; }
+
+    b->sent = 0;
+    b->received = 0;
+    b->stop = false;
+
+    for (size_t i = 0; i < b->connections; ++i) {
+        b->cons[i] =
+            teoLNullConnectE("127.0.0.1", (int16_t)port, event_cb, b, TCP);
+        if (b->cons[i] == NULL || b->cons[i]->status <= 0 ||
+            !teoLNullReactorPoolAdd(pool, b->cons[i], NULL)) {
+            printf("%6zu shards: can't connect\n", shards);
+            teoLNullDisconnect(b->cons[i]);
+            for (size_t j = 0; j < i; ++j) {
+                teoLNullReactorPoolDisconnect(b->cons[j]);
+            }
+            teoLNullReactorPoolDestroy(pool);
+            return 0;
+        }
+    }
+
+    pthread_t *threads = malloc(b->senders * sizeof(pthread_t));
+    struct sender *senders = malloc(b->senders * sizeof(struct sender));
+
+    uint64_t started = now_ns();
+    for (size_t i = 0; i < b->senders; ++i) {
+        senders[i].b = b;
+        senders[i].index = i;
+        pthread_create(&threads[i], NULL, sender_thread, &senders[i]);
+    }
+
+    uint64_t last_received = 0;
+    uint64_t last_progress = started;
+    for (;;) {
+        uint64_t received = __atomic_load_n(&b->received, __ATOMIC_RELAXED);
+        if (received >= b->messages) { break; }
+
+        uint64_t now = now_ns();
+        if (received != last_received) {
+            last_received = received;
+            last_progress = now;
+        } else if (now - last_progress > STALL_TIMEOUT_NS) {
+            printf("%6zu shards: stalled at %llu of %zu messages\n", shards,
+                   (unsigned long long)received, b->messages);
+            __atomic_store_n(&b->stop, true, __ATOMIC_RELAXED);
+            break;
+        }
+        usleep(1000);
+    }
+    uint64_t elapsed = now_ns() - started;
+
+    for (size_t i = 0; i < b->senders; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    free(senders);
+
+    for (size_t i = 0; i < b->connections; ++i) {
+        teoLNullReactorPoolDisconnect(b->cons[i]);
+    }
+    teoLNullReactorPoolDestroy(pool);
+
+    return (double)__atomic_load_n(&b->received, __ATOMIC_RELAXED) /
+           ((double)elapsed / 1e9);
+}
+
+int main(int argc, char **argv) {
+    struct bench b;
+    memset(&b, 0, sizeof(b));
+    b.connections = argc > 1 ? (size_t)atol(argv[1]) : 200;
+    b.senders = argc > 2 ? (size_t)atol(argv[2]) : 4;
+    b.messages = argc > 3 ? (size_t)atol(argv[3]) : 1000000;
+    if (b.connections == 0) { b.connections = 1; }
+    if (b.senders == 0) { b.senders = 1; }
+    if (b.senders > b.connections) { b.senders = b.connections; }
+    b.cons = calloc(b.connections, sizeof(teoLNullConnectData *));
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) { cpus = 1; }
+
+    int port = echo_start(cpus);
+    if (port == -1) { return 1; }
+
+    teoLNullInit();
+    teoLNUllSetOption_EncryptionProtocol(ENC_PROTO_DISABLED);
+
+    printf("%ld CPUs, %zu connections, %zu senders, %zu messages of %d "
+           "bytes\n",
+           cpus, b.connections, b.senders, b.messages, DATA_SIZE);
+
+    const size_t max_shards = cpus > 4 ? (size_t)cpus : 4;
+    int result = 0;
+    for (size_t shards = 1; shards <= max_shards; shards *= 2) {
+        double rate = run(&b, port, shards);
+        if (rate == 0) {
+            result = 1;
+            continue;
+        }
+        printf("%6zu shards: %10.0f msg/s\n", shards, rate);
+    }
+
+    teoLNullCleanup();
+    free(b.cons);
+
+    return result;
+}
@@ -0,0 +1,251 @@
+/**
+ * \file   main_bench_udp.c
+ *
+ * \example main_bench_udp.c
+ *
+ * This is benchmark of Teocli library batched UDP output used by TR-UDP
+ * connections. Application starts loopback UDP receiver thread and sends
+ * datagrams of equal size to it in three modes:
+ *
+ * *  sendto: one system call per datagram, as without
+ *    teoLNUllSetOption_UdpSendBatch
+ * *  sendmmsg: datagrams collected by teoLNullUdpSender are flushed with one
+ *    sendmmsg
+ * *  sendmmsg + GSO: equal sized datagrams are passed to kernel as one
+ *    UDP_SEGMENT send, as with teoLNUllSetOption_UdpSegmentOffload
+ *
+ * Sent and received datagrams per second and system calls per datagram are
+ * shown. Loopback drops datagrams receiver can't keep up with, so received
+ * rate is limited by receiver thread.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_bench_udp [datagrams] [datagram_size]
+ *
+ * **Example:** ./teocli_bench_udp 1000000 512
+ *
+ * Linux only.
+ */
+
+#define _GNU_SOURCE
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client_udp.h"
+
+// Datagrams collected before flush, as in TR-UDP connection
+#define BATCH_SIZE 64
+// Maximum datagram size
+#define MAX_DATAGRAM_SIZE 65000
+// Receiver is idle for this time after all datagrams are sent, ms
+#define RECEIVE_IDLE_MS 200
+// Socket buffers size
+#define SOCKET_BUFFER_SIZE (8 * 1024 * 1024)
+
+/////////////////
+// Loopback receiver
+/////////////////
+
+struct receiver {
+    int fd;            ///< Receiver socket
+    uint64_t received; ///< Datagrams received, atomic
+    bool stop;         ///< Stop receiver thread, atomic
+};
+
+static void count_datagram(void *data, size_t data_length,
+                           struct sockaddr_in *addr, void *user_data) {
+    struct receiver *r = user_data;
+    (void)data;
+    (void)data_length;
+    (void)addr;
+
+    __atomic_add_fetch(&r->received, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Receiver thread, receives datagrams by recvmmsg and counts them
+ */
+static void *receiver_thread(void *arg) {
+    struct receiver *r = arg;
+
+    teoLNullUdpReceiver *receiver =
+        teoLNullUdpReceiverCreate(BATCH_SIZE, MAX_DATAGRAM_SIZE);
+    if (receiver == NULL) { return NULL; }
+
+    struct pollfd pfd;
+    pfd.fd = r->fd;
+    pfd.events = POLLIN;
+
+    while (!__atomic_load_n(&r->stop, __ATOMIC_RELAXED)) {
+        if (poll(&pfd, 1, 10) <= 0) { continue; }
+
+        while (teoLNullUdpReceive(receiver, r->fd, BATCH_SIZE, count_datagram,
+                                  r) > 0) {}
+    }
+
+    teoLNullUdpReceiverDestroy(receiver);
+
+    return NULL;
+}
+
+/**
+ * Create loopback UDP socket with large buffers
+ *
+ * @return Socket or -1 at error
+ */
+static int udp_socket(struct sockaddr_in *addr) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == -1) { return -1; }
+
+    int size = SOCKET_BUFFER_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(*addr);
+    if (bind(fd, (struct sockaddr *)addr, addr_len) == -1 ||
+        getsockname(fd, (struct sockaddr *)addr, &addr_len) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/////////////////
+// Benchmark
+/////////////////
+
+enum send_mode {
+    MODE_SENDTO,
+    MODE_SENDMMSG,
+    MODE_SEGMENT_OFFLOAD,
+};
+
+static const char *mode_names[] = {"sendto", "sendmmsg", "sendmmsg + GSO"};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Send datagrams in one mode and show results
+ *
+ * @return true on success
+ */
+static bool run(struct receiver *r, const struct sockaddr_in *to,
+                enum send_mode mode, size_t datagrams, size_t datagram_size) {
+    struct sockaddr_in from;
+    int fd = udp_socket(&from);
+    if (fd == -1) {
+        perror("sender socket");
+        return false;
+    }
+
+    teoLNullUdpSender *sender =
+        teoLNullUdpSenderCreate(BATCH_SIZE, BATCH_SIZE * datagram_size);
+    uint8_t *data = calloc(1, datagram_size);
+    if (sender == NULL || data == NULL) {
+        teoLNullUdpSenderDestroy(sender);
+        free(data);
+        close(fd);
+        return false;
+    }
+
+    const bool segment_offload = mode == MODE_SEGMENT_OFFLOAD;
+    __atomic_store_n(&r->received, 0, __ATOMIC_RELAXED);
+
+    uint64_t calls = 0;
+    uint64_t started = now_ns();
+    for (size_t i = 0; i < datagrams; ++i) {
+        if (mode == MODE_SENDTO) {
+            sendto(fd, data, datagram_size, 0, (const struct sockaddr *)to,
+                   sizeof(*to));
+            ++calls;
+            continue;
+        }
+
+        teoLNullUdpSenderAdd(sender, fd, data, datagram_size, to,
+                             segment_offload);
+        if ((i + 1) % BATCH_SIZE == 0 || i + 1 == datagrams) {
+            calls += teoLNullUdpSenderFlush(sender, fd, segment_offload);
+        }
+    }
+    uint64_t elapsed = now_ns() - started;
+
+    // Wait for receiver to drain socket
+    uint64_t received = 0;
+    for (;;) {
+        usleep(RECEIVE_IDLE_MS * 1000);
+        uint64_t now_received =
+            __atomic_load_n(&r->received, __ATOMIC_RELAXED);
+        if (now_received == received) { break; }
+        received = now_received;
+    }
+
+    const double seconds = (double)elapsed / 1e9;
+    printf("%-16s %12.0f %12.0f %10.3f %7.1f%%\n", mode_names[mode],
+           (double)datagrams / seconds, (double)received / seconds,
+           (double)calls / (double)datagrams,
+           100.0 * (double)(datagrams - received) / (double)datagrams);
+
+    teoLNullUdpSenderDestroy(sender);
+    free(data);
+    close(fd);
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t datagrams = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+    size_t datagram_size = argc > 2 ? (size_t)atol(argv[2]) : 512;
+    if (datagrams == 0) { datagrams = 1; }
+    if (datagram_size == 0) { datagram_size = 1; }
+    if (datagram_size > MAX_DATAGRAM_SIZE) {
+        datagram_size = MAX_DATAGRAM_SIZE;
+    }
+
+    struct receiver r;
+    memset(&r, 0, sizeof(r));
+    struct sockaddr_in to;
+    r.fd = udp_socket(&to);
+    if (r.fd == -1) {
+        perror("receiver socket");
+        return 1;
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, receiver_thread, &r);
+
+    printf("%zu datagrams of %zu bytes, batches of %d\n\n", datagrams,
+           datagram_size, BATCH_SIZE);
+    printf("%-16s %12s %12s %10s %8s\n", "mode", "sent/s", "received/s",
+           "calls/dgm", "lost");
+
+    int result = 0;
+    for (int mode = MODE_SENDTO; mode <= MODE_SEGMENT_OFFLOAD; ++mode) {
+        if (!run(&r, &to, (enum send_mode)mode, datagrams, datagram_size)) {
+            result = 1;
+        }
+    }
+
+    __atomic_store_n(&r.stop, true, __ATOMIC_RELAXED);
+    pthread_join(thread, NULL);
+    close(r.fd);
+
+    return result;
+}
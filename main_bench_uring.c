@@ -0,0 +1,263 @@
+/**
+ * \file   main_bench_uring.c
+ *
+ * \example main_bench_uring.c
+ *
+ * This is benchmark of Teocli library io_uring backend. Application starts
+ * loopback TCP echo server thread and compares select and io_uring backends
+ * of TCP connection:
+ *
+ * *  Ping-pong latency: one packet is sent and echo is waited for, p50 and
+ *    p99 of round trip time are shown
+ * *  Pipelined echo: packets are sent from receive event keeping window of
+ *    packets in flight, system calls of event loop thread per packet are
+ *    shown
+ *
+ * System calls are counted by wrappers of libc socket functions, io_uring
+ * system calls are counted by syscall wrapper.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_bench_uring [packets] [data_size]
+ *
+ * **Example:** ./teocli_bench_uring 20000 64
+ *
+ * Linux only.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+#include "libteol0/teonet_l0_client_options.h"
+
+// User command of benchmark packets
+#define CMD_BENCH 129
+// Number of pipelined packets in flight
+#define PIPELINE_WINDOW 32
+
+/////////////////
+// System call counting
+/////////////////
+
+static __thread int count_syscalls;
+static __thread uint64_t syscalls;
+
+#define COUNTED(name, ret, params, args)                                      \
+    ret name params {                                                         \
+        static ret(*next) params;                                             \
+        if (next == NULL) { next = (ret(*) params)dlsym(RTLD_NEXT, #name); } \
+        if (count_syscalls) { ++syscalls; }                                   \
+        return next args;                                                     \
+    }
+
+COUNTED(send, ssize_t, (int fd, const void *buf, size_t len, int flags),
+        (fd, buf, len, flags))
+COUNTED(sendto, ssize_t,
+        (int fd, const void *buf, size_t len, int flags,
+         const struct sockaddr *addr, socklen_t addr_len),
+        (fd, buf, len, flags, addr, addr_len))
+COUNTED(sendmsg, ssize_t, (int fd, const struct msghdr *msg, int flags),
+        (fd, msg, flags))
+COUNTED(recv, ssize_t, (int fd, void *buf, size_t len, int flags),
+        (fd, buf, len, flags))
+COUNTED(recvfrom, ssize_t,
+        (int fd, void *buf, size_t len, int flags, struct sockaddr *addr,
+         socklen_t *addr_len),
+        (fd, buf, len, flags, addr, addr_len))
+COUNTED(recvmsg, ssize_t, (int fd, struct msghdr *msg, int flags),
+        (fd, msg, flags))
+COUNTED(read, ssize_t, (int fd, void *buf, size_t len), (fd, buf, len))
+COUNTED(write, ssize_t, (int fd, const void *buf, size_t len),
+        (fd, buf, len))
+COUNTED(select, int,
+        (int nfds, fd_set *rfds, fd_set *wfds, fd_set *efds,
+         struct timeval *tv),
+        (nfds, rfds, wfds, efds, tv))
+COUNTED(poll, int, (struct pollfd *fds, nfds_t nfds, int timeout),
+        (fds, nfds, timeout))
+
+long syscall(long number, ...) {
+    static long (*next)(long, ...);
+    if (next == NULL) {
+        next = (long (*)(long, ...))dlsym(RTLD_NEXT, "syscall");
+    }
+    if (count_syscalls) { ++syscalls; }
+
+    va_list ap;
+    va_start(ap, number);
+    long a[6];
+    for (int i = 0; i < 6; ++i) { a[i] = va_arg(ap, long); }
+    va_end(ap);
+
+    return next(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+/////////////////
+// Loopback echo server
+/////////////////
+
+static void *echo_server(void *arg) {
+    int listen_fd = *(int *)arg;
+
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd == -1) { break; }
+
+        char buffer[65536];
+        ssize_t rc;
+        while ((rc = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            ssize_t sent = 0;
+            while (sent < rc) {
+                ssize_t snd = send(fd, buffer + sent, rc - sent, MSG_NOSIGNAL);
+                if (snd <= 0) { break; }
+                sent += snd;
+            }
+        }
+        close(fd);
+    }
+
+    return NULL;
+}
+
+/////////////////
+// Benchmark
+/////////////////
+
+struct bench {
+    size_t packets;    ///< Number of packets of every test
+    size_t data_size;  ///< Packet data size
+    uint8_t *data;     ///< Packet data
+    size_t sent;       ///< Packets sent by pipelined test
+    size_t received;   ///< Packets received
+    bool pipelined;    ///< Pipelined test is running
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void event_cb(void *con, teoLNullEvents event, void *data,
+                     size_t data_len, void *user_data) {
+    struct bench *b = user_data;
+    (void)data_len;
+
+    if (event != EV_L_RECEIVED) { return; }
+
+    teoLNullCPacket *cp = data;
+    if (cp->cmd != CMD_BENCH) { return; }
+
+    ++b->received;
+    if (b->pipelined && b->sent < b->packets) {
+        teoLNullSend(con, CMD_BENCH, "bench", b->data, b->data_size);
+        ++b->sent;
+    }
+}
+
+static void run(struct bench *b, int port, bool io_uring) {
+    teoLNUllSetOption_IoUring(io_uring);
+
+    teoLNullConnectData *con =
+        teoLNullConnectE("127.0.0.1", (int16_t)port, event_cb, b, TCP);
+    if (con == NULL || con->status <= 0) {
+        printf("%-9s can't connect\n", io_uring ? "io_uring" : "select");
+        teoLNullDisconnect(con);
+        return;
+    }
+
+    // Ping-pong latency
+    uint64_t *rtt = malloc(b->packets * sizeof(uint64_t));
+    b->pipelined = false;
+    b->received = 0;
+    for (size_t i = 0; i < b->packets; ++i) {
+        uint64_t started = now_ns();
+        teoLNullSend(con, CMD_BENCH, "bench", b->data, b->data_size);
+        while (b->received == i) { teoLNullReadEventLoop(con, 1000); }
+        rtt[i] = now_ns() - started;
+    }
+    qsort(rtt, b->packets, sizeof(uint64_t), compare_u64);
+    uint64_t p50 = rtt[b->packets / 2];
+    uint64_t p99 = rtt[b->packets * 99 / 100];
+    free(rtt);
+
+    // Pipelined echo
+    b->pipelined = true;
+    b->received = 0;
+    b->sent = 0;
+    syscalls = 0;
+    count_syscalls = 1;
+    uint64_t started = now_ns();
+    while (b->sent < PIPELINE_WINDOW && b->sent < b->packets) {
+        teoLNullSend(con, CMD_BENCH, "bench", b->data, b->data_size);
+        ++b->sent;
+    }
+    while (b->received < b->packets) { teoLNullReadEventLoop(con, 1000); }
+    uint64_t elapsed = now_ns() - started;
+    count_syscalls = 0;
+
+    printf("%-9s p50 %7.1f us  p99 %7.1f us  pipelined %6.2f syscalls/msg "
+           "%9.0f msg/s\n",
+           io_uring ? "io_uring" : "select", p50 / 1000.0, p99 / 1000.0,
+           (double)syscalls / b->packets,
+           b->packets / (elapsed / 1000000000.0));
+
+    teoLNullDisconnect(con);
+}
+
+int main(int argc, char **argv) {
+    struct bench b;
+    memset(&b, 0, sizeof(b));
+    b.packets = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+    b.data_size = argc > 2 ? (size_t)atol(argv[2]) : 64;
+    if (b.packets == 0) { b.packets = 1; }
+    b.data = calloc(1, b.data_size ? b.data_size : 1);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listen_fd, (struct sockaddr *)&addr, addr_len) == -1 ||
+        listen(listen_fd, 4) == -1 ||
+        getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) == -1) {
+        perror("echo server");
+        return 1;
+    }
+
+    pthread_t server;
+    pthread_create(&server, NULL, echo_server, &listen_fd);
+
+    teoLNullInit();
+    teoLNUllSetOption_EncryptionProtocol(ENC_PROTO_DISABLED);
+
+    printf("%zu packets of %zu bytes\n", b.packets, b.data_size);
+    run(&b, ntohs(addr.sin_port), false);
+    run(&b, ntohs(addr.sin_port), true);
+
+    teoLNullCleanup();
+    free(b.data);
+
+    return 0;
+}
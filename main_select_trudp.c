@@ -673,8 +673,12 @@ static teoLNullConnectData* trudpLNullConnect(void *user_data) {
 
     con->last_packet_offset = 0;
     con->read_buffer = NULL;
-    con->read_buffer_offset = 0;
-    con->read_buffer_size = 0;
+    con->recv_ring = NULL;
+    con->recv_ring_size = 0;
+    con->recv_ring_head = 0;
+    con->recv_ring_length = 0;
+    con->recv_ring_peak = 0;
+    con->recv_scratch = NULL;
     con->event_cb = event_cb;
     con->user_data = user_data;
     